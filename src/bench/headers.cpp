@@ -0,0 +1,68 @@
+// Copyright (c) 2018 The Libercoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "main.h"
+
+// Headers per batch, a full headers message carries up to MAX_HEADERS_RESULTS
+static const size_t BENCH_HEADERS_COUNT = 64;
+
+// Headers above the precomputed hash table and below the height targets are enforced from, so every
+// header gets hashed. The parent is put in the block index once for all benchmarks
+static const std::vector<CBlockHeader>& BenchHeaders()
+{
+    static std::vector<CBlockHeader> headers;
+    if (!headers.empty())
+        return headers;
+
+    SelectParams(CBaseChainParams::MAIN);
+    CBlockHeader parent;
+    parent.nNonce = 1;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindex = new CBlockIndex(parent);
+        BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(parent.GetHash(), pindex)).first;
+        pindex->phashBlock = &mi->first;
+        pindex->nHeight = 232000;
+    }
+
+    uint256 hashPrevBlock = parent.GetHash();
+    headers.resize(BENCH_HEADERS_COUNT);
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = 4;
+        headers[i].hashPrevBlock = hashPrevBlock;
+        headers[i].nTime = 1500000000 + i * 150;
+        headers[i].nBits = UintToArith256(Params().GetConsensus().powLimit).GetCompact();
+        headers[i].nNonce = i;
+        hashPrevBlock = headers[i].GetHash();
+    }
+    return headers;
+}
+
+// One header after the other, as AcceptBlockHeader hashes them under cs_main
+static void HeadersPoW_Serial(benchmark::State& state)
+{
+    const std::vector<CBlockHeader>& headers = BenchHeaders();
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < headers.size(); i++)
+            headers[i].GetPoWHash(232001 + (int)i);
+    }
+}
+
+// The same batch on the parallel task pool, should be faster by about the number of cores
+static void HeadersPoW_Precompute(benchmark::State& state)
+{
+    const std::vector<CBlockHeader>& headers = BenchHeaders();
+    while (state.KeepRunning()) {
+        // fresh copies, the hashes remembered by the previous round would be skipped over
+        std::vector<CBlockHeader> batch(headers);
+        PrecomputeHeadersPoW(batch, Params());
+    }
+}
+
+BENCHMARK(HeadersPoW_Serial);
+BENCHMARK(HeadersPoW_Precompute);
@@ -0,0 +1,67 @@
+// Copyright (c) 2018 The Libercoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+
+// debug.log of a scratch data directory, opened once for all logging benchmarks
+static void OpenBenchDebugLog()
+{
+    static bool fOpened = false;
+    if (fOpened)
+        return;
+    fOpened = true;
+
+    boost::filesystem::path pathTemp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("bench_logging_%%%%%%%%");
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+    ClearDatadirCache();
+    OpenDebugLog();
+}
+
+static void LogPrintDisabledCategory(benchmark::State& state)
+{
+    bool fDebugOld = fDebug;
+    fDebug = true;
+    const std::string strArg(256, 'a');
+    while (state.KeepRunning()) {
+        LogPrint("bench-disabled", "LogPrintDisabledCategory %d %s\n", 42, strArg);
+    }
+    fDebug = fDebugOld;
+}
+
+static void LogPrintToDebugLog(benchmark::State& state, bool fAsync)
+{
+    OpenBenchDebugLog();
+    fPrintToDebugLog = true;
+    if (fAsync)
+        StartDebugLogWriter();
+
+    const std::string strArg(64, 'a');
+    int n = 0;
+    while (state.KeepRunning()) {
+        LogPrintf("LogPrintToDebugLog %d %s\n", n++, strArg);
+    }
+
+    if (fAsync)
+        StopDebugLogWriter();
+    fPrintToDebugLog = false;
+}
+
+static void LogPrintfSync(benchmark::State& state)
+{
+    LogPrintToDebugLog(state, false);
+}
+
+static void LogPrintfAsync(benchmark::State& state)
+{
+    LogPrintToDebugLog(state, true);
+}
+
+BENCHMARK(LogPrintDisabledCategory);
+BENCHMARK(LogPrintfSync);
+BENCHMARK(LogPrintfAsync);
@@ -0,0 +1,91 @@
+// Copyright (c) 2018 The Libercoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "crypto/Lyra2Z/Lyra2.h"
+
+#include <string.h>
+
+// PoW parameters used by CBlockHeader::GetPoWHash
+static const uint64_t LYRA2_TIME_COST = 2;
+static const uint64_t LYRA2_ROWS = 330;
+static const uint64_t LYRA2_COLS = 256;
+
+// Matrix allocated and released for every hash
+static void LYRA2_PoW(benchmark::State& state)
+{
+    unsigned char header[80], hash[32];
+    memset(header, 0, sizeof(header));
+    uint32_t nNonce = 0;
+    LYRA2_detect_simd();
+    while (state.KeepRunning()) {
+        memcpy(header + 76, &nNonce, 4);
+        LYRA2(hash, 32, header, 80, header, 80, LYRA2_TIME_COST, LYRA2_ROWS, LYRA2_COLS);
+        nNonce++;
+    }
+}
+
+// Matrix reused between hashes, with the given sponge implementation. Falls back to the portable
+// sponge if the CPU doesn't support the requested one
+static void LYRA2_PoW_Scratchpad_Impl(benchmark::State& state, int impl)
+{
+    unsigned char header[80], hash[32];
+    memset(header, 0, sizeof(header));
+    uint32_t nNonce = 0;
+    if (LYRA2_select_impl(impl) != 0)
+        LYRA2_select_impl(LYRA2_IMPL_GENERIC);
+    CLyra2Scratchpad scratchpad(LYRA2_ROWS, LYRA2_COLS, true);
+    while (state.KeepRunning()) {
+        memcpy(header + 76, &nNonce, 4);
+        scratchpad.Hash(hash, 32, header, 80, header, 80, LYRA2_TIME_COST);
+        nNonce++;
+    }
+    LYRA2_detect_simd();
+}
+
+static void LYRA2_PoW_Scratchpad(benchmark::State& state)
+{
+    LYRA2_PoW_Scratchpad_Impl(state, LYRA2_IMPL_GENERIC);
+}
+
+static void LYRA2_PoW_Scratchpad_SSE2(benchmark::State& state)
+{
+    LYRA2_PoW_Scratchpad_Impl(state, LYRA2_IMPL_SSE2);
+}
+
+static void LYRA2_PoW_Scratchpad_AVX2(benchmark::State& state)
+{
+    LYRA2_PoW_Scratchpad_Impl(state, LYRA2_IMPL_AVX2);
+}
+
+// Four nonces hashed together, as done by the miner with -genlanes=4
+static void LYRA2_PoW_Lanes4(benchmark::State& state)
+{
+    const unsigned int nLanes = 4;
+    unsigned char header[nLanes][80], hash[nLanes][32];
+    void *output[nLanes];
+    const void *input[nLanes];
+    memset(header, 0, sizeof(header));
+    for (unsigned int l = 0; l < nLanes; l++) {
+        output[l] = hash[l];
+        input[l] = header[l];
+    }
+    uint32_t nNonce = 0;
+    LYRA2_detect_simd();
+    CLyra2Scratchpad scratchpad(LYRA2_ROWS, LYRA2_COLS, true, nLanes);
+    while (state.KeepRunning()) {
+        for (unsigned int l = 0; l < nLanes; l++) {
+            uint32_t nLaneNonce = nNonce + l;
+            memcpy(header[l] + 76, &nLaneNonce, 4);
+        }
+        scratchpad.HashLanes(nLanes, output, 32, input, 80, input, 80, LYRA2_TIME_COST);
+        nNonce += nLanes;
+    }
+}
+
+BENCHMARK(LYRA2_PoW);
+BENCHMARK(LYRA2_PoW_Scratchpad);
+BENCHMARK(LYRA2_PoW_Scratchpad_SSE2);
+BENCHMARK(LYRA2_PoW_Scratchpad_AVX2);
+BENCHMARK(LYRA2_PoW_Lanes4);
@@ -143,3 +143,121 @@ int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& fr
     }
     return sign * r.GetLow64();
 }
+
+/**
+ * CZerocoinBlockData implementation
+ */
+CZerocoinBlockData::CZerocoinBlockData(const MintMap &mintedPubCoins, const AccumulatorMap &accumulatorChanges, const SerialSet &spentSerials)
+{
+    size_t nValues = accumulatorChanges.size() + spentSerials.size();
+    for (const auto &mints: mintedPubCoins)
+        nValues += mints.second.size();
+    vchValues.reserve(nValues * VALUE_SIZE);
+
+    vMintGroups.reserve(mintedPubCoins.size());
+    for (const auto &mints: mintedPubCoins) {
+        MintGroup group = {mints.first, (uint32_t)(vchValues.size() / VALUE_SIZE), (uint32_t)mints.second.size()};
+        for (const CBigNum &pubCoin: mints.second)
+            AddValue(pubCoin);
+        vMintGroups.push_back(group);
+    }
+
+    vAccumulatorChanges.reserve(accumulatorChanges.size());
+    for (const auto &change: accumulatorChanges) {
+        AccumulatorChange accChange = {change.first, AddValue(change.second.first), change.second.second};
+        vAccumulatorChanges.push_back(accChange);
+    }
+
+    nFirstSerialSlot = vchValues.size() / VALUE_SIZE;
+    nSerials = spentSerials.size();
+    for (const CBigNum &serial: spentSerials)
+        AddValue(serial);
+}
+
+uint32_t CZerocoinBlockData::AddValue(const CBigNum &value)
+{
+    uint32_t nSlot = vchValues.size() / VALUE_SIZE;
+    vchValues.resize(vchValues.size() + VALUE_SIZE, 0);
+
+    int nBytes = BN_num_bytes(&value);
+    if (BN_is_negative(&value) || nBytes > (int)VALUE_SIZE)
+        mapOversized.insert(make_pair(nSlot, value));
+    else if (nBytes > 0)
+        BN_bn2bin(&value, &vchValues[(nSlot + 1) * VALUE_SIZE - nBytes]);
+
+    return nSlot;
+}
+
+CBigNum CZerocoinBlockData::GetValue(uint32_t nSlot) const
+{
+    if (!mapOversized.empty()) {
+        map<uint32_t, CBigNum>::const_iterator it = mapOversized.find(nSlot);
+        if (it != mapOversized.end())
+            return it->second;
+    }
+
+    CBigNum value;
+    BN_bin2bn(&vchValues[nSlot * VALUE_SIZE], VALUE_SIZE, &value);
+    return value;
+}
+
+template<typename T>
+static typename vector<T>::const_iterator FindDenomAndId(const vector<T> &v, const CZerocoinBlockData::DenomAndId &denomAndId)
+{
+    typename vector<T>::const_iterator it = lower_bound(v.begin(), v.end(), denomAndId,
+            [](const T &entry, const CZerocoinBlockData::DenomAndId &key) { return entry.denomAndId < key; });
+    return (it != v.end() && it->denomAndId == denomAndId) ? it : v.end();
+}
+
+bool CZerocoinBlockData::HasAccumulatorChange(const DenomAndId &denomAndId) const
+{
+    return FindDenomAndId(vAccumulatorChanges, denomAndId) != vAccumulatorChanges.end();
+}
+
+bool CZerocoinBlockData::GetAccumulatorChange(const DenomAndId &denomAndId, CBigNum &value, int &nMints) const
+{
+    vector<AccumulatorChange>::const_iterator it = FindDenomAndId(vAccumulatorChanges, denomAndId);
+    if (it == vAccumulatorChanges.end())
+        return false;
+    value = GetValue(it->nSlot);
+    nMints = it->nMints;
+    return true;
+}
+
+bool CZerocoinBlockData::HasMintedPubCoins(const DenomAndId &denomAndId) const
+{
+    return FindDenomAndId(vMintGroups, denomAndId) != vMintGroups.end();
+}
+
+bool CZerocoinBlockData::GetMintedPubCoins(const DenomAndId &denomAndId, vector<CBigNum> &pubCoins) const
+{
+    vector<MintGroup>::const_iterator it = FindDenomAndId(vMintGroups, denomAndId);
+    if (it == vMintGroups.end())
+        return false;
+    pubCoins.clear();
+    pubCoins.reserve(it->nMints);
+    for (uint32_t i = 0; i < it->nMints; i++)
+        pubCoins.push_back(GetValue(it->nFirstSlot + i));
+    return true;
+}
+
+void CZerocoinBlockData::GetMintedPubCoins(MintMap &mintedPubCoins) const
+{
+    for (const MintGroup &group: vMintGroups) {
+        vector<CBigNum> &pubCoins = mintedPubCoins[group.denomAndId];
+        for (uint32_t i = 0; i < group.nMints; i++)
+            pubCoins.push_back(GetValue(group.nFirstSlot + i));
+    }
+}
+
+void CZerocoinBlockData::GetAccumulatorChanges(AccumulatorMap &accumulatorChanges) const
+{
+    for (const AccumulatorChange &change: vAccumulatorChanges)
+        accumulatorChanges[change.denomAndId] = make_pair(GetValue(change.nSlot), change.nMints);
+}
+
+void CZerocoinBlockData::GetSpentSerials(SerialSet &spentSerials) const
+{
+    for (uint32_t i = 0; i < nSerials; i++)
+        spentSerials.insert(spentSerials.end(), GetValue(nFirstSerialSlot + i));
+}
@@ -14,6 +14,9 @@
 #include "libzerocoin/bitcoin_bignum/bignum.h"
 #include "util.h"
 
+#include <map>
+#include <memory>
+#include <set>
 #include <vector>
 #define ZC_ADVANCED_INDEX_VERSION_CHAIN           130500
 
@@ -150,6 +153,62 @@ enum BlockStatus: uint32_t {
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
 };
 
+/** Zerocoin mints, accumulator updates and spent serials of one block. Only allocated for blocks that have
+ * any of them. Values are packed into one buffer of fixed width big-endian slots instead of an OpenSSL
+ * BIGNUM each; the rare value that does not fit a slot is kept as a CBigNum.
+ */
+class CZerocoinBlockData
+{
+public:
+    typedef std::pair<int,int> DenomAndId;
+    //! Maps <denomination,id> to public coins minted in the block, ordered by serialized value of public coin
+    typedef std::map<DenomAndId, std::vector<CBigNum>> MintMap;
+    //! Maps <denomination,id> to <accumulator value after the block, number of mints in the block>
+    typedef std::map<DenomAndId, std::pair<CBigNum,int>> AccumulatorMap;
+    typedef std::set<CBigNum> SerialSet;
+
+    //! Slot width, enough for a value modulo the 2048-bit accumulator modulus
+    static const size_t VALUE_SIZE = 256;
+
+private:
+    struct MintGroup {
+        DenomAndId denomAndId;
+        uint32_t nFirstSlot;
+        uint32_t nMints;
+    };
+
+    struct AccumulatorChange {
+        DenomAndId denomAndId;
+        uint32_t nSlot;
+        int nMints;
+    };
+
+    //! Both sorted by denomAndId
+    std::vector<MintGroup> vMintGroups;
+    std::vector<AccumulatorChange> vAccumulatorChanges;
+    uint32_t nFirstSerialSlot;
+    uint32_t nSerials;
+
+    std::vector<unsigned char> vchValues;
+    //! Negative values and values wider than VALUE_SIZE bytes, by slot
+    std::map<uint32_t, CBigNum> mapOversized;
+
+    uint32_t AddValue(const CBigNum &value);
+    CBigNum GetValue(uint32_t nSlot) const;
+
+public:
+    CZerocoinBlockData(const MintMap &mintedPubCoins, const AccumulatorMap &accumulatorChanges, const SerialSet &spentSerials);
+
+    bool HasAccumulatorChange(const DenomAndId &denomAndId) const;
+    bool GetAccumulatorChange(const DenomAndId &denomAndId, CBigNum &value, int &nMints) const;
+    bool HasMintedPubCoins(const DenomAndId &denomAndId) const;
+    bool GetMintedPubCoins(const DenomAndId &denomAndId, std::vector<CBigNum> &pubCoins) const;
+
+    void GetMintedPubCoins(MintMap &mintedPubCoins) const;
+    void GetAccumulatorChanges(AccumulatorMap &accumulatorChanges) const;
+    void GetSpentSerials(SerialSet &spentSerials) const;
+};
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block. A blockindex may have multiple pprev pointing
@@ -201,19 +260,19 @@ public:
     unsigned int nBits;
     unsigned int nNonce;
 
+    //! PoW hash computed when the header was first checked, null if unknown.
+    //! Stored in the block tree DB next to the index entry, not in CDiskBlockIndex.
+    uint256 hashPoW;
+
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     uint32_t nSequenceId;
 
-    //! Public coin values of mints in this block, ordered by serialized value of public coin
-    //! Maps <denomination,id> to vector of public coins
-    map<pair<int,int>, vector<CBigNum>> mintedPubCoins;
-
-    //! Accumulator updates. Contains only changes made by mints in this block
-    //! Maps <denomination, id> to <accumulator value (CBigNum), number of such mints in this block>
-    map<pair<int,int>, pair<CBigNum,int>> accumulatorChanges;
+    //! (memory only) Memoized GetNextWorkRequired() result for a child of this block, 0 if not computed yet.
+    //! Set by SetNextWorkRequired() under cs_main when the index is added or loaded, never written afterwards.
+    unsigned int nNextWorkRequired;
 
-    //! Values of coin serials spent in this block
-    set<CBigNum> spentSerials;
+    //! Zerocoin mints, accumulator changes and spent serials of this block, NULL if there are none
+    std::shared_ptr<const CZerocoinBlockData> zerocoinData;
 
     void SetNull()
     {
@@ -229,16 +288,16 @@ public:
         nChainTx = 0;
         nStatus = 0;
         nSequenceId = 0;
+        nNextWorkRequired = 0;
 
         nVersion       = 0;
         hashMerkleRoot = uint256();
         nTime          = 0;
         nBits          = 0;
         nNonce         = 0;
+        hashPoW        = uint256();
 
-        mintedPubCoins.clear();
-        accumulatorChanges.clear();
-        spentSerials.clear();
+        zerocoinData.reset();
     }
 
     CBlockIndex()
@@ -255,6 +314,60 @@ public:
         nTime          = block.nTime;
         nBits          = block.nBits;
         nNonce         = block.nNonce;
+        if (block.IsComputed())
+            hashPoW    = block.powHash;
+    }
+
+    //! Replace zerocoin data of this block, nothing is allocated if all of it is empty
+    void SetZerocoinData(const CZerocoinBlockData::MintMap &mintedPubCoins,
+                         const CZerocoinBlockData::AccumulatorMap &accumulatorChanges,
+                         const CZerocoinBlockData::SerialSet &spentSerials)
+    {
+        if (mintedPubCoins.empty() && accumulatorChanges.empty() && spentSerials.empty())
+            zerocoinData.reset();
+        else
+            zerocoinData = std::make_shared<const CZerocoinBlockData>(mintedPubCoins, accumulatorChanges, spentSerials);
+    }
+
+    bool HasAccumulatorChange(const CZerocoinBlockData::DenomAndId &denomAndId) const
+    {
+        return zerocoinData && zerocoinData->HasAccumulatorChange(denomAndId);
+    }
+
+    bool GetAccumulatorChange(const CZerocoinBlockData::DenomAndId &denomAndId, CBigNum &value, int &nMints) const
+    {
+        return zerocoinData && zerocoinData->GetAccumulatorChange(denomAndId, value, nMints);
+    }
+
+    bool HasMintedPubCoins(const CZerocoinBlockData::DenomAndId &denomAndId) const
+    {
+        return zerocoinData && zerocoinData->HasMintedPubCoins(denomAndId);
+    }
+
+    bool GetMintedPubCoins(const CZerocoinBlockData::DenomAndId &denomAndId, std::vector<CBigNum> &pubCoins) const
+    {
+        return zerocoinData && zerocoinData->GetMintedPubCoins(denomAndId, pubCoins);
+    }
+
+    void GetMintedPubCoins(CZerocoinBlockData::MintMap &mintedPubCoins) const
+    {
+        mintedPubCoins.clear();
+        if (zerocoinData)
+            zerocoinData->GetMintedPubCoins(mintedPubCoins);
+    }
+
+    void GetAccumulatorChanges(CZerocoinBlockData::AccumulatorMap &accumulatorChanges) const
+    {
+        accumulatorChanges.clear();
+        if (zerocoinData)
+            zerocoinData->GetAccumulatorChanges(accumulatorChanges);
+    }
+
+    void GetSpentSerials(CZerocoinBlockData::SerialSet &spentSerials) const
+    {
+        spentSerials.clear();
+        if (zerocoinData)
+            zerocoinData->GetSpentSerials(spentSerials);
     }
 
     CDiskBlockPos GetBlockPos() const {
@@ -415,9 +528,20 @@ public:
         READWRITE(nBits);
         READWRITE(nNonce);
         if (!(nType & SER_GETHASH) && nVersion >= ZC_ADVANCED_INDEX_VERSION_CHAIN) {
+            // Same layout as the maps the zerocoin data used to be stored in
+            CZerocoinBlockData::MintMap mintedPubCoins;
+            CZerocoinBlockData::AccumulatorMap accumulatorChanges;
+            CZerocoinBlockData::SerialSet spentSerials;
+            if (!ser_action.ForRead()) {
+                GetMintedPubCoins(mintedPubCoins);
+                GetAccumulatorChanges(accumulatorChanges);
+                GetSpentSerials(spentSerials);
+            }
             READWRITE(mintedPubCoins);
             READWRITE(accumulatorChanges);
             READWRITE(spentSerials);
+            if (ser_action.ForRead())
+                SetZerocoinData(mintedPubCoins, accumulatorChanges, spentSerials);
         }
 
         nDiskBlockVersion = nVersion;
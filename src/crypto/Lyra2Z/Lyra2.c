@@ -24,71 +24,100 @@
 #include "Lyra2.h"
 #include "Sponge.h"
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+//Alignment of the memory matrix, in bytes (a cache line)
+#define LYRA2_MATRIX_ALIGN 64
+
 /**
- * Executes Lyra2 based on the G function from Blake2b. This version supports salts and passwords
- * whose combined length is smaller than the size of the memory matrix, (i.e., (nRows x nCols x b) bits,
- * where "b" is the underlying sponge's bitrate). In this implementation, the "basil" is composed by all
- * integer parameters (treated as type "unsigned int") in the order they are provided, plus the value
- * of nCols, (i.e., basil = kLen || pwdlen || saltlen || timeCost || nRows || nCols).
+ * Allocates the memory matrix for the given dimensions. The matrix is not cleared: Lyra2 writes every
+ * row before reading it, so only the blocks holding the password need to be zeroed before each run.
  *
- * @param K The derived key to be output by the algorithm
- * @param kLen Desired key length
- * @param pwd User password
- * @param pwdlen Password length
- * @param salt Salt
- * @param saltlen Salt length
- * @param timeCost Parameter to determine the processing time (T)
+ * @param ctx The scratchpad to be initialized
  * @param nRows Number or rows of the memory matrix (R)
  * @param nCols Number of columns of the memory matrix (C)
+ * @param fHugePages Try to back the matrix with huge pages (Linux only, falls back to regular pages)
  *
- * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
+ * @return 0 if the scratchpad is allocated; -1 if there is no memory
  */
-int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
-
-    //============================= Basic variables ============================//
-    int64_t row = 2; //index of row to be processed
-    int64_t prev = 1; //index of prev (last row ever computed/modified)
-    int64_t rowa = 0; //index of row* (a previous row, deterministically picked during Setup and randomly picked while Wandering)
-    int64_t tau; //Time Loop iterator
-    int64_t step = 1; //Visitation step (used during Setup and Wandering phases)
-    int64_t window = 2; //Visitation window (used to define which rows can be revisited during Setup)
-    int64_t gap = 1; //Modifier to the step, assuming the values 1 or -1
-    int64_t i; //auxiliary iteration counter
-    //==========================================================================/
-
-    //========== Initializing the Memory Matrix and pointers to it =============//
-    //Tries to allocate enough space for the whole memory matrix
-
-
-    const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
-    const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
-
-    i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-    uint64_t *wholeMatrix = malloc(i);
-    if (wholeMatrix == NULL) {
-      return -1;
+int LYRA2_ctx_init(LYRA2_ctx *ctx, uint64_t nRows, uint64_t nCols, int fHugePages) {
+    ctx->nRows = nRows;
+    ctx->nCols = nCols;
+    ctx->nSize = (size_t) (nRows * nCols * BLOCK_LEN_BYTES);
+    ctx->fMapped = 0;
+    ctx->memory = NULL;
+    ctx->wholeMatrix = NULL;
+
+#if defined(__linux__)
+    if (fHugePages) {
+        void *p = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+        //Explicit huge pages: size must be a multiple of the huge page size (2 MB)
+        size_t nHugeSize = (ctx->nSize + (1 << 21) - 1) & ~(size_t) ((1 << 21) - 1);
+        p = mmap(NULL, nHugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+            ctx->nSize = nHugeSize;
+#endif
+        if (p == MAP_FAILED) {
+            //No reserved huge pages: ask for transparent huge pages instead
+            p = mmap(NULL, ctx->nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#if defined(MADV_HUGEPAGE)
+            if (p != MAP_FAILED)
+                madvise(p, ctx->nSize, MADV_HUGEPAGE);
+#endif
+        }
+        if (p != MAP_FAILED) {
+            ctx->fMapped = 1;
+            ctx->memory = p;
+            ctx->wholeMatrix = (uint64_t *) p;
+            return 0;
+        }
     }
-    memset(wholeMatrix, 0, i);
+#else
+    (void) fHugePages;
+#endif
+
+    ctx->memory = malloc(ctx->nSize + LYRA2_MATRIX_ALIGN - 1);
+    if (ctx->memory == NULL)
+        return -1;
+    ctx->wholeMatrix = (uint64_t *) (((uintptr_t) ctx->memory + LYRA2_MATRIX_ALIGN - 1) & ~(uintptr_t) (LYRA2_MATRIX_ALIGN - 1));
+    return 0;
+}
 
-    //Allocates pointers to each row of the matrix
-    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
-    if (memMatrix == NULL) {
-      return -1;
-    }
-    //Places the pointers in the correct positions
-    uint64_t *ptrWord = wholeMatrix;
-    for (i = 0; i < nRows; i++) {
-      memMatrix[i] = ptrWord;
-      ptrWord += ROW_LEN_INT64;
+/**
+ * Releases the memory matrix of the scratchpad
+ *
+ * @param ctx The scratchpad
+ */
+void LYRA2_ctx_free(LYRA2_ctx *ctx) {
+#if defined(__linux__)
+    if (ctx->fMapped) {
+        munmap(ctx->memory, ctx->nSize);
+        ctx->memory = NULL;
+        ctx->wholeMatrix = NULL;
+        return;
     }
-    //==========================================================================/
+#endif
+    free(ctx->memory);
+    ctx->memory = NULL;
+    ctx->wholeMatrix = NULL;
+}
 
-    //============= Getting the password + salt + basil padded with 10*1 ===============//
-    //OBS.:The memory matrix will temporarily hold the password: not for saving memory,
-    //but this ensures that the password copied locally will be overwritten as soon as possible
+/**
+ * Writes pad(pwd || salt || basil) at the start of the memory matrix. The matrix temporarily holds the
+ * password: not for saving memory, but this ensures that the password copied locally will be overwritten
+ * as soon as possible. In this implementation, the "basil" is composed by all integer parameters (treated
+ * as type "unsigned int") in the order they are provided, plus the value of nCols, (i.e., basil = kLen ||
+ * pwdlen || saltlen || timeCost || nRows || nCols).
+ */
+static void LYRA2_absorb_input(uint64_t *state, const LYRA2_sponge *sponge, uint64_t *wholeMatrix, uint64_t nBlocksInput,
+                               uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen,
+                               uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    uint64_t i;
 
     //First, we clean enough blocks for the password, salt, basil and padding
-    uint64_t nBlocksInput = ((saltlen + pwdlen + 6 * sizeof (uint64_t)) / BLOCK_LEN_BLAKE2_SAFE_BYTES) + 1;
     byte *ptrByte = (byte*) wholeMatrix;
     memset(ptrByte, 0, nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_BYTES);
 
@@ -119,202 +148,110 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     ptrByte = (byte*) wholeMatrix; //resets the pointer to the start of the memory matrix
     ptrByte += nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_BYTES - 1; //sets the pointer to the correct position: end of incomplete block
     *ptrByte ^= 0x01; //last byte of padding: at the end of the last incomplete block
-    //==========================================================================/
-
-    //======================= Initializing the Sponge State ====================//
-    //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-    uint64_t *state = malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
-    initState(state);
-    //==========================================================================/
 
-    //================================ Setup Phase =============================//
     //Absorbing salt, password and basil: this is the only place in which the block length is hard-coded to 512 bits
-    ptrWord = wholeMatrix;
+    initState(state);
+    uint64_t *ptrWord = wholeMatrix;
     for (i = 0; i < nBlocksInput; i++) {
-      absorbBlockBlake2Safe(state, ptrWord); //absorbs each block of pad(pwd || salt || basil)
+      sponge->absorbBlockBlake2Safe(state, ptrWord); //absorbs each block of pad(pwd || salt || basil)
       ptrWord += BLOCK_LEN_BLAKE2_SAFE_INT64; //goes to next block of pad(pwd || salt || basil)
     }
-
-    //Initializes M[0] and M[1]
-    reducedSqueezeRow0(state, memMatrix[0], nCols); //The locally copied password is most likely overwritten here
-    reducedDuplexRow1(state, memMatrix[0], memMatrix[1], nCols);
-
-    do {
-      //M[row] = rand; //M[row*] = M[row*] XOR rotW(rand)
-      reducedDuplexRowSetup(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
-
-
-      //updates the value of row* (deterministically picked during Setup))
-      rowa = (rowa + step) & (window - 1);
-      //update prev: it now points to the last row ever computed
-      prev = row;
-      //updates row: goes to the next row to be computed
-      row++;
-
-      //Checks if all rows in the window where visited.
-      if (rowa == 0) {
-      step = window + gap; //changes the step: approximately doubles its value
-      window *= 2; //doubles the size of the re-visitation window
-      gap = -gap; //inverts the modifier to the step
-    }
-
-    } while (row < nRows);
-    //==========================================================================/
-
-    //============================ Wandering Phase =============================//
-    row = 0; //Resets the visitation to the first row of the memory matrix
-    for (tau = 1; tau <= timeCost; tau++) {
-        //Step is approximately half the number of all rows of the memory matrix for an odd tau; otherwise, it is -1
-        step = (tau % 2 == 0) ? -1 : nRows / 2 - 1;
-        do {
-        //Selects a pseudorandom index row*
-        //------------------------------------------------------------------------------------------
-        //rowa = ((unsigned int)state[0]) & (nRows-1);	//(USE THIS IF nRows IS A POWER OF 2)
-        rowa = ((uint64_t) (state[0])) % nRows; //(USE THIS FOR THE "GENERIC" CASE)
-        //------------------------------------------------------------------------------------------
-
-        //Performs a reduced-round duplexing operation over M[row*] XOR M[prev], updating both M[row*] and M[row]
-        reducedDuplexRow(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
-
-        //update prev: it now points to the last row ever computed
-        prev = row;
-
-        //updates row: goes to the next row to be computed
-        //------------------------------------------------------------------------------------------
-        //row = (row + step) & (nRows-1);	//(USE THIS IF nRows IS A POWER OF 2)
-        row = (row + step) % nRows; //(USE THIS FOR THE "GENERIC" CASE)
-        //------------------------------------------------------------------------------------------
-
-      } while (row != 0);
-    }
-    //==========================================================================/
-
-    //============================ Wrap-up Phase ===============================//
-    //Absorbs the last block of the memory matrix
-    absorbBlock(state, memMatrix[rowa]);
-
-    //Squeezes the key
-    squeeze(state, K, kLen);
-    //==========================================================================/
-
-    //========================= Freeing the memory =============================//
-    free(memMatrix);
-    free(wholeMatrix);
-
-    //Wiping out the sponge's internal state before freeing it
-    memset(state, 0, 16 * sizeof (uint64_t));
-    free(state);
-    //==========================================================================/
-
-    return 0;
 }
 
-int LYRA2_old(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+//Hint the cache about the first blocks of a row that is about to be visited (the hardware prefetcher
+//follows the rest of the row)
+#if defined(__GNUC__)
+#define LYRA2_PREFETCH_ROW(p) do { \
+    __builtin_prefetch((p), 1, 3); \
+    __builtin_prefetch((const char *) (p) + 64, 1, 3); \
+    __builtin_prefetch((const char *) (p) + 128, 1, 3); \
+    __builtin_prefetch((const char *) (p) + 192, 1, 3); \
+} while (0)
+#else
+#define LYRA2_PREFETCH_ROW(p) do { (void) (p); } while (0)
+#endif
+
+/**
+ * Executes Lyra2 based on the G function from Blake2b for up to LYRA2_MAX_LANES independent inputs at
+ * once. The visitation order of Setup and of row/prev during Wandering does not depend on the input, so
+ * every lane runs the same loop; each step is applied to all lanes before moving to the next one. The
+ * pseudorandom row* of each lane is known one step ahead, so it is prefetched while the other lanes are
+ * being processed, which hides most of the memory latency of a single hash.
+ *
+ * All lanes share the parameters; lane l reads pwd[l] and salt[l] and writes K[l], using the memory
+ * matrix of ctx[l]. The scratchpads must have the same dimensions.
+ *
+ * @param ctx Array of nLanes scratchpads initialized with LYRA2_ctx_init
+ * @param nLanes Number of inputs to hash (1 to LYRA2_MAX_LANES)
+ * @param K The derived keys to be output by the algorithm
+ * @param kLen Desired key length
+ * @param pwd User passwords
+ * @param pwdlen Password length
+ * @param salt Salts
+ * @param saltlen Salt length
+ * @param timeCost Parameter to determine the processing time (T)
+ *
+ * @return 0 if the keys are generated correctly; -1 if there is an error
+ */
+int LYRA2_ctx_hash_lanes(LYRA2_ctx *ctx, unsigned int nLanes, void *const *K, uint64_t kLen, const void *const *pwd, uint64_t pwdlen,
+                         const void *const *salt, uint64_t saltlen, uint64_t timeCost) {
 
     //============================= Basic variables ============================//
     int64_t row = 2; //index of row to be processed
     int64_t prev = 1; //index of prev (last row ever computed/modified)
-    int64_t rowa = 0; //index of row* (a previous row, deterministically picked during Setup and randomly picked while Wandering)
+    int64_t rowa = 0; //index of row* (a previous row, deterministically picked during Setup)
+    int64_t rowaLane[LYRA2_MAX_LANES]; //index of row* of each lane, randomly picked while Wandering
     int64_t tau; //Time Loop iterator
     int64_t step = 1; //Visitation step (used during Setup and Wandering phases)
     int64_t window = 2; //Visitation window (used to define which rows can be revisited during Setup)
     int64_t gap = 1; //Modifier to the step, assuming the values 1 or -1
-    int64_t i; //auxiliary iteration counter
+    unsigned int l; //lane iterator
+    uint64_t nRows, nCols;
+    const LYRA2_sponge *sponge = lyra2_sponge;
     //==========================================================================/
 
-    //========== Initializing the Memory Matrix and pointers to it =============//
-    //Tries to allocate enough space for the whole memory matrix
-
-
-    const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
-    const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
-
-    i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-    uint64_t *wholeMatrix = malloc(i);
-    if (wholeMatrix == NULL) {
+    if (nLanes == 0 || nLanes > LYRA2_MAX_LANES) {
       return -1;
     }
-    memset(wholeMatrix, 0, i);
+    nRows = ctx[0].nRows;
+    nCols = ctx[0].nCols;
 
-    //Allocates pointers to each row of the matrix
-    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
-    if (memMatrix == NULL) {
-      return -1;
-    }
-    //Places the pointers in the correct positions
-    uint64_t *ptrWord = wholeMatrix;
-    for (i = 0; i < nRows; i++) {
-      memMatrix[i] = ptrWord;
-      ptrWord += ROW_LEN_INT64;
-    }
-    //==========================================================================/
-
-    //============= Getting the password + salt + basil padded with 10*1 ===============//
-    //OBS.:The memory matrix will temporarily hold the password: not for saving memory,
-    //but this ensures that the password copied locally will be overwritten as soon as possible
+    //======================== Pointers to the Memory Matrix ===================//
+    //Row r of lane l starts at ctx[l].wholeMatrix + r * ROW_LEN_INT64
+    const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
+#define MEM_ROW(l, r) (ctx[l].wholeMatrix + (r) * ROW_LEN_INT64)
 
-    //First, we clean enough blocks for the password, salt, basil and padding
+    //The input must fit the memory matrix
     uint64_t nBlocksInput = ((saltlen + pwdlen + 6 * sizeof (uint64_t)) / BLOCK_LEN_BLAKE2_SAFE_BYTES) + 1;
-    byte *ptrByte = (byte*) wholeMatrix;
-    memset(ptrByte, 0, nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_BYTES);
-
-    //Prepends the password
-    memcpy(ptrByte, pwd, pwdlen);
-    ptrByte += pwdlen;
 
-    //Concatenates the salt
-    memcpy(ptrByte, salt, saltlen);
-    ptrByte += saltlen;
-
-    //Concatenates the basil: every integer passed as parameter, in the order they are provided by the interface
-    memcpy(ptrByte, &kLen, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-    memcpy(ptrByte, &pwdlen, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-    memcpy(ptrByte, &saltlen, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-    memcpy(ptrByte, &timeCost, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-    memcpy(ptrByte, &nRows, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-    memcpy(ptrByte, &nCols, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-
-    //Now comes the padding
-    *ptrByte = 0x80; //first byte of padding: right after the password
-    ptrByte = (byte*) wholeMatrix; //resets the pointer to the start of the memory matrix
-    ptrByte += nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_BYTES - 1; //sets the pointer to the correct position: end of incomplete block
-    *ptrByte ^= 0x01; //last byte of padding: at the end of the last incomplete block
+    for (l = 0; l < nLanes; l++) {
+      if (ctx[l].wholeMatrix == NULL || ctx[l].nRows != nRows || ctx[l].nCols != nCols || nRows < 3) {
+        return -1;
+      }
+      if (nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_BYTES > ctx[l].nSize) {
+        return -1;
+      }
+    }
     //==========================================================================/
 
     //======================= Initializing the Sponge State ====================//
     //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-    uint64_t *state = malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
-    initState(state);
+    ALIGN uint64_t state[LYRA2_MAX_LANES][16];
     //==========================================================================/
 
     //================================ Setup Phase =============================//
-    //Absorbing salt, password and basil: this is the only place in which the block length is hard-coded to 512 bits
-    ptrWord = wholeMatrix;
-    for (i = 0; i < nBlocksInput; i++) {
-      absorbBlockBlake2Safe(state, ptrWord); //absorbs each block of pad(pwd || salt || basil)
-      ptrWord += BLOCK_LEN_BLAKE2_SAFE_BYTES; //goes to next block of pad(pwd || salt || basil)
-    }
+    for (l = 0; l < nLanes; l++) {
+      LYRA2_absorb_input(state[l], sponge, ctx[l].wholeMatrix, nBlocksInput, kLen, pwd[l], pwdlen, salt[l], saltlen, timeCost, nRows, nCols);
 
-    //Initializes M[0] and M[1]
-    reducedSqueezeRow0(state, memMatrix[0], nCols); //The locally copied password is most likely overwritten here
-    reducedDuplexRow1(state, memMatrix[0], memMatrix[1], nCols);
+      //Initializes M[0] and M[1]
+      sponge->reducedSqueezeRow0(state[l], MEM_ROW(l, 0), nCols); //The locally copied password is most likely overwritten here
+      sponge->reducedDuplexRow1(state[l], MEM_ROW(l, 0), MEM_ROW(l, 1), nCols);
+    }
 
     do {
       //M[row] = rand; //M[row*] = M[row*] XOR rotW(rand)
-      reducedDuplexRowSetup(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
-
+      for (l = 0; l < nLanes; l++)
+        sponge->reducedDuplexRowSetup(state[l], MEM_ROW(l, prev), MEM_ROW(l, rowa), MEM_ROW(l, row), nCols);
 
       //updates the value of row* (deterministically picked during Setup))
       rowa = (rowa + step) & (window - 1);
@@ -325,58 +262,108 @@ int LYRA2_old(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const vo
 
       //Checks if all rows in the window where visited.
       if (rowa == 0) {
-      step = window + gap; //changes the step: approximately doubles its value
-      window *= 2; //doubles the size of the re-visitation window
-      gap = -gap; //inverts the modifier to the step
-    }
+        step = window + gap; //changes the step: approximately doubles its value
+        window *= 2; //doubles the size of the re-visitation window
+        gap = -gap; //inverts the modifier to the step
+      }
 
     } while (row < nRows);
+
+    for (l = 0; l < nLanes; l++)
+      rowaLane[l] = rowa;
     //==========================================================================/
 
     //============================ Wandering Phase =============================//
     row = 0; //Resets the visitation to the first row of the memory matrix
     for (tau = 1; tau <= timeCost; tau++) {
-        //Step is approximately half the number of all rows of the memory matrix for an odd tau; otherwise, it is -1
-        step = (tau % 2 == 0) ? -1 : nRows / 2 - 1;
-        do {
-        //Selects a pseudorandom index row*
-        //------------------------------------------------------------------------------------------
-        //rowa = ((unsigned int)state[0]) & (nRows-1);	//(USE THIS IF nRows IS A POWER OF 2)
-        rowa = ((uint64_t) (state[0])) % nRows; //(USE THIS FOR THE "GENERIC" CASE)
-        //------------------------------------------------------------------------------------------
+      //Step is approximately half the number of all rows of the memory matrix for an odd tau; otherwise, it is -1
+      step = (tau % 2 == 0) ? -1 : nRows / 2 - 1;
+      do {
+        //Selects a pseudorandom index row* for every lane and starts fetching it
+        for (l = 0; l < nLanes; l++) {
+          rowaLane[l] = ((uint64_t) (state[l][0])) % nRows; //(USE THIS FOR THE "GENERIC" CASE)
+          LYRA2_PREFETCH_ROW(MEM_ROW(l, rowaLane[l]));
+        }
 
         //Performs a reduced-round duplexing operation over M[row*] XOR M[prev], updating both M[row*] and M[row]
-        reducedDuplexRow(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+        for (l = 0; l < nLanes; l++)
+          sponge->reducedDuplexRow(state[l], MEM_ROW(l, prev), MEM_ROW(l, rowaLane[l]), MEM_ROW(l, row), nCols);
 
         //update prev: it now points to the last row ever computed
         prev = row;
 
         //updates row: goes to the next row to be computed
-        //------------------------------------------------------------------------------------------
-        //row = (row + step) & (nRows-1);	//(USE THIS IF nRows IS A POWER OF 2)
         row = (row + step) % nRows; //(USE THIS FOR THE "GENERIC" CASE)
-        //------------------------------------------------------------------------------------------
 
       } while (row != 0);
     }
     //==========================================================================/
 
     //============================ Wrap-up Phase ===============================//
-    //Absorbs the last block of the memory matrix
-    absorbBlock(state, memMatrix[rowa]);
+    for (l = 0; l < nLanes; l++) {
+      //Absorbs the last block of the memory matrix
+      sponge->absorbBlock(state[l], MEM_ROW(l, rowaLane[l]));
 
-    //Squeezes the key
-    squeeze(state, K, kLen);
+      //Squeezes the key
+      sponge->squeeze(state[l], K[l], kLen);
+    }
     //==========================================================================/
+#undef MEM_ROW
 
-    //========================= Freeing the memory =============================//
-    free(memMatrix);
-    free(wholeMatrix);
-
-    //Wiping out the sponge's internal state before freeing it
-    memset(state, 0, 16 * sizeof (uint64_t));
-    free(state);
-    //==========================================================================/
+    //Wiping out the sponge's internal state
+    memset(state, 0, sizeof (state));
 
     return 0;
 }
+
+/**
+ * Executes Lyra2 on a single input, see LYRA2_ctx_hash_lanes. The memory matrix is provided by the caller
+ * and its dimensions define nRows and nCols, so the same scratchpad can be reused for any number of hashes.
+ *
+ * @param ctx Scratchpad initialized with LYRA2_ctx_init
+ * @param K The derived key to be output by the algorithm
+ * @param kLen Desired key length
+ * @param pwd User password
+ * @param pwdlen Password length
+ * @param salt Salt
+ * @param saltlen Salt length
+ * @param timeCost Parameter to determine the processing time (T)
+ *
+ * @return 0 if the key is generated correctly; -1 if there is an error
+ */
+int LYRA2_ctx_hash(LYRA2_ctx *ctx, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost) {
+    void *const keys[1] = {K};
+    const void *const pwds[1] = {pwd};
+    const void *const salts[1] = {salt};
+
+    return LYRA2_ctx_hash_lanes(ctx, 1, keys, kLen, pwds, pwdlen, salts, saltlen, timeCost);
+}
+
+/**
+ * Executes Lyra2 with a memory matrix allocated for this call only. Callers hashing repeatedly should keep
+ * a LYRA2_ctx and use LYRA2_ctx_hash instead.
+ *
+ * @param K The derived key to be output by the algorithm
+ * @param kLen Desired key length
+ * @param pwd User password
+ * @param pwdlen Password length
+ * @param salt Salt
+ * @param saltlen Salt length
+ * @param timeCost Parameter to determine the processing time (T)
+ * @param nRows Number or rows of the memory matrix (R)
+ * @param nCols Number of columns of the memory matrix (C)
+ *
+ * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
+ */
+int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    LYRA2_ctx ctx;
+    int result;
+
+    if (LYRA2_ctx_init(&ctx, nRows, nCols, 0) != 0) {
+      return -1;
+    }
+    result = LYRA2_ctx_hash(&ctx, K, kLen, pwd, pwdlen, salt, saltlen, timeCost);
+    LYRA2_ctx_free(&ctx);
+
+    return result;
+}
@@ -37,16 +37,89 @@ typedef unsigned char byte;
         #define BLOCK_LEN_BYTES (BLOCK_LEN_INT64 * 8)    //Block length, in bytes
 #endif
 
+#include <stddef.h>
+
+/**
+ * Caller-owned scratchpad holding the Lyra2 memory matrix (nRows x nCols blocks). Allocating 8 MB per hash
+ * dominates the cost of small inputs, so threads hashing repeatedly (validation, mining) keep one around.
+ * A scratchpad must not be used by two threads at once.
+ */
+typedef struct LYRA2_ctx {
+    uint64_t *wholeMatrix;      //aligned start of the matrix
+    uint64_t nRows;
+    uint64_t nCols;
+    size_t nSize;               //size of the allocation, in bytes
+    void *memory;               //allocation backing wholeMatrix
+    int fMapped;                //memory was obtained with mmap
+} LYRA2_ctx;
+
+//Maximum number of inputs hashed together by LYRA2_ctx_hash_lanes
+#define LYRA2_MAX_LANES 8
+
+//Implementations of the Blake2b sponge: scalar, SSE2 and AVX2
+#define LYRA2_IMPL_GENERIC 0
+#define LYRA2_IMPL_SSE2 1
+#define LYRA2_IMPL_AVX2 2
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+    const char *LYRA2_detect_simd(void);
+    int LYRA2_select_impl(int impl);
+
+    int LYRA2_ctx_init(LYRA2_ctx *ctx, uint64_t nRows, uint64_t nCols, int fHugePages);
+    void LYRA2_ctx_free(LYRA2_ctx *ctx);
+    int LYRA2_ctx_hash(LYRA2_ctx *ctx, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost);
+    int LYRA2_ctx_hash_lanes(LYRA2_ctx *ctx, unsigned int nLanes, void *const *K, uint64_t kLen, const void *const *pwd, uint64_t pwdlen,
+                             const void *const *salt, uint64_t saltlen, uint64_t timeCost);
+
     int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
 
 #ifdef __cplusplus
 }
 
-int LYRA2_old(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
+/** Owner of one LYRA2_ctx per lane, for scratchpads kept per thread */
+class CLyra2Scratchpad
+{
+private:
+    LYRA2_ctx ctx[LYRA2_MAX_LANES];
+    unsigned int nLanes;
+    bool fValid;
+
+    CLyra2Scratchpad(const CLyra2Scratchpad &);
+    CLyra2Scratchpad &operator=(const CLyra2Scratchpad &);
+
+public:
+    CLyra2Scratchpad(uint64_t nRows, uint64_t nCols, bool fHugePages, unsigned int nLanesIn = 1) : nLanes(0), fValid(false) {
+        if (nLanesIn == 0 || nLanesIn > LYRA2_MAX_LANES)
+            return;
+        for (; nLanes < nLanesIn; nLanes++)
+            if (LYRA2_ctx_init(&ctx[nLanes], nRows, nCols, fHugePages ? 1 : 0) != 0)
+                return;
+        fValid = true;
+    }
+    ~CLyra2Scratchpad() {
+        for (unsigned int l = 0; l < nLanes; l++)
+            LYRA2_ctx_free(&ctx[l]);
+    }
+
+    bool IsValid() const { return fValid; }
+    unsigned int GetLanes() const { return fValid ? nLanes : 0; }
+    LYRA2_ctx *Get() { return fValid ? &ctx[0] : NULL; }
+
+    int Hash(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost) {
+        return fValid ? LYRA2_ctx_hash(&ctx[0], K, kLen, pwd, pwdlen, salt, saltlen, timeCost) : -1;
+    }
+
+    // Hash nLanesUsed (at most GetLanes()) inputs in one pass
+    int HashLanes(unsigned int nLanesUsed, void *const *K, uint64_t kLen, const void *const *pwd, uint64_t pwdlen,
+                  const void *const *salt, uint64_t saltlen, uint64_t timeCost) {
+        if (!fValid || nLanesUsed > nLanes)
+            return -1;
+        return LYRA2_ctx_hash_lanes(ctx, nLanesUsed, K, kLen, pwd, pwdlen, salt, saltlen, timeCost);
+    }
+};
 
 #endif
 
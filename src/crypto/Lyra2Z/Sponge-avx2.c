@@ -0,0 +1,256 @@
+/**
+ * AVX2 implementation of the Blake2b sponge used by Lyra2. Produces the same results as the scalar
+ * functions in Sponge.c; the state is kept in four 256-bit registers (one Blake2b row each) and a whole
+ * 96 byte block is handled with three loads. Selected at runtime by LYRA2_detect_simd.
+ *
+ * This software is hereby placed in the public domain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ''AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include "Lyra2.h"
+#include "Sponge.h"
+
+#if defined(LYRA2_HAVE_X86_SIMD)
+
+#include <immintrin.h>
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+#define LOAD_STATE(a, b, c, d, state) \
+    do { \
+        a = _mm256_loadu_si256((const __m256i *) (state)); \
+        b = _mm256_loadu_si256((const __m256i *) (state) + 1); \
+        c = _mm256_loadu_si256((const __m256i *) (state) + 2); \
+        d = _mm256_loadu_si256((const __m256i *) (state) + 3); \
+    } while (0)
+#define STORE_STATE(state, a, b, c, d) \
+    do { \
+        _mm256_storeu_si256((__m256i *) (state), a); \
+        _mm256_storeu_si256((__m256i *) (state) + 1, b); \
+        _mm256_storeu_si256((__m256i *) (state) + 2, c); \
+        _mm256_storeu_si256((__m256i *) (state) + 3, d); \
+    } while (0)
+
+#define ROTR32(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(2,3,0,1))
+#define ROTR24(x) _mm256_shuffle_epi8((x), r24)
+#define ROTR16(x) _mm256_shuffle_epi8((x), r16)
+#define ROTR63(x) _mm256_or_si256(_mm256_srli_epi64((x), 63), _mm256_add_epi64((x), (x)))
+
+//Byte shuffles rotating every 64-bit word right by 24 and 16 bits
+#define ROTR_MASKS \
+    const __m256i r24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, \
+                                         3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10); \
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, \
+                                         2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9)
+
+//Blake2b's G function over four columns at once
+#define G4(a, b, c, d) \
+    do { \
+        a = _mm256_add_epi64(a, b); d = ROTR32(_mm256_xor_si256(d, a)); \
+        c = _mm256_add_epi64(c, d); b = ROTR24(_mm256_xor_si256(b, c)); \
+        a = _mm256_add_epi64(a, b); d = ROTR16(_mm256_xor_si256(d, a)); \
+        c = _mm256_add_epi64(c, d); b = ROTR63(_mm256_xor_si256(b, c)); \
+    } while (0)
+
+#define ROUND_LYRA_AVX2(a, b, c, d) \
+    do { \
+        G4(a, b, c, d); \
+        b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0,3,2,1)); \
+        c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2)); \
+        d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2,1,0,3)); \
+        G4(a, b, c, d); \
+        b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2,1,0,3)); \
+        c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2)); \
+        d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0,3,2,1)); \
+    } while (0)
+
+//rotW(rand): words (s11, s0, s1, ..., s10)
+#define ROTW_AVX2(r0, r1, r2, a, b, c) \
+    do { \
+        __m256i t0_ = _mm256_permute4x64_epi64(a, _MM_SHUFFLE(2,1,0,3)); \
+        __m256i t1_ = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2,1,0,3)); \
+        __m256i t2_ = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(2,1,0,3)); \
+        r0 = _mm256_blend_epi32(t0_, t2_, 0x03); \
+        r1 = _mm256_blend_epi32(t1_, t0_, 0x03); \
+        r2 = _mm256_blend_epi32(t2_, t1_, 0x03); \
+    } while (0)
+
+TARGET_AVX2 static void blake2bLyra_avx2(__m256i *a, __m256i *b, __m256i *c, __m256i *d) {
+    ROTR_MASKS;
+    __m256i va = *a, vb = *b, vc = *c, vd = *d;
+    int r;
+    for (r = 0; r < 12; r++)
+        ROUND_LYRA_AVX2(va, vb, vc, vd);
+    *a = va; *b = vb; *c = vc; *d = vd;
+}
+
+TARGET_AVX2 static void squeeze_avx2(uint64_t *state, unsigned char *out, unsigned int len) {
+    __m256i a, b, c, d;
+    int fullBlocks = len / BLOCK_LEN_BYTES;
+    int i;
+
+    LOAD_STATE(a, b, c, d, state);
+    for (i = 0; i < fullBlocks; i++) {
+        STORE_STATE(state, a, b, c, d);
+        memcpy(out, state, BLOCK_LEN_BYTES);
+        blake2bLyra_avx2(&a, &b, &c, &d);
+        out += BLOCK_LEN_BYTES;
+    }
+    STORE_STATE(state, a, b, c, d);
+    memcpy(out, state, len % BLOCK_LEN_BYTES);
+}
+
+TARGET_AVX2 static void absorbBlock_avx2(uint64_t *state, const uint64_t *in) {
+    __m256i a, b, c, d;
+
+    LOAD_STATE(a, b, c, d, state);
+    a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i *) in));
+    b = _mm256_xor_si256(b, _mm256_loadu_si256((const __m256i *) in + 1));
+    c = _mm256_xor_si256(c, _mm256_loadu_si256((const __m256i *) in + 2));
+    blake2bLyra_avx2(&a, &b, &c, &d);
+    STORE_STATE(state, a, b, c, d);
+}
+
+TARGET_AVX2 static void absorbBlockBlake2Safe_avx2(uint64_t *state, const uint64_t *in) {
+    __m256i a, b, c, d;
+
+    LOAD_STATE(a, b, c, d, state);
+    a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i *) in));
+    b = _mm256_xor_si256(b, _mm256_loadu_si256((const __m256i *) in + 1));
+    blake2bLyra_avx2(&a, &b, &c, &d);
+    STORE_STATE(state, a, b, c, d);
+}
+
+TARGET_AVX2 static void reducedSqueezeRow0_avx2(uint64_t *state, uint64_t *rowOut, uint64_t nCols) {
+    ROTR_MASKS;
+    __m256i a, b, c, d;
+    __m256i *ptrOut = (__m256i *) (rowOut + (nCols - 1) * BLOCK_LEN_INT64);
+    uint64_t i;
+
+    LOAD_STATE(a, b, c, d, state);
+    for (i = 0; i < nCols; i++) {
+        //M[row][C-1-col] = H.reduced_squeeze()
+        _mm256_storeu_si256(ptrOut, a);
+        _mm256_storeu_si256(ptrOut + 1, b);
+        _mm256_storeu_si256(ptrOut + 2, c);
+        ptrOut -= BLOCK_LEN_INT64 / 4;
+        ROUND_LYRA_AVX2(a, b, c, d);
+    }
+    STORE_STATE(state, a, b, c, d);
+}
+
+TARGET_AVX2 static void reducedDuplexRow1_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols) {
+    ROTR_MASKS;
+    __m256i a, b, c, d, in0, in1, in2;
+    const __m256i *ptrIn = (const __m256i *) rowIn;
+    __m256i *ptrOut = (__m256i *) (rowOut + (nCols - 1) * BLOCK_LEN_INT64);
+    uint64_t i;
+
+    LOAD_STATE(a, b, c, d, state);
+    for (i = 0; i < nCols; i++) {
+        //Absorbing "M[prev][col]"
+        in0 = _mm256_loadu_si256(ptrIn);
+        in1 = _mm256_loadu_si256(ptrIn + 1);
+        in2 = _mm256_loadu_si256(ptrIn + 2);
+        a = _mm256_xor_si256(a, in0);
+        b = _mm256_xor_si256(b, in1);
+        c = _mm256_xor_si256(c, in2);
+        ROUND_LYRA_AVX2(a, b, c, d);
+        //M[row][C-1-col] = M[prev][col] XOR rand
+        _mm256_storeu_si256(ptrOut, _mm256_xor_si256(in0, a));
+        _mm256_storeu_si256(ptrOut + 1, _mm256_xor_si256(in1, b));
+        _mm256_storeu_si256(ptrOut + 2, _mm256_xor_si256(in2, c));
+        ptrIn += BLOCK_LEN_INT64 / 4;
+        ptrOut -= BLOCK_LEN_INT64 / 4;
+    }
+    STORE_STATE(state, a, b, c, d);
+}
+
+TARGET_AVX2 static void reducedDuplexRowSetup_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    ROTR_MASKS;
+    __m256i a, b, c, d, in0, in1, in2, r0, r1, r2;
+    const __m256i *ptrIn = (const __m256i *) rowIn;
+    __m256i *ptrInOut = (__m256i *) rowInOut;
+    __m256i *ptrOut = (__m256i *) (rowOut + (nCols - 1) * BLOCK_LEN_INT64);
+    uint64_t i;
+
+    LOAD_STATE(a, b, c, d, state);
+    for (i = 0; i < nCols; i++) {
+        //Absorbing "M[prev] [+] M[row*]"
+        in0 = _mm256_loadu_si256(ptrIn);
+        in1 = _mm256_loadu_si256(ptrIn + 1);
+        in2 = _mm256_loadu_si256(ptrIn + 2);
+        a = _mm256_xor_si256(a, _mm256_add_epi64(in0, _mm256_loadu_si256(ptrInOut)));
+        b = _mm256_xor_si256(b, _mm256_add_epi64(in1, _mm256_loadu_si256(ptrInOut + 1)));
+        c = _mm256_xor_si256(c, _mm256_add_epi64(in2, _mm256_loadu_si256(ptrInOut + 2)));
+        ROUND_LYRA_AVX2(a, b, c, d);
+        //M[row][col] = M[prev][col] XOR rand
+        _mm256_storeu_si256(ptrOut, _mm256_xor_si256(in0, a));
+        _mm256_storeu_si256(ptrOut + 1, _mm256_xor_si256(in1, b));
+        _mm256_storeu_si256(ptrOut + 2, _mm256_xor_si256(in2, c));
+        //M[row*][col] = M[row*][col] XOR rotW(rand)
+        ROTW_AVX2(r0, r1, r2, a, b, c);
+        _mm256_storeu_si256(ptrInOut, _mm256_xor_si256(_mm256_loadu_si256(ptrInOut), r0));
+        _mm256_storeu_si256(ptrInOut + 1, _mm256_xor_si256(_mm256_loadu_si256(ptrInOut + 1), r1));
+        _mm256_storeu_si256(ptrInOut + 2, _mm256_xor_si256(_mm256_loadu_si256(ptrInOut + 2), r2));
+        ptrIn += BLOCK_LEN_INT64 / 4;
+        ptrInOut += BLOCK_LEN_INT64 / 4;
+        ptrOut -= BLOCK_LEN_INT64 / 4;
+    }
+    STORE_STATE(state, a, b, c, d);
+}
+
+TARGET_AVX2 static void reducedDuplexRow_avx2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    ROTR_MASKS;
+    __m256i a, b, c, d, r0, r1, r2;
+    const __m256i *ptrIn = (const __m256i *) rowIn;
+    __m256i *ptrInOut = (__m256i *) rowInOut;
+    __m256i *ptrOut = (__m256i *) rowOut;
+    uint64_t i;
+
+    LOAD_STATE(a, b, c, d, state);
+    for (i = 0; i < nCols; i++) {
+        //Absorbing "M[prev] [+] M[row*]"
+        a = _mm256_xor_si256(a, _mm256_add_epi64(_mm256_loadu_si256(ptrIn), _mm256_loadu_si256(ptrInOut)));
+        b = _mm256_xor_si256(b, _mm256_add_epi64(_mm256_loadu_si256(ptrIn + 1), _mm256_loadu_si256(ptrInOut + 1)));
+        c = _mm256_xor_si256(c, _mm256_add_epi64(_mm256_loadu_si256(ptrIn + 2), _mm256_loadu_si256(ptrInOut + 2)));
+        ROUND_LYRA_AVX2(a, b, c, d);
+        //M[rowOut][col] = M[rowOut][col] XOR rand
+        _mm256_storeu_si256(ptrOut, _mm256_xor_si256(_mm256_loadu_si256(ptrOut), a));
+        _mm256_storeu_si256(ptrOut + 1, _mm256_xor_si256(_mm256_loadu_si256(ptrOut + 1), b));
+        _mm256_storeu_si256(ptrOut + 2, _mm256_xor_si256(_mm256_loadu_si256(ptrOut + 2), c));
+        //M[rowInOut][col] = M[rowInOut][col] XOR rotW(rand), reloaded since row* may be the same row as rowOut
+        ROTW_AVX2(r0, r1, r2, a, b, c);
+        _mm256_storeu_si256(ptrInOut, _mm256_xor_si256(_mm256_loadu_si256(ptrInOut), r0));
+        _mm256_storeu_si256(ptrInOut + 1, _mm256_xor_si256(_mm256_loadu_si256(ptrInOut + 1), r1));
+        _mm256_storeu_si256(ptrInOut + 2, _mm256_xor_si256(_mm256_loadu_si256(ptrInOut + 2), r2));
+        ptrIn += BLOCK_LEN_INT64 / 4;
+        ptrInOut += BLOCK_LEN_INT64 / 4;
+        ptrOut += BLOCK_LEN_INT64 / 4;
+    }
+    STORE_STATE(state, a, b, c, d);
+}
+
+const LYRA2_sponge lyra2_sponge_avx2 = {
+    "avx2",
+    absorbBlock_avx2,
+    absorbBlockBlake2Safe_avx2,
+    squeeze_avx2,
+    reducedSqueezeRow0_avx2,
+    reducedDuplexRow1_avx2,
+    reducedDuplexRowSetup_avx2,
+    reducedDuplexRow_avx2
+};
+
+#endif // LYRA2_HAVE_X86_SIMD
@@ -0,0 +1,234 @@
+/**
+ * SSE2 implementation of the Blake2b sponge used by Lyra2. Produces the same results as the scalar
+ * functions in Sponge.c; the state is kept in eight 128-bit registers (two words each) while a row is
+ * processed. Selected at runtime by LYRA2_detect_simd.
+ *
+ * This software is hereby placed in the public domain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ''AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include "Lyra2.h"
+#include "Sponge.h"
+
+#if defined(LYRA2_HAVE_X86_SIMD)
+
+#include <emmintrin.h>
+
+#define TARGET_SSE2 __attribute__((target("sse2")))
+
+//State words 0-15 in pairs: s[0] = (v0,v1), ..., s[7] = (v14,v15)
+#define LOAD_STATE(s, state) \
+    do { int k_; for (k_ = 0; k_ < 8; k_++) s[k_] = _mm_loadu_si128((const __m128i *) (state) + k_); } while (0)
+#define STORE_STATE(state, s) \
+    do { int k_; for (k_ = 0; k_ < 8; k_++) _mm_storeu_si128((__m128i *) (state) + k_, s[k_]); } while (0)
+
+#define ROTR32(x) _mm_shuffle_epi32((x), _MM_SHUFFLE(2,3,0,1))
+#define ROTR24(x) _mm_or_si128(_mm_srli_epi64((x), 24), _mm_slli_epi64((x), 40))
+#define ROTR16(x) _mm_shufflehi_epi16(_mm_shufflelo_epi16((x), _MM_SHUFFLE(0,3,2,1)), _MM_SHUFFLE(0,3,2,1))
+#define ROTR63(x) _mm_or_si128(_mm_srli_epi64((x), 63), _mm_add_epi64((x), (x)))
+
+//(hi(a), lo(b))
+#define HI_LO(a, b) _mm_unpackhi_epi64((a), _mm_unpacklo_epi64((b), (b)))
+
+//Blake2b's G function over two columns at once
+#define G2(a, b, c, d) \
+    do { \
+        a = _mm_add_epi64(a, b); d = ROTR32(_mm_xor_si128(d, a)); \
+        c = _mm_add_epi64(c, d); b = ROTR24(_mm_xor_si128(b, c)); \
+        a = _mm_add_epi64(a, b); d = ROTR16(_mm_xor_si128(d, a)); \
+        c = _mm_add_epi64(c, d); b = ROTR63(_mm_xor_si128(b, c)); \
+    } while (0)
+
+//Rows: a = s[0..1], b = s[2..3], c = s[4..5], d = s[6..7]
+#define ROUND_LYRA_SSE2(s) \
+    do { \
+        __m128i t0_, t1_; \
+        G2(s[0], s[2], s[4], s[6]); \
+        G2(s[1], s[3], s[5], s[7]); \
+        /* diagonalize */ \
+        t0_ = s[4]; s[4] = s[5]; s[5] = t0_; \
+        t0_ = s[2]; t1_ = s[6]; \
+        s[2] = HI_LO(s[2], s[3]); s[3] = HI_LO(s[3], t0_); \
+        s[6] = HI_LO(s[7], t1_); s[7] = HI_LO(t1_, s[7]); \
+        G2(s[0], s[2], s[4], s[6]); \
+        G2(s[1], s[3], s[5], s[7]); \
+        /* undiagonalize */ \
+        t0_ = s[4]; s[4] = s[5]; s[5] = t0_; \
+        t0_ = s[2]; t1_ = s[6]; \
+        s[2] = HI_LO(s[3], t0_); s[3] = HI_LO(t0_, s[3]); \
+        s[6] = HI_LO(t1_, s[7]); s[7] = HI_LO(s[7], t1_); \
+    } while (0)
+
+TARGET_SSE2 static void blake2bLyra_sse2(__m128i s[8]) {
+    int r;
+    for (r = 0; r < 12; r++)
+        ROUND_LYRA_SSE2(s);
+}
+
+TARGET_SSE2 static void squeeze_sse2(uint64_t *state, unsigned char *out, unsigned int len) {
+    __m128i s[8];
+    int fullBlocks = len / BLOCK_LEN_BYTES;
+    int i;
+
+    LOAD_STATE(s, state);
+    for (i = 0; i < fullBlocks; i++) {
+        STORE_STATE(state, s);
+        memcpy(out, state, BLOCK_LEN_BYTES);
+        blake2bLyra_sse2(s);
+        out += BLOCK_LEN_BYTES;
+    }
+    STORE_STATE(state, s);
+    memcpy(out, state, len % BLOCK_LEN_BYTES);
+}
+
+TARGET_SSE2 static void absorbBlock_sse2(uint64_t *state, const uint64_t *in) {
+    __m128i s[8];
+    int k;
+
+    LOAD_STATE(s, state);
+    for (k = 0; k < 6; k++)
+        s[k] = _mm_xor_si128(s[k], _mm_loadu_si128((const __m128i *) in + k));
+    blake2bLyra_sse2(s);
+    STORE_STATE(state, s);
+}
+
+TARGET_SSE2 static void absorbBlockBlake2Safe_sse2(uint64_t *state, const uint64_t *in) {
+    __m128i s[8];
+    int k;
+
+    LOAD_STATE(s, state);
+    for (k = 0; k < 4; k++)
+        s[k] = _mm_xor_si128(s[k], _mm_loadu_si128((const __m128i *) in + k));
+    blake2bLyra_sse2(s);
+    STORE_STATE(state, s);
+}
+
+TARGET_SSE2 static void reducedSqueezeRow0_sse2(uint64_t *state, uint64_t *rowOut, uint64_t nCols) {
+    __m128i s[8];
+    __m128i *ptrOut = (__m128i *) (rowOut + (nCols - 1) * BLOCK_LEN_INT64);
+    uint64_t i;
+    int k;
+
+    LOAD_STATE(s, state);
+    for (i = 0; i < nCols; i++) {
+        //M[row][C-1-col] = H.reduced_squeeze()
+        for (k = 0; k < 6; k++)
+            _mm_storeu_si128(ptrOut + k, s[k]);
+        ptrOut -= BLOCK_LEN_INT64 / 2;
+        ROUND_LYRA_SSE2(s);
+    }
+    STORE_STATE(state, s);
+}
+
+TARGET_SSE2 static void reducedDuplexRow1_sse2(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols) {
+    __m128i s[8], in[6];
+    const __m128i *ptrIn = (const __m128i *) rowIn;
+    __m128i *ptrOut = (__m128i *) (rowOut + (nCols - 1) * BLOCK_LEN_INT64);
+    uint64_t i;
+    int k;
+
+    LOAD_STATE(s, state);
+    for (i = 0; i < nCols; i++) {
+        //Absorbing "M[prev][col]"
+        for (k = 0; k < 6; k++) {
+            in[k] = _mm_loadu_si128(ptrIn + k);
+            s[k] = _mm_xor_si128(s[k], in[k]);
+        }
+        ROUND_LYRA_SSE2(s);
+        //M[row][C-1-col] = M[prev][col] XOR rand
+        for (k = 0; k < 6; k++)
+            _mm_storeu_si128(ptrOut + k, _mm_xor_si128(in[k], s[k]));
+        ptrIn += BLOCK_LEN_INT64 / 2;
+        ptrOut -= BLOCK_LEN_INT64 / 2;
+    }
+    STORE_STATE(state, s);
+}
+
+//rotW(rand): words (s11, s0, s1, ..., s10)
+#define ROTW_SSE2(r, s) \
+    do { \
+        r[0] = HI_LO(s[5], s[0]); r[1] = HI_LO(s[0], s[1]); r[2] = HI_LO(s[1], s[2]); \
+        r[3] = HI_LO(s[2], s[3]); r[4] = HI_LO(s[3], s[4]); r[5] = HI_LO(s[4], s[5]); \
+    } while (0)
+
+TARGET_SSE2 static void reducedDuplexRowSetup_sse2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    __m128i s[8], in[6], rot[6];
+    const __m128i *ptrIn = (const __m128i *) rowIn;
+    __m128i *ptrInOut = (__m128i *) rowInOut;
+    __m128i *ptrOut = (__m128i *) (rowOut + (nCols - 1) * BLOCK_LEN_INT64);
+    uint64_t i;
+    int k;
+
+    LOAD_STATE(s, state);
+    for (i = 0; i < nCols; i++) {
+        //Absorbing "M[prev] [+] M[row*]"
+        for (k = 0; k < 6; k++) {
+            in[k] = _mm_loadu_si128(ptrIn + k);
+            s[k] = _mm_xor_si128(s[k], _mm_add_epi64(in[k], _mm_loadu_si128(ptrInOut + k)));
+        }
+        ROUND_LYRA_SSE2(s);
+        //M[row][col] = M[prev][col] XOR rand
+        for (k = 0; k < 6; k++)
+            _mm_storeu_si128(ptrOut + k, _mm_xor_si128(in[k], s[k]));
+        //M[row*][col] = M[row*][col] XOR rotW(rand)
+        ROTW_SSE2(rot, s);
+        for (k = 0; k < 6; k++)
+            _mm_storeu_si128(ptrInOut + k, _mm_xor_si128(_mm_loadu_si128(ptrInOut + k), rot[k]));
+        ptrIn += BLOCK_LEN_INT64 / 2;
+        ptrInOut += BLOCK_LEN_INT64 / 2;
+        ptrOut -= BLOCK_LEN_INT64 / 2;
+    }
+    STORE_STATE(state, s);
+}
+
+TARGET_SSE2 static void reducedDuplexRow_sse2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    __m128i s[8], rot[6];
+    const __m128i *ptrIn = (const __m128i *) rowIn;
+    __m128i *ptrInOut = (__m128i *) rowInOut;
+    __m128i *ptrOut = (__m128i *) rowOut;
+    uint64_t i;
+    int k;
+
+    LOAD_STATE(s, state);
+    for (i = 0; i < nCols; i++) {
+        //Absorbing "M[prev] [+] M[row*]"
+        for (k = 0; k < 6; k++)
+            s[k] = _mm_xor_si128(s[k], _mm_add_epi64(_mm_loadu_si128(ptrIn + k), _mm_loadu_si128(ptrInOut + k)));
+        ROUND_LYRA_SSE2(s);
+        //M[rowOut][col] = M[rowOut][col] XOR rand
+        for (k = 0; k < 6; k++)
+            _mm_storeu_si128(ptrOut + k, _mm_xor_si128(_mm_loadu_si128(ptrOut + k), s[k]));
+        //M[rowInOut][col] = M[rowInOut][col] XOR rotW(rand), reloaded since row* may be the same row as rowOut
+        ROTW_SSE2(rot, s);
+        for (k = 0; k < 6; k++)
+            _mm_storeu_si128(ptrInOut + k, _mm_xor_si128(_mm_loadu_si128(ptrInOut + k), rot[k]));
+        ptrIn += BLOCK_LEN_INT64 / 2;
+        ptrInOut += BLOCK_LEN_INT64 / 2;
+        ptrOut += BLOCK_LEN_INT64 / 2;
+    }
+    STORE_STATE(state, s);
+}
+
+const LYRA2_sponge lyra2_sponge_sse2 = {
+    "sse2",
+    absorbBlock_sse2,
+    absorbBlockBlake2Safe_sse2,
+    squeeze_sse2,
+    reducedSqueezeRow0_sse2,
+    reducedDuplexRow1_sse2,
+    reducedDuplexRowSetup_sse2,
+    reducedDuplexRow_sse2
+};
+
+#endif // LYRA2_HAVE_X86_SIMD
@@ -730,6 +730,62 @@ inline void reducedDuplexRowd(uint64_t *state, uint64_t *rowIn, uint64_t *rowInO
 }
 */
 
+const LYRA2_sponge lyra2_sponge_generic = {
+    "generic",
+    absorbBlock,
+    absorbBlockBlake2Safe,
+    squeeze,
+    reducedSqueezeRow0,
+    reducedDuplexRow1,
+    reducedDuplexRowSetup,
+    reducedDuplexRow
+};
+
+const LYRA2_sponge *lyra2_sponge = &lyra2_sponge_generic;
+
+/**
+ * Selects the given implementation of the sponge
+ *
+ * @param impl  One of LYRA2_IMPL_GENERIC, LYRA2_IMPL_SSE2, LYRA2_IMPL_AVX2
+ *
+ * @return 0 if the implementation is supported by the CPU and was selected; -1 otherwise
+ */
+int LYRA2_select_impl(int impl) {
+    switch (impl) {
+    case LYRA2_IMPL_GENERIC:
+        lyra2_sponge = &lyra2_sponge_generic;
+        return 0;
+#if defined(LYRA2_HAVE_X86_SIMD)
+    case LYRA2_IMPL_SSE2:
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("sse2"))
+            return -1;
+        lyra2_sponge = &lyra2_sponge_sse2;
+        return 0;
+    case LYRA2_IMPL_AVX2:
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("avx2"))
+            return -1;
+        lyra2_sponge = &lyra2_sponge_avx2;
+        return 0;
+#endif
+    default:
+        return -1;
+    }
+}
+
+/**
+ * Selects the fastest implementation of the sponge supported by the CPU. Must be called before any
+ * thread starts hashing.
+ *
+ * @return Name of the selected implementation
+ */
+const char *LYRA2_detect_simd(void) {
+    if (LYRA2_select_impl(LYRA2_IMPL_AVX2) != 0 && LYRA2_select_impl(LYRA2_IMPL_SSE2) != 0)
+        LYRA2_select_impl(LYRA2_IMPL_GENERIC);
+    return lyra2_sponge->name;
+}
+
 /**
  Prints an array of unsigned chars
  */
@@ -92,6 +92,34 @@ void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint
 //---- Misc
 void printArray(unsigned char *array, unsigned int size, char *name);
 
+//---- Runtime selected implementation
+//SSE2/AVX2 code is built with per-function target attributes, so no special compiler flags are needed
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define LYRA2_HAVE_X86_SIMD 1
+#endif
+
+/* Sponge operations used by Lyra2 with the state kept in memory between calls */
+typedef struct LYRA2_sponge {
+    const char *name;
+    void (*absorbBlock)(uint64_t *state, const uint64_t *in);
+    void (*absorbBlockBlake2Safe)(uint64_t *state, const uint64_t *in);
+    void (*squeeze)(uint64_t *state, unsigned char *out, unsigned int len);
+    void (*reducedSqueezeRow0)(uint64_t *state, uint64_t *row, uint64_t nCols);
+    void (*reducedDuplexRow1)(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols);
+    void (*reducedDuplexRowSetup)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+    void (*reducedDuplexRow)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+} LYRA2_sponge;
+
+extern const LYRA2_sponge lyra2_sponge_generic;
+#if defined(LYRA2_HAVE_X86_SIMD)
+extern const LYRA2_sponge lyra2_sponge_sse2;
+extern const LYRA2_sponge lyra2_sponge_avx2;
+#endif
+
+/* Implementation used by LYRA2 and LYRA2_ctx_hash, generic until LYRA2_detect_simd is called */
+extern const LYRA2_sponge *lyra2_sponge;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 
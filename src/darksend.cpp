@@ -12,6 +12,7 @@
 #include "libernode-payments.h"
 #include "libernode-sync.h"
 #include "libernodeman.h"
+#include "scheduler.h"
 #include "script/sign.h"
 #include "txmempool.h"
 #include "util.h"
@@ -2479,6 +2480,8 @@ void CDarksendPool::SetState(PoolState nStateNew) {
     nState = nStateNew;
 }
 
+static void ScheduleLibernodeCheck();
+
 void CDarksendPool::UpdatedBlockTip(const CBlockIndex *pindex) {
     pCurrentBlockIndex = pindex;
     LogPrint("privatesend", "CDarksendPool::UpdatedBlockTip -- pCurrentBlockIndex->nHeight: %d\n", pCurrentBlockIndex->nHeight);
@@ -2486,61 +2489,133 @@ void CDarksendPool::UpdatedBlockTip(const CBlockIndex *pindex) {
     if (!fLiteMode && libernodeSync.IsLibernodeListSynced()) {
         NewBlock();
     }
+
+    ScheduleLibernodeCheck();
 }
 
-//TODO: Rename/move to core
-void ThreadCheckDarkSendPool() {
-    if (fLiteMode) return; // disable all Dash specific functionality
+static CCriticalSection cs_maintenance;
+static std::map<std::string, CMaintenanceTaskStats> mapMaintenanceStats;
+static CScheduler* pschedulerMaintenance = NULL;
+// a block driven libernode check is already queued
+static bool fLibernodeCheckScheduled = false;
 
-    static bool fOneThread;
-    if (fOneThread) return;
-    fOneThread = true;
+/// Run one maintenance job and account for it, false if it had to be skipped
+static bool RunMaintenanceTask(const std::string& strName, const CScheduler::Function& func, bool fRequireSynced)
+{
+    if (ShutdownRequested()) return false;
 
-    // Make this thread recognisable as the PrivateSend thread
-    RenameThread("dash-privatesend");
+    if (fRequireSynced && !libernodeSync.IsBlockchainSynced()) {
+        LOCK(cs_maintenance);
+        mapMaintenanceStats[strName].nSkipped++;
+        return false;
+    }
 
-    unsigned int nTick = 0;
-    unsigned int nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN;
+    int64_t nStart = GetTimeMicros();
+    func();
+    int64_t nElapsed = GetTimeMicros() - nStart;
 
-    while (true) {
-        MilliSleep(1000);
+    LOCK(cs_maintenance);
+    CMaintenanceTaskStats& stats = mapMaintenanceStats[strName];
+    stats.nRuns++;
+    stats.nTotalMicros += nElapsed;
+    stats.nMaxMicros = std::max(stats.nMaxMicros, nElapsed);
+    stats.nLastMicros = nElapsed;
+    stats.nTimeLastRun = GetTime();
+    return true;
+}
 
-        // try to sync from all available nodes, one step at a time
-        libernodeSync.ProcessTick();
+/// Run func every nIntervalSeconds, counted from the end of the previous run so a slow job never piles up.
+/// Jobs waiting for the blockchain to sync retry every sync tick, which is as often as that state changes
+static void RunPeriodicMaintenanceTask(const std::string& strName, const CScheduler::Function& func, bool fRequireSynced, int64_t nIntervalSeconds)
+{
+    bool fRan = RunMaintenanceTask(strName, func, fRequireSynced);
+    if (ShutdownRequested()) return;
 
-        if (libernodeSync.IsBlockchainSynced() && !ShutdownRequested()) {
+    int64_t nDelay = fRan ? nIntervalSeconds : std::min<int64_t>(nIntervalSeconds, LIBERNODE_SYNC_TICK_SECONDS);
+    pschedulerMaintenance->scheduleFromNow(boost::bind(&RunPeriodicMaintenanceTask, strName, func, fRequireSynced, nIntervalSeconds), nDelay);
+}
 
-            nTick++;
+static void SchedulePeriodicMaintenanceTask(const std::string& strName, const CScheduler::Function& func, bool fRequireSynced, int64_t nFirstSeconds, int64_t nIntervalSeconds)
+{
+    {
+        LOCK(cs_maintenance);
+        mapMaintenanceStats[strName].strName = strName;
+    }
+    pschedulerMaintenance->scheduleFromNow(boost::bind(&RunPeriodicMaintenanceTask, strName, func, fRequireSynced, nIntervalSeconds), nFirstSeconds);
+}
 
-            // make sure to check all libernodes first
-            mnodeman.Check();
+static void CheckLibernodes()
+{
+    {
+        LOCK(cs_maintenance);
+        fLibernodeCheckScheduled = false;
+    }
+    RunMaintenanceTask("check", boost::bind(&CLibernodeMan::Check, &mnodeman), true);
+}
 
-            // check if we should activate or ping every few minutes,
-            // slightly postpone first run to give net thread a chance to connect to some peers
-            if (nTick % LIBERNODE_MIN_MNP_SECONDS == 15)
-                activeLibernode.ManageState();
+/// Re-check libernode states right away, new blocks can spend collaterals and expire pings
+static void ScheduleLibernodeCheck()
+{
+    LOCK(cs_maintenance);
+    if (!pschedulerMaintenance || fLibernodeCheckScheduled) return;
+    fLibernodeCheckScheduled = true;
+    pschedulerMaintenance->scheduleFromNow(&CheckLibernodes, 0);
+}
 
-            if (nTick % 60 == 0) {
-                mnodeman.ProcessLibernodeConnections();
-                mnodeman.CheckAndRemove();
-                mnpayments.CheckAndRemove();
-                instantsend.CheckAndRemove();
-            }
-            if (fLiberNode && (nTick % (60 * 5) == 0)) {
-                mnodeman.DoFullVerificationStep();
-            }
+static void DoPrivateSendQueueMaintenance()
+{
+    darkSendPool.CheckTimeout();
+    darkSendPool.CheckForCompleteQueue();
+}
 
-//            if(nTick % (60 * 5) == 0) {
-//                governance.DoMaintenance();
-//            }
+static void DoAutomaticDenominating()
+{
+    bool fRan = RunMaintenanceTask("privatesend-auto", boost::bind(&CDarksendPool::DoAutomaticDenominating, &darkSendPool, false), true);
+    if (ShutdownRequested()) return;
 
-            darkSendPool.CheckTimeout();
-            darkSendPool.CheckForCompleteQueue();
+    int64_t nDelay = fRan ? PRIVATESEND_AUTO_TIMEOUT_MIN + GetRandInt(PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN) : LIBERNODE_SYNC_TICK_SECONDS;
+    pschedulerMaintenance->scheduleFromNow(&DoAutomaticDenominating, nDelay);
+}
 
-            if (nDoAutoNextRun == nTick) {
-                darkSendPool.DoAutomaticDenominating();
-                nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN + GetRandInt(PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN);
-            }
-        }
+//TODO: Rename/move to core
+void ScheduleDarkSendMaintenance(CScheduler& scheduler) {
+    if (fLiteMode) return; // disable all Dash specific functionality
+
+    {
+        LOCK(cs_maintenance);
+        if (pschedulerMaintenance) return;
+        pschedulerMaintenance = &scheduler;
+        mapMaintenanceStats["check"].strName = "check";
+        mapMaintenanceStats["privatesend-auto"].strName = "privatesend-auto";
     }
+
+    // try to sync from all available nodes, one step at a time
+    SchedulePeriodicMaintenanceTask("sync", boost::bind(&CLibernodeSync::ProcessTick, &libernodeSync), false, 1, LIBERNODE_SYNC_TICK_SECONDS);
+
+    // states only change with time here, pings and new blocks trigger checks of their own
+    SchedulePeriodicMaintenanceTask("check", boost::bind(&CLibernodeMan::Check, &mnodeman), true, LIBERNODE_CHECK_SECONDS, LIBERNODE_CHECK_SECONDS);
+
+    // check if we should activate or ping every few minutes,
+    // slightly postpone first run to give net thread a chance to connect to some peers
+    SchedulePeriodicMaintenanceTask("activelibernode", boost::bind(&CActiveLibernode::ManageState, &activeLibernode), true, 15, LIBERNODE_MIN_MNP_SECONDS);
+
+    SchedulePeriodicMaintenanceTask("connections", boost::bind(&CLibernodeMan::ProcessLibernodeConnections, &mnodeman), true, 60, 60);
+    SchedulePeriodicMaintenanceTask("libernodes-cleanup", boost::bind(&CLibernodeMan::CheckAndRemove, &mnodeman), true, 60, 60);
+    SchedulePeriodicMaintenanceTask("payments-cleanup", boost::bind(&CLibernodePayments::CheckAndRemove, &mnpayments), true, 60, 60);
+    SchedulePeriodicMaintenanceTask("payees-cleanup", boost::bind(&CLibernodePayeeIndex::CheckAndRemove, &mnpayeeindex), true, 60, 60);
+    SchedulePeriodicMaintenanceTask("instantsend-cleanup", boost::bind(&CInstantSend::CheckAndRemove, &instantsend), true, 60, 60);
+
+    if (fLiberNode)
+        SchedulePeriodicMaintenanceTask("verify", boost::bind(&CLibernodeMan::DoFullVerificationStep, &mnodeman), true, 60 * 5, 60 * 5);
+
+    SchedulePeriodicMaintenanceTask("privatesend-queue", &DoPrivateSendQueueMaintenance, true, 1, 1);
+    scheduler.scheduleFromNow(&DoAutomaticDenominating, PRIVATESEND_AUTO_TIMEOUT_MIN);
+}
+
+std::vector<CMaintenanceTaskStats> GetDarkSendMaintenanceStats() {
+    LOCK(cs_maintenance);
+    std::vector<CMaintenanceTaskStats> vecStats;
+    for (std::map<std::string, CMaintenanceTaskStats>::const_iterator it = mapMaintenanceStats.begin(); it != mapMaintenanceStats.end(); ++it)
+        vecStats.push_back(it->second);
+    return vecStats;
 }
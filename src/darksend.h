@@ -11,6 +11,7 @@
 class CDarksendPool;
 class CDarkSendSigner;
 class CDarksendBroadcastTx;
+class CScheduler;
 
 // timeouts
 static const int PRIVATESEND_AUTO_TIMEOUT_MIN       = 5;
@@ -478,6 +479,24 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
 };
 
-void ThreadCheckDarkSendPool();
+/** Timing counters of a libernode / PrivateSend maintenance task */
+struct CMaintenanceTaskStats
+{
+    std::string strName;
+    int64_t nRuns;
+    // runs skipped because the blockchain wasn't synced yet
+    int64_t nSkipped;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    int64_t nLastMicros;
+    int64_t nTimeLastRun;
+
+    CMaintenanceTaskStats() : nRuns(0), nSkipped(0), nTotalMicros(0), nMaxMicros(0), nLastMicros(0), nTimeLastRun(0) {}
+};
+
+/// Schedule the libernode / PrivateSend maintenance jobs as independent tasks
+void ScheduleDarkSendMaintenance(CScheduler& scheduler);
+/// Counters of all maintenance tasks, by name
+std::vector<CMaintenanceTaskStats> GetDarkSendMaintenanceStats();
 
 #endif
@@ -7,11 +7,140 @@
 
 #include "chainparams.h"
 #include "clientversion.h"
+#include "crypto/common.h"
 #include "hash.h"
 #include "streams.h"
 #include "util.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+//! size of the buffer between the (de)serializer and the file
+static const size_t FLATDB_BUFFER_SIZE = 1 << 20;
+//! the journal is folded into a new snapshot once it outgrows the snapshot, or this size, whichever is larger
+static const uint64_t FLATDB_MIN_JOURNAL_SIZE = 1 << 20;
+
+/**
+*   Serializes into a file through a bounded buffer, hashing everything written
+*/
+class CFlatDBFileWriter
+{
+private:
+    FILE* file;
+    CHashWriter hasher;
+    std::vector<char> vBuffer;
+
+    void Flush()
+    {
+        if (!vBuffer.empty() && fwrite(&vBuffer[0], 1, vBuffer.size(), file) != vBuffer.size())
+            throw std::ios_base::failure("CFlatDBFileWriter::Flush: write failed");
+        vBuffer.clear();
+    }
+
+public:
+    int nType;
+    int nVersion;
+
+    CFlatDBFileWriter(FILE* fileIn, int nTypeIn, int nVersionIn) :
+        file(fileIn), hasher(nTypeIn, nVersionIn), nType(nTypeIn), nVersion(nVersionIn)
+    {
+        vBuffer.reserve(FLATDB_BUFFER_SIZE);
+    }
+
+    CFlatDBFileWriter& write(const char* pch, size_t nSize)
+    {
+        hasher.write(pch, nSize);
+        while (nSize > 0) {
+            size_t nChunk = std::min(nSize, FLATDB_BUFFER_SIZE - vBuffer.size());
+            vBuffer.insert(vBuffer.end(), pch, pch + nChunk);
+            pch += nChunk;
+            nSize -= nChunk;
+            if (vBuffer.size() == FLATDB_BUFFER_SIZE)
+                Flush();
+        }
+        return (*this);
+    }
+
+    template<typename T>
+    CFlatDBFileWriter& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+
+    /// Append the checksum of everything written so far and flush. Nothing can be written afterwards
+    uint256 Finalize()
+    {
+        uint256 hash = hasher.GetHash();
+        vBuffer.insert(vBuffer.end(), (const char*)hash.begin(), (const char*)hash.end());
+        Flush();
+        return hash;
+    }
+};
+
+/**
+*   Deserializes the nDataSize bytes preceding the checksum of a file through a bounded buffer,
+*   hashing everything read
+*/
+class CFlatDBFileReader
+{
+private:
+    FILE* file;
+    CHashWriter hasher;
+    std::vector<char> vBuffer;
+    size_t nPos;
+    uint64_t nRemaining;
+
+    void Fill()
+    {
+        if (nRemaining == 0)
+            throw std::ios_base::failure("CFlatDBFileReader::read: end of data");
+        size_t nChunk = std::min<uint64_t>(nRemaining, FLATDB_BUFFER_SIZE);
+        vBuffer.resize(nChunk);
+        if (fread(&vBuffer[0], 1, nChunk, file) != nChunk)
+            throw std::ios_base::failure("CFlatDBFileReader::read: read failed");
+        hasher.write(&vBuffer[0], nChunk);
+        nRemaining -= nChunk;
+        nPos = 0;
+    }
+
+public:
+    int nType;
+    int nVersion;
+
+    CFlatDBFileReader(FILE* fileIn, uint64_t nDataSize, int nTypeIn, int nVersionIn) :
+        file(fileIn), hasher(nTypeIn, nVersionIn), nPos(0), nRemaining(nDataSize), nType(nTypeIn), nVersion(nVersionIn)
+    {}
+
+    CFlatDBFileReader& read(char* pch, size_t nSize)
+    {
+        while (nSize > 0) {
+            if (nPos == vBuffer.size())
+                Fill();
+            size_t nChunk = std::min(nSize, vBuffer.size() - nPos);
+            memcpy(pch, &vBuffer[nPos], nChunk);
+            nPos += nChunk;
+            pch += nChunk;
+            nSize -= nChunk;
+        }
+        return (*this);
+    }
+
+    template<typename T>
+    CFlatDBFileReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+
+    /// Hash of all data, including whatever the deserializer left unread
+    uint256 GetHash()
+    {
+        while (nRemaining > 0)
+            Fill();
+        return hasher.GetHash();
+    }
+};
 
 /** 
 *   Generic Dumping and Loading
@@ -21,7 +150,7 @@
 template<typename T>
 class CFlatDB
 {
-private:
+protected:
 
     enum ReadResult {
         Ok,
@@ -37,34 +166,38 @@ private:
     std::string strFilename;
     std::string strMagicMessage;
 
-    bool Write(const T& objToSave)
+    bool Write(const T& objToSave, uint256* phashRet = NULL)
     {
         // LOCK(objToSave.cs);
 
         int64_t nStart = GetTimeMillis();
 
-        // serialize, checksum data up to that point, then append checksum
-        CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-        ssObj << strMagicMessage; // specific magic message for this type of object
-        ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-        ssObj << objToSave;
-        uint256 hash = Hash(ssObj.begin(), ssObj.end());
-        ssObj << hash;
+        // write next to the old file and swap it in, so a failed write never leaves a truncated file
+        boost::filesystem::path pathTmp = pathDB.string() + ".new";
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
+        if (!file)
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
-        // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
-        CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-        if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
-
-        // Write and commit header, data
+        // serialize through a bounded buffer, checksum data up to that point, then append checksum
         try {
-            fileout << ssObj;
+            CFlatDBFileWriter fileout(file, SER_DISK, CLIENT_VERSION);
+            fileout << strMagicMessage; // specific magic message for this type of object
+            fileout << FLATDATA(Params().MessageStart()); // network specific magic number
+            fileout << objToSave;
+            uint256 hash = fileout.Finalize();
+            if (phashRet)
+                *phashRet = hash;
         }
         catch (std::exception &e) {
+            fclose(file);
+            boost::filesystem::remove(pathTmp);
             return error("%s: Serialize or I/O error - %s", __func__, e.what());
         }
-        fileout.fclose();
+        FileCommit(file);
+        fclose(file);
+
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Failed to rename %s to %s", __func__, pathTmp.string(), pathDB.string());
 
         LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToSave.ToString());
@@ -72,11 +205,9 @@ private:
         return true;
     }
 
-    ReadResult Read(T& objToLoad, bool fDryRun = false)
+    /// Stream the file into objToLoad, or only check its header and checksum if pobjToLoad is NULL
+    ReadResult ReadFile(T* pobjToLoad, uint256* phashRet = NULL)
     {
-        //LOCK(objToLoad.cs);
-
-        int64_t nStart = GetTimeMillis();
         // open input file, and associate with CAutoFile
         FILE *file = fopen(pathDB.string().c_str(), "rb");
         CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
@@ -86,71 +217,97 @@ private:
             return FileError;
         }
 
-        // use file size to size memory buffer
-        int fileSize = boost::filesystem::file_size(pathDB);
-        int dataSize = fileSize - sizeof(uint256);
-        // Don't try to resize to a negative number if file is small
-        if (dataSize < 0)
-            dataSize = 0;
-        std::vector<unsigned char> vchData;
-        vchData.resize(dataSize);
-        uint256 hashIn;
-
-        // read data and checksum from file
-        try {
-            filein.read((char *)&vchData[0], dataSize);
-            filein >> hashIn;
-        }
-        catch (std::exception &e) {
-            error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            return HashReadError;
-        }
-        filein.fclose();
-
-        CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
-
-        // verify stored checksum matches input data
-        uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-        if (hashIn != hashTmp)
+        // the checksum is stored after the data
+        uint64_t nFileSize = boost::filesystem::file_size(pathDB);
+        if (nFileSize < sizeof(uint256))
         {
-            error("%s: Checksum mismatch, data corrupted", __func__);
-            return IncorrectHash;
+            error("%s: File %s is too small", __func__, pathDB.string());
+            return HashReadError;
         }
-
+        CFlatDBFileReader ssObj(filein.Get(), nFileSize - sizeof(uint256), SER_DISK, CLIENT_VERSION);
 
         unsigned char pchMsgTmp[4];
         std::string strMagicMessageTmp;
+        ReadResult result = Ok;
+        std::string strError;
         try {
             // de-serialize file header (file specific magic message) and ..
             ssObj >> strMagicMessageTmp;
 
             // ... verify the message matches predefined one
             if (strMagicMessage != strMagicMessageTmp)
-            {
-                error("%s: Invalid magic message", __func__);
-                return IncorrectMagicMessage;
-            }
-
+                result = IncorrectMagicMessage;
 
             // de-serialize file header (network specific magic number) and ..
-            ssObj >> FLATDATA(pchMsgTmp);
+            if (result == Ok)
+                ssObj >> FLATDATA(pchMsgTmp);
 
             // ... verify the network matches ours
-            if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
-            {
-                error("%s: Invalid network magic number", __func__);
-                return IncorrectMagicNumber;
-            }
+            if (result == Ok && memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+                result = IncorrectMagicNumber;
 
             // de-serialize data into T object
-            ssObj >> objToLoad;
+            if (result == Ok && pobjToLoad)
+                ssObj >> *pobjToLoad;
+        }
+        catch (std::exception &e) {
+            strError = e.what();
+            result = IncorrectFormat;
+        }
+
+        // verify stored checksum matches input data. Data is deserialized as it streams in,
+        // so corruption is only detected here and whatever was loaded has to be dropped
+        uint256 hashIn, hashTmp;
+        try {
+            hashTmp = ssObj.GetHash();
+            filein >> hashIn;
         }
         catch (std::exception &e) {
-            objToLoad.Clear();
+            if (pobjToLoad)
+                pobjToLoad->Clear();
             error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            return IncorrectFormat;
+            return HashReadError;
+        }
+        filein.fclose();
+
+        if (hashIn != hashTmp)
+        {
+            if (pobjToLoad)
+                pobjToLoad->Clear();
+            error("%s: Checksum mismatch, data corrupted", __func__);
+            return IncorrectHash;
+        }
+
+        switch (result) {
+            case IncorrectMagicMessage:
+                error("%s: Invalid magic message", __func__);
+                break;
+            case IncorrectMagicNumber:
+                error("%s: Invalid network magic number", __func__);
+                break;
+            case IncorrectFormat:
+                if (pobjToLoad)
+                    pobjToLoad->Clear();
+                error("%s: Deserialize or I/O error - %s", __func__, strError);
+                break;
+            default:
+                break;
         }
 
+        if (phashRet)
+            *phashRet = hashIn;
+        return result;
+    }
+
+    ReadResult Read(T& objToLoad, bool fDryRun = false, uint256* phashRet = NULL)
+    {
+        //LOCK(objToLoad.cs);
+
+        int64_t nStart = GetTimeMillis();
+        ReadResult readResult = ReadFile(&objToLoad, phashRet);
+        if (readResult != Ok)
+            return readResult;
+
         LogPrintf("Loaded info from %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToLoad.ToString());
         if(!fDryRun) {
@@ -162,19 +319,9 @@ private:
         return Ok;
     }
 
-
-public:
-    CFlatDB(std::string strFilenameIn, std::string strMagicMessageIn)
-    {
-        pathDB = GetDataDir() / strFilenameIn;
-        strFilename = strFilenameIn;
-        strMagicMessage = strMagicMessageIn;
-    }
-
-    bool Load(T& objToLoad)
+    /// Log the outcome of reading the file, false if it must not be touched
+    bool CheckReadResult(ReadResult readResult)
     {
-        LogPrintf("Reading info from %s...\n", strFilename);
-        ReadResult readResult = Read(objToLoad);
         if (readResult == FileError)
             LogPrintf("Missing file %s, will try to recreate\n", strFilename);
         else if (readResult != Ok)
@@ -186,35 +333,35 @@ public:
             }
             else {
                 LogPrintf("%s: File format is unknown or invalid, please fix it manually\n", __func__);
-                // program should exit with an error
                 return false;
             }
         }
         return true;
     }
 
+public:
+    CFlatDB(std::string strFilenameIn, std::string strMagicMessageIn)
+    {
+        pathDB = GetDataDir() / strFilenameIn;
+        strFilename = strFilenameIn;
+        strMagicMessage = strMagicMessageIn;
+    }
+
+    bool Load(T& objToLoad)
+    {
+        LogPrintf("Reading info from %s...\n", strFilename);
+        // program should exit with an error if the file can't be used
+        return CheckReadResult(Read(objToLoad));
+    }
+
     bool Dump(T& objToSave)
     {
         int64_t nStart = GetTimeMillis();
 
+        // header and checksum only, the content is not loaded just to be thrown away
         LogPrintf("Verifying %s format...\n", strFilename);
-        T tmpObjToLoad;
-        ReadResult readResult = Read(tmpObjToLoad, true);
-
-        // there was an error and it was not an error on file opening => do not proceed
-        if (readResult == FileError)
-            LogPrintf("Missing file %s, will try to recreate\n", strFilename);
-        else if (readResult != Ok)
-        {
-            LogPrintf("Error reading %s: ", strFilename);
-            if(readResult == IncorrectFormat)
-                LogPrintf("%s: Magic is ok but data has invalid format, will try to recreate\n", __func__);
-            else
-            {
-                LogPrintf("%s: File format is unknown or invalid, please fix it manually\n", __func__);
-                return false;
-            }
-        }
+        if (!CheckReadResult(ReadFile(NULL)))
+            return false;
 
         LogPrintf("Writting info to %s...\n", strFilename);
         Write(objToSave);
@@ -225,5 +372,216 @@ public:
 
 };
 
+/**
+*   Snapshot plus journal
+*   ---------------------
+*   Changes made after the snapshot are appended to <file>.journal as records taken from
+*   T::TakeJournalRecords() and replayed with T::ApplyJournalRecord() once the snapshot is loaded.
+*   The journal starts with the checksum of its snapshot, so a journal left over from an older
+*   snapshot is ignored. Every record carries its own checksum, a torn tail is cut off on load.
+*/
+
+template<typename T>
+class CJournaledFlatDB : public CFlatDB<T>
+{
+private:
+    typedef typename CFlatDB<T>::ReadResult ReadResult;
+
+    boost::filesystem::path pathJournal;
+
+    /// Checksum stored at the end of the snapshot
+    bool ReadSnapshotHash(uint256& hashRet)
+    {
+        FILE *file = fopen(this->pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull() || fseek(filein.Get(), -(long)sizeof(uint256), SEEK_END) != 0)
+            return false;
+        try {
+            filein >> hashRet;
+        }
+        catch (std::exception &e) {
+            return false;
+        }
+        return true;
+    }
+
+    /// Read and check the journal header, leaving filein at the first record
+    bool ReadJournalHeader(CAutoFile& filein, const uint256& hashSnapshot)
+    {
+        std::string strMagicMessageTmp;
+        unsigned char pchMsgTmp[4];
+        uint256 hashSnapshotTmp;
+        try {
+            filein >> strMagicMessageTmp >> FLATDATA(pchMsgTmp) >> hashSnapshotTmp;
+        }
+        catch (std::exception &e) {
+            return false;
+        }
+        return strMagicMessageTmp == this->strMagicMessage &&
+               memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)) == 0 &&
+               hashSnapshotTmp == hashSnapshot;
+    }
+
+    void ReplayJournal(T& objToLoad, const uint256& hashSnapshot)
+    {
+        int64_t nStart = GetTimeMillis();
+
+        FILE *file = fopen(pathJournal.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return;
+
+        if (!ReadJournalHeader(filein, hashSnapshot)) {
+            LogPrintf("Journal %s does not belong to %s, ignoring it\n", pathJournal.filename().string(), this->strFilename);
+            return;
+        }
+
+        uint64_t nFileSize = boost::filesystem::file_size(pathJournal);
+        uint64_t nGood = ftell(filein.Get());
+        int nRecords = 0;
+        while (nGood < nFileSize) {
+            try {
+                uint32_t nSize, nChecksum;
+                filein >> nSize;
+                if (nSize == 0 || nSize > MAX_SIZE || nGood + 2 * sizeof(uint32_t) + nSize > nFileSize)
+                    break;
+                CDataStream ssRecord(SER_DISK, CLIENT_VERSION);
+                ssRecord.resize(nSize);
+                filein.read(&ssRecord[0], nSize);
+                filein >> nChecksum;
+                uint256 hash = Hash(ssRecord.begin(), ssRecord.end());
+                if (nChecksum != ReadLE32(hash.begin()))
+                    break;
+                objToLoad.ApplyJournalRecord(ssRecord);
+            }
+            catch (std::exception &e) {
+                error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                break;
+            }
+            nGood = ftell(filein.Get());
+            nRecords++;
+        }
+        filein.fclose();
+
+        if (nGood < nFileSize) {
+            // new records are appended, they must not end up behind garbage
+            LogPrintf("Dropping %d bytes of torn tail of %s\n", nFileSize - nGood, pathJournal.filename().string());
+            boost::filesystem::resize_file(pathJournal, nGood);
+        }
+
+        LogPrintf("Replayed %d records from %s  %dms\n", nRecords, pathJournal.filename().string(), GetTimeMillis() - nStart);
+    }
+
+    /// Fold everything into a new snapshot and start an empty journal for it
+    bool WriteSnapshot(T& objToSave)
+    {
+        // do not overwrite a file that isn't ours
+        LogPrintf("Verifying %s format...\n", this->strFilename);
+        if (!this->CheckReadResult(this->ReadFile(NULL)))
+            return false;
+
+        uint256 hashSnapshot;
+        LogPrintf("Writting info to %s...\n", this->strFilename);
+        if (!this->Write(objToSave, &hashSnapshot))
+            return false;
+
+        // if this fails, the old journal no longer matches the snapshot and is ignored on load
+        FILE *file = fopen(pathJournal.string().c_str(), "wb");
+        CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull())
+            return error("%s: Failed to open file %s", __func__, pathJournal.string());
+        try {
+            fileout << this->strMagicMessage << FLATDATA(Params().MessageStart()) << hashSnapshot;
+        }
+        catch (std::exception &e) {
+            return error("%s: Serialize or I/O error - %s", __func__, e.what());
+        }
+        FileCommit(fileout.Get());
+        return true;
+    }
+
+public:
+    CJournaledFlatDB(std::string strFilenameIn, std::string strMagicMessageIn) :
+        CFlatDB<T>(strFilenameIn, strMagicMessageIn)
+    {
+        pathJournal = GetDataDir() / (strFilenameIn + ".journal");
+    }
+
+    bool Load(T& objToLoad)
+    {
+        LogPrintf("Reading info from %s...\n", this->strFilename);
+        uint256 hashSnapshot;
+        ReadResult readResult = this->Read(objToLoad, true, &hashSnapshot);
+        if (!this->CheckReadResult(readResult))
+            return false;
+
+        // The journal is replayed here rather than on first use. Dump keeps it below the size of the snapshot
+        // (or FLATDB_MIN_JOURNAL_SIZE), so this costs no more than the snapshot read, and CheckAndRemove
+        // below needs the complete state anyway
+        if (readResult == CFlatDB<T>::Ok)
+            ReplayJournal(objToLoad, hashSnapshot);
+
+        LogPrintf("%s: Cleaning....\n", __func__);
+        objToLoad.CheckAndRemove();
+        LogPrintf("     %s\n", objToLoad.ToString());
+        return true;
+    }
+
+    /// Append the changes made since the last flush, or write a new snapshot if the journal got too long
+    bool Dump(T& objToSave)
+    {
+        int64_t nStart = GetTimeMillis();
+
+        std::vector<CDataStream> vRecords;
+        objToSave.TakeJournalRecords(vRecords);
+
+        uint64_t nAppendSize = 0;
+        BOOST_FOREACH(const CDataStream& ssRecord, vRecords)
+            nAppendSize += ssRecord.size() + 2 * sizeof(uint32_t);
+
+        // append only to a journal that belongs to the snapshot on disk
+        uint256 hashSnapshot;
+        FILE *file = NULL;
+        if (ReadSnapshotHash(hashSnapshot))
+            file = fopen(pathJournal.string().c_str(), "r+b");
+        CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+        bool fSnapshot = fileout.IsNull() || !ReadJournalHeader(fileout, hashSnapshot);
+        if (!fSnapshot) {
+            uint64_t nJournalSize = boost::filesystem::file_size(pathJournal);
+            uint64_t nSnapshotSize = boost::filesystem::file_size(this->pathDB);
+            fSnapshot = nJournalSize + nAppendSize > std::max(nSnapshotSize, FLATDB_MIN_JOURNAL_SIZE);
+        }
+
+        if (fSnapshot) {
+            fileout.fclose();
+            // the snapshot includes whatever vRecords held
+            if (!WriteSnapshot(objToSave))
+                return false;
+            LogPrintf("%s dump finished  %dms\n", this->strFilename, GetTimeMillis() - nStart);
+            return true;
+        }
+
+        try {
+            fseek(fileout.Get(), 0, SEEK_END);
+            BOOST_FOREACH(const CDataStream& ssRecord, vRecords) {
+                if (ssRecord.empty())
+                    continue;
+                uint256 hash = Hash(ssRecord.begin(), ssRecord.end());
+                fileout << (uint32_t)ssRecord.size();
+                fileout.write(&ssRecord[0], ssRecord.size());
+                fileout << ReadLE32(hash.begin());
+            }
+        }
+        catch (std::exception &e) {
+            return error("%s: Serialize or I/O error - %s", __func__, e.what());
+        }
+        FileCommit(fileout.Get());
+
+        LogPrintf("Appended %d records to %s  %dms\n", vRecords.size(), pathJournal.filename().string(), GetTimeMillis() - nStart);
+        LogPrintf("     %s\n", objToSave.ToString());
+        return true;
+    }
+};
+
 
 #endif
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
+#include "crypto/Lyra2Z/Lyra2.h"
 #include "consensus/validation.h"
 #include "httpserver.h"
 #include "httprpc.h"
@@ -37,6 +38,8 @@
 #include "utilmoneystr.h"
 #include "validationinterface.h"
 #include "validation.h"
+#include "zerocoin.h"
+#include "libzerocoin/ParallelTasks.h"
 
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
@@ -220,6 +223,7 @@ void Interrupt(boost::thread_group &threadGroup) {
     InterruptREST();
     InterruptTorControl();
     threadGroup.interrupt_all();
+    WakeSocketHandler();
 }
 
 void Shutdown() {
@@ -256,6 +260,8 @@ void Shutdown() {
     CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
     flatdb4.Dump(netfulfilledman);
     */
+    CJournaledFlatDB<CLibernodePayeeIndex> flatdb5("libercoinpayees.dat", "magicLibernodePayeeIndex");
+    flatdb5.Dump(mnpayeeindex);
     StopTorControl();
     UnregisterNodeSignals(GetNodeSignals());
 
@@ -311,6 +317,7 @@ void Shutdown() {
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    StopDebugLogWriter();
 }
 
 /**
@@ -396,6 +403,9 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-par=<n>", strprintf(
             _("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
             -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-zkpthreads=<n>", strprintf(
+            _("Set the number of threads used for zerocoin proving, header hashing and libernode signature checks (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+            -GetNumCores(), MAX_ZEROCOIN_THREADS, DEFAULT_ZEROCOIN_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
@@ -470,6 +480,9 @@ std::string HelpMessage(HelpMessageMode mode) {
             _("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)"),
             DEFAULT_RPC_SERIALIZE_VERSION));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(
+            _("Socket event backend: select, or epoll where available (default: %s)"),
+            GetSocketEventsModeName(GetDefaultSocketEventsMode())));
     strUsage += HelpMessageOpt("-timeout=<n>",
                                strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"),
                                          DEFAULT_CONNECT_TIMEOUT));
@@ -523,6 +536,9 @@ std::string HelpMessage(HelpMessageMode mode) {
         strUsage += HelpMessageOpt("-checkpoints",
                                    strprintf("Disable expensive verification for known chain history (default: %u)",
                                              DEFAULT_CHECKPOINTS_ENABLED));
+        strUsage += HelpMessageOpt("-checkpowondisk",
+                                   strprintf("Recompute proof of work of every block read from disk instead of checking the hash stored in the block index (default: %u)",
+                                             DEFAULT_CHECKPOWONDISK));
         strUsage += HelpMessageOpt("-disablesafemode",
                                    strprintf("Disable safemode, override a real safe mode event (default: %u)",
                                              DEFAULT_DISABLE_SAFEMODE));
@@ -547,7 +563,7 @@ std::string HelpMessage(HelpMessageMode mode) {
         strUsage += HelpMessageOpt("-bip9params=deployment:start:end",
                                    "Use given start/end times for specified bip9 deployment (regtest-only)");
     }
-    string debugCategories = "addrman, alert, bench, cmpctblock, coindb, db, http, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, zmq"; // Don't translate these and qt below
+    string debugCategories = "addrman, alert, bench, cmpctblock, coindb, db, http, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, zerocoin, zmq"; // Don't translate these and qt below
     if (mode == HMM_BITCOIN_QT)
         debugCategories += ", qt";
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(
@@ -560,6 +576,9 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-genproclimit=<n>", strprintf(
             _("Set the number of threads for coin generation if enabled (-1 = all cores, default: %d)"),
             DEFAULT_GENERATE_THREADS));
+    if (showDebug)
+        strUsage += HelpMessageOpt("-genlanes=<n>", strprintf("Number of nonces every coin generation thread hashes together, up to %d (default: %d)",
+            LYRA2_MAX_LANES, DEFAULT_GENERATE_LANES));
 
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
     strUsage += HelpMessageOpt("-logips",
@@ -567,6 +586,9 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"),
                                                            DEFAULT_LOGTIMESTAMPS));
     if (showDebug) {
+        strUsage += HelpMessageOpt("-logasync",
+                                   strprintf("Write debug.log from a background thread, up to 100ms of messages are lost on a crash (default: %u)",
+                                             DEFAULT_LOGASYNC));
         strUsage += HelpMessageOpt("-logtimemicros",
                                    strprintf("Add microsecond precision to debug timestamps (default: %u)",
                                              DEFAULT_LOGTIMEMICROS));
@@ -580,6 +602,9 @@ std::string HelpMessage(HelpMessageMode mode) {
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>",
                                    strprintf("Limit size of signature cache to <n> MiB (default: %u)",
                                              DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxzerocoinspendcachesize=<n>",
+                                   strprintf("Limit size of verified zerocoin spend cache to <n> MiB (default: %u)",
+                                             DEFAULT_MAX_ZEROCOIN_SPEND_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf(
                 "Maximum tip age in seconds to consider node in initial block download (default: %u)",
                 DEFAULT_MAX_TIP_AGE));
@@ -1119,6 +1144,14 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
 #endif
     }
 
+    bool fExplicitSocketEvents = mapArgs.count("-socketevents") != 0;
+    if (fExplicitSocketEvents &&
+        !ParseSocketEventsMode(GetArg("-socketevents", ""), nSocketEventsMode))
+        return InitError(strprintf(_("Unsupported -socketevents mode: '%s'"), GetArg("-socketevents", "")));
+    // Settle the mode before the connection limits and listening sockets depend on it
+    if (!InitSocketEvents(!fExplicitSocketEvents))
+        return InitError(strprintf(_("Could not set up socket events mode '%s'"), GetArg("-socketevents", "")));
+
     // Make sure enough file descriptors are available
     int nBind = std::max(
             (mapMultiArgs.count("-bind") ? mapMultiArgs.at("-bind").size() : 0) +
@@ -1127,7 +1160,8 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int) (FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    if (nSocketEventsMode == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::max(std::min(nMaxConnections, (int) (FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1174,6 +1208,7 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fCheckPoWOnDisk = GetBoolArg("-checkpowondisk", DEFAULT_CHECKPOWONDISK);
 
     // mempool AC_CONFIG_SUBDIRSlimits
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
@@ -1308,6 +1343,9 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
 
     // ********************************************************* Step 4: application initialization: dir lock, daemonize, pidfile, debug log
 
+    // Pick the fastest Lyra2 sponge the CPU supports
+    std::string strLyra2Impl = LYRA2_detect_simd();
+
     // Initialize elliptic curve code
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1340,23 +1378,37 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     if (GetBoolArg("-shrinkdebugfile", !fDebug))
         ShrinkDebugFile();
 
-    if (fPrintToDebugLog)
+    if (fPrintToDebugLog) {
         OpenDebugLog();
+        if (GetBoolArg("-logasync", DEFAULT_LOGASYNC))
+            StartDebugLogWriter();
+    }
 
     if (!fLogTimestamps)
         LogPrintf("Startup time: %s\n", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()));
     LogPrintf("Default data directory %s\n", GetDefaultDataDir().string());
     LogPrintf("Using data directory %s\n", strDataDir);
     LogPrintf("Using config file %s\n", GetConfigFile().string());
+    LogPrintf("Using the '%s' Lyra2 sponge implementation\n", strLyra2Impl);
     LogPrintf("Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
     std::ostringstream strErrors;
 
-    LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    LogPrintf("Using %u threads for script and zerocoin spend verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+        for (int i = 0; i < nScriptCheckThreads - 1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadZerocoinSpendCheck);
+        }
     }
 
+    // Wallet proving, header hashing and libernode signature checks share one pool, started on first use
+    int nZerocoinThreads = GetArg("-zkpthreads", DEFAULT_ZEROCOIN_THREADS);
+    if (nZerocoinThreads <= 0)
+        nZerocoinThreads += GetNumCores();
+    nZerocoinThreads = std::max(std::min(nZerocoinThreads, MAX_ZEROCOIN_THREADS), 1);
+    libzerocoin::ParallelTasks::SetThreadCount(nZerocoinThreads);
+    LogPrintf("Using %u threads for zerocoin proofs\n", nZerocoinThreads);
+
     // Start the lightweight task scheduler thread
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
@@ -1944,6 +1996,10 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
        */
        CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
        flatdb4.Load(netfulfilledman);
+
+       uiInterface.InitMessage(_("Loading libernode payee index..."));
+       CJournaledFlatDB<CLibernodePayeeIndex> flatdb5("libercoinpayees.dat", "magicLibernodePayeeIndex");
+       flatdb5.Load(mnpayeeindex);
        /*
        if (!flatdb4.Load(netfulfilledman)) {
            LogPrint("Failed to load fulfilled requests cache from netfulfilled.dat");
@@ -1961,9 +2017,9 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
        libernodeSync.UpdatedBlockTip(chainActive.Tip());
    //    governance.UpdatedBlockTip(chainActive.Tip());
 
-       // ********************************************************* Step 11d: start dash-privatesend thread
+       // ********************************************************* Step 11d: schedule libernode and PrivateSend maintenance
 
-       threadGroup.create_thread(boost::bind(&ThreadCheckDarkSendPool));
+       ScheduleDarkSendMaintenance(scheduler);
 
 
 
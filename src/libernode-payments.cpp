@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "activelibernode.h"
+#include "clientversion.h"
 #include "darksend.h"
 #include "libernode-payments.h"
 #include "libernode-sync.h"
@@ -15,6 +16,8 @@
 
 /** Object for who's going to get paid on which blocks */
 CLibernodePayments mnpayments;
+/** Object for who was paid by recent blocks */
+CLibernodePayeeIndex mnpayeeindex;
 
 CCriticalSection cs_vecPayees;
 CCriticalSection cs_mapLibernodeBlocks;
@@ -904,3 +907,127 @@ void CLibernodePayments::UpdatedBlockTip(const CBlockIndex *pindex) {
     
     ProcessBlock(pindex->nHeight + 5);
 }
+
+void CLibernodePayeeIndex::GetCoinbasePayees(const CBlock& block, int nHeight, CBlockCoinbasePayees& payeesRet) {
+    payeesRet.blockHash = block.GetHash();
+    payeesRet.vecPayees.clear();
+
+    CAmount nLibernodePayment = GetLibernodePayment(nHeight, block.vtx[0].GetValueOut());
+    BOOST_FOREACH(const CTxOut& txout, block.vtx[0].vout) {
+        if (txout.nValue == nLibernodePayment)
+            payeesRet.vecPayees.push_back(txout);
+    }
+}
+
+void CLibernodePayeeIndex::AddBlock(const CBlock& block, const CBlockIndex* pindex) {
+    CBlockCoinbasePayees payees;
+    GetCoinbasePayees(block, pindex->nHeight, payees);
+    int nMinHeight = pindex->nHeight - mnpayments.GetStorageLimit();
+
+    LOCK(cs);
+    mapBlockPayees[pindex->nHeight] = payees;
+    setDirtyHeights.insert(pindex->nHeight);
+    // the periodic cleanup only runs once synced, don't let the index grow with the chain until then
+    EraseBelow(nMinHeight);
+}
+
+void CLibernodePayeeIndex::RemoveBlock(const CBlockIndex* pindex) {
+    LOCK(cs);
+    std::map<int, CBlockCoinbasePayees>::iterator it = mapBlockPayees.find(pindex->nHeight);
+    if (it != mapBlockPayees.end() && it->second.blockHash == pindex->GetBlockHash()) {
+        mapBlockPayees.erase(it);
+        setDirtyHeights.insert(pindex->nHeight);
+    }
+}
+
+bool CLibernodePayeeIndex::GetPayees(const CBlockIndex* pindex, std::vector<CTxOut>& vecPayeesRet) {
+    {
+        LOCK(cs);
+        std::map<int, CBlockCoinbasePayees>::const_iterator it = mapBlockPayees.find(pindex->nHeight);
+        if (it != mapBlockPayees.end() && it->second.blockHash == pindex->GetBlockHash()) {
+            vecPayeesRet = it->second.vecPayees;
+            return true;
+        }
+    }
+
+    // block connected before the index was there (or dropped with an old cache file)
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+        LogPrintf("CLibernodePayeeIndex::GetPayees -- ReadBlockFromDisk failed at nHeight %d\n", pindex->nHeight);
+        return false;
+    }
+
+    CBlockCoinbasePayees payees;
+    GetCoinbasePayees(block, pindex->nHeight, payees);
+    vecPayeesRet = payees.vecPayees;
+
+    LOCK(cs);
+    mapBlockPayees[pindex->nHeight] = payees;
+    setDirtyHeights.insert(pindex->nHeight);
+    return true;
+}
+
+void CLibernodePayeeIndex::CheckAndRemove() {
+    LOCK(cs);
+    if (mapBlockPayees.empty())
+        return;
+
+    // keep as many blocks as the full scan of UpdateLastPaid visits
+    EraseBelow(mapBlockPayees.rbegin()->first - mnpayments.GetStorageLimit());
+
+    LogPrint("mnpayments", "CLibernodePayeeIndex::CheckAndRemove -- %s\n", ToString());
+}
+
+void CLibernodePayeeIndex::EraseBelow(int nMinHeight) {
+    AssertLockHeld(cs);
+    std::map<int, CBlockCoinbasePayees>::iterator itMin = mapBlockPayees.lower_bound(nMinHeight);
+    mapBlockPayees.erase(mapBlockPayees.begin(), itMin);
+    // No journal records for these: higher heights are on disk by the time the records are taken,
+    // and CheckAndRemove at load drops the old ones again
+    setDirtyHeights.erase(setDirtyHeights.begin(), setDirtyHeights.lower_bound(nMinHeight));
+}
+
+void CLibernodePayeeIndex::Clear() {
+    LOCK(cs);
+    for (std::map<int, CBlockCoinbasePayees>::iterator it = mapBlockPayees.begin(); it != mapBlockPayees.end(); ++it)
+        setDirtyHeights.insert(it->first);
+    mapBlockPayees.clear();
+}
+
+void CLibernodePayeeIndex::TakeJournalRecords(std::vector<CDataStream>& vRecordsRet) {
+    LOCK(cs);
+    BOOST_FOREACH(int nHeight, setDirtyHeights) {
+        CDataStream ssRecord(SER_DISK, CLIENT_VERSION);
+        std::map<int, CBlockCoinbasePayees>::const_iterator it = mapBlockPayees.find(nHeight);
+        bool fErased = it == mapBlockPayees.end();
+        ssRecord << nHeight << fErased;
+        if (!fErased)
+            ssRecord << it->second;
+        vRecordsRet.push_back(ssRecord);
+    }
+    setDirtyHeights.clear();
+}
+
+void CLibernodePayeeIndex::ApplyJournalRecord(CDataStream& ssRecord) {
+    int nHeight;
+    bool fErased;
+    ssRecord >> nHeight >> fErased;
+
+    LOCK(cs);
+    if (fErased) {
+        mapBlockPayees.erase(nHeight);
+    } else {
+        CBlockCoinbasePayees payees;
+        ssRecord >> payees;
+        mapBlockPayees[nHeight] = payees;
+    }
+}
+
+std::string CLibernodePayeeIndex::ToString() const {
+    LOCK(cs);
+    std::ostringstream info;
+
+    info << "Blocks: " << (int) mapBlockPayees.size();
+
+    return info.str();
+}
@@ -15,6 +15,7 @@
 class CLibernodePayments;
 class CLibernodePaymentVote;
 class CLibernodeBlockPayees;
+class CLibernodePayeeIndex;
 
 static const int MNPAYMENTS_SIGNATURES_REQUIRED         = 6;
 static const int MNPAYMENTS_SIGNATURES_TOTAL            = 10;
@@ -31,6 +32,7 @@ extern CCriticalSection cs_mapLibernodeBlocks;
 extern CCriticalSection cs_mapLibernodePayeeVotes;
 
 extern CLibernodePayments mnpayments;
+extern CLibernodePayeeIndex mnpayeeindex;
 
 /// TODO: all 4 functions do not belong here really, they should be refactored/moved somewhere (main.cpp ?)
 bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockReward, std::string &strErrorRet);
@@ -222,4 +224,70 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
 };
 
+//
+// Libernode Payee Index
+// Coinbase outputs of recent blocks that can be libernode payments, so the last paid block of every
+// libernode is found without reading blocks from disk
+//
+
+class CBlockCoinbasePayees
+{
+public:
+    uint256 blockHash;
+    // coinbase outputs paying exactly the libernode payment of the block
+    std::vector<CTxOut> vecPayees;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(blockHash);
+        READWRITE(vecPayees);
+    }
+};
+
+class CLibernodePayeeIndex
+{
+private:
+    mutable CCriticalSection cs;
+
+    // payees by block height. Entries carry the block hash, so leftovers of a reorg are never matched
+    std::map<int, CBlockCoinbasePayees> mapBlockPayees;
+    // heights changed since the last journal records were taken
+    std::set<int> setDirtyHeights;
+
+    static void GetCoinbasePayees(const CBlock& block, int nHeight, CBlockCoinbasePayees& payeesRet);
+    /// Drop blocks below nMinHeight, requires cs
+    void EraseBelow(int nMinHeight);
+
+public:
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        LOCK(cs);
+        READWRITE(mapBlockPayees);
+        if (ser_action.ForRead())
+            setDirtyHeights.clear();
+    }
+
+    /// Current entries (or their removal) of the heights changed since the last call, see CJournaledFlatDB
+    void TakeJournalRecords(std::vector<CDataStream>& vRecordsRet);
+    void ApplyJournalRecord(CDataStream& ssRecord);
+
+    /// Record the payees of a block connected to the active chain
+    void AddBlock(const CBlock& block, const CBlockIndex* pindex);
+    /// Forget the payees of a block disconnected from the active chain
+    void RemoveBlock(const CBlockIndex* pindex);
+    /// Payees of an active chain block, read from disk (and remembered) if the block isn't indexed yet
+    bool GetPayees(const CBlockIndex* pindex, std::vector<CTxOut>& vecPayeesRet);
+
+    /// Drop blocks that are too old to be scanned by UpdateLastPaid
+    void CheckAndRemove();
+    void Clear();
+
+    int size() const { LOCK(cs); return mapBlockPayees.size(); }
+    std::string ToString() const;
+};
+
 #endif
@@ -235,8 +235,9 @@ void CLibernodeSync::ClearFulfilledRequests() {
 }
 
 void CLibernodeSync::ProcessTick() {
+    // scheduled every LIBERNODE_SYNC_TICK_SECONDS
     static int nTick = 0;
-    if (nTick++ % LIBERNODE_SYNC_TICK_SECONDS != 0) return;
+    nTick++;
     if (!pCurrentBlockIndex) return;
 
     //the actual count of libernodes we have currently
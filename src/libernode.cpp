@@ -11,9 +11,84 @@
 #include "libernode-payments.h"
 #include "libernode-sync.h"
 #include "libernodeman.h"
+#include "random.h"
 #include "util.h"
 
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_set.hpp>
+
+namespace {
+
+class CLibernodeSigCacheHasher
+{
+public:
+    size_t operator()(const uint256& key) const {
+        return key.GetCheapHash();
+    }
+};
+
+/**
+ * Recently verified libernode signatures. Pings and broadcasts waiting to be processed are verified in batches,
+ * processing then finds their signatures here
+ */
+class CLibernodeSigCache
+{
+private:
+    //! Entries are SHA256(nonce || message || public key || signature)
+    uint256 nonce;
+    typedef boost::unordered_set<uint256, CLibernodeSigCacheHasher> set_type;
+    set_type setValid;
+    boost::shared_mutex cs_sigcache;
+
+public:
+    CLibernodeSigCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void ComputeEntry(uint256& entry, const std::string& strMessage, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write((const unsigned char*)strMessage.data(), strMessage.size()).Write(pubKey.begin(), pubKey.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.count(entry);
+    }
+
+    void Set(const uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        while (setValid.size() >= LIBERNODE_SIG_CACHE_SIZE) {
+            set_type::size_type s = GetRand(setValid.bucket_count());
+            set_type::local_iterator it = setValid.begin(s);
+            if (it != setValid.end(s)) {
+                setValid.erase(*it);
+            }
+        }
+        setValid.insert(entry);
+    }
+};
+
+CLibernodeSigCache libernodeSigCache;
+
+}
+
+bool VerifyLibernodeSignature(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet)
+{
+    uint256 entry;
+    libernodeSigCache.ComputeEntry(entry, strMessage, vchSig, pubKey);
+    if (libernodeSigCache.Get(entry))
+        return true;
+
+    if (!darkSendSigner.VerifyMessage(pubKey, vchSig, strMessage, strErrorRet))
+        return false;
+
+    libernodeSigCache.Set(entry);
+    return true;
+}
 
 
 CLibernode::CLibernode() :
@@ -107,11 +182,19 @@ CLibernode::CLibernode(const CLibernodeBroadcast &mnb) :
 bool CLibernode::UpdateFromNewBroadcast(CLibernodeBroadcast &mnb) {
     if (mnb.sigTime <= sigTime && !mnb.fRecovery) return false;
 
+    CService addrOld = addr;
+    CPubKey pubKeyLibernodeOld = pubKeyLibernode;
     pubKeyLibernode = mnb.pubKeyLibernode;
     sigTime = mnb.sigTime;
     vchSig = mnb.vchSig;
-    nProtocolVersion = mnb.nProtocolVersion;
+    if (nProtocolVersion != mnb.nProtocolVersion) {
+        nProtocolVersion = mnb.nProtocolVersion;
+        mnodeman.NotifyLibernodeStateChanged();
+    }
     addr = mnb.addr;
+    if (addr != addrOld || pubKeyLibernode != pubKeyLibernodeOld) {
+        mnodeman.UpdateLibernodeKeys(this, addrOld, pubKeyLibernodeOld);
+    }
     nPoSeBanScore = 0;
     nPoSeBanHeight = 0;
     nTimeLastChecked = 0;
@@ -159,6 +242,14 @@ arith_uint256 CLibernode::CalculateScore(const uint256 &blockHash) {
 void CLibernode::Check(bool fForce) {
     LOCK(cs);
 
+    // Libernode ranks are cached by the manager, let it know if any of the paths below changes the state
+    struct CStateWatch {
+        const int &nState;
+        const int nStateOrig;
+        CStateWatch(const int &nStateIn) : nState(nStateIn), nStateOrig(nStateIn) {}
+        ~CStateWatch() { if (nState != nStateOrig) mnodeman.NotifyLibernodeStateChanged(); }
+    } stateWatch(nActiveState);
+
     if (ShutdownRequested()) return;
 
     if (!fForce && (GetTime() - nTimeLastChecked < LIBERNODE_CHECK_SECONDS)) return;
@@ -389,55 +480,6 @@ int CLibernode::GetCollateralAge() {
     return nHeight - nCacheCollateralBlock;
 }
 
-void CLibernode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanBack) {
-    if (!pindex) {
-        LogPrintf("CLibernode::UpdateLastPaid pindex is NULL\n");
-        return;
-    }
-
-    const CBlockIndex *BlockReading = pindex;
-
-    CScript mnpayee = GetScriptForDestination(pubKeyCollateralAddress.GetID());
-    LogPrint("libernode", "CLibernode::UpdateLastPaidBlock -- searching for block with payment to %s\n", vin.prevout.ToStringShort());
-
-    LOCK(cs_mapLibernodeBlocks);
-
-    for (int i = 0; BlockReading && BlockReading->nHeight > nBlockLastPaid && i < nMaxBlocksToScanBack; i++) {
-//        LogPrintf("mnpayments.mapLibernodeBlocks.count(BlockReading->nHeight)=%s\n", mnpayments.mapLibernodeBlocks.count(BlockReading->nHeight));
-//        LogPrintf("mnpayments.mapLibernodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2)=%s\n", mnpayments.mapLibernodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2));
-        if (mnpayments.mapLibernodeBlocks.count(BlockReading->nHeight) &&
-            mnpayments.mapLibernodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2)) {
-            // LogPrintf("i=%s, BlockReading->nHeight=%s\n", i, BlockReading->nHeight);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, BlockReading, Params().GetConsensus())) // shouldn't really happen
-            {
-                LogPrintf("ReadBlockFromDisk failed\n");
-                continue;
-            }
-
-            CAmount nLibernodePayment = GetLibernodePayment(BlockReading->nHeight, block.vtx[0].GetValueOut());
-
-            BOOST_FOREACH(CTxOut txout, block.vtx[0].vout)
-            if (mnpayee == txout.scriptPubKey && nLibernodePayment == txout.nValue) {
-                nBlockLastPaid = BlockReading->nHeight;
-                nTimeLastPaid = BlockReading->nTime;
-                LogPrint("libernode", "CLibernode::UpdateLastPaidBlock -- searching for block with payment to %s -- found new %d\n", vin.prevout.ToStringShort(), nBlockLastPaid);
-                return;
-            }
-        }
-
-        if (BlockReading->pprev == NULL) {
-            assert(BlockReading);
-            break;
-        }
-        BlockReading = BlockReading->pprev;
-    }
-
-    // Last payment for this libernode wasn't found in latest mnpayments blocks
-    // or it was found in mnpayments blocks but wasn't found in the blockchain.
-    // LogPrint("libernode", "CLibernode::UpdateLastPaidBlock -- searching for block with payment to %s -- keeping old %d\n", vin.prevout.ToStringShort(), nBlockLastPaid);
-}
-
 bool CLibernodeBroadcast::Create(std::string strService, std::string strKeyLibernode, std::string strTxHash, std::string strOutputIndex, std::string &strErrorRet, CLibernodeBroadcast &mnbRet, bool fOffline) {
     LogPrintf("CLibernodeBroadcast::Create\n");
     CTxIn txin;
@@ -703,15 +745,19 @@ bool CLibernodeBroadcast::CheckOutpoint(int &nDos) {
     return true;
 }
 
+std::string CLibernodeBroadcast::GetStrMessage() const {
+    return addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
+           pubKeyCollateralAddress.GetID().ToString() + pubKeyLibernode.GetID().ToString() +
+           boost::lexical_cast<std::string>(nProtocolVersion);
+}
+
 bool CLibernodeBroadcast::Sign(CKey &keyCollateralAddress) {
     std::string strError;
     std::string strMessage;
 
     sigTime = GetAdjustedTime();
 
-    strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
-                 pubKeyCollateralAddress.GetID().ToString() + pubKeyLibernode.GetID().ToString() +
-                 boost::lexical_cast<std::string>(nProtocolVersion);
+    strMessage = GetStrMessage();
 
     if (!darkSendSigner.SignMessage(strMessage, vchSig, keyCollateralAddress)) {
         LogPrintf("CLibernodeBroadcast::Sign -- SignMessage() failed\n");
@@ -731,13 +777,11 @@ bool CLibernodeBroadcast::CheckSignature(int &nDos) {
     std::string strError = "";
     nDos = 0;
 
-    strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
-                 pubKeyCollateralAddress.GetID().ToString() + pubKeyLibernode.GetID().ToString() +
-                 boost::lexical_cast<std::string>(nProtocolVersion);
+    strMessage = GetStrMessage();
 
     LogPrint("libernode", "CLibernodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", strMessage, CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
 
-    if (!darkSendSigner.VerifyMessage(pubKeyCollateralAddress, vchSig, strMessage, strError)) {
+    if (!VerifyLibernodeSignature(pubKeyCollateralAddress, vchSig, strMessage, strError)) {
         LogPrintf("CLibernodeBroadcast::CheckSignature -- Got bad Libernode announce signature, error: %s\n", strError);
         nDos = 100;
         return false;
@@ -762,12 +806,16 @@ CLibernodePing::CLibernodePing(CTxIn &vinNew) {
     vchSig = std::vector < unsigned char > ();
 }
 
+std::string CLibernodePing::GetStrMessage() const {
+    return vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+}
+
 bool CLibernodePing::Sign(CKey &keyLibernode, CPubKey &pubKeyLibernode) {
     std::string strError;
     std::string strLiberNodeSignMessage;
 
     sigTime = GetAdjustedTime();
-    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    std::string strMessage = GetStrMessage();
 
     if (!darkSendSigner.SignMessage(strMessage, vchSig, keyLibernode)) {
         LogPrintf("CLibernodePing::Sign -- SignMessage() failed\n");
@@ -783,11 +831,11 @@ bool CLibernodePing::Sign(CKey &keyLibernode, CPubKey &pubKeyLibernode) {
 }
 
 bool CLibernodePing::CheckSignature(CPubKey &pubKeyLibernode, int &nDos) {
-    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    std::string strMessage = GetStrMessage();
     std::string strError = "";
     nDos = 0;
 
-    if (!darkSendSigner.VerifyMessage(pubKeyLibernode, vchSig, strMessage, strError)) {
+    if (!VerifyLibernodeSignature(pubKeyLibernode, vchSig, strMessage, strError)) {
         LogPrintf("CLibernodePing::CheckSignature -- Got bad Libernode ping signature, libernode=%s, error: %s\n", vin.prevout.ToStringShort(), strError);
         nDos = 33;
         return false;
@@ -25,6 +25,15 @@ static const int LIBERNODE_NEW_START_REQUIRED_SECONDS  = 180 * 60;
 static const int LIBERNODE_COIN_REQUIRED  = 512;
 
 static const int LIBERNODE_POSE_BAN_MAX_SCORE          = 5;
+
+// Number of recently verified ping and broadcast signatures kept
+static const size_t LIBERNODE_SIG_CACHE_SIZE           = 20000;
+
+/**
+ * Verify a libernode ping or broadcast signature, the pubkey recovery is skipped if the same signature was
+ * verified recently (e.g. by CLibernodeMan::PrecheckSignatures)
+ */
+bool VerifyLibernodeSignature(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet);
 //
 // The Libernode Ping Class : Contains a different serialize method for sending pings from libernodes throughout the network
 //
@@ -80,6 +89,9 @@ public:
 
     bool IsExpired() { return GetTime() - sigTime > LIBERNODE_NEW_START_REQUIRED_SECONDS; }
 
+    /// Message covered by the signature
+    std::string GetStrMessage() const;
+
     bool Sign(CKey& keyLibernode, CPubKey& pubKeyLibernode);
     bool CheckSignature(CPubKey& pubKeyLibernode, int &nDos);
     bool SimpleCheck(int& nDos);
@@ -298,7 +310,6 @@ public:
 
     int GetLastPaidTime() { return nTimeLastPaid; }
     int GetLastPaidBlock() { return nBlockLastPaid; }
-    void UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanBack);
 
     // KEEP TRACK OF EACH GOVERNANCE ITEM INCASE THIS NODE GOES OFFLINE, SO WE CAN RECALC THEIR STATUS
     void AddGovernanceVote(uint256 nGovernanceObjectHash);
@@ -372,6 +383,9 @@ public:
     bool Update(CLibernode* pmn, int& nDos);
     bool CheckOutpoint(int& nDos);
 
+    /// Message covered by the signature
+    std::string GetStrMessage() const;
+
     bool Sign(CKey& keyCollateralAddress);
     bool CheckSignature(int& nDos);
     void RelayLiberNode();
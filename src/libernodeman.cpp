@@ -9,7 +9,9 @@
 #include "libernode-payments.h"
 #include "libernode-sync.h"
 #include "libernodeman.h"
+#include "libzerocoin/ParallelTasks.h"
 #include "netfulfilledman.h"
+#include "random.h"
 #include "util.h"
 //#include "random.h"
 
@@ -79,15 +81,6 @@ void CLibernodeIndex::Clear()
     mapReverseIndex.clear();
     nSize = 0;
 }
-struct CompareByAddr
-
-{
-    bool operator()(const CLibernode* t1,
-                    const CLibernode* t2) const
-    {
-        return t1->addr < t2->addr;
-    }
-};
 
 void CLibernodeIndex::RebuildIndex()
 {
@@ -97,8 +90,136 @@ void CLibernodeIndex::RebuildIndex()
     }
 }
 
+CLibernodeRegistry::SaltedKeyHasher::SaltedKeyHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t CLibernodeRegistry::SaltedKeyHasher::operator()(const COutPoint& outpoint) const
+{
+    return CSipHasher(k0, k1).Write(outpoint.hash.begin(), 32).Write(outpoint.n).Finalize();
+}
+
+size_t CLibernodeRegistry::SaltedKeyHasher::operator()(const CKeyID& keyID) const
+{
+    return CSipHasher(k0, k1).Write(keyID.begin(), keyID.size()).Finalize();
+}
+
+size_t CLibernodeRegistry::SaltedKeyHasher::operator()(const CPubKey& pubKey) const
+{
+    return CSipHasher(k0, k1).Write(pubKey.begin(), pubKey.size()).Finalize();
+}
+
+size_t CLibernodeRegistry::SaltedKeyHasher::operator()(const CService& addr) const
+{
+    return CSipHasher(k0, k1).Write(addr.GetHash()).Write(addr.GetPort()).Finalize();
+}
+
+template<typename Map>
+static void EraseIndexEntry(Map& map, const typename Map::key_type& key, CLibernode* pmn)
+{
+    std::pair<typename Map::iterator, typename Map::iterator> range = map.equal_range(key);
+    for(typename Map::iterator it = range.first; it != range.second; ++it) {
+        if(it->second == pmn) {
+            map.erase(it);
+            return;
+        }
+    }
+}
+
+CLibernodeRegistry::CLibernodeRegistry(const CLibernodeRegistry& other)
+{
+    *this = other;
+}
+
+CLibernodeRegistry& CLibernodeRegistry::operator=(const CLibernodeRegistry& other)
+{
+    // the indexes point into the list, rebuild them instead of copying
+    if(this != &other) {
+        Clear();
+        BOOST_FOREACH(const CLibernode& mn, other.listLibernodes) {
+            Add(mn);
+        }
+    }
+    return *this;
+}
+
+void CLibernodeRegistry::IndexKeys(CLibernode* pmn)
+{
+    mapByCollateral.insert(std::make_pair(pmn->pubKeyCollateralAddress.GetID(), pmn));
+    mapByPubKey.insert(std::make_pair(pmn->pubKeyLibernode, pmn));
+    mapByAddr.insert(std::make_pair(pmn->addr, pmn));
+}
+
+CLibernode* CLibernodeRegistry::Add(const CLibernode& mn)
+{
+    if(mapByOutpoint.count(mn.vin.prevout)) {
+        return NULL;
+    }
+    iterator it = listLibernodes.insert(listLibernodes.end(), mn);
+    mapByOutpoint.insert(std::make_pair(mn.vin.prevout, it));
+    IndexKeys(&(*it));
+    return &(*it);
+}
+
+CLibernodeRegistry::iterator CLibernodeRegistry::Erase(iterator it)
+{
+    CLibernode* pmn = &(*it);
+    mapByOutpoint.erase(pmn->vin.prevout);
+    EraseIndexEntry(mapByCollateral, pmn->pubKeyCollateralAddress.GetID(), pmn);
+    EraseIndexEntry(mapByPubKey, pmn->pubKeyLibernode, pmn);
+    EraseIndexEntry(mapByAddr, pmn->addr, pmn);
+    return listLibernodes.erase(it);
+}
+
+void CLibernodeRegistry::Clear()
+{
+    mapByOutpoint.clear();
+    mapByCollateral.clear();
+    mapByPubKey.clear();
+    mapByAddr.clear();
+    listLibernodes.clear();
+}
+
+CLibernode* CLibernodeRegistry::Find(const COutPoint& outpoint)
+{
+    outpoint_m_t::iterator it = mapByOutpoint.find(outpoint);
+    return it != mapByOutpoint.end() ? &(*it->second) : NULL;
+}
+
+CLibernode* CLibernodeRegistry::FindByCollateral(const CKeyID& keyID)
+{
+    collateral_mm_t::iterator it = mapByCollateral.find(keyID);
+    return it != mapByCollateral.end() ? it->second : NULL;
+}
+
+CLibernode* CLibernodeRegistry::FindByPubKey(const CPubKey& pubKeyLibernode)
+{
+    pubkey_mm_t::iterator it = mapByPubKey.find(pubKeyLibernode);
+    return it != mapByPubKey.end() ? it->second : NULL;
+}
+
+std::vector<CLibernode*> CLibernodeRegistry::FindByAddr(const CService& addr)
+{
+    std::vector<CLibernode*> vecRet;
+    std::pair<addr_mm_t::iterator, addr_mm_t::iterator> range = mapByAddr.equal_range(addr);
+    for(addr_mm_t::iterator it = range.first; it != range.second; ++it) {
+        vecRet.push_back(it->second);
+    }
+    return vecRet;
+}
+
+void CLibernodeRegistry::UpdateKeys(CLibernode* pmn, const CService& addrOld, const CPubKey& pubKeyLibernodeOld)
+{
+    if(pmn->addr != addrOld) {
+        EraseIndexEntry(mapByAddr, addrOld, pmn);
+        mapByAddr.insert(std::make_pair(pmn->addr, pmn));
+    }
+    if(pmn->pubKeyLibernode != pubKeyLibernodeOld) {
+        EraseIndexEntry(mapByPubKey, pubKeyLibernodeOld, pmn);
+        mapByPubKey.insert(std::make_pair(pmn->pubKeyLibernode, pmn));
+    }
+}
+
 CLibernodeMan::CLibernodeMan() : cs(),
-  vLibernodes(),
+  registryLibernodes(),
   mAskedUsForLibernodeList(),
   mWeAskedForLibernodeList(),
   mWeAskedForLibernodeListEntry(),
@@ -114,6 +235,8 @@ CLibernodeMan::CLibernodeMan() : cs(),
   fLibernodesRemoved(false),
 //  vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  mapRankTables(),
+  nRankStateVersion(0),
   mapSeenLibernodeBroadcast(),
   mapSeenLibernodePing(),
   nDsqCount(0)
@@ -123,10 +246,9 @@ bool CLibernodeMan::Add(CLibernode &mn)
 {
     LOCK(cs);
 
-    CLibernode *pmn = Find(mn.vin);
-    if (pmn == NULL) {
-        LogPrint("libernode", "CLibernodeMan::Add -- Adding new Libernode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
-        vLibernodes.push_back(mn);
+    if (registryLibernodes.Add(mn) != NULL) {
+        LogPrint("libernode", "CLibernodeMan::Add -- Adding new Libernode: addr=%s, %i now\n", mn.addr.ToString(), size());
+        mapRankTables.clear();
         indexLibernodes.AddLibernodeVIN(mn.vin);
         fLibernodesAdded = true;
         return true;
@@ -170,7 +292,7 @@ void CLibernodeMan::Check()
 
 //    LogPrint("libernode", "CLibernodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
-    BOOST_FOREACH(CLibernode& mn, vLibernodes) {
+    BOOST_FOREACH(CLibernode& mn, registryLibernodes) {
         mn.Check();
     }
 }
@@ -189,11 +311,11 @@ void CLibernodeMan::CheckAndRemove()
         Check();
 
         // Remove spent libernodes, prepare structures and make requests to reasure the state of inactive ones
-        std::vector<CLibernode>::iterator it = vLibernodes.begin();
+        CLibernodeRegistry::iterator it = registryLibernodes.begin();
         std::vector<std::pair<int, CLibernode> > vecLibernodeRanks;
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES libernode entries at a time
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
-        while(it != vLibernodes.end()) {
+        while(it != registryLibernodes.end()) {
             CLibernodeBroadcast mnb = CLibernodeBroadcast(*it);
             uint256 hash = mnb.GetHash();
             // If collateral was spent ...
@@ -206,7 +328,8 @@ void CLibernodeMan::CheckAndRemove()
 
                 // and finally remove it from the list
 //                it->FlagGovernanceItemsAsDirty();
-                it = vLibernodes.erase(it);
+                it = registryLibernodes.Erase(it);
+                mapRankTables.clear();
                 fLibernodesRemoved = true;
             } else {
                 bool fAsk = pCurrentBlockIndex &&
@@ -366,7 +489,8 @@ void CLibernodeMan::CheckAndRemove()
 void CLibernodeMan::Clear()
 {
     LOCK(cs);
-    vLibernodes.clear();
+    registryLibernodes.Clear();
+    mapRankTables.clear();
     mAskedUsForLibernodeList.clear();
     mWeAskedForLibernodeList.clear();
     mWeAskedForLibernodeListEntry.clear();
@@ -384,7 +508,7 @@ int CLibernodeMan::CountLibernodes(int nProtocolVersion)
     int nCount = 0;
     nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinLibernodePaymentsProto() : nProtocolVersion;
 
-    BOOST_FOREACH(CLibernode& mn, vLibernodes) {
+    BOOST_FOREACH(CLibernode& mn, registryLibernodes) {
         if(mn.nProtocolVersion < nProtocolVersion) continue;
         nCount++;
     }
@@ -398,7 +522,7 @@ int CLibernodeMan::CountEnabled(int nProtocolVersion)
     int nCount = 0;
     nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinLibernodePaymentsProto() : nProtocolVersion;
 
-    BOOST_FOREACH(CLibernode& mn, vLibernodes) {
+    BOOST_FOREACH(CLibernode& mn, registryLibernodes) {
         if(mn.nProtocolVersion < nProtocolVersion || !mn.IsEnabled()) continue;
         nCount++;
     }
@@ -412,7 +536,7 @@ int CLibernodeMan::CountByIP(int nNetworkType)
     LOCK(cs);
     int nNodeCount = 0;
 
-    BOOST_FOREACH(CLibernode& mn, vLibernodes)
+    BOOST_FOREACH(CLibernode& mn, registryLibernodes)
         if ((nNetworkType == NET_IPV4 && mn.addr.IsIPv4()) ||
             (nNetworkType == NET_TOR  && mn.addr.IsTor())  ||
             (nNetworkType == NET_IPV6 && mn.addr.IsIPv6())) {
@@ -448,36 +572,25 @@ CLibernode* CLibernodeMan::Find(const CScript &payee)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CLibernode& mn, vLibernodes)
-    {
-        if(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) == payee)
-            return &mn;
-    }
-    return NULL;
+    CTxDestination dest;
+    if(!ExtractDestination(payee, dest)) return NULL;
+    const CKeyID *keyID = boost::get<CKeyID>(&dest);
+    // libernodes are paid to the P2PKH script of their collateral key only
+    if(!keyID || GetScriptForDestination(*keyID) != payee) return NULL;
+
+    return registryLibernodes.FindByCollateral(*keyID);
 }
 
 CLibernode* CLibernodeMan::Find(const CTxIn &vin)
 {
     LOCK(cs);
-
-    BOOST_FOREACH(CLibernode& mn, vLibernodes)
-    {
-        if(mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    return registryLibernodes.Find(vin.prevout);
 }
 
 CLibernode* CLibernodeMan::Find(const CPubKey &pubKeyLibernode)
 {
     LOCK(cs);
-
-    BOOST_FOREACH(CLibernode& mn, vLibernodes)
-    {
-        if(mn.pubKeyLibernode == pubKeyLibernode)
-            return &mn;
-    }
-    return NULL;
+    return registryLibernodes.FindByPubKey(pubKeyLibernode);
 }
 
 bool CLibernodeMan::Get(const CPubKey& pubKeyLibernode, CLibernode& libernode)
@@ -602,7 +715,7 @@ CLibernode* CLibernodeMan::GetNextLibernodeInQueueForPayment(int nBlockHeight, b
     */
     int nMnCount = CountEnabled();
     int index = 0;
-    BOOST_FOREACH(CLibernode &mn, vLibernodes)
+    BOOST_FOREACH(CLibernode &mn, registryLibernodes)
     {
         index += 1;
         // LogPrintf("index=%s, mn=%s\n", index, mn.ToString());
@@ -700,7 +813,7 @@ CLibernode* CLibernodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToExc
 
     // fill a vector of pointers
     std::vector<CLibernode*> vpLibernodesShuffled;
-    BOOST_FOREACH(CLibernode &mn, vLibernodes) {
+    BOOST_FOREACH(CLibernode &mn, registryLibernodes) {
         vpLibernodesShuffled.push_back(&mn);
     }
 
@@ -729,25 +842,25 @@ CLibernode* CLibernodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToExc
     return NULL;
 }
 
-int CLibernodeMan::GetLibernodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+const CLibernodeMan::CRankTable& CLibernodeMan::GetRankTable(int nBlockHeight, const uint256& blockHash, int nMinProtocol, RankFilter filter)
 {
-    std::vector<std::pair<int64_t, CLibernode*> > vecLibernodeScores;
+    AssertLockHeld(cs);
 
-    //make sure we know about this block
-    uint256 blockHash = uint256();
-    if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
+    // read the version first: a state change while the table is being built makes the next call rebuild it
+    int nStateVersion = nRankStateVersion;
+    std::tuple<int, int, int> key(nBlockHeight, nMinProtocol, filter);
+    std::map<std::tuple<int, int, int>, CRankTable>::iterator it = mapRankTables.find(key);
+    if(it != mapRankTables.end() && it->second.blockHash == blockHash && it->second.nStateVersion == nStateVersion)
+        return it->second;
 
-    LOCK(cs);
+    std::vector<std::pair<int64_t, CLibernode*> > vecLibernodeScores;
 
     // scan for winner
-    BOOST_FOREACH(CLibernode& mn, vLibernodes) {
+    BOOST_FOREACH(CLibernode& mn, registryLibernodes) {
         if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive) {
-            if(!mn.IsEnabled()) continue;
-        }
-        else {
-            if(!mn.IsValidForPayment()) continue;
-        }
+        if(filter == RANK_ENABLED && !mn.IsEnabled()) continue;
+        if(filter == RANK_VALID_FOR_PAYMENT && !mn.IsValidForPayment()) continue;
+
         int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
 
         vecLibernodeScores.push_back(std::make_pair(nScore, &mn));
@@ -755,81 +868,72 @@ int CLibernodeMan::GetLibernodeRank(const CTxIn& vin, int nBlockHeight, int nMin
 
     sort(vecLibernodeScores.rbegin(), vecLibernodeScores.rend(), CompareScoreMN());
 
-    int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CLibernode*)& scorePair, vecLibernodeScores) {
-        nRank++;
-        if(scorePair.second->vin.prevout == vin.prevout) return nRank;
+    if(it == mapRankTables.end()) {
+        // tables are keyed by height first, drop the oldest one
+        if(mapRankTables.size() >= MAX_RANK_TABLES)
+            mapRankTables.erase(mapRankTables.begin());
+        it = mapRankTables.insert(std::make_pair(key, CRankTable())).first;
+    }
+
+    CRankTable& table = it->second;
+    table.blockHash = blockHash;
+    table.nStateVersion = nStateVersion;
+    table.vecRanked.clear();
+    table.mapRanks.clear();
+    BOOST_FOREACH (PAIRTYPE(int64_t, CLibernode*)& s, vecLibernodeScores) {
+        table.vecRanked.push_back(s.second);
+        table.mapRanks[s.second->vin.prevout] = table.vecRanked.size();
     }
 
-    return -1;
+    return table;
 }
 
-std::vector<std::pair<int, CLibernode> > CLibernodeMan::GetLibernodeRanks(int nBlockHeight, int nMinProtocol)
+int CLibernodeMan::GetLibernodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CLibernode*> > vecLibernodeScores;
-    std::vector<std::pair<int, CLibernode> > vecLibernodeRanks;
-
     //make sure we know about this block
     uint256 blockHash = uint256();
-    if(!GetBlockHash(blockHash, nBlockHeight)) return vecLibernodeRanks;
+    if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
 
     LOCK(cs);
 
-    // scan for winner
-    BOOST_FOREACH(CLibernode& mn, vLibernodes) {
-
-        if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
+    const CRankTable& table = GetRankTable(nBlockHeight, blockHash, nMinProtocol, fOnlyActive ? RANK_ENABLED : RANK_VALID_FOR_PAYMENT);
+    std::map<COutPoint, int>::const_iterator it = table.mapRanks.find(vin.prevout);
+    return it != table.mapRanks.end() ? it->second : -1;
+}
 
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+std::vector<std::pair<int, CLibernode> > CLibernodeMan::GetLibernodeRanks(int nBlockHeight, int nMinProtocol)
+{
+    std::vector<std::pair<int, CLibernode> > vecLibernodeRanks;
 
-        vecLibernodeScores.push_back(std::make_pair(nScore, &mn));
-    }
+    //make sure we know about this block
+    uint256 blockHash = uint256();
+    if(!GetBlockHash(blockHash, nBlockHeight)) return vecLibernodeRanks;
 
-    sort(vecLibernodeScores.rbegin(), vecLibernodeScores.rend(), CompareScoreMN());
+    LOCK(cs);
 
-    int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CLibernode*)& s, vecLibernodeScores) {
-        nRank++;
-        vecLibernodeRanks.push_back(std::make_pair(nRank, *s.second));
-    }
+    const CRankTable& table = GetRankTable(nBlockHeight, blockHash, nMinProtocol, RANK_ENABLED);
+    vecLibernodeRanks.reserve(table.vecRanked.size());
+    for (size_t i = 0; i < table.vecRanked.size(); i++)
+        vecLibernodeRanks.push_back(std::make_pair((int)i + 1, *table.vecRanked[i]));
 
     return vecLibernodeRanks;
 }
 
 CLibernode* CLibernodeMan::GetLibernodeByRank(int nRank, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CLibernode*> > vecLibernodeScores;
-
-    LOCK(cs);
-
     uint256 blockHash;
     if(!GetBlockHash(blockHash, nBlockHeight)) {
         LogPrintf("CLibernode::GetLibernodeByRank -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", nBlockHeight);
         return NULL;
     }
 
-    // Fill scores
-    BOOST_FOREACH(CLibernode& mn, vLibernodes) {
-
-        if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive && !mn.IsEnabled()) continue;
-
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecLibernodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecLibernodeScores.rbegin(), vecLibernodeScores.rend(), CompareScoreMN());
+    LOCK(cs);
 
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CLibernode*)& s, vecLibernodeScores){
-        rank++;
-        if(rank == nRank) {
-            return s.second;
-        }
-    }
+    const CRankTable& table = GetRankTable(nBlockHeight, blockHash, nMinProtocol, fOnlyActive ? RANK_ENABLED : RANK_ALL);
+    if(nRank < 1 || nRank > (int)table.vecRanked.size())
+        return NULL;
 
-    return NULL;
+    return table.vecRanked[nRank - 1];
 }
 
 void CLibernodeMan::ProcessLibernodeConnections()
@@ -976,8 +1080,20 @@ void CLibernodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
         int nInvCount = 0;
 
-        BOOST_FOREACH(CLibernode& mn, vLibernodes) {
-            if (vin != CTxIn() && vin != mn.vin) continue; // asked for specific vin but we are not there yet
+        // asked for specific vin, look it up instead of walking the list
+        std::vector<CLibernode*> vpLibernodesToSend;
+        if (vin != CTxIn()) {
+            CLibernode* pmn = Find(vin);
+            if (pmn && pmn->vin == vin) vpLibernodesToSend.push_back(pmn);
+        } else {
+            vpLibernodesToSend.reserve(registryLibernodes.size());
+            BOOST_FOREACH(CLibernode& mn, registryLibernodes) {
+                vpLibernodesToSend.push_back(&mn);
+            }
+        }
+
+        BOOST_FOREACH(CLibernode* pmn, vpLibernodesToSend) {
+            CLibernode& mn = *pmn;
             if (mn.addr.IsRFC1918() || mn.addr.IsLocal()) continue; // do not send local network libernode
             if (mn.IsUpdateRequired()) continue; // do not send outdated libernodes
 
@@ -1027,6 +1143,85 @@ void CLibernodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
     }
 }
 
+void CLibernodeMan::PrecheckSignatures(CNode* pfrom)
+{
+    if(fLiteMode) return;
+    if(!libernodeSync.IsBlockchainSynced()) return;
+
+    // copies of the complete announces and pings not looked at yet
+    std::vector<CLibernodeBroadcast> vecMnb;
+    std::vector<CLibernodePing> vecMnp;
+    BOOST_FOREACH(CNetMessage& msg, pfrom->vRecvMsg) {
+        if(!msg.complete()) break;
+        if(msg.fPrechecked) continue;
+        msg.fPrechecked = true;
+
+        std::string strCommand = msg.hdr.GetCommand();
+        if(strCommand != NetMsgType::MNANNOUNCE && strCommand != NetMsgType::MNPING) continue;
+        try {
+            CDataStream vRecv(msg.vRecv);
+            if(strCommand == NetMsgType::MNANNOUNCE) {
+                CLibernodeBroadcast mnb;
+                vRecv >> mnb;
+                vecMnb.push_back(mnb);
+            } else {
+                CLibernodePing mnp;
+                vRecv >> mnp;
+                vecMnp.push_back(mnp);
+            }
+        } catch (const std::exception&) {
+            // malformed, left to ProcessMessage
+        }
+        if(vecMnb.size() + vecMnp.size() >= PRECHECK_MAX_MESSAGES) break;
+    }
+
+    // a single message is checked just as fast when it's processed
+    if(vecMnb.size() + vecMnp.size() < 2) return;
+
+    // pubkeys to check against, messages already seen are skipped
+    std::vector<std::pair<CPubKey, const CLibernodePing*> > vecPings;
+    std::vector<const CLibernodeBroadcast*> vecBroadcasts;
+    {
+        LOCK(cs);
+
+        std::map<COutPoint, CPubKey> mapBatchKeys;
+        BOOST_FOREACH(const CLibernodeBroadcast& mnb, vecMnb) {
+            if(mapSeenLibernodeBroadcast.count(mnb.GetHash())) continue;
+            vecBroadcasts.push_back(&mnb);
+            if(mnb.lastPing != CLibernodePing()) {
+                vecPings.push_back(std::make_pair(mnb.pubKeyLibernode, &mnb.lastPing));
+            }
+            mapBatchKeys[mnb.vin.prevout] = mnb.pubKeyLibernode;
+        }
+        BOOST_FOREACH(const CLibernodePing& mnp, vecMnp) {
+            if(mapSeenLibernodePing.count(mnp.GetHash())) continue;
+            // the libernode may be announced earlier in the same batch
+            CLibernode* pmn = registryLibernodes.Find(mnp.vin.prevout);
+            std::map<COutPoint, CPubKey>::iterator it = mapBatchKeys.find(mnp.vin.prevout);
+            if(pmn) {
+                vecPings.push_back(std::make_pair(pmn->pubKeyLibernode, &mnp));
+            } else if(it != mapBatchKeys.end()) {
+                vecPings.push_back(std::make_pair(it->second, &mnp));
+            }
+        }
+    }
+
+    size_t nBroadcasts = vecBroadcasts.size();
+    LogPrint("libernode", "CLibernodeMan::PrecheckSignatures -- checking %d announces and %d pings, peer=%d\n", (int)nBroadcasts, (int)vecPings.size(), pfrom->id);
+
+    // valid signatures are cached by VerifyLibernodeSignature, invalid ones are reported when processed
+    libzerocoin::ParallelTasks::ParallelFor(nBroadcasts + vecPings.size(), [&vecBroadcasts, &vecPings, nBroadcasts](size_t i) {
+        std::string strError;
+        if(i < nBroadcasts) {
+            const CLibernodeBroadcast* pmnb = vecBroadcasts[i];
+            VerifyLibernodeSignature(pmnb->pubKeyCollateralAddress, pmnb->vchSig, pmnb->GetStrMessage(), strError);
+        } else {
+            const std::pair<CPubKey, const CLibernodePing*>& ping = vecPings[i - nBroadcasts];
+            VerifyLibernodeSignature(ping.first, ping.second->vchSig, ping.second->GetStrMessage(), strError);
+        }
+    });
+}
+
 // Verification of libernodes via unique direct requests.
 
 void CLibernodeMan::DoFullVerificationStep()
@@ -1070,13 +1265,6 @@ void CLibernodeMan::DoFullVerificationStep()
     int nOffset = MAX_POSE_RANK + nMyRank - 1;
     if(nOffset >= (int)vecLibernodeRanks.size()) return;
 
-    std::vector<CLibernode*> vSortedByAddr;
-    BOOST_FOREACH(CLibernode& mn, vLibernodes) {
-        vSortedByAddr.push_back(&mn);
-    }
-
-    sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
-
     it = vecLibernodeRanks.begin() + nOffset;
     while(it != vecLibernodeRanks.end()) {
         if(it->second.IsPoSeVerified() || it->second.IsPoSeBanned()) {
@@ -1092,7 +1280,7 @@ void CLibernodeMan::DoFullVerificationStep()
         }
         LogPrint("libernode", "CLibernodeMan::DoFullVerificationStep -- Verifying libernode %s rank %d/%d address %s\n",
                     it->second.vin.prevout.ToStringShort(), it->first, nRanksTotal, it->second.addr.ToString());
-        if(SendVerifyRequest(CAddress(it->second.addr, NODE_NETWORK), vSortedByAddr)) {
+        if(SendVerifyRequest(CAddress(it->second.addr, NODE_NETWORK))) {
             nCount++;
             if(nCount >= MAX_POSE_CONNECTIONS) break;
         }
@@ -1111,34 +1299,35 @@ void CLibernodeMan::DoFullVerificationStep()
 
 void CLibernodeMan::CheckSameAddr()
 {
-    if(!libernodeSync.IsSynced() || vLibernodes.empty()) return;
+    if(!libernodeSync.IsSynced()) return;
 
     std::vector<CLibernode*> vBan;
-    std::vector<CLibernode*> vSortedByAddr;
 
     {
         LOCK(cs);
 
-        CLibernode* pprevLibernode = NULL;
-        CLibernode* pverifiedLibernode = NULL;
-
-        BOOST_FOREACH(CLibernode& mn, vLibernodes) {
-            vSortedByAddr.push_back(&mn);
+        // addresses shared by several libernodes, each one is checked once
+        std::set<CService> setSharedAddr;
+        BOOST_FOREACH(CLibernode& mn, registryLibernodes) {
+            if(registryLibernodes.CountByAddr(mn.addr) > 1) {
+                setSharedAddr.insert(mn.addr);
+            }
         }
 
-        sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
-
-        BOOST_FOREACH(CLibernode* pmn, vSortedByAddr) {
-            // check only (pre)enabled libernodes
-            if(!pmn->IsEnabled() && !pmn->IsPreEnabled()) continue;
-            // initial step
-            if(!pprevLibernode) {
-                pprevLibernode = pmn;
-                pverifiedLibernode = pmn->IsPoSeVerified() ? pmn : NULL;
-                continue;
-            }
-            // second+ step
-            if(pmn->addr == pprevLibernode->addr) {
+        BOOST_FOREACH(const CService& addr, setSharedAddr) {
+            CLibernode* pprevLibernode = NULL;
+            CLibernode* pverifiedLibernode = NULL;
+
+            BOOST_FOREACH(CLibernode* pmn, registryLibernodes.FindByAddr(addr)) {
+                // check only (pre)enabled libernodes
+                if(!pmn->IsEnabled() && !pmn->IsPreEnabled()) continue;
+                // initial step
+                if(!pprevLibernode) {
+                    pprevLibernode = pmn;
+                    pverifiedLibernode = pmn->IsPoSeVerified() ? pmn : NULL;
+                    continue;
+                }
+                // second+ step
                 if(pverifiedLibernode) {
                     // another libernode with the same ip is verified, ban this one
                     vBan.push_back(pmn);
@@ -1148,10 +1337,8 @@ void CLibernodeMan::CheckSameAddr()
                     // and keep a reference to be able to ban following libernodes with the same ip
                     pverifiedLibernode = pmn;
                 }
-            } else {
-                pverifiedLibernode = pmn->IsPoSeVerified() ? pmn : NULL;
+                pprevLibernode = pmn;
             }
-            pprevLibernode = pmn;
         }
     }
 
@@ -1162,7 +1349,7 @@ void CLibernodeMan::CheckSameAddr()
     }
 }
 
-bool CLibernodeMan::SendVerifyRequest(const CAddress& addr, const std::vector<CLibernode*>& vSortedByAddr)
+bool CLibernodeMan::SendVerifyRequest(const CAddress& addr)
 {
     if(netfulfilledman.HasFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
         // we already asked for verification, not a good idea to do this too often, skip it
@@ -1272,47 +1459,44 @@ void CLibernodeMan::ProcessVerifyReply(CNode* pnode, CLibernodeVerification& mnv
 
         CLibernode* prealLibernode = NULL;
         std::vector<CLibernode*> vpLibernodesToBan;
-        std::vector<CLibernode>::iterator it = vLibernodes.begin();
         std::string strMessage1 = strprintf("%s%d%s", pnode->addr.ToString(), mnv.nonce, blockHash.ToString());
-        while(it != vLibernodes.end()) {
-            if(CAddress(it->addr, NODE_NETWORK) == pnode->addr) {
-                if(darkSendSigner.VerifyMessage(it->pubKeyLibernode, mnv.vchSig1, strMessage1, strError)) {
-                    // found it!
-                    prealLibernode = &(*it);
-                    if(!it->IsPoSeVerified()) {
-                        it->DecreasePoSeBanScore();
-                    }
-                    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
-
-                    // we can only broadcast it if we are an activated libernode
-                    if(activeLibernode.vin == CTxIn()) continue;
-                    // update ...
-                    mnv.addr = it->addr;
-                    mnv.vin1 = it->vin;
-                    mnv.vin2 = activeLibernode.vin;
-                    std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(), mnv.nonce, blockHash.ToString(),
-                                            mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
-                    // ... and sign it
-                    if(!darkSendSigner.SignMessage(strMessage2, mnv.vchSig2, activeLibernode.keyLibernode)) {
-                        LogPrintf("LibernodeMan::ProcessVerifyReply -- SignMessage() failed\n");
-                        return;
-                    }
+        // pnode->addr is a CAddress, only the CService part has to match
+        BOOST_FOREACH(CLibernode* pmn, registryLibernodes.FindByAddr(pnode->addr)) {
+            if(darkSendSigner.VerifyMessage(pmn->pubKeyLibernode, mnv.vchSig1, strMessage1, strError)) {
+                // found it!
+                prealLibernode = pmn;
+                if(!pmn->IsPoSeVerified()) {
+                    pmn->DecreasePoSeBanScore();
+                }
+                netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
+
+                // we can only broadcast it if we are an activated libernode
+                if(activeLibernode.vin == CTxIn()) continue;
+                // update ...
+                mnv.addr = pmn->addr;
+                mnv.vin1 = pmn->vin;
+                mnv.vin2 = activeLibernode.vin;
+                std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(), mnv.nonce, blockHash.ToString(),
+                                        mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
+                // ... and sign it
+                if(!darkSendSigner.SignMessage(strMessage2, mnv.vchSig2, activeLibernode.keyLibernode)) {
+                    LogPrintf("LibernodeMan::ProcessVerifyReply -- SignMessage() failed\n");
+                    return;
+                }
 
-                    std::string strError;
+                std::string strError;
 
-                    if(!darkSendSigner.VerifyMessage(activeLibernode.pubKeyLibernode, mnv.vchSig2, strMessage2, strError)) {
-                        LogPrintf("LibernodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
-                        return;
-                    }
+                if(!darkSendSigner.VerifyMessage(activeLibernode.pubKeyLibernode, mnv.vchSig2, strMessage2, strError)) {
+                    LogPrintf("LibernodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
+                    return;
+                }
 
-                    mWeAskedForVerification[pnode->addr] = mnv;
-                    mnv.Relay();
+                mWeAskedForVerification[pnode->addr] = mnv;
+                mnv.Relay();
 
-                } else {
-                    vpLibernodesToBan.push_back(&(*it));
-                }
+            } else {
+                vpLibernodesToBan.push_back(pmn);
             }
-            ++it;
         }
         // no real libernode found?...
         if(!prealLibernode) {
@@ -1426,12 +1610,12 @@ void CLibernodeMan::ProcessVerifyBroadcast(CNode* pnode, const CLibernodeVerific
 
         // increase ban score for everyone else with the same addr
         int nCount = 0;
-        BOOST_FOREACH(CLibernode& mn, vLibernodes) {
-            if(mn.addr != mnv.addr || mn.vin.prevout == mnv.vin1.prevout) continue;
-            mn.IncreasePoSeBanScore();
+        BOOST_FOREACH(CLibernode* pmn, registryLibernodes.FindByAddr(mnv.addr)) {
+            if(pmn->vin.prevout == mnv.vin1.prevout) continue;
+            pmn->IncreasePoSeBanScore();
             nCount++;
             LogPrint("libernode", "CLibernodeMan::ProcessVerifyBroadcast -- increased PoSe ban score for %s addr %s, new score %d\n",
-                        mn.vin.prevout.ToStringShort(), mn.addr.ToString(), mn.nPoSeBanScore);
+                        pmn->vin.prevout.ToStringShort(), pmn->addr.ToString(), pmn->nPoSeBanScore);
         }
         LogPrintf("CLibernodeMan::ProcessVerifyBroadcast -- PoSe score incresed for %d fake libernodes, addr %s\n",
                     nCount, pnode->addr.ToString());
@@ -1442,7 +1626,7 @@ std::string CLibernodeMan::ToString() const
 {
     std::ostringstream info;
 
-    info << "Libernodes: " << (int)vLibernodes.size() <<
+    info << "Libernodes: " << (int)registryLibernodes.size() <<
             ", peers who asked us for Libernode list: " << (int)mAskedUsForLibernodeList.size() <<
             ", peers we asked for Libernode list: " << (int)mWeAskedForLibernodeList.size() <<
             ", entries in Libernode list we asked for: " << (int)mWeAskedForLibernodeListEntry.size() <<
@@ -1589,8 +1773,38 @@ void CLibernodeMan::UpdateLastPaid()
     LogPrint("mnpayments", "CLibernodeMan::UpdateLastPaid -- nHeight=%d, nMaxBlocksToScanBack=%d, IsFirstRun=%s\n",
                              pCurrentBlockIndex->nHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
 
-    BOOST_FOREACH(CLibernode& mn, vLibernodes) {
-        mn.UpdateLastPaid(pCurrentBlockIndex, nMaxBlocksToScanBack);
+    // Libernodes by payee script. Blocks are visited newest first, so the first block paying a script is the
+    // last payment of every libernode using it
+    std::map<CScript, std::vector<CLibernode*> > mapPayees;
+    BOOST_FOREACH(CLibernode& mn, registryLibernodes) {
+        mapPayees[GetScriptForDestination(mn.pubKeyCollateralAddress.GetID())].push_back(&mn);
+    }
+
+    {
+        LOCK(cs_mapLibernodeBlocks);
+
+        const CBlockIndex *pindex = pCurrentBlockIndex;
+        for (int i = 0; pindex && i < nMaxBlocksToScanBack && !mapPayees.empty(); i++, pindex = pindex->pprev) {
+            // only payees elected by the network count
+            std::map<int, CLibernodeBlockPayees>::iterator itVotes = mnpayments.mapLibernodeBlocks.find(pindex->nHeight);
+            if (itVotes == mnpayments.mapLibernodeBlocks.end()) continue;
+
+            std::vector<CTxOut> vecPayees;
+            if (!mnpayeeindex.GetPayees(pindex, vecPayees)) continue;
+
+            BOOST_FOREACH(const CTxOut& txout, vecPayees) {
+                std::map<CScript, std::vector<CLibernode*> >::iterator it = mapPayees.find(txout.scriptPubKey);
+                if (it == mapPayees.end() || !itVotes->second.HasPayeeWithVotes(txout.scriptPubKey, 2)) continue;
+
+                BOOST_FOREACH(CLibernode* pmn, it->second) {
+                    if (pindex->nHeight <= pmn->nBlockLastPaid) continue;
+                    pmn->nBlockLastPaid = pindex->nHeight;
+                    pmn->nTimeLastPaid = pindex->nTime;
+                    LogPrint("libernode", "CLibernodeMan::UpdateLastPaid -- libernode %s was paid at %d\n", pmn->vin.prevout.ToStringShort(), pmn->nBlockLastPaid);
+                }
+                mapPayees.erase(it);
+            }
+        }
     }
 
     // every time is like the first time if winners list is not synced
@@ -1609,20 +1823,28 @@ void CLibernodeMan::CheckAndRebuildLibernodeIndex()
         return;
     }
 
-    if(indexLibernodes.GetSize() <= int(vLibernodes.size())) {
+    if(indexLibernodes.GetSize() <= int(registryLibernodes.size())) {
         return;
     }
 
     indexLibernodesOld = indexLibernodes;
     indexLibernodes.Clear();
-    for(size_t i = 0; i < vLibernodes.size(); ++i) {
-        indexLibernodes.AddLibernodeVIN(vLibernodes[i].vin);
+    BOOST_FOREACH(CLibernode& mn, registryLibernodes) {
+        indexLibernodes.AddLibernodeVIN(mn.vin);
     }
 
     fIndexRebuilt = true;
     nLastIndexRebuildTime = GetTime();
 }
 
+void CLibernodeMan::UpdateLibernodeKeys(CLibernode* pmn, const CService& addrOld, const CPubKey& pubKeyLibernodeOld)
+{
+    LOCK(cs);
+    // temporary copies are not indexed
+    if(registryLibernodes.Find(pmn->vin.prevout) != pmn) return;
+    registryLibernodes.UpdateKeys(pmn, addrOld, pubKeyLibernodeOld);
+}
+
 void CLibernodeMan::UpdateWatchdogVoteTime(const CTxIn& vin)
 {
     LOCK(cs);
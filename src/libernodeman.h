@@ -8,6 +8,12 @@
 #include "libernode.h"
 #include "sync.h"
 
+#include <atomic>
+#include <list>
+#include <tuple>
+
+#include <boost/unordered_map.hpp>
+
 using namespace std;
 
 class CLibernodeMan;
@@ -78,6 +84,124 @@ private:
 
 };
 
+/**
+ * Storage of the known libernodes. Entries don't move once added, so pointers to them stay valid until
+ * they are erased, and are indexed by collateral outpoint, collateral key, libernode key and address.
+ *
+ * Addresses and libernode keys are changed by new broadcasts, UpdateKeys() must be called after that.
+ * Serialized the same way as the std::vector<CLibernode> it replaced
+ */
+class CLibernodeRegistry
+{
+public: // Types
+    typedef std::list<CLibernode>::iterator iterator;
+
+    typedef std::list<CLibernode>::const_iterator const_iterator;
+
+private:
+    class SaltedKeyHasher
+    {
+    private:
+        /** Salt */
+        uint64_t k0, k1;
+
+    public:
+        SaltedKeyHasher();
+
+        size_t operator()(const COutPoint& outpoint) const;
+        size_t operator()(const CKeyID& keyID) const;
+        size_t operator()(const CPubKey& pubKey) const;
+        size_t operator()(const CService& addr) const;
+    };
+
+    typedef boost::unordered_map<COutPoint, iterator, SaltedKeyHasher> outpoint_m_t;
+
+    typedef boost::unordered_multimap<CKeyID, CLibernode*, SaltedKeyHasher> collateral_mm_t;
+
+    typedef boost::unordered_multimap<CPubKey, CLibernode*, SaltedKeyHasher> pubkey_mm_t;
+
+    typedef boost::unordered_multimap<CService, CLibernode*, SaltedKeyHasher> addr_mm_t;
+
+    std::list<CLibernode> listLibernodes;
+
+    outpoint_m_t          mapByOutpoint;
+
+    collateral_mm_t       mapByCollateral;
+
+    pubkey_mm_t           mapByPubKey;
+
+    addr_mm_t             mapByAddr;
+
+    void IndexKeys(CLibernode* pmn);
+
+public:
+    CLibernodeRegistry() {}
+
+    CLibernodeRegistry(const CLibernodeRegistry& other);
+
+    CLibernodeRegistry& operator=(const CLibernodeRegistry& other);
+
+    iterator begin() { return listLibernodes.begin(); }
+    iterator end() { return listLibernodes.end(); }
+    const_iterator begin() const { return listLibernodes.begin(); }
+    const_iterator end() const { return listLibernodes.end(); }
+
+    size_t size() const { return listLibernodes.size(); }
+    bool empty() const { return listLibernodes.empty(); }
+
+    /// Add a copy of mn, returns NULL if its outpoint is known already
+    CLibernode* Add(const CLibernode& mn);
+
+    /// Erase an entry, returns the iterator following it
+    iterator Erase(iterator it);
+
+    void Clear();
+
+    CLibernode* Find(const COutPoint& outpoint);
+
+    /// First libernode using collateral key keyID
+    CLibernode* FindByCollateral(const CKeyID& keyID);
+
+    /// First libernode using libernode key pubKeyLibernode
+    CLibernode* FindByPubKey(const CPubKey& pubKeyLibernode);
+
+    /// All libernodes announcing address addr
+    std::vector<CLibernode*> FindByAddr(const CService& addr);
+
+    size_t CountByAddr(const CService& addr) const { return mapByAddr.count(addr); }
+
+    /// Move pmn to its new address and libernode key in the indexes
+    void UpdateKeys(CLibernode* pmn, const CService& addrOld, const CPubKey& pubKeyLibernodeOld);
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        WriteCompactSize(s, listLibernodes.size());
+        BOOST_FOREACH(const CLibernode& mn, listLibernodes) {
+            ::Serialize(s, mn, nType, nVersion);
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        Clear();
+        uint64_t nSize = ReadCompactSize(s);
+        for(uint64_t i = 0; i < nSize; i++) {
+            CLibernode mn;
+            ::Unserialize(s, mn, nType, nVersion);
+            Add(mn);
+        }
+    }
+
+    size_t GetSerializeSize(int nType, int nVersion) const
+    {
+        CSizeComputer s(nType, nVersion);
+        Serialize(s, nType, nVersion);
+        return s.size();
+    }
+};
+
 class CLibernodeMan
 {
 public:
@@ -110,6 +234,25 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const size_t MAX_RANK_TABLES             = 64;
+
+    static const size_t PRECHECK_MAX_MESSAGES       = 512;
+
+    // Libernodes taking part in a ranking
+    enum RankFilter {
+        RANK_ENABLED,               // IsEnabled()
+        RANK_VALID_FOR_PAYMENT,     // IsValidForPayment()
+        RANK_ALL
+    };
+
+    // Libernodes ordered by score for one block, rank n is vecRanked[n-1]
+    struct CRankTable {
+        uint256 blockHash;
+        int nStateVersion;
+        std::vector<CLibernode*> vecRanked;
+        std::map<COutPoint, int> mapRanks;
+    };
+
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -117,8 +260,8 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
-    // map to hold all MNs
-    std::vector<CLibernode> vLibernodes;
+    // all MNs
+    CLibernodeRegistry registryLibernodes;
     // who's asked for the Libernode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForLibernodeList;
     // who we asked for the Libernode list and the last time
@@ -152,9 +295,41 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // Rank tables by <block height, min protocol, filter>. They point into registryLibernodes, so they are dropped
+    // whenever an entry is added or removed, and rebuilt when any libernode changed state since
+    std::map<std::tuple<int, int, int>, CRankTable> mapRankTables;
+    std::atomic<int> nRankStateVersion;
+
     friend class CLibernodeSync;
 
+    /// Rank table for the block at nBlockHeight (which must have hash blockHash), built on first use
+    const CRankTable& GetRankTable(int nBlockHeight, const uint256& blockHash, int nMinProtocol, RankFilter filter);
+
 public:
+    /**
+     * All libernodes, iterated in place while holding cs for the lifetime of the snapshot. Do not lock
+     * cs_main after taking one, lock it first if it's needed
+     */
+    class CSnapshot
+    {
+    private:
+        CCriticalBlock lock;
+        CLibernodeRegistry& registry;
+
+    public:
+        typedef CLibernodeRegistry::iterator iterator;
+
+        typedef CLibernodeRegistry::const_iterator const_iterator;
+
+        CSnapshot(CLibernodeMan& man) : lock(man.cs, "mnodeman.cs", __FILE__, __LINE__), registry(man.registryLibernodes) {}
+
+        iterator begin() { return registry.begin(); }
+        iterator end() { return registry.end(); }
+        const_iterator begin() const { return registry.begin(); }
+        const_iterator end() const { return registry.end(); }
+        size_t size() const { return registry.size(); }
+    };
+
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CLibernodeBroadcast> > mapSeenLibernodeBroadcast;
     // Keep track of all pings I've seen
@@ -179,7 +354,7 @@ public:
             READWRITE(strVersion);
         }
 
-        READWRITE(vLibernodes);
+        READWRITE(registryLibernodes);
         READWRITE(mAskedUsForLibernodeList);
         READWRITE(mWeAskedForLibernodeList);
         READWRITE(mWeAskedForLibernodeListEntry);
@@ -191,8 +366,10 @@ public:
         READWRITE(mapSeenLibernodeBroadcast);
         READWRITE(mapSeenLibernodePing);
         READWRITE(indexLibernodes);
-        if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
-            Clear();
+        if(ser_action.ForRead()) {
+            mapRankTables.clear();
+            if(strVersion != SERIALIZATION_VERSION_STRING)
+                Clear();
         }
     }
 
@@ -294,8 +471,6 @@ public:
     /// Find a random entry
     CLibernode* FindRandomNotInVec(const std::vector<CTxIn> &vecToExclude, int nProtocolVersion = -1);
 
-    std::vector<CLibernode> GetFullLibernodeVector() { return vLibernodes; }
-
     std::vector<std::pair<int, CLibernode> > GetLibernodeRanks(int nBlockHeight = -1, int nMinProtocol=0);
     int GetLibernodeRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
     CLibernode* GetLibernodeByRank(int nRank, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
@@ -305,15 +480,25 @@ public:
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
+    /// Verify the signatures of the announces and pings queued in pfrom->vRecvMsg on the parallel task pool,
+    /// so ProcessMessage finds them cached. Must be called with pfrom->cs_vRecvMsg held
+    void PrecheckSignatures(CNode* pfrom);
+
     void DoFullVerificationStep();
     void CheckSameAddr();
-    bool SendVerifyRequest(const CAddress& addr, const std::vector<CLibernode*>& vSortedByAddr);
+    bool SendVerifyRequest(const CAddress& addr);
     void SendVerifyReply(CNode* pnode, CLibernodeVerification& mnv);
     void ProcessVerifyReply(CNode* pnode, CLibernodeVerification& mnv);
     void ProcessVerifyBroadcast(CNode* pnode, const CLibernodeVerification& mnv);
 
     /// Return the number of (unique) Libernodes
-    int size() { return vLibernodes.size(); }
+    int size() { return registryLibernodes.size(); }
+
+    /// Called when a libernode changes state or protocol version, cached ranks are rebuilt on next use
+    void NotifyLibernodeStateChanged() { nRankStateVersion++; }
+
+    /// Called when a new broadcast changed the address or libernode key of pmn, to reindex it
+    void UpdateLibernodeKeys(CLibernode* pmn, const CService& addrOld, const CPubKey& pubKeyLibernodeOld);
 
     std::string ToString() const;
 
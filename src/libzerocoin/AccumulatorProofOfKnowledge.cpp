@@ -34,9 +34,13 @@ namespace libzerocoin {
         Bignum r_2 = Bignum::randBignum(params->accumulatorModulus / 4);
         Bignum r_3 = Bignum::randBignum(params->accumulatorModulus / 4);
 
-        this->C_e = g_n.pow_mod(e, params->accumulatorModulus) * h_n.pow_mod(r_1, params->accumulatorModulus);
-        this->C_u = witness.getValue() * h_n.pow_mod(r_2, params->accumulatorModulus);
-        this->C_r = g_n.pow_mod(r_2, params->accumulatorModulus) * h_n.pow_mod(r_3, params->accumulatorModulus);
+        const IntegerGroupParams &pok = params->accumulatorPoKCommitmentGroup;
+        const IntegerGroupParams &qrn = params->accumulatorQRNCommitmentGroup;
+        const Bignum &N = params->accumulatorModulus;
+
+        this->C_e = qrn.powG(e, N) * qrn.powH(r_1, N);
+        this->C_u = witness.getValue() * qrn.powH(r_2, N);
+        this->C_r = qrn.powG(r_2, N) * qrn.powH(r_3, N);
 
         Bignum r_alpha = Bignum::randBignum(params->maxCoinValue * Bignum(2).pow(params->k_prime + params->k_dprime));
         if (!(Bignum::randBignum(Bignum(3)) % 2)) {
@@ -78,32 +82,17 @@ namespace libzerocoin {
             r_delta = 0 - r_delta;
         }
 
-        this->st_1 = (sg.pow_mod(r_alpha, params->accumulatorPoKCommitmentGroup.modulus) *
-                      sh.pow_mod(r_phi, params->accumulatorPoKCommitmentGroup.modulus)) %
-                     params->accumulatorPoKCommitmentGroup.modulus;
-        this->st_2 = (((commitmentToCoin.getCommitmentValue() *
-                        sg.inverse(params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(r_gamma,
-                                                                                           params->accumulatorPoKCommitmentGroup.modulus)) *
-                      sh.pow_mod(r_psi, params->accumulatorPoKCommitmentGroup.modulus)) %
-                     params->accumulatorPoKCommitmentGroup.modulus;
-        this->st_3 = ((sg * commitmentToCoin.getCommitmentValue()).pow_mod(r_sigma,
-                                                                           params->accumulatorPoKCommitmentGroup.modulus) *
-                      sh.pow_mod(r_xi, params->accumulatorPoKCommitmentGroup.modulus)) %
-                     params->accumulatorPoKCommitmentGroup.modulus;
-
-        this->t_1 =
-                (h_n.pow_mod(r_zeta, params->accumulatorModulus) * g_n.pow_mod(r_epsilon, params->accumulatorModulus)) %
-                params->accumulatorModulus;
-        this->t_2 =
-                (h_n.pow_mod(r_eta, params->accumulatorModulus) * g_n.pow_mod(r_alpha, params->accumulatorModulus)) %
-                params->accumulatorModulus;
-        this->t_3 = (C_u.pow_mod(r_alpha, params->accumulatorModulus) *
-                     ((h_n.inverse(params->accumulatorModulus)).pow_mod(r_beta, params->accumulatorModulus))) %
-                    params->accumulatorModulus;
-        this->t_4 = (C_r.pow_mod(r_alpha, params->accumulatorModulus) *
-                     ((h_n.inverse(params->accumulatorModulus)).pow_mod(r_delta, params->accumulatorModulus)) *
-                     ((g_n.inverse(params->accumulatorModulus)).pow_mod(r_beta, params->accumulatorModulus))) %
-                    params->accumulatorModulus;
+        // (h_n^-1)^x and (g_n^-1)^x are computed as h_n^-x and g_n^-x from the fixed-base tables
+        this->st_1 = pok.powGH(r_alpha, r_phi, pok.modulus);
+        this->st_2 = pok.pow(commitmentToCoin.getCommitmentValue() * sg.inverse(pok.modulus), r_gamma, pok.modulus).mul_mod(
+                pok.powH(r_psi, pok.modulus), pok.modulus);
+        this->st_3 = pok.pow(sg * commitmentToCoin.getCommitmentValue(), r_sigma, pok.modulus).mul_mod(
+                pok.powH(r_xi, pok.modulus), pok.modulus);
+
+        this->t_1 = qrn.powGH(r_epsilon, r_zeta, N);
+        this->t_2 = qrn.powGH(r_alpha, r_eta, N);
+        this->t_3 = qrn.pow(C_u, r_alpha, N).mul_mod(qrn.powH(0 - r_beta, N), N);
+        this->t_4 = qrn.pow(C_r, r_alpha, N).mul_mod(qrn.powGH(0 - r_beta, 0 - r_delta, N), N);
 
         CHashWriter hasher(0, 0);
         hasher << *params << sg << sh << g_n << h_n << commitmentToCoin.getCommitmentValue() << C_e << C_u << C_r
@@ -144,38 +133,21 @@ namespace libzerocoin {
 
         Bignum c = Bignum(hasher.GetHash()); //this hash should be of length k_prime bits
 
-        Bignum st_1_prime = (valueOfCommitmentToCoin.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) *
-                             sg.pow_mod(s_alpha, params->accumulatorPoKCommitmentGroup.modulus) *
-                             sh.pow_mod(s_phi, params->accumulatorPoKCommitmentGroup.modulus)) %
-                            params->accumulatorPoKCommitmentGroup.modulus;
-        Bignum st_2_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * ((valueOfCommitmentToCoin *
-                                                                                              sg.inverse(
-                                                                                                      params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(
-                s_gamma, params->accumulatorPoKCommitmentGroup.modulus)) *
-                             sh.pow_mod(s_psi, params->accumulatorPoKCommitmentGroup.modulus)) %
-                            params->accumulatorPoKCommitmentGroup.modulus;
-        Bignum st_3_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) *
-                             (sg * valueOfCommitmentToCoin).pow_mod(s_sigma,
-                                                                    params->accumulatorPoKCommitmentGroup.modulus) *
-                             sh.pow_mod(s_xi, params->accumulatorPoKCommitmentGroup.modulus)) %
-                            params->accumulatorPoKCommitmentGroup.modulus;
-
-        Bignum t_1_prime =
-                (C_r.pow_mod(c, params->accumulatorModulus) * h_n.pow_mod(s_zeta, params->accumulatorModulus) *
-                 g_n.pow_mod(s_epsilon, params->accumulatorModulus)) % params->accumulatorModulus;
-        Bignum t_2_prime =
-                (C_e.pow_mod(c, params->accumulatorModulus) * h_n.pow_mod(s_eta, params->accumulatorModulus) *
-                 g_n.pow_mod(s_alpha, params->accumulatorModulus)) % params->accumulatorModulus;
-
-        Bignum t_3_prime = ((a.getValue()).pow_mod(c, params->accumulatorModulus) *
-                            C_u.pow_mod(s_alpha, params->accumulatorModulus) *
-                            ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus))) %
-                           params->accumulatorModulus;
-
-        Bignum t_4_prime = (C_r.pow_mod(s_alpha, params->accumulatorModulus) *
-                            ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_delta, params->accumulatorModulus)) *
-                            ((g_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus))) %
-                           params->accumulatorModulus;
+        const IntegerGroupParams &pok = params->accumulatorPoKCommitmentGroup;
+        const IntegerGroupParams &qrn = params->accumulatorQRNCommitmentGroup;
+        const Bignum &N = params->accumulatorModulus;
+
+        Bignum st_1_prime = pok.pow(valueOfCommitmentToCoin, c, pok.modulus).mul_mod(
+                pok.powGH(s_alpha, s_phi, pok.modulus), pok.modulus);
+        Bignum st_2_prime = pok.pow(valueOfCommitmentToCoin * sg.inverse(pok.modulus), s_gamma, pok.modulus).mul_mod(
+                pok.powGH(c, s_psi, pok.modulus), pok.modulus);
+        Bignum st_3_prime = pok.pow(sg * valueOfCommitmentToCoin, s_sigma, pok.modulus).mul_mod(
+                pok.powGH(c, s_xi, pok.modulus), pok.modulus);
+
+        Bignum t_1_prime = qrn.pow(C_r, c, N).mul_mod(qrn.powGH(s_epsilon, s_zeta, N), N);
+        Bignum t_2_prime = qrn.pow(C_e, c, N).mul_mod(qrn.powGH(s_alpha, s_eta, N), N);
+        Bignum t_3_prime = qrn.pow2(a.getValue(), c, C_u, s_alpha, N).mul_mod(qrn.powH(0 - s_beta, N), N);
+        Bignum t_4_prime = qrn.pow(C_r, s_alpha, N).mul_mod(qrn.powGH(0 - s_beta, 0 - s_delta, N), N);
 
         bool result = false;
 
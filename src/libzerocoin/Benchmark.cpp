@@ -21,6 +21,7 @@ using namespace std;
 #include <sys/time.h>
 
 #include "Zerocoin.h"
+#include "../streams.h"
 
 using namespace libzerocoin;
 
@@ -293,6 +294,47 @@ Test_MintCoin()
 	return true;
 }
 
+bool
+Test_FixedBaseExp()
+{
+	const uint32_t NUM_EXPONENTIATIONS = 100;
+	const IntegerGroupParams &qrn = g_Params->accumulatorParams.accumulatorQRNCommitmentGroup;
+	const Bignum &N = g_Params->accumulatorParams.accumulatorModulus;
+	vector<Bignum> exponents, results(NUM_EXPONENTIATIONS);
+
+	// Exponents of the size used by the accumulator proof, half of them negative
+	for (uint32_t i = 0; i < NUM_EXPONENTIATIONS; i++) {
+		Bignum e = Bignum::randBignum(N * g_Params->accumulatorParams.accumulatorPoKCommitmentGroup.modulus);
+		exponents.push_back(i % 2 ? 0 - e : e);
+	}
+
+	try {
+		timer.start();
+		for (uint32_t i = 0; i < NUM_EXPONENTIATIONS; i++) {
+			results[i] = qrn.g.pow_mod(exponents[i], N);
+		}
+		timer.stop();
+
+		cout << "\tPOW_MOD ELAPSED TIME: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
+
+		timer.start();
+		for (uint32_t i = 0; i < NUM_EXPONENTIATIONS; i++) {
+			if (qrn.powG(exponents[i], N) != results[i]) {
+				cout << "Fixed-base result doesn't match" << endl;
+				return false;
+			}
+		}
+		timer.stop();
+
+		cout << "\tFIXED-BASE ELAPSED TIME: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
+	} catch (runtime_error &e) {
+		cout << e.what() << endl;
+		return false;
+	}
+
+	return true;
+}
+
 bool
 Test_MintAndSpend()
 {
@@ -330,7 +372,7 @@ Test_MintAndSpend()
 		cout << "\tWITNESS ELAPSED TIME: \n\t\tTotal: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s\n\t\tPer Element: " << timer.duration()/TESTS_COINS_TO_ACCUMULATE << " ms\t" << (timer.duration()/TESTS_COINS_TO_ACCUMULATE)*0.001 << " s" << endl;
 
 		// Now spend the coin
-		SpendMetaData m(1,1);
+		SpendMetaData m(1, uint256());
 
 		timer.start();
 		CoinSpend spend(g_Params, *(gCoins[0]), acc, wAcc, m);
@@ -383,6 +425,7 @@ Test_RunAllTests()
 	LogTestResult("parameter generation is correct", Test_ParamGen);
 	LogTestResult("coins can be minted", Test_MintCoin);
 	LogTestResult("the accumulator works", Test_Accumulator);
+	LogTestResult("fixed-base exponentiation matches pow_mod", Test_FixedBaseExp);
 	LogTestResult("a minted coin can be spent", Test_MintAndSpend);
 
 	// Summarize test results
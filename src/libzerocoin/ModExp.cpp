@@ -0,0 +1,193 @@
+#include "Zerocoin.h"
+#include "ModExp.h"
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+namespace libzerocoin {
+
+typedef std::vector<std::pair<unsigned int, const BIGNUM *> > DigitList;
+
+MontgomeryContext::MontgomeryContext(const CBigNum &modulusIn) : modulus(modulusIn), mont(BN_MONT_CTX_new()) {
+    CAutoBN_CTX pctx;
+    if (mont == NULL || !BN_is_odd(&modulus) || !BN_MONT_CTX_set(mont, &modulus, pctx)) {
+        BN_MONT_CTX_free(mont);
+        throw bignum_error("MontgomeryContext : BN_MONT_CTX_set failed");
+    }
+}
+
+MontgomeryContext::~MontgomeryContext() {
+    BN_MONT_CTX_free(mont);
+}
+
+CBigNum MontgomeryContext::pow(const CBigNum &base, const CBigNum &e) const {
+    CAutoBN_CTX pctx;
+    CBigNum ret;
+    if (e < 0) {
+        // g^-x = (g^-1)^x
+        CBigNum inv = base.inverse(modulus);
+        CBigNum posE = e * -1;
+        if (!BN_mod_exp_mont(&ret, &inv, &posE, &modulus, pctx, mont))
+            throw bignum_error("MontgomeryContext::pow : BN_mod_exp_mont failed on negative exponent");
+    }
+    else if (!BN_mod_exp_mont(&ret, &base, &e, &modulus, pctx, mont))
+        throw bignum_error("MontgomeryContext::pow : BN_mod_exp_mont failed");
+
+    return ret;
+}
+
+CBigNum MontgomeryContext::pow2(const CBigNum &a, const CBigNum &x, const CBigNum &b, const CBigNum &y) const {
+    CAutoBN_CTX pctx;
+    CBigNum ret;
+    CBigNum a1 = x < 0 ? a.inverse(modulus) : a;
+    CBigNum x1 = x < 0 ? x * -1 : x;
+    CBigNum b1 = y < 0 ? b.inverse(modulus) : b;
+    CBigNum y1 = y < 0 ? y * -1 : y;
+    if (!BN_mod_exp2_mont(&ret, &a1, &x1, &b1, &y1, &modulus, pctx, mont))
+        throw bignum_error("MontgomeryContext::pow2 : BN_mod_exp2_mont failed");
+
+    return ret;
+}
+
+// Yao's method: with u_d the product of all entries whose digit is at least d, the product of
+// entry^digit over all entries equals the product of u_d for d = max..1. Result is in Montgomery form
+static bool YaoProduct(DigitList &digits, CBigNum &result, BN_MONT_CTX *mont, BN_CTX *pctx) {
+    if (digits.empty())
+        return false;
+
+    std::sort(digits.begin(), digits.end(), std::greater<std::pair<unsigned int, const BIGNUM *> >());
+
+    CBigNum u;
+    if (!BN_copy(&u, digits[0].second))
+        throw bignum_error("YaoProduct : BN_copy failed");
+
+    size_t k = 1;
+    for (unsigned int d = digits[0].first; d > 0; d--) {
+        for (; k < digits.size() && digits[k].first == d; k++) {
+            if (!BN_mod_mul_montgomery(&u, &u, digits[k].second, mont, pctx))
+                throw bignum_error("YaoProduct : BN_mod_mul_montgomery failed");
+        }
+        if (d == digits[0].first)
+            result = u;
+        else if (!BN_mod_mul_montgomery(&result, &result, &u, mont, pctx))
+            throw bignum_error("YaoProduct : BN_mod_mul_montgomery failed");
+    }
+
+    return true;
+}
+
+FixedBaseExp::FixedBaseExp(const CBigNum &baseIn, const std::shared_ptr<const MontgomeryContext> &contextIn,
+                           unsigned int maxExponentBits, const CBigNum &orderIn) :
+        base(), order(0), context(contextIn), window(1) {
+
+    // Keep the base in [0, modulus). Proof values are deserialized from the network and may be negative,
+    // the table has to give the same result as BN_mod_exp for them
+    CAutoBN_CTX pctx;
+    if (!BN_nnmod(&base, &baseIn, &context->getModulus(), pctx))
+        throw bignum_error("FixedBaseExp : BN_nnmod failed");
+
+    // Reducing exponents is only correct if base really has the given order
+    if (orderIn > 0 && context->pow(base, orderIn).isOne()) {
+        order = orderIn;
+        maxExponentBits = order.bitSize();
+    }
+    maxExponentBits = std::max(maxExponentBits, 1u);
+
+    // Pick the window minimising the table walk plus the accumulation pass
+    unsigned int bestCost = UINT_MAX;
+    for (unsigned int w = 1; w <= 8; w++) {
+        unsigned int cost = (maxExponentBits + w - 1) / w + (1u << w);
+        if (cost < bestCost) {
+            bestCost = cost;
+            window = w;
+        }
+    }
+
+    BN_MONT_CTX *mont = context->get();
+    CBigNum x = base;
+    if (!BN_to_montgomery(&x, &x, mont, pctx))
+        throw bignum_error("FixedBaseExp : BN_to_montgomery failed");
+
+    table.resize((maxExponentBits + window - 1) / window);
+    for (size_t i = 0; i < table.size(); i++) {
+        table[i] = x;
+        for (unsigned int j = 0; i + 1 < table.size() && j < window; j++) {
+            if (!BN_mod_mul_montgomery(&x, &x, &x, mont, pctx))
+                throw bignum_error("FixedBaseExp : BN_mod_mul_montgomery failed");
+        }
+    }
+}
+
+bool FixedBaseExp::fits(const CBigNum &e) const {
+    return e >= 0 && (size_t)e.bitSize() <= window * table.size();
+}
+
+CBigNum FixedBaseExp::pow(const CBigNum &e) const {
+    std::vector<std::pair<const FixedBaseExp *, CBigNum> > terms(1, std::make_pair(this, e));
+    return multiPow(terms);
+}
+
+CBigNum FixedBaseExp::multiPow(const std::vector<std::pair<const FixedBaseExp *, CBigNum> > &terms) {
+    if (terms.empty())
+        return CBigNum(1);
+
+    const MontgomeryContext &context = *terms[0].first->context;
+    const CBigNum &modulus = context.getModulus();
+    unsigned int window = terms[0].first->window;
+
+    CAutoBN_CTX pctx;
+    DigitList positive, negative;
+    CBigNum rest(1);
+    bool fRest = false;
+
+    for (size_t n = 0; n < terms.size(); n++) {
+        const FixedBaseExp &t = *terms[n].first;
+        if (t.context->getModulus() != modulus)
+            throw bignum_error("FixedBaseExp::multiPow : tables use different moduli");
+
+        CBigNum e = terms[n].second;
+        if (t.order > 0)
+            e = e % t.order;
+
+        bool fNegative = e < 0;
+        CBigNum absE = fNegative ? e * -1 : e;
+        if (t.window != window || !t.fits(absE)) {
+            rest = rest.mul_mod(context.pow(t.base, e), modulus);
+            fRest = true;
+            continue;
+        }
+
+        DigitList &digits = fNegative ? negative : positive;
+        for (size_t i = 0; i * window < (size_t)absE.bitSize(); i++) {
+            unsigned int digit = 0;
+            for (unsigned int j = 0; j < window; j++)
+                digit |= (unsigned int)BN_is_bit_set(&absE, i * window + j) << j;
+            if (digit != 0)
+                digits.push_back(std::make_pair(digit, &t.table[i]));
+        }
+    }
+
+    BN_MONT_CTX *mont = context.get();
+    CBigNum result(1);
+    CBigNum product;
+    if (YaoProduct(positive, product, mont, pctx)) {
+        if (!BN_from_montgomery(&result, &product, mont, pctx))
+            throw bignum_error("FixedBaseExp::multiPow : BN_from_montgomery failed");
+    }
+    if (YaoProduct(negative, product, mont, pctx)) {
+        if (!BN_from_montgomery(&product, &product, mont, pctx))
+            throw bignum_error("FixedBaseExp::multiPow : BN_from_montgomery failed");
+        result = result.mul_mod(product.inverse(modulus), modulus);
+    }
+    if (fRest)
+        result = result.mul_mod(rest, modulus);
+
+    // Same representative as BN_mod_exp whatever path produced the result
+    if (!BN_nnmod(&result, &result, &modulus, pctx))
+        throw bignum_error("FixedBaseExp::multiPow : BN_nnmod failed");
+
+    return result;
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef MODEXP_H
+#define MODEXP_H
+
+#include <memory>
+#include <vector>
+#include <utility>
+
+#include "bitcoin_bignum/bignum.h"
+
+namespace libzerocoin {
+
+// Montgomery context for one odd modulus. Built once and shared (read only) by every exponentiation
+// modulo it, instead of being rebuilt inside each BN_mod_exp call
+class MontgomeryContext {
+private:
+    CBigNum         modulus;
+    BN_MONT_CTX     *mont;
+
+    MontgomeryContext(const MontgomeryContext &);
+    MontgomeryContext &operator=(const MontgomeryContext &);
+
+public:
+    explicit MontgomeryContext(const CBigNum &modulus);
+    ~MontgomeryContext();
+
+    const CBigNum &getModulus() const { return modulus; }
+    BN_MONT_CTX *get() const { return mont; }
+
+    // base^e mod modulus, negative exponents use the inverse of base like CBigNum::pow_mod
+    CBigNum pow(const CBigNum &base, const CBigNum &e) const;
+
+    // a^x * b^y mod modulus with one simultaneous exponentiation
+    CBigNum pow2(const CBigNum &a, const CBigNum &x, const CBigNum &b, const CBigNum &y) const;
+};
+
+// Fixed-base exponentiation. Stores base^(2^(w*i)) in Montgomery form for every w-bit window of the exponent
+// and evaluates base^e with Yao's method: about maxExponentBits/w + 2^w multiplications and no squarings.
+// If the order of base is known exponents are reduced modulo it, otherwise exponents longer than the table
+// fall back to a plain exponentiation. Not constant time, same as the BN_mod_exp calls it replaces.
+class FixedBaseExp {
+private:
+    CBigNum         base;
+    // order of base or zero if unknown
+    CBigNum         order;
+    std::shared_ptr<const MontgomeryContext> context;
+    unsigned int    window;
+    std::vector<CBigNum> table;
+
+    // exponent must be non-negative and fit into the table
+    bool fits(const CBigNum &e) const;
+
+public:
+    FixedBaseExp(const CBigNum &base, const std::shared_ptr<const MontgomeryContext> &context,
+                 unsigned int maxExponentBits, const CBigNum &order = CBigNum(0));
+
+    const CBigNum &getBase() const { return base; }
+    const std::shared_ptr<const MontgomeryContext> &getContext() const { return context; }
+
+    // base^e mod modulus, e may be negative
+    CBigNum pow(const CBigNum &e) const;
+
+    // product of base_i^e_i mod modulus for tables sharing the same context, computed in one pass
+    static CBigNum multiPow(const std::vector<std::pair<const FixedBaseExp *, CBigNum> > &terms);
+};
+
+}
+
+#endif // MODEXP_H
@@ -1,110 +1,205 @@
 #include "Zerocoin.h"
 #include "ParallelTasks.h"
 
-#define BOOST_THREAD_PROVIDES_FUTURE
-
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
-#include <boost/thread/future.hpp>
-#include <boost/chrono.hpp>
 
-#include <queue>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
 #include <vector>
-#include <list>
 #include <algorithm>
 #include <functional>
 
 namespace libzerocoin {
 
-#ifdef ZEROCOIN_THREADING
+// One bulk operation: body(i) for i in [0, count). Workers and the submitting thread claim indices one at
+// a time so a batch is split evenly no matter how many threads picked it up
+class ParallelBatch {
+private:
+    std::function<void(size_t)>     body;
+    size_t                          count;
+    std::atomic<size_t>             next;
+    std::atomic<size_t>             done;
 
-// Number of seconds before thread shuts down if idle
-constexpr static int secondsBeforeThreadShutdown = 10;
+    boost::mutex                    mutex;
+    boost::condition_variable       finished;
+    std::exception_ptr              error;
+
+public:
+    ParallelBatch(std::function<void(size_t)> bodyIn, size_t countIn) : body(std::move(bodyIn)), count(countIn), next(0), done(0) {}
+
+    // process items until the batch runs dry
+    void Run() {
+        size_t i, nFinished = 0;
+        while ((i = next.fetch_add(1)) < count) {
+            try {
+                body(i);
+            }
+            catch (...) {
+                boost::lock_guard<boost::mutex> lock(mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+            nFinished++;
+        }
 
-// Simple thread pool class for using multiple cores effeciently
+        if (nFinished > 0 && done.fetch_add(nFinished) + nFinished == count) {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            finished.notify_all();
+        }
+    }
+
+    // wait for the items claimed by other threads and rethrow the first exception
+    void Wait() {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        finished.wait(lock, [this] { return done.load() == count; });
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+#ifdef ZEROCOIN_THREADING
+
+// Persistent work-stealing thread pool shared by everything that uses ParallelTasks. Every worker owns a deque
+// of batches: it takes work from the back of its own deque and steals from the front of the others when it
+// runs out. Threads are started on first use and live until shutdown
 
 static class ParallelOpThreadPool {
 private:
-    std::list<boost::thread>                  threads;
-    std::queue<boost::packaged_task<void>>    taskQueue;
-    boost::mutex                              taskQueueMutex;
-    boost::condition_variable                 taskQueueCondition;
+    struct Worker {
+        boost::mutex                                    mutex;
+        std::deque<std::shared_ptr<ParallelBatch>>      batches;
+    };
+
+    std::vector<std::unique_ptr<Worker>>    workers;
+    std::vector<boost::thread>              threads;
+
+    // protects startup/shutdown and is used to put idle workers to sleep
+    boost::mutex                            poolMutex;
+    boost::condition_variable               poolCondition;
+
+    // number of batch references sitting in the worker deques
+    std::atomic<size_t>                     queued;
+    std::atomic<size_t>                     nextWorker;
+    std::atomic<bool>                       started;
+    bool                                    shutdown;
+    size_t                                  numberOfThreads;
+
+    bool PopOwn(size_t n, std::shared_ptr<ParallelBatch> &batch) {
+        Worker &w = *workers[n];
+        boost::lock_guard<boost::mutex> lock(w.mutex);
+        if (w.batches.empty())
+            return false;
+        batch = std::move(w.batches.back());
+        w.batches.pop_back();
+        queued--;
+        return true;
+    }
 
-    bool                                      shutdown;
-    size_t                                    numberOfThreads;
+    bool Steal(size_t n, std::shared_ptr<ParallelBatch> &batch) {
+        for (size_t k = 1; k < workers.size(); k++) {
+            Worker &victim = *workers[(n + k) % workers.size()];
+            boost::lock_guard<boost::mutex> lock(victim.mutex);
+            if (victim.batches.empty())
+                continue;
+            batch = std::move(victim.batches.front());
+            victim.batches.pop_front();
+            queued--;
+            return true;
+        }
+        return false;
+    }
 
-    void ThreadProc() {
+    void ThreadProc(size_t n) {
         for (;;) {
-            boost::packaged_task<void> job;
-            {
-                boost::unique_lock<boost::mutex> lock(taskQueueMutex);
-
-                taskQueueCondition.wait_for(lock, boost::chrono::seconds(secondsBeforeThreadShutdown),
-                                            [this] { return !taskQueue.empty() || shutdown; });
-                if (taskQueue.empty()) {
-                    // Either timeout or shutdown. If it's a timeout we need to delete ourself from the thread list and detach the thread
-                    // In case of shutdown thread list will be empty and destructor will wait for this thread completion
-                    boost::thread::id currentId = boost::this_thread::get_id();
-                    auto pThread = find_if(threads.begin(), threads.end(), [=](const boost::thread &t) { return t.get_id() == currentId; });
-                    if (pThread != threads.end()) {
-                        pThread->detach();
-                        threads.erase(pThread);
-                    }
-                    break;
-                }
-                job = std::move(taskQueue.front());
-                taskQueue.pop();
+            std::shared_ptr<ParallelBatch> batch;
+            if (PopOwn(n, batch) || Steal(n, batch)) {
+                batch->Run();
+                continue;
             }
-            job();
+
+            boost::unique_lock<boost::mutex> lock(poolMutex);
+            poolCondition.wait(lock, [this] { return queued.load() > 0 || shutdown; });
+            if (shutdown)
+                break;
         }
     }
 
     void StartThreads() {
-        // should be called with mutex aquired
-        // start missing threads
-        while(threads.size() < numberOfThreads)
-            threads.emplace_back(std::bind(&ParallelOpThreadPool::ThreadProc, this));
-    }
+        boost::lock_guard<boost::mutex> lock(poolMutex);
+        if (started.load())
+            return;
 
-public:
-    ParallelOpThreadPool() : shutdown(false), numberOfThreads(boost::thread::hardware_concurrency()) {}
+        if (numberOfThreads == 0)
+            numberOfThreads = std::max(boost::thread::hardware_concurrency(), 1u);
 
-    ~ParallelOpThreadPool() {
-        std::list<boost::thread> threadsToJoin;
+        for (size_t n = 0; n < numberOfThreads; n++)
+            workers.emplace_back(new Worker());
+        for (size_t n = 0; n < numberOfThreads; n++)
+            threads.emplace_back(std::bind(&ParallelOpThreadPool::ThreadProc, this, n));
 
-        taskQueueMutex.lock();
-
-        shutdown = true;
-        taskQueueCondition.notify_all();
+        started = true;
+    }
 
-        // move the list to separate variable to wait for the shutdown process to complete
-        threadsToJoin.swap(threads);
+public:
+    ParallelOpThreadPool() : queued(0), nextWorker(0), started(false), shutdown(false), numberOfThreads(0) {}
 
-        taskQueueMutex.unlock();
+    ~ParallelOpThreadPool() {
+        {
+            boost::lock_guard<boost::mutex> lock(poolMutex);
+            shutdown = true;
+            poolCondition.notify_all();
+        }
 
-        // wait for all the threads
-        for (boost::thread &t: threadsToJoin)
+        for (boost::thread &t: threads)
             t.join();
     }
 
-    // Post a task to the thread pool and return a future to wait for its completion
-    boost::future<void> PostTask(function<void()> task) {
-        boost::packaged_task<void> packagedTask(std::move(task));
-        boost::future<void> ret = packagedTask.get_future();
+    void SetThreadCount(size_t n) {
+        boost::lock_guard<boost::mutex> lock(poolMutex);
+        if (!started.load())
+            numberOfThreads = n;
+    }
 
-        taskQueueMutex.lock();
+    // Run the batch on the pool and on the calling thread, return when every item is processed. The caller only
+    // works on its own batch so it's safe to call with locks held or from inside another batch
+    void Run(std::function<void(size_t)> body, size_t count) {
+        if (count == 0)
+            return;
 
-        // lazy start threads on first request or after shutdown
-        if (threads.size() < numberOfThreads)
+        if (count == 1) {
+            body(0);
+            return;
+        }
+
+        if (!started.load())
             StartThreads();
 
-        taskQueue.emplace(std::move(packagedTask));
-        taskQueueCondition.notify_one();
+        std::shared_ptr<ParallelBatch> batch = std::make_shared<ParallelBatch>(std::move(body), count);
 
-        taskQueueMutex.unlock();
+        // the caller takes one share itself, wake up to count-1 workers for the rest
+        size_t nShares = std::min(workers.size(), count - 1);
+        size_t first = nextWorker.fetch_add(nShares);
+        for (size_t k = 0; k < nShares; k++) {
+            Worker &w = *workers[(first + k) % workers.size()];
+            boost::lock_guard<boost::mutex> lock(w.mutex);
+            w.batches.push_back(batch);
+            queued++;
+        }
 
-        return ret;
+        {
+            boost::lock_guard<boost::mutex> lock(poolMutex);
+            if (nShares == 1)
+                poolCondition.notify_one();
+            else
+                poolCondition.notify_all();
+        }
+
+        batch->Run();
+        batch->Wait();
     }
 
 } s_parallelOpThreadPool;
@@ -113,11 +208,12 @@ public:
 
 static class ParallelOpThreadPool {
 public:
-    boost::future<void> PostTask(function<void()> task) {
-        task();
-        boost::promise<void> promise;
-        promise.set_value();
-        return promise.get_future();
+    void SetThreadCount(size_t) {}
+
+    void Run(std::function<void(size_t)> body, size_t count) {
+        ParallelBatch batch(std::move(body), count);
+        batch.Run();
+        batch.Wait();
     }
 } s_parallelOpThreadPool;
 
@@ -130,16 +226,25 @@ ParallelTasks::ParallelTasks(int n) {
 }
 
 void ParallelTasks::Add(function<void()> task) {
-    tasks.push_back(s_parallelOpThreadPool.PostTask(std::move(task)));
+    tasks.push_back(std::move(task));
 }
 
 void ParallelTasks::Wait() {
-    for (boost::future<void> &f: tasks)
-        f.get();
+    std::vector<std::function<void()>> batch;
+    batch.swap(tasks);
+    s_parallelOpThreadPool.Run([&batch](size_t i) { batch[i](); }, batch.size());
 }
 
 void ParallelTasks::Reset() {
     tasks.clear();
 }
 
+void ParallelTasks::ParallelFor(size_t n, std::function<void(size_t)> body) {
+    s_parallelOpThreadPool.Run(std::move(body), n);
+}
+
+void ParallelTasks::SetThreadCount(int n) {
+    s_parallelOpThreadPool.SetThreadCount(n > 0 ? (size_t)n : 0);
+}
+
 } // namespace libzerocoin
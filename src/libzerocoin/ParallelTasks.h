@@ -4,30 +4,34 @@
 #include <vector>
 #include <functional>
 
-#define BOOST_THREAD_PROVIDES_FUTURE
-
-
-#include <boost/thread/future.hpp>
 #include <boost/thread.hpp>
 
 namespace libzerocoin {
 
 class ParallelTasks {
 private:
-    vector<boost::future<void>> tasks;
+    vector<std::function<void()>> tasks;
 
 public:
     ParallelTasks(int n=0);
 
-    // add new task
+    // add new task, tasks are started as one batch by Wait()
     void Add(std::function<void()> task);
 
-    // wait for everything added so far
+    // run everything added so far on the shared pool and wait for completion. The calling thread takes part
+    // in the batch. The first exception thrown by a task is rethrown after all the tasks are finished
     void Wait();
 
     // clear all the tasks from the waiting list
     void Reset();
 
+    // run body(i) for every i in [0, n) as one batch on the shared pool, same rules as Wait()
+    static void ParallelFor(size_t n, std::function<void(size_t)> body);
+
+    // set the number of worker threads of the shared pool (0 means number of cores). Takes effect only if
+    // called before the first parallel operation
+    static void SetThreadCount(int n);
+
     // helper class to put thread interruption on pause
     class DoNotDisturb {
     private:
@@ -39,4 +43,4 @@ public:
 
 }
 
-#endif // PARALLELTASKS_H
\ No newline at end of file
+#endif // PARALLELTASKS_H
@@ -25,6 +25,27 @@ Params::Params(CBigNum N, uint32_t securityLevel) {
 
 	this->accumulatorParams.initialized = true;
 	this->initialized = true;
+
+	PrecomputeTables();
+}
+
+void Params::PrecomputeTables() {
+	// Prime order groups: exponents get reduced modulo the group order
+	this->coinCommitmentGroup.PrecomputeTables(this->coinCommitmentGroup.modulus,
+	                                           this->coinCommitmentGroup.groupOrder.bitSize());
+	this->serialNumberSoKCommitmentGroup.PrecomputeTables(this->serialNumberSoKCommitmentGroup.modulus,
+	                                                      this->serialNumberSoKCommitmentGroup.groupOrder.bitSize());
+
+	AccumulatorAndProofParams &ap = this->accumulatorParams;
+	ap.accumulatorPoKCommitmentGroup.PrecomputeTables(ap.accumulatorPoKCommitmentGroup.modulus,
+	                                                  ap.accumulatorPoKCommitmentGroup.groupOrder.bitSize());
+
+	// QR_N has hidden order, cover the longest responses of the accumulator proof:
+	// |N/4| + |PoK modulus| + k' + k'' bits for the random part, |N/4| + |maxCoinValue| + |challenge| for c*r*e
+	uint32_t maxExponentBits = ap.accumulatorModulus.bitSize() +
+	        std::max<uint32_t>(ap.accumulatorPoKCommitmentGroup.modulus.bitSize() + ap.k_prime + ap.k_dprime,
+	                 ap.maxCoinValue.bitSize() + HASH_OUTPUT_BITS) + 2;
+	ap.accumulatorQRNCommitmentGroup.PrecomputeTables(ap.accumulatorModulus, maxExponentBits);
 }
 
 AccumulatorAndProofParams::AccumulatorAndProofParams() {
@@ -35,11 +56,52 @@ IntegerGroupParams::IntegerGroupParams() {
 	this->initialized = false;
 }
 
+void IntegerGroupParams::PrecomputeTables(const CBigNum &tableModulus, uint32_t maxExponentBits) {
+	this->context = std::make_shared<const MontgomeryContext>(tableModulus);
+	this->gTable = std::make_shared<const FixedBaseExp>(this->g, this->context, maxExponentBits, this->groupOrder);
+	this->hTable = std::make_shared<const FixedBaseExp>(this->h, this->context, maxExponentBits, this->groupOrder);
+}
+
+CBigNum IntegerGroupParams::powG(const CBigNum &e, const CBigNum &m) const {
+	if (this->gTable && this->context->getModulus() == m)
+		return this->gTable->pow(e);
+	return this->g.pow_mod(e, m);
+}
+
+CBigNum IntegerGroupParams::powH(const CBigNum &e, const CBigNum &m) const {
+	if (this->hTable && this->context->getModulus() == m)
+		return this->hTable->pow(e);
+	return this->h.pow_mod(e, m);
+}
+
+CBigNum IntegerGroupParams::powGH(const CBigNum &x, const CBigNum &y, const CBigNum &m) const {
+	if (this->gTable && this->hTable && this->context->getModulus() == m) {
+		std::vector<std::pair<const FixedBaseExp *, CBigNum> > terms;
+		terms.push_back(std::make_pair(this->gTable.get(), x));
+		terms.push_back(std::make_pair(this->hTable.get(), y));
+		return FixedBaseExp::multiPow(terms);
+	}
+	return this->g.pow_mod(x, m).mul_mod(this->h.pow_mod(y, m), m);
+}
+
+CBigNum IntegerGroupParams::pow(const CBigNum &base, const CBigNum &e, const CBigNum &m) const {
+	if (this->context && this->context->getModulus() == m)
+		return this->context->pow(base, e);
+	return base.pow_mod(e, m);
+}
+
+CBigNum IntegerGroupParams::pow2(const CBigNum &a, const CBigNum &x, const CBigNum &b, const CBigNum &y,
+                                 const CBigNum &m) const {
+	if (this->context && this->context->getModulus() == m)
+		return this->context->pow2(a, x, b, y);
+	return a.pow_mod(x, m).mul_mod(b.pow_mod(y, m), m);
+}
+
 Bignum IntegerGroupParams::randomElement() const {
 	// The generator of the group raised
 	// to a random number less than the order of the group
 	// provides us with a uniformly distributed random number.
-	return this->g.pow_mod(Bignum::randBignum(this->groupOrder),this->modulus);
+	return powG(Bignum::randBignum(this->groupOrder), this->modulus);
 }
 
 } /* namespace libzerocoin */
@@ -52,6 +52,40 @@ public:
 	 */
     CBigNum groupOrder;
 
+	/**
+	 * Montgomery context and fixed-base exponentiation tables for g and h.
+	 * Built by PrecomputeTables() once the parameters are final, not serialized.
+	 */
+	std::shared_ptr<const MontgomeryContext> context;
+	std::shared_ptr<const FixedBaseExp> gTable;
+	std::shared_ptr<const FixedBaseExp> hTable;
+
+	/**
+	 * Builds the tables for g and h modulo tableModulus
+	 * @param tableModulus      modulus the generators are used with
+	 * @param maxExponentBits   longest exponent to cover if the group order is unknown
+	 */
+	void PrecomputeTables(const CBigNum &tableModulus, uint32_t maxExponentBits);
+
+	/**
+	 * g^e mod m and h^e mod m. The tables are used when m is their modulus,
+	 * otherwise this is plain pow_mod.
+	 */
+	CBigNum powG(const CBigNum &e, const CBigNum &m) const;
+	CBigNum powH(const CBigNum &e, const CBigNum &m) const;
+
+	/**
+	 * g^x * h^y mod m computed in one pass over both tables
+	 */
+	CBigNum powGH(const CBigNum &x, const CBigNum &y, const CBigNum &m) const;
+
+	/**
+	 * base^e mod m and a^x * b^y mod m for arbitrary bases, reusing the
+	 * Montgomery context when m is its modulus
+	 */
+	CBigNum pow(const CBigNum &base, const CBigNum &e, const CBigNum &m) const;
+	CBigNum pow2(const CBigNum &a, const CBigNum &x, const CBigNum &b, const CBigNum &y, const CBigNum &m) const;
+
 	ADD_SERIALIZE_METHODS;
 
 	template <typename Stream, typename Operation>
@@ -61,6 +95,12 @@ public:
 		READWRITE(h);
 		READWRITE(modulus);
 		READWRITE(groupOrder);
+		if (ser_action.ForRead()) {
+			// tables were built for the old values
+			context.reset();
+			gTable.reset();
+			hTable.reset();
+		}
 	};
 
 };
@@ -174,6 +214,12 @@ public:
 	**/
     Params(CBigNum accumulatorModulus, uint32_t securityLevel = ZEROCOIN_DEFAULT_SECURITYLEVEL);
 
+	/**
+	 * Builds the fixed-base exponentiation tables of every group used by the proofs.
+	 * Called by the constructor, call again after deserializing parameters.
+	 */
+	void PrecomputeTables();
+
 	bool initialized;
 
 	AccumulatorAndProofParams accumulatorParams;
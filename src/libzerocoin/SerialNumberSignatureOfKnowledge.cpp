@@ -29,11 +29,6 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const Params*
 		throw ZerocoinException("Groups are not structured correctly.");
 	}
 
-	Bignum a = params->coinCommitmentGroup.g;
-	Bignum b = params->coinCommitmentGroup.h;
-	Bignum g = params->serialNumberSoKCommitmentGroup.g;
-	Bignum h = params->serialNumberSoKCommitmentGroup.h;
-
 	CHashWriter hasher(0,0);
 	hasher << *params << commitmentToCoin.getCommitmentValue() << coin.getSerialNumber();
     if (!msghash.IsNull())
@@ -85,10 +80,10 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const Params*
 			s_notprime[i]       = r[i];
 			sprime[i]           = v[i];
 		} else {
-            challenges.Add([this, i, &r, &v, &b, &commitmentToCoin, &coin] {
+            challenges.Add([this, i, &r, &v, &commitmentToCoin, &coin] {
                 s_notprime[i]   = r[i] - coin.getRandomness();
                 sprime[i]       = v[i] - (commitmentToCoin.getRandomness() *
-			                              b.pow_mod(r[i] - coin.getRandomness(), params->serialNumberSoKCommitmentGroup.groupOrder));
+			                              params->coinCommitmentGroup.powH(r[i] - coin.getRandomness(), params->serialNumberSoKCommitmentGroup.groupOrder));
             });
 		}
     }
@@ -98,15 +93,10 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const Params*
 inline Bignum SerialNumberSignatureOfKnowledge::challengeCalculation(const Bignum& a_exp,const Bignum& b_exp,
         const Bignum& h_exp) const {
 
-	Bignum a = params->coinCommitmentGroup.g;
-	Bignum b = params->coinCommitmentGroup.h;
-	Bignum g = params->serialNumberSoKCommitmentGroup.g;
-	Bignum h = params->serialNumberSoKCommitmentGroup.h;
-
-	Bignum exponent = (a.pow_mod(a_exp, params->serialNumberSoKCommitmentGroup.groupOrder)
-	                   * b.pow_mod(b_exp, params->serialNumberSoKCommitmentGroup.groupOrder)) % params->serialNumberSoKCommitmentGroup.groupOrder;
+	// a, b are the generators of coinCommitmentGroup, whose modulus is the order of serialNumberSoKCommitmentGroup
+	Bignum exponent = params->coinCommitmentGroup.powGH(a_exp, b_exp, params->serialNumberSoKCommitmentGroup.groupOrder);
 
-	return (g.pow_mod(exponent, params->serialNumberSoKCommitmentGroup.modulus) * h.pow_mod(h_exp, params->serialNumberSoKCommitmentGroup.modulus)) % params->serialNumberSoKCommitmentGroup.modulus;
+	return params->serialNumberSoKCommitmentGroup.powGH(exponent, h_exp, params->serialNumberSoKCommitmentGroup.modulus);
 }
 
 bool SerialNumberSignatureOfKnowledge::Verify(const Bignum& coinSerialNumber, const Bignum& valueOfCommitmentToCoin,
@@ -114,11 +104,6 @@ bool SerialNumberSignatureOfKnowledge::Verify(const Bignum& coinSerialNumber, co
 
     ParallelTasks::DoNotDisturb dnd;
 
-	Bignum a = params->coinCommitmentGroup.g;
-	Bignum b = params->coinCommitmentGroup.h;
-	Bignum g = params->serialNumberSoKCommitmentGroup.g;
-	Bignum h = params->serialNumberSoKCommitmentGroup.h;
-
 	// Make sure that the serial number has a unique representation
 	if (coinSerialNumber < 0 || coinSerialNumber >= params->coinCommitmentGroup.groupOrder){
 		return false;
@@ -133,20 +118,33 @@ bool SerialNumberSignatureOfKnowledge::Verify(const Bignum& coinSerialNumber, co
 	vector<CBigNum> tprime(params->zkp_iterations);
 	unsigned char *hashbytes = (unsigned char*) &this->hash;
 
+	// Roughly half of the iterations raise the commitment to a coin to some power, build a
+	// fixed-base table for it once per proof
+	const IntegerGroupParams &sokGroup = params->serialNumberSoKCommitmentGroup;
+	std::shared_ptr<const FixedBaseExp> commitmentTable;
+	if (sokGroup.hTable)
+		commitmentTable = std::make_shared<const FixedBaseExp>(valueOfCommitmentToCoin, sokGroup.context, sokGroup.groupOrder.bitSize());
+
     ParallelTasks challenges(params->zkp_iterations);
 
 	for(uint32_t i = 0; i < params->zkp_iterations; i++) {
-        challenges.Add([this, i, hashbytes, &b, &h, &tprime, &coinSerialNumber, &valueOfCommitmentToCoin] {
+        challenges.Add([this, i, hashbytes, &sokGroup, &commitmentTable, &tprime, &coinSerialNumber, &valueOfCommitmentToCoin] {
             int bit = i % 8;
             int byte = i / 8;
             bool challenge_bit = ((hashbytes[byte] >> bit) & 0x01);
             if(challenge_bit) {
                 tprime[i] = challengeCalculation(coinSerialNumber, s_notprime[i], sprime[i]);
             } else {
-                Bignum exp = b.pow_mod(s_notprime[i], params->serialNumberSoKCommitmentGroup.groupOrder);
-                tprime[i] = ((valueOfCommitmentToCoin.pow_mod(exp, params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus) *
-                             (h.pow_mod(sprime[i], params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus)) %
-                            params->serialNumberSoKCommitmentGroup.modulus;
+                Bignum exp = params->coinCommitmentGroup.powH(s_notprime[i], sokGroup.groupOrder);
+                if (commitmentTable) {
+                    std::vector<std::pair<const FixedBaseExp *, CBigNum> > terms;
+                    terms.push_back(std::make_pair(commitmentTable.get(), exp));
+                    terms.push_back(std::make_pair(sokGroup.hTable.get(), sprime[i]));
+                    tprime[i] = FixedBaseExp::multiPow(terms);
+                } else {
+                    tprime[i] = sokGroup.pow(valueOfCommitmentToCoin, exp, sokGroup.modulus).mul_mod(
+                            sokGroup.powH(sprime[i], sokGroup.modulus), sokGroup.modulus);
+                }
             }
         });
 	}
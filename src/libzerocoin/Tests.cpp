@@ -309,6 +309,42 @@ Test_EqualityPoK()
 	return true;
 }
 
+bool
+Test_FixedBaseExpNegativeBase()
+{
+	try {
+		// BN_mod_exp gives the non-negative representative, (-5)^3 mod 1000000007 = 999999882
+		shared_ptr<const MontgomeryContext> small = make_shared<const MontgomeryContext>(Bignum(1000000007));
+		FixedBaseExp smallTable(Bignum(-5), small, 32);
+		if (smallTable.pow(Bignum(3)) != Bignum(999999882)) {
+			return false;
+		}
+
+		// A negative commitment value as a spend proof could carry it, checked against pow_mod
+		const IntegerGroupParams &group = g_Params->serialNumberSoKCommitmentGroup;
+		Bignum negBase = Bignum(0) - Bignum::randBignum(group.modulus);
+		FixedBaseExp table(negBase, group.context, group.groupOrder.bitSize());
+		for (uint32_t i = 0; i < 10; i++) {
+			Bignum e = Bignum::randBignum(group.groupOrder);
+			Bignum expected = negBase.pow_mod(e, group.modulus);
+			if (table.pow(e) != expected || table.pow(0 - e) != expected.inverse(group.modulus)) {
+				return false;
+			}
+
+			vector<pair<const FixedBaseExp *, Bignum> > terms;
+			terms.push_back(make_pair(&table, e));
+			terms.push_back(make_pair(group.hTable.get(), e));
+			if (FixedBaseExp::multiPow(terms) != expected.mul_mod(group.h.pow_mod(e, group.modulus), group.modulus)) {
+				return false;
+			}
+		}
+	} catch (runtime_error &e) {
+		return false;
+	}
+
+	return true;
+}
+
 bool
 Test_MintCoin()
 {
@@ -452,6 +488,7 @@ Test_RunAllTests()
 	LogTestResult("parameter sizes are correct", Test_CalcParamSizes);
 	LogTestResult("group/field parameters can be generated", Test_GenerateGroupParams);
 	LogTestResult("parameter generation is correct", Test_ParamGen);
+	LogTestResult("fixed-base exponentiation reduces a negative base", Test_FixedBaseExpNegativeBase);
 	LogTestResult("coins can be minted", Test_MintCoin);
 	LogTestResult("invalid coins will be rejected", Test_InvalidCoin);
 	LogTestResult("the accumulator works", Test_Accumulator);
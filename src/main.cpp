@@ -47,6 +47,7 @@
 #include "libernode-sync.h"
 #include "libernodeman.h"
 #include "zerocoin.h"
+#include "libzerocoin/ParallelTasks.h"
 
 #include <atomic>
 #include <sstream>
@@ -89,6 +90,7 @@ bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fCheckPoWOnDisk = DEFAULT_CHECKPOWONDISK;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
@@ -1099,7 +1101,7 @@ int64_t GetTransactionSigOpCost(const CTransaction &tx, const CCoinsViewCache &i
 
 
 //static libzerocoin::Params *ZCParams;
-bool CheckTransaction(const CTransaction &tx, CValidationState &state, uint256 hashTx,  bool isVerifyDB, int nHeight, bool isCheckWallet, CZerocoinTxInfo *zerocoinTxInfo) {
+bool CheckTransaction(const CTransaction &tx, CValidationState &state, uint256 hashTx,  bool isVerifyDB, int nHeight, bool isCheckWallet, CZerocoinTxInfo *zerocoinTxInfo, std::vector<CZerocoinSpendCheck> *pvChecks) {
     //LogPrintf("CheckTransaction nHeight=%s, isVerifyDB=%s, isCheckWallet=%s, txHash=%s\n", nHeight, isVerifyDB, isCheckWallet, tx.GetHash().ToString());
 //    LogPrintf("transaction = %s\n", tx.ToString());
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
@@ -1143,7 +1145,7 @@ bool CheckTransaction(const CTransaction &tx, CValidationState &state, uint256 h
                 return state.DoS(10, false, REJECT_INVALID, "bad-txns-prevout-null");
             }
         }
-        if (!CheckZerocoinTransaction(tx, state, hashTx, isVerifyDB, nHeight, isCheckWallet, zerocoinTxInfo))
+        if (!CheckZerocoinTransaction(tx, state, hashTx, isVerifyDB, nHeight, isCheckWallet, zerocoinTxInfo, pvChecks))
         return false;
     }
     return true;
@@ -1174,7 +1176,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
                               bool *pfMissingInputs, bool fOverrideMempoolLimit, const CAmount &nAbsurdFee,
                               std::vector <uint256> &vHashTxnToUncache, bool isCheckWalletTransaction) {
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
-    LogPrintf("AcceptToMemoryPoolWorker(),fCheckInputs=%s, tx.IsZerocoinSpend()=%s, fTestNet=%s\n", fCheckInputs,
+    LogPrint("mempool", "AcceptToMemoryPoolWorker(),fCheckInputs=%s, tx.IsZerocoinSpend()=%s, fTestNet=%s\n", fCheckInputs,
               tx.IsZerocoinSpend(), fTestNet);
     uint256 hash = tx.GetHash();
     AssertLockHeld(cs_main);
@@ -1182,13 +1184,13 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
         *pfMissingInputs = false;
 
     if (!CheckTransaction(tx, state, hash, false, INT_MAX, isCheckWalletTransaction)) {
-        LogPrintf("CheckTransaction() failed!");
+        LogPrint("mempool", "CheckTransaction() failed!");
         return false; // state filled in by CheckTransaction
     }
 
     // Coinbase is only valid in a block, not as a loose transaction
     if (tx.IsCoinBase()) {
-        LogPrintf("cause by -> coinbase!\n");
+        LogPrint("mempool", "cause by -> coinbase!\n");
         return state.DoS(100, false, REJECT_INVALID, "coinbase");
     }
 
@@ -1210,7 +1212,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
     // Rather not work on nonstandard transactions (unless -testnet/-regtest)
     string reason;
     if (!fTestNet && fRequireStandard && !IsStandardTx(tx, reason, witnessEnabled)) {
-        LogPrintf("cause by -> Not StandardTx\n");
+        LogPrint("mempool", "cause by -> Not StandardTx\n");
         return state.DoS(0, false, REJECT_NONSTANDARD, reason);
     }
 
@@ -1249,7 +1251,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
                             }
                         }
                         if (fReplacementOptOut) {
-                            LogPrintf("cause by -> txn-mempool-conflict!\n");
+                            LogPrint("mempool", "cause by -> txn-mempool-conflict!\n");
                             return state.Invalid(false, REJECT_CONFLICT, "txn-mempool-conflict");
                         }
 
@@ -1275,7 +1277,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
             bool fHadTxInCache = pcoinsTip->HaveCoinsInCache(hash);
             if (view.HaveCoins(hash)) {
                 if (!fHadTxInCache) vHashTxnToUncache.push_back(hash);
-                LogPrintf("cause by -> txn-already-known!\n");
+                LogPrint("mempool", "cause by -> txn-already-known!\n");
                 return state.Invalid(false, REJECT_ALREADY_KNOWN, "txn-already-known");
             }
 
@@ -1289,14 +1291,14 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
                         vHashTxnToUncache.push_back(txin.prevout.hash);
                     if (!view.HaveCoins(txin.prevout.hash)) {
                         if (pfMissingInputs) *pfMissingInputs = true;
-                        LogPrintf("cause by ->view.HaveCoins!\n");
+                        LogPrint("mempool", "cause by ->view.HaveCoins!\n");
                         return false; // fMissingInputs and !state.IsInvalid() is used to detect this condition, don't set state.Invalid()
                     }
                 }
 
                 // are the actual inputs available?
                 if (!view.HaveInputs(tx)) {
-                    LogPrintf("cause by -> bad-txns-inputs-spent!\n");
+                    LogPrint("mempool", "cause by -> bad-txns-inputs-spent!\n");
                     return state.Invalid(false, REJECT_DUPLICATE, "bad-txns-inputs-spent");
                 }
 
@@ -1324,12 +1326,12 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
 
             // Check for non-standard pay-to-script-hash in inputs
             if (!fTestNet && fRequireStandard && !AreInputsStandard(tx, view)) {
-                LogPrintf("cause by -> AreInputsStandard\n");
+                LogPrint("mempool", "cause by -> AreInputsStandard\n");
                 return state.Invalid(false, REJECT_NONSTANDARD, "bad-txns-nonstandard-inputs");
             }
             // Check for non-standard witness in P2WSH
             if (!tx.wit.IsNull() && fRequireStandard && !IsWitnessStandard(tx, view)) {
-                LogPrintf("cause by -> IsWitnessStandard\n");
+                LogPrint("mempool", "cause by -> IsWitnessStandard\n");
                 return state.DoS(0, false, REJECT_NONSTANDARD, "bad-witness-nonstandard", true);
             }
             int64_t nSigOpsCost = GetTransactionSigOpCost(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
@@ -1361,7 +1363,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
             // int64_t txMinFee = tx.GetMinFee(1000, true, GMF_RELAY);
             int64_t txMinFee = 0;
             if (fLimitFree && nFees < txMinFee) {
-                LogPrintf("not enough fee, nFees=%d, txMinFee=%d\n", nFees, txMinFee);
+                LogPrint("mempool", "not enough fee, nFees=%d, txMinFee=%d\n", nFees, txMinFee);
                 return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "not enough fee", false, strprintf("nFees=%d, txMinFee=%d", nFees, txMinFee));
             }
             unsigned int nSize = entry.GetTxSize();
@@ -1408,7 +1410,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
                 // -limitfreerelay unit is thousand-bytes-per-minute
                 // At default rate it would take over a month to fill 1GB
                 if (dFreeCount + nSize >= GetArg("-limitfreerelay", DEFAULT_LIMITFREERELAY) * 10 * 1000) {
-                    LogPrintf("cause by -> rate limited free transaction\n");
+                    LogPrint("mempool", "cause by -> rate limited free transaction\n");
                     return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "rate limited free transaction");
                 }
                 LogPrint("mempool", "Rate limit dFreeCount: %g => %g\n", dFreeCount, dFreeCount + nSize);
@@ -1430,7 +1432,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
             std::string errString;
             if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants,
                                                 nLimitDescendantSize, errString)) {
-                LogPrintf("cause by -> too-long-mempool-chain\n");
+                LogPrint("mempool", "cause by -> too-long-mempool-chain\n");
                 return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, errString);
             }
 
@@ -1442,7 +1444,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
             {
                 const uint256 &hashAncestor = ancestorIt->GetTx().GetHash();
                 if (setConflicts.count(hashAncestor)) {
-                    LogPrintf("cause by -> bad-txns-spends-conflicting-tx\n");
+                    LogPrint("mempool", "cause by -> bad-txns-spends-conflicting-tx\n");
                     return state.DoS(10, false,
                                      REJECT_INVALID, "bad-txns-spends-conflicting-tx", false,
                                      strprintf("%s spends conflicting transaction %s",
@@ -1591,7 +1593,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
                 //                // Only the witness is missing, so the transaction itself may be fine.
                 //                state.SetCorruptionPossible();
                 //            }
-                LogPrintf("CheckInputs --> Failed!\n");
+                LogPrint("mempool", "CheckInputs --> Failed!\n");
                 return false;
             }
 
@@ -1652,7 +1654,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool &pool, CValidationState &state, const C
     }
 
     SyncWithWallets(tx, NULL, NULL);
-    LogPrintf("AcceptToMemoryPoolWorker -> OK\n");
+    LogPrint("mempool", "AcceptToMemoryPoolWorker -> OK\n");
 
     return true;
 }
@@ -1763,7 +1765,7 @@ bool WriteBlockToDisk(const CBlock &block, CDiskBlockPos &pos, const CMessageHea
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos, int nHeight, const Consensus::Params &consensusParams) {
+static bool ReadBlockDataFromDisk(CBlock &block, const CDiskBlockPos &pos) {
     block.SetNull();
 
     // Open history file to read
@@ -1778,23 +1780,155 @@ bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos, int nHeight, con
     catch (const std::exception &e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
+    return true;
+}
+
+bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos, int nHeight, const Consensus::Params &consensusParams) {
+    if (!ReadBlockDataFromDisk(block, pos))
+        return false;
     // Check the header
-    if (!CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams,nHeight))
+    uint256 powHash = block.GetPoWHash(nHeight);
+    if (!CheckProofOfWork(powHash, block.nBits, consensusParams,nHeight))
         if(nHeight > ZPOW_ERR || nHeight == INT_MAX)
             return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
+    if (nHeight != INT_MAX)
+        block.SetPoWHash(powHash);
     return true;
 }
 
 bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex, const Consensus::Params &consensusParams) {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), pindex->nHeight, consensusParams))
+    // The PoW hash stored with the index was computed when the header was first
+    // validated, so only recompute it when it is unknown or -checkpowondisk is set.
+    bool fStoredPoW = !fCheckPoWOnDisk && !pindex->hashPoW.IsNull();
+    if (fStoredPoW) {
+        if (!ReadBlockDataFromDisk(block, pindex->GetBlockPos()))
+            return false;
+    } else if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), pindex->nHeight, consensusParams))
         return false;
     if (block.GetHash() != pindex->GetBlockHash()) {
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
                      pindex->ToString(), pindex->GetBlockPos().ToString());
     }
+    if (fStoredPoW) {
+        if (!CheckProofOfWork(pindex->hashPoW, block.nBits, consensusParams, pindex->nHeight))
+            if (pindex->nHeight > ZPOW_ERR)
+                return error("ReadBlockFromDisk: Errors in block header at %s", pindex->GetBlockPos().ToString());
+        block.SetPoWHash(pindex->hashPoW);
+    }
+    return true;
+}
+
+// Skip over the inputs of a serialized transaction
+static void SkipSerializedTxIns(CDataStream &ss, uint64_t nIn) {
+    for (uint64_t i = 0; i < nIn; i++) {
+        ss.ignore(36);                              // prevout
+        ss.ignore((int)ReadCompactSize(ss));        // scriptSig
+        ss.ignore(4);                               // nSequence
+    }
+}
+
+// Skip over a serialized transaction. Follows SerializeTransaction, so it throws wherever deserializing the
+// transaction would
+static void SkipSerializedTransaction(CDataStream &ss) {
+    ss.ignore(4);                                   // nVersion
+    uint64_t nIn = ReadCompactSize(ss);
+    unsigned char flags = 0;
+    bool fHasOuts = true;
+    if (nIn == 0) {
+        ss >> flags;
+        if (flags != 0)
+            nIn = ReadCompactSize(ss);
+        else
+            fHasOuts = false;
+    }
+    SkipSerializedTxIns(ss, nIn);
+    if (fHasOuts) {
+        uint64_t nOut = ReadCompactSize(ss);
+        for (uint64_t i = 0; i < nOut; i++) {
+            ss.ignore(8);                           // nValue
+            ss.ignore((int)ReadCompactSize(ss));    // scriptPubKey
+        }
+    }
+    if (flags & 1) {
+        flags ^= 1;
+        for (uint64_t i = 0; i < nIn; i++) {
+            uint64_t nStack = ReadCompactSize(ss);
+            for (uint64_t j = 0; j < nStack; j++)
+                ss.ignore((int)ReadCompactSize(ss));
+        }
+    }
+    if (flags)
+        throw std::ios_base::failure("Unknown transaction optional data");
+    ss.ignore(4);                                   // nLockTime
+}
+
+bool ReadRawBlockFromDisk(CSerializeData &vData, const CBlockIndex *pindex,
+                          const CMessageHeader::MessageStartChars &messageStart,
+                          const Consensus::Params &consensusParams) {
+    // Serialized size of a CBlockHeader, which is what the block hash covers
+    static const unsigned int BLOCK_HEADER_SIZE = 80;
+
+    // WriteBlockToDisk stores the network magic and the block size just before the block
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s: invalid block position %s", __func__, pos.ToString());
+    pos.nPos -= MESSAGE_START_SIZE + sizeof(unsigned int);
+
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+
+    CBlockHeader header;
+    try {
+        CMessageHeader::MessageStartChars blkStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blkStart) >> nSize;
+        if (memcmp(blkStart, messageStart, MESSAGE_START_SIZE))
+            return error("%s: block magic mismatch at %s", __func__, pindex->GetBlockPos().ToString());
+        if (nSize < BLOCK_HEADER_SIZE || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+            return error("%s: invalid block size %u at %s", __func__, nSize, pindex->GetBlockPos().ToString());
+        vData.resize(nSize);
+        filein.read(&vData[0], nSize);
+
+        // The size prefix must cover exactly the header and the transactions. Walking their lengths catches
+        // a wrong prefix whatever follows the block, including the zero padding at the end of the file
+        CDataStream ssBlock(vData.begin(), vData.end(), SER_DISK, CLIENT_VERSION);
+        ssBlock >> header;
+        uint64_t nTx = ReadCompactSize(ssBlock);
+        for (uint64_t i = 0; i < nTx; i++)
+            SkipSerializedTransaction(ssBlock);
+        if (!ssBlock.empty()) {
+            vData.clear();
+            return error("%s: block size %u does not match the data at %s", __func__, nSize,
+                         pindex->GetBlockPos().ToString());
+        }
+    }
+    catch (const std::exception &e) {
+        vData.clear();
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pindex->GetBlockPos().ToString());
+    }
+
+    // The transactions are passed on untouched; the header still has to be the one we indexed
+    if (header.GetHash() != pindex->GetBlockHash()) {
+        vData.clear();
+        return error("%s: GetHash() doesn't match index for %s at %s", __func__,
+                     pindex->ToString(), pindex->GetBlockPos().ToString());
+    }
+    uint256 powHash = (!fCheckPoWOnDisk && !pindex->hashPoW.IsNull()) ? pindex->hashPoW
+                                                                       : header.GetPoWHash(pindex->nHeight);
+    if (!CheckProofOfWork(powHash, header.nBits, consensusParams, pindex->nHeight) && pindex->nHeight > ZPOW_ERR) {
+        vData.clear();
+        return error("%s: Errors in block header at %s", __func__, pindex->GetBlockPos().ToString());
+    }
     return true;
 }
 
+bool IsRawBlockSerialization(const CBlockIndex *pindex, bool fWitness, const Consensus::Params &consensusParams) {
+    // Blocks are stored with their witness data, and blocks from before segwit
+    // activation are rejected if they carry any, so those read the same either way.
+    return fWitness || !IsWitnessEnabled(pindex->pprev, consensusParams);
+}
+
 
 
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params &consensusParams, int nTime) {
@@ -2396,6 +2530,14 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+// Every spend proof takes long enough to verify that it is handed out to workers one at a time
+static CCheckQueue<CZerocoinSpendCheck> zerocoinspendcheckqueue(1);
+
+void ThreadZerocoinSpendCheck() {
+    RenameThread("bitcoin-zcspend");
+    zerocoinspendcheckqueue.Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2709,6 +2851,9 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
     if (fJustCheck)
         return true;
 
+    // Remember who the coinbase paid, libernode last paid blocks are computed from it
+    mnpayeeindex.AddBlock(block, pindex);
+
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull() || !pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
         if (pindex->GetUndoPos().IsNull()) {
@@ -2969,6 +3114,7 @@ bool static DisconnectTip(CValidationState &state, const CChainParams &chainpara
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
 
     DisconnectTipZC(block, pindexDelete);
+    mnpayeeindex.RemoveBlock(pindexDelete);
 
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED))
@@ -3571,6 +3717,7 @@ CBlockIndex *AddToBlockIndex(const CBlockHeader &block) {
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
         pindexNew->BuildSkip();
     }
+    SetNextWorkRequired(pindexNew);
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
     if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)
@@ -3590,6 +3737,8 @@ bool ReceivedBlockTransactions(const CBlock &block, CValidationState &state, CBl
     pindexNew->nDataPos = pos.nPos;
     pindexNew->nUndoPos = 0;
     pindexNew->nStatus |= BLOCK_HAVE_DATA;
+    if (pindexNew->hashPoW.IsNull() && block.IsComputed())
+        pindexNew->hashPoW = block.powHash;
     if (IsWitnessEnabled(pindexNew->pprev, Params().GetConsensus())) {
         pindexNew->nStatus |= BLOCK_OPT_WITNESS;
     }
@@ -3724,9 +3873,15 @@ bool CheckBlockHeader(const CBlockHeader &block, CValidationState &state, const
     int nHeight = ZerocoinGetNHeight(block);
     if(Params().NetworkIDString() == CBaseChainParams::REGTEST)
         return true;
-    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams,nHeight)) {
-        if(nHeight > ZPOW_ERR || nHeight == INT_MAX)
-            return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+    if (fCheckPOW) {
+        // Reuse the hash if this header was already hashed (e.g. by CheckBlock, or read from disk)
+        uint256 powHash = block.IsComputed() ? block.powHash : block.GetPoWHash(nHeight);
+        if (!CheckProofOfWork(powHash, block.nBits, consensusParams,nHeight)) {
+            if(nHeight > ZPOW_ERR || nHeight == INT_MAX)
+                return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+        }
+        if (nHeight != INT_MAX)
+            block.SetPoWHash(powHash);
     }
 
     return true;
@@ -3826,13 +3981,21 @@ bool CheckBlock(const CBlock &block, CValidationState &state, const Consensus::P
         if (block.zerocoinTxInfo == NULL)
             block.zerocoinTxInfo = new CZerocoinTxInfo();
 
-        BOOST_FOREACH(const CTransaction &tx, block.vtx)
-        if (!CheckTransaction(tx, state, tx.GetHash(), isVerifyDB, nHeight, false, block.zerocoinTxInfo)) {
-            LogPrintf("block=%s\n", block.ToString());
-            return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
-                                 strprintf("Transaction check failed (tx hash %s) %s", tx.GetHash().ToString(),
-                                           state.GetDebugMessage()));
+        // Zerocoin spend proofs are verified in parallel on the -par threads, everything else stays serial
+        CCheckQueueControl<CZerocoinSpendCheck> control(nScriptCheckThreads ? &zerocoinspendcheckqueue : NULL);
+        BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+            std::vector<CZerocoinSpendCheck> vChecks;
+            if (!CheckTransaction(tx, state, tx.GetHash(), isVerifyDB, nHeight, false, block.zerocoinTxInfo,
+                                  nScriptCheckThreads ? &vChecks : NULL)) {
+                LogPrintf("block=%s\n", block.ToString());
+                return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
+                                     strprintf("Transaction check failed (tx hash %s) %s", tx.GetHash().ToString(),
+                                               state.GetDebugMessage()));
+            }
+            control.Add(vChecks);
         }
+        if (!control.Wait())
+            return state.DoS(0, false, REJECT_INVALID, "bad-zerocoin-spend", false, "zerocoin spend verification failed");
         block.zerocoinTxInfo->Complete();
 
         unsigned int nSigOps = 0;
@@ -4497,6 +4660,7 @@ bool static LoadBlockIndexDB() {
             pindexBestInvalid = pindex;
         if (pindex->pprev)
             pindex->BuildSkip();
+        SetNextWorkRequired(pindex);
         if (pindex->IsValid(BLOCK_VALID_TREE) &&
             (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
@@ -5368,53 +5532,63 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
                 // Pruned nodes may have deleted the block, so check whether
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block);
-                    else if (inv.type == MSG_WITNESS_BLOCK)
-                        pfrom->PushMessage(NetMsgType::BLOCK, block);
-                    else if (inv.type == MSG_FILTERED_BLOCK) {
-                        bool send = false;
-                        CMerkleBlock merkleBlock;
-                        {
-                            LOCK(pfrom->cs_filter);
-                            if (pfrom->pfilter) {
-                                send = true;
-                                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                    // Full blocks whose stored serialization is what the peer asked for are
+                    // sent straight from the block file, without deserializing them first
+                    CSerializeData vRawBlock;
+                    if ((inv.type == MSG_BLOCK || inv.type == MSG_WITNESS_BLOCK) &&
+                        IsRawBlockSerialization(mi->second, inv.type == MSG_WITNESS_BLOCK, consensusParams) &&
+                        ReadRawBlockFromDisk(vRawBlock, mi->second, Params().MessageStart(), consensusParams)) {
+                        pfrom->PushRawMessage(NetMsgType::BLOCK, vRawBlock);
+                    } else {
+                        // Send block from disk
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                            assert(!"cannot load block from disk");
+                        if (inv.type == MSG_BLOCK)
+                            pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block);
+                        else if (inv.type == MSG_WITNESS_BLOCK)
+                            pfrom->PushMessage(NetMsgType::BLOCK, block);
+                        else if (inv.type == MSG_FILTERED_BLOCK) {
+                            bool send = false;
+                            CMerkleBlock merkleBlock;
+                            {
+                                LOCK(pfrom->cs_filter);
+                                if (pfrom->pfilter) {
+                                    send = true;
+                                    merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                                }
                             }
+                            if (send) {
+                                pfrom->PushMessage(NetMsgType::MERKLEBLOCK, merkleBlock);
+                                // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+                                // This avoids hurting performance by pointlessly requiring a round-trip
+                                // Note that there is currently no way for a node to request any single transactions we didn't send here -
+                                // they must either disconnect and retry or request the full block.
+                                // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+                                // however we MUST always provide at least what the remote peer needs
+                                typedef std::pair<unsigned int, uint256> PairType;
+                                BOOST_FOREACH(PairType & pair, merkleBlock.vMatchedTxn)
+                                pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX,
+                                                           block.vtx[pair.first]);
+                            }
+                            // else
+                            // no response
+                        } else if (inv.type == MSG_CMPCT_BLOCK) {
+                            // If a peer is asking for old blocks, we're almost guaranteed
+                            // they wont have a useful mempool to match against a compact block,
+                            // and we don't feel like constructing the object for them, so
+                            // instead we respond with the full, non-compact block.
+                            bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
+                            if (CanDirectFetch(consensusParams) &&
+                                mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+                                CBlockHeaderAndShortTxIDs cmpctblock(block, fPeerWantsWitness);
+                                pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
+                                                           NetMsgType::CMPCTBLOCK, cmpctblock);
+                            } else
+                                pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
+                                                           NetMsgType::BLOCK, block);
                         }
-                        if (send) {
-                            pfrom->PushMessage(NetMsgType::MERKLEBLOCK, merkleBlock);
-                            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                            // This avoids hurting performance by pointlessly requiring a round-trip
-                            // Note that there is currently no way for a node to request any single transactions we didn't send here -
-                            // they must either disconnect and retry or request the full block.
-                            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                            // however we MUST always provide at least what the remote peer needs
-                            typedef std::pair<unsigned int, uint256> PairType;
-                            BOOST_FOREACH(PairType & pair, merkleBlock.vMatchedTxn)
-                            pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX,
-                                                       block.vtx[pair.first]);
-                        }
-                        // else
-                        // no response
-                    } else if (inv.type == MSG_CMPCT_BLOCK) {
-                        // If a peer is asking for old blocks, we're almost guaranteed
-                        // they wont have a useful mempool to match against a compact block,
-                        // and we don't feel like constructing the object for them, so
-                        // instead we respond with the full, non-compact block.
-                        bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
-                        if (CanDirectFetch(consensusParams) &&
-                            mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
-                            CBlockHeaderAndShortTxIDs cmpctblock(block, fPeerWantsWitness);
-                            pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
-                                                       NetMsgType::CMPCTBLOCK, cmpctblock);
-                        } else
-                            pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
-                                                       NetMsgType::BLOCK, block);
+
                     }
 
                     // Trigger the peer node to send a getblocks request for the next batch of inventory
@@ -5602,6 +5776,59 @@ uint32_t GetFetchFlags(CNode *pfrom, CBlockIndex *pprev, const Consensus::Params
     return nFetchFlags;
 }
 
+/**
+ * Compute the PoW hashes of a headers message on the shared parallel task pool before cs_main is taken, so
+ * AcceptBlockHeader finds them in the headers and only does the cheap checks under the lock. Only headers
+ * that are new and chained to a known block are hashed. Work is done in chunks and stops at the first
+ * header that fails PoW: the serial path rejects the message there anyway
+ */
+void PrecomputeHeadersPoW(const std::vector<CBlockHeader> &headers, const CChainParams &chainparams)
+{
+    if (headers.empty() || chainparams.NetworkIDString() == CBaseChainParams::REGTEST)
+        return;
+
+    std::vector<uint256> hashes(headers.size());
+    size_t nEnd = headers.size();
+    for (size_t i = 0; i < headers.size(); i++) {
+        hashes[i] = headers[i].GetHash();
+        if (i > 0 && headers[i].hashPrevBlock != hashes[i-1]) {
+            nEnd = i;
+            break;
+        }
+    }
+
+    // Heights must be the ones CheckBlockHeader will see, the first header fixes them for the whole chain
+    int nFirstHeight;
+    size_t nFirst = 0;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(headers[0].hashPrevBlock);
+        if (mi == mapBlockIndex.end())
+            return;
+        nFirstHeight = mi->second->nHeight + 1;
+        while (nFirst < nEnd && mapBlockIndex.count(hashes[nFirst]))
+            nFirst++;
+    }
+
+    const Consensus::Params &consensusParams = chainparams.GetConsensus();
+    const size_t nChunk = 4 * (size_t)std::max(GetNumCores(), 1);
+    while (nFirst < nEnd) {
+        size_t nCount = std::min(nChunk, nEnd - nFirst);
+        std::atomic<bool> fFailed(false);
+        libzerocoin::ParallelTasks::ParallelFor(nCount, [&headers, &consensusParams, &fFailed, nFirst, nFirstHeight](size_t i) {
+            const CBlockHeader &header = headers[nFirst + i];
+            int nHeight = nFirstHeight + (int)(nFirst + i);
+            uint256 powHash = header.GetPoWHash(nHeight);
+            header.SetPoWHash(powHash);
+            if (!CheckProofOfWork(powHash, header.nBits, consensusParams, nHeight))
+                fFailed = true;
+        });
+        if (fFailed)
+            break;
+        nFirst += nCount;
+    }
+}
+
 bool static ProcessMessage(CNode *pfrom, string strCommand, CDataStream &vRecv, int64_t nTimeReceived,
                            const CChainParams &chainparams) {
     if (mapArgs.count("-dropmessagestest") && GetRand(atoi(mapArgs["-dropmessagestest"])) == 0) {
@@ -6588,6 +6815,9 @@ bool static ProcessMessage(CNode *pfrom, string strCommand, CDataStream &vRecv,
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // Lyra2 is the expensive part of accepting headers, get it done on all cores without holding cs_main
+        PrecomputeHeadersPoW(headers, chainparams);
+
         {
             LOCK(cs_main);
 
@@ -6992,6 +7222,9 @@ bool ProcessMessages(CNode *pfrom) {
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return fOk;
 
+    // libernode lists arrive as bursts of announces and pings, verify their signatures in parallel
+    mnodeman.PrecheckSignatures(pfrom);
+
     std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.begin();
     while (!pfrom->fDisconnect && it != pfrom->vRecvMsg.end()) {
         // Don't bother if send buffer is too full to respond anyway
@@ -41,6 +41,7 @@ class CScriptCheck;
 class CTxMemPool;
 class CValidationInterface;
 class CValidationState;
+class CZerocoinSpendCheck;
 
 struct PrecomputedTransactionData;
 struct CNodeStateStats;
@@ -141,6 +142,8 @@ static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 /** Default for -permitbaremultisig */
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+/** Default for -checkpowondisk */
+static const bool DEFAULT_CHECKPOWONDISK = false;
 static const bool DEFAULT_TXINDEX = true;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
@@ -236,6 +239,8 @@ extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Recompute the PoW hash of blocks read from disk instead of trusting the one stored with the index */
+extern bool fCheckPoWOnDisk;
 //extern int nBestHeight;
 
 // Settings
@@ -324,6 +329,8 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the zerocoin spend checking thread */
+void ThreadZerocoinSpendCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -430,7 +437,7 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight);
 
 /** Context-independent validity checks */
 //BTZC: ADD params for libercoin works
-bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, int nHeight = INT_MAX, bool isCheckWallet = false, CZerocoinTxInfo *zerocoinTxInfo = NULL);
+bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, int nHeight = INT_MAX, bool isCheckWallet = false, CZerocoinTxInfo *zerocoinTxInfo = NULL, std::vector<CZerocoinSpendCheck> *pvChecks = NULL);
 //bool CheckTransaction(const CTransaction& tx, CValidationState& state);
 
 /**
@@ -523,11 +530,21 @@ public:
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/**
+ * Read the serialized bytes of a block exactly as stored in its blk*.dat file,
+ * checking only the header against the index. Used to serve blocks without
+ * deserializing and reserializing them.
+ */
+bool ReadRawBlockFromDisk(CSerializeData& vData, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart, const Consensus::Params& consensusParams);
+/** Whether the on-disk serialization of a block is what a reader asked for (with or without witness data) */
+bool IsRawBlockSerialization(const CBlockIndex* pindex, bool fWitness, const Consensus::Params& consensusParams);
 
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+/** Hash the new headers of a headers message on the parallel task pool, for CheckBlockHeader to reuse. Takes cs_main briefly */
+void PrecomputeHeadersPoW(const std::vector<CBlockHeader>& headers, const CChainParams& chainparams);
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, int nHeight = INT_MAX, bool isVerifyDB = false);
 
 /** Context-dependent validity checks.
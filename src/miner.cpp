@@ -987,7 +987,7 @@ static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainpar
     return true;
 }
 
-void static ZcoinMiner(const CChainParams &chainparams) {
+void static ZcoinMiner(const CChainParams &chainparams, int nThread, int nThreads, unsigned int nLanes) {
     SetThreadPriority(THREAD_PRIORITY_LOWEST);
     RenameThread("libercoin-miner");
 
@@ -996,7 +996,16 @@ void static ZcoinMiner(const CChainParams &chainparams) {
     boost::shared_ptr<CReserveScript> coinbaseScript;
     GetMainSignals().ScriptForMining(coinbaseScript);
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
+    // Nonces tried by this thread. Threads work on their own slice of the nonce space so they never repeat
+    // each other's work when they happen to build the same block
+    const uint64_t nNonceBegin = ((uint64_t)nThread << 32) / nThreads;
+    const uint64_t nNonceEnd = ((uint64_t)(nThread + 1) << 32) / nThreads;
+    // Lyra2 memory matrices reused for every nonce tried by this thread, one per lane
+    CLyra2Scratchpad scratchpad(330, 256, true, nLanes);
     try {
+        if (!scratchpad.IsValid())
+            throw std::runtime_error("LibercoinMiner() : Out of memory");
+
         // Throw an error if no script was provided.  This can happen
         // due to some internal error but also if the keypool is empty.
         // In the latter case, already the pointer is NULL.
@@ -1005,6 +1014,16 @@ void static ZcoinMiner(const CChainParams &chainparams) {
             throw std::runtime_error("No coinbase script available (mining requires a wallet)");
         }
 
+        // Headers and hashes of the nonces tried in one pass
+        CBlockHeader laneHeaders[LYRA2_MAX_LANES];
+        uint256 laneHashes[LYRA2_MAX_LANES];
+        void *laneOutput[LYRA2_MAX_LANES];
+        const void *laneInput[LYRA2_MAX_LANES];
+        for (unsigned int l = 0; l < nLanes; l++) {
+            laneOutput[l] = BEGIN(laneHashes[l]);
+            laneInput[l] = BEGIN(laneHeaders[l].nVersion);
+        }
+
         while (true) {
             if (chainparams.MiningRequiresPeers()) {
                 // Busy-wait for the network to come online so we don't waste time mining
@@ -1045,6 +1064,8 @@ void static ZcoinMiner(const CChainParams &chainparams) {
             // Search
             //
             int64_t nStart = GetTime();
+            int64_t nLastPoll = GetTimeMillis();
+            uint64_t nNonce = nNonceBegin;
             arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
             LogPrintf("hashTarget: %s\n", hashTarget.ToString());
             LogPrintf("fTestnet: %d\n", fTestNet);
@@ -1053,49 +1074,57 @@ void static ZcoinMiner(const CChainParams &chainparams) {
             LogPrintf("pblock->nVersion: %s\n", pblock->nVersion);
             LogPrintf("pblock->nTime: %s\n", pblock->nTime);
             while (true) {
-                // Check if something found
-                uint256 thash;
-
-                while (true) {
-
-                    LYRA2(BEGIN(thash), 32, BEGIN(pblock->nVersion), 80, BEGIN(pblock->nVersion), 80, 2, 330, 256);
-                    //LogPrintf("*****\nhash   : %s  \ntarget : %s\n", UintToArith256(thash).ToString(), hashTarget.ToString());
+                // Hash the next nLanes nonces of the slice in one pass
+                unsigned int nBatch = (unsigned int)std::min<uint64_t>(nLanes, nNonceEnd - nNonce);
+                for (unsigned int l = 0; l < nBatch; l++) {
+                    laneHeaders[l] = pblock->GetBlockHeader();
+                    laneHeaders[l].nNonce = (uint32_t)(nNonce + l);
+                }
+                if (scratchpad.HashLanes(nBatch, laneOutput, 32, laneInput, 80, laneInput, 80, 2) != 0) {
+                    LogPrintf("LibercoinMiner() : Out of memory\n");
+                    throw std::runtime_error("LibercoinMiner() : Out of memory");
+                }
 
-                    if (thash.IsNull())
-                    {
-                        LogPrintf("LibercoinMiner() : Out of memory\n");
-                        throw std::runtime_error("LibercoinMiner() : Out of memory");
-                    }
-                    if (UintToArith256(thash) <= hashTarget) {
-                        // Found a solution
-                        LogPrintf("Found a solution. Hash: %s", UintToArith256(thash).ToString());
-                        SetThreadPriority(THREAD_PRIORITY_NORMAL);
-//                        CheckWork(pblock, *pwallet, reservekey);
-                        LogPrintf("LibercoinMiner:\n");
-                        LogPrintf("proof-of-work found  \n  hash: %s  \ntarget: %s\n", UintToArith256(thash).ToString(), hashTarget.ToString());
-                        ProcessBlockFound(pblock, chainparams);
-                        SetThreadPriority(THREAD_PRIORITY_LOWEST);
-                        coinbaseScript->KeepScript();
-                        // In regression test mode, stop mining after a block is found.
-                        if (chainparams.MineBlocksOnDemand())
-                            throw boost::thread_interrupted();
-                        break;
-                    }
-                    pblock->nNonce += 1;
-                    if ((pblock->nNonce % 5) == 0)
-                        break;
+                int nFound = -1;
+                for (unsigned int l = 0; l < nBatch && nFound < 0; l++)
+                    if (UintToArith256(laneHashes[l]) <= hashTarget)
+                        nFound = l;
+
+                if (nFound >= 0) {
+                    // Found a solution
+                    uint256 thash = laneHashes[nFound];
+                    pblock->nNonce = laneHeaders[nFound].nNonce;
+                    LogPrintf("Found a solution. Hash: %s", UintToArith256(thash).ToString());
+                    SetThreadPriority(THREAD_PRIORITY_NORMAL);
+                    LogPrintf("LibercoinMiner:\n");
+                    LogPrintf("proof-of-work found  \n  hash: %s  \ntarget: %s\n", UintToArith256(thash).ToString(), hashTarget.ToString());
+                    ProcessBlockFound(pblock, chainparams);
+                    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+                    coinbaseScript->KeepScript();
+                    // In regression test mode, stop mining after a block is found.
+                    if (chainparams.MineBlocksOnDemand())
+                        throw boost::thread_interrupted();
+                    break;
                 }
+                nNonce += nBatch;
+
                 // Check for stop or if block needs to be rebuilt
                 boost::this_thread::interruption_point();
+                if (nNonce >= nNonceEnd)
+                    break;
+                if (pindexPrev != chainActive.Tip())
+                    break;
+
+                // The remaining checks take locks, run them about once a second
+                if (GetTimeMillis() - nLastPoll < 1000)
+                    continue;
+                nLastPoll = GetTimeMillis();
+
                 // Regtest mode doesn't require peers
                 if (vNodes.empty() && chainparams.MiningRequiresPeers())
                     break;
-                if (pblock->nNonce >= 0xffff0000)
-                    break;
                 if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 60)
                     break;
-                if (pindexPrev != chainActive.Tip())
-                    break;
 
                 // Update nTime every few seconds
                 if (UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev) < 0)
@@ -1135,9 +1164,11 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
     if (nThreads == 0 || !fGenerate)
         return;
 
+    unsigned int nLanes = (unsigned int)std::max(1, std::min((int)GetArg("-genlanes", DEFAULT_GENERATE_LANES), LYRA2_MAX_LANES));
+
     minerThreads = new boost::thread_group();
     for (int i = 0; i < nThreads; i++)
-        minerThreads->create_thread(boost::bind(&ZcoinMiner, boost::cref(chainparams)));
+        minerThreads->create_thread(boost::bind(&ZcoinMiner, boost::cref(chainparams), i, nThreads, nLanes));
 }
 
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
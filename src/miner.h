@@ -24,6 +24,8 @@ namespace Consensus { struct Params; };
 
 static const bool DEFAULT_GENERATE = false;
 static const int DEFAULT_GENERATE_THREADS = 1;
+// Nonces hashed together by every miner thread (-genlanes)
+static const int DEFAULT_GENERATE_LANES = 1;
 
 static const bool DEFAULT_PRINTPRIORITY = false;
 
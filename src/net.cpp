@@ -26,9 +26,16 @@
 #else
 
 #include <fcntl.h>
+#include <sys/uio.h>
 
 #endif
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+#define USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -47,6 +54,20 @@
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
+// Longest ThreadSocketHandler waits (in milliseconds) while it has to poll: select() for
+// newly queued sends, edge triggered backends for peers with unread or unsent data left
+#define SOCKET_POLL_INTERVAL 50
+
+// Longest an edge triggered backend waits without any socket event, which bounds how late
+// timeouts and disconnects are handled
+#define SOCKET_HOUSEKEEPING_INTERVAL 1000
+
+// Reads from one peer per wakeup with an edge triggered backend, before others get a turn
+#define MAX_SOCKET_READS_PER_WAKEUP 8
+
+// Socket events returned by one epoll_wait() call
+#define MAX_EPOLL_EVENTS 256
+
 #if !defined(HAVE_MSG_NOSIGNAL) && !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
 #endif
@@ -112,6 +133,332 @@ NodeId nLastNodeId = 0;
 CCriticalSection cs_nLastNodeId;
 
 static CSemaphore *semOutbound = NULL;
+
+// -dropmessagestest and -fuzzmessagestest, read once by StartNode (0 = off)
+static int nDropMessagesTest = 0;
+static int nFuzzMessagesTest = 0;
+
+SocketEventsMode nSocketEventsMode = GetDefaultSocketEventsMode();
+
+SocketEventsMode GetDefaultSocketEventsMode() {
+#ifdef USE_EPOLL
+    return SOCKETEVENTS_EPOLL;
+#else
+    return SOCKETEVENTS_SELECT;
+#endif
+}
+
+std::string GetSocketEventsModeName(SocketEventsMode mode) {
+    switch (mode) {
+        case SOCKETEVENTS_SELECT:
+            return "select";
+        case SOCKETEVENTS_EPOLL:
+            return "epoll";
+    }
+    return "unknown";
+}
+
+bool ParseSocketEventsMode(const std::string &strMode, SocketEventsMode &mode) {
+    if (strMode == "select") {
+        mode = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef USE_EPOLL
+    if (strMode == "epoll") {
+        mode = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+// Whether the socket event backend is able to watch this socket
+static bool IsWatchableSocket(SOCKET hSocket) {
+    return nSocketEventsMode != SOCKETEVENTS_SELECT || IsSelectableSocket(hSocket);
+}
+
+/**
+ * How ThreadSocketHandler waits for its sockets. The select() backend rebuilds
+ * its fd sets from vNodes on every call; the epoll backend keeps the sockets
+ * registered and only reports readiness when it changes (edge triggered).
+ */
+class CSocketEvents {
+public:
+    virtual ~CSocketEvents() {}
+
+    /** Start watching the socket of a peer that was added to vNodes */
+    virtual void AddNode(CNode *pnode) {}
+
+    /** Stop watching the socket of a peer; called right before the socket is closed */
+    virtual void RemoveNode(CNode *pnode) {}
+
+    /** Start watching vhListenSocket, once all the listening sockets are bound */
+    virtual void WatchListenSockets() {}
+
+    /**
+     * Wait at most nTimeout milliseconds. Listening sockets with a pending connection are
+     * returned in vAccept, and peers whose socket can be read or written in vRecv and vSend.
+     * Returns true if the wait was cut short by Wake().
+     */
+    virtual bool Wait(int64_t nTimeout, std::vector<const ListenSocket *> &vAccept,
+                      std::vector<CNode *> &vRecv, std::vector<CNode *> &vSend) = 0;
+
+    /** Cut a Wait() in progress short; may be called from any thread */
+    virtual void Wake() {}
+
+    /** Whether a socket is only reported again after its state changed, so work left undone has to be retried */
+    virtual bool IsEdgeTriggered() const { return false; }
+};
+
+class CSocketEventsSelect : public CSocketEvents {
+public:
+    bool Wait(int64_t nTimeout, std::vector<const ListenSocket *> &vAccept,
+              std::vector<CNode *> &vRecv, std::vector<CNode *> &vSend) {
+        struct timeval timeout = MillisToTimeval(nTimeout);
+
+        fd_set fdsetRecv;
+        fd_set fdsetSend;
+        fd_set fdsetError;
+        FD_ZERO(&fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        SOCKET hSocketMax = 0;
+        bool have_fds = false;
+
+        BOOST_FOREACH(
+        const ListenSocket &hListenSocket, vhListenSocket) {
+            FD_SET(hListenSocket.socket, &fdsetRecv);
+            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
+            have_fds = true;
+        }
+
+        {
+            LOCK(cs_vNodes);
+            BOOST_FOREACH(CNode * pnode, vNodes)
+            {
+                if (pnode->hSocket == INVALID_SOCKET)
+                    continue;
+                FD_SET(pnode->hSocket, &fdsetError);
+                hSocketMax = std::max(hSocketMax, pnode->hSocket);
+                have_fds = true;
+
+                // Implement the following logic:
+                // * If there is data to send, select() for sending data. As this only
+                //   happens when optimistic write failed, we choose to first drain the
+                //   write buffer in this case before receiving more. This avoids
+                //   needlessly queueing received data, if the remote peer is not themselves
+                //   receiving data. This means properly utilizing TCP flow control signalling.
+                // * Otherwise, if there is no (complete) message in the receive buffer,
+                //   or there is space left in the buffer, select() for receiving data.
+                // * (if neither of the above applies, there is certainly one message
+                //   in the receiver buffer ready to be processed).
+                // Together, that means that at least one of the following is always possible,
+                // so we don't deadlock:
+                // * We send some data.
+                // * We wait for data to be received (and disconnect after timeout).
+                // * We process a message in the buffer (message handler thread).
+                {
+                    TRY_LOCK(pnode->cs_vSend, lockSend);
+                    if (lockSend && !pnode->vSendMsg.empty()) {
+                        FD_SET(pnode->hSocket, &fdsetSend);
+                        continue;
+                    }
+                }
+                {
+                    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                    if (lockRecv && (
+                            pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+                            pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
+                        FD_SET(pnode->hSocket, &fdsetRecv);
+                }
+            }
+        }
+
+        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        boost::this_thread::interruption_point();
+
+        if (nSelect == SOCKET_ERROR) {
+            if (have_fds) {
+                int nErr = WSAGetLastError();
+                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+                for (unsigned int i = 0; i <= hSocketMax; i++)
+                    FD_SET(i, &fdsetRecv);
+            }
+            FD_ZERO(&fdsetSend);
+            FD_ZERO(&fdsetError);
+            MilliSleep(nTimeout);
+        }
+
+        BOOST_FOREACH(
+        const ListenSocket &hListenSocket, vhListenSocket)
+        {
+            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+                vAccept.push_back(&hListenSocket);
+        }
+
+        {
+            LOCK(cs_vNodes);
+            BOOST_FOREACH(CNode * pnode, vNodes)
+            {
+                if (pnode->hSocket == INVALID_SOCKET)
+                    continue;
+                if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError))
+                    vRecv.push_back(pnode);
+                if (FD_ISSET(pnode->hSocket, &fdsetSend))
+                    vSend.push_back(pnode);
+            }
+        }
+        return false;
+    }
+};
+
+#ifdef USE_EPOLL
+class CSocketEventsEpoll : public CSocketEvents {
+private:
+    int hEpoll;
+    // eventfd that Wake() writes to; registered with a NULL data pointer
+    int hWakeEvent;
+
+    bool Watch(SOCKET hSocket, uint32_t nEvents, void *ptr) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = nEvents;
+        event.data.ptr = ptr;
+        return epoll_ctl(hEpoll, EPOLL_CTL_ADD, hSocket, &event) == 0;
+    }
+
+public:
+    CSocketEventsEpoll() : hEpoll(-1), hWakeEvent(-1) {}
+
+    ~CSocketEventsEpoll() {
+        if (hWakeEvent != -1)
+            close(hWakeEvent);
+        if (hEpoll != -1)
+            close(hEpoll);
+    }
+
+    bool Init() {
+        hEpoll = epoll_create1(EPOLL_CLOEXEC);
+        if (hEpoll == -1)
+            return error("%s: epoll_create1 failed: %s", __func__, NetworkErrorString(errno));
+        hWakeEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (hWakeEvent == -1)
+            return error("%s: eventfd failed: %s", __func__, NetworkErrorString(errno));
+        if (!Watch(hWakeEvent, EPOLLIN, NULL))
+            return error("%s: epoll_ctl failed: %s", __func__, NetworkErrorString(errno));
+        return true;
+    }
+
+    void WatchListenSockets() {
+        // Listening sockets stay level triggered, AcceptConnection takes one connection at a time
+        BOOST_FOREACH(ListenSocket & hListenSocket, vhListenSocket)
+        {
+            if (!Watch(hListenSocket.socket, EPOLLIN, &hListenSocket))
+                LogPrintf("socket epoll_ctl error %s, not accepting connections on a listening socket\n",
+                          NetworkErrorString(errno));
+        }
+    }
+
+    void AddNode(CNode *pnode) {
+        if (!Watch(pnode->hSocket, EPOLLIN | EPOLLOUT | EPOLLET, pnode)) {
+            LogPrintf("socket epoll_ctl error %s, disconnecting peer=%d\n", NetworkErrorString(errno), pnode->id);
+            pnode->CloseSocketDisconnect();
+        }
+    }
+
+    void RemoveNode(CNode *pnode) {
+        // Closing the socket is not enough: a forked child (-blocknotify and friends)
+        // may still hold it, and its events would keep pointing at this node
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        epoll_ctl(hEpoll, EPOLL_CTL_DEL, pnode->hSocket, &event);
+    }
+
+    bool Wait(int64_t nTimeout, std::vector<const ListenSocket *> &vAccept,
+              std::vector<CNode *> &vRecv, std::vector<CNode *> &vSend) {
+        struct epoll_event events[MAX_EPOLL_EVENTS];
+        int nEvents = epoll_wait(hEpoll, events, MAX_EPOLL_EVENTS, nTimeout);
+        if (nEvents == -1) {
+            if (errno != EINTR) {
+                LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(errno));
+                MilliSleep(nTimeout);
+            }
+            return false;
+        }
+
+        bool fWoken = false;
+        for (int i = 0; i < nEvents; i++) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == NULL) {
+                // Reset the counter, or the level triggered wake event keeps firing
+                uint64_t nCount;
+                ssize_t nRead = read(hWakeEvent, &nCount, sizeof(nCount));
+                (void)nRead;
+                fWoken = true;
+                continue;
+            }
+            bool fListenSocket = false;
+            BOOST_FOREACH(const ListenSocket & hListenSocket, vhListenSocket)
+            {
+                if (ptr == &hListenSocket) {
+                    vAccept.push_back(&hListenSocket);
+                    fListenSocket = true;
+                    break;
+                }
+            }
+            if (fListenSocket)
+                continue;
+
+            CNode *pnode = (CNode *) ptr;
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                vRecv.push_back(pnode);
+            if (events[i].events & EPOLLOUT)
+                vSend.push_back(pnode);
+        }
+        return fWoken;
+    }
+
+    void Wake() {
+        // Only fails when the counter is about to overflow, which wakes the handler as well
+        uint64_t nCount = 1;
+        ssize_t nWritten = write(hWakeEvent, &nCount, sizeof(nCount));
+        (void)nWritten;
+    }
+
+    bool IsEdgeTriggered() const { return true; }
+};
+#endif
+
+// Created by InitSocketEvents, before any socket is bound or connected
+static CSocketEvents *pSocketEvents = NULL;
+
+bool InitSocketEvents(bool fFallback) {
+    assert(pSocketEvents == NULL);
+#ifdef USE_EPOLL
+    if (nSocketEventsMode == SOCKETEVENTS_EPOLL) {
+        CSocketEventsEpoll *pSocketEventsEpoll = new CSocketEventsEpoll();
+        if (pSocketEventsEpoll->Init())
+            pSocketEvents = pSocketEventsEpoll;
+        else {
+            delete pSocketEventsEpoll;
+            if (!fFallback)
+                return false;
+            LogPrintf("Could not set up epoll, falling back to select() for socket events\n");
+            nSocketEventsMode = SOCKETEVENTS_SELECT;
+        }
+    }
+#endif
+    if (pSocketEvents == NULL)
+        pSocketEvents = new CSocketEventsSelect();
+    LogPrintf("Using %s for socket events\n", GetSocketEventsModeName(nSocketEventsMode));
+    return true;
+}
+
+void WakeSocketHandler() {
+    if (pSocketEvents)
+        pSocketEvents->Wake();
+}
 boost::condition_variable messageHandlerCondition;
 
 // Signals for message handling
@@ -385,7 +732,7 @@ CNode *ConnectNode(CAddress addrConnect, const char *pszDest, bool fCountFailure
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout,
                                       &proxyConnectionFailed) :
         ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed)) {
-        if (!IsSelectableSocket(hSocket)) {
+        if (!IsWatchableSocket(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -426,6 +773,8 @@ CNode *ConnectNode(CAddress addrConnect, const char *pszDest, bool fCountFailure
             LOCK(cs_vNodes);
             vNodes.push_back(pnode);
         }
+        if (pSocketEvents)
+            pSocketEvents->AddNode(pnode);
 
         pnode->nServicesExpected = ServiceFlags(addrConnect.nServices & nRelevantServices);
         pnode->nTimeConnected = GetTime();
@@ -464,6 +813,8 @@ void CNode::CloseSocketDisconnect() {
     fDisconnect = true;
     if (hSocket != INVALID_SOCKET) {
         LogPrint("net", "disconnecting peer=%d\n", id);
+        if (pSocketEvents)
+            pSocketEvents->RemoveNode(this);
         CloseSocket(hSocket);
     }
 
@@ -660,9 +1011,14 @@ void CNode::copyStats(CNodeStats &stats) {
     X(fInbound);
     X(nStartingHeight);
     X(nSendBytes);
-    X(mapSendBytesPerMsgCmd);
     X(nRecvBytes);
-    X(mapRecvBytesPerMsgCmd);
+    const std::vector<std::string> &allMessages = getAllNetMessageTypes();
+    for (size_t i = 0; i < allMessages.size(); i++) {
+        stats.mapSendBytesPerMsgCmd[allMessages[i]] = vSendBytesPerMsgCmd[i];
+        stats.mapRecvBytesPerMsgCmd[allMessages[i]] = vRecvBytesPerMsgCmd[i];
+    }
+    stats.mapSendBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = vSendBytesPerMsgCmd[allMessages.size()];
+    stats.mapRecvBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = vRecvBytesPerMsgCmd[allMessages.size()];
     X(fWhitelisted);
 
     // It is common for nodes with good ping times to suddenly become lagged,
@@ -720,11 +1076,8 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes) {
 
             //store received bytes per message command
             //to prevent a memory DOS, only allow valid commands
-            mapMsgCmdSize::iterator i = mapRecvBytesPerMsgCmd.find(msg.hdr.pchCommand);
-            if (i == mapRecvBytesPerMsgCmd.end())
-                i = mapRecvBytesPerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
-            assert(i != mapRecvBytesPerMsgCmd.end());
-            i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
+            vRecvBytesPerMsgCmd[GetNetMessageTypeIndex(msg.hdr.pchCommand)] +=
+                    msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
 
             msg.nTime = GetTimeMicros();
             messageHandlerCondition.notify_one();
@@ -780,25 +1133,75 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes) {
 }
 
 
+// Keep an emptied send buffer for the node's next messages, unless the pool is
+// full or the buffer grew too large to be worth holding on to.
 // requires LOCK(cs_vSend)
-void SocketSendData(CNode *pnode) {
+static void RecycleSendBuffer(CNode *pnode, CSerializeData &data) {
+    if (pnode->vSendBufferPool.size() >= MAX_SEND_BUFFER_POOL || data.capacity() > MAX_POOLED_SEND_BUFFER_SIZE)
+        return;
+    data.clear();
+    pnode->vSendBufferPool.push_back(CSerializeData());
+    pnode->vSendBufferPool.back().swap(data);
+}
+
+// Send the queued buffers from it onwards, starting nSendOffset bytes into the
+// first one, gathering as many of them as possible into a single system call.
+static int SendQueuedBuffers(CNode *pnode, std::deque<CSerializeData>::const_iterator it) {
+#ifdef WIN32
+    return send(pnode->hSocket, &(*it)[pnode->nSendOffset], it->size() - pnode->nSendOffset,
+                MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+    struct iovec iov[MAX_SEND_IOVECS];
+    int nIov = 0;
+    size_t nOffset = pnode->nSendOffset;
+    for (; it != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS; ++it) {
+        iov[nIov].iov_base = (void *) &(*it)[nOffset];
+        iov[nIov].iov_len = it->size() - nOffset;
+        nOffset = 0;
+        nIov++;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = nIov;
+    return sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
+}
+
+// requires LOCK(cs_vSend)
+bool AdvanceSendQueue(CNode *pnode, size_t nBytes) {
+    // Step over the buffers that went out completely
     std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    while (nBytes > 0 && it != pnode->vSendMsg.end() && nBytes >= it->size() - pnode->nSendOffset) {
+        nBytes -= it->size() - pnode->nSendOffset;
+        pnode->nSendOffset = 0;
+        pnode->nSendSize -= it->size();
+        RecycleSendBuffer(pnode, *it);
+        it++;
+    }
+    pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
 
-    while (it != pnode->vSendMsg.end()) {
-        const CSerializeData &data = *it;
-        assert(data.size() > pnode->nSendOffset);
-        int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset,
-                          MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (pnode->vSendMsg.empty()) {
+        assert(nBytes == 0);
+        assert(pnode->nSendOffset == 0);
+        assert(pnode->nSendSize == 0);
+    }
+    if (nBytes == 0)
+        return true;
+    pnode->nSendOffset += nBytes;
+    return false;
+}
+
+// requires LOCK(cs_vSend)
+void SocketSendData(CNode *pnode) {
+    while (!pnode->vSendMsg.empty()) {
+        assert(pnode->vSendMsg.front().size() > pnode->nSendOffset);
+        int nBytes = SendQueuedBuffers(pnode, pnode->vSendMsg.begin());
         if (nBytes > 0) {
             pnode->nLastSend = GetTime();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             pnode->RecordBytesSent(nBytes);
-            if (pnode->nSendOffset == data.size()) {
-                pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                it++;
-            } else {
+            if (!AdvanceSendQueue(pnode, nBytes)) {
                 // could not send full message; stop sending more
                 break;
             }
@@ -815,12 +1218,6 @@ void SocketSendData(CNode *pnode) {
             break;
         }
     }
-
-    if (it == pnode->vSendMsg.end()) {
-        assert(pnode->nSendOffset == 0);
-        assert(pnode->nSendSize == 0);
-    }
-    pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
 }
 
 static std::list<CNode *> vNodesDisconnected;
@@ -1000,7 +1397,7 @@ static void AcceptConnection(const ListenSocket &hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket)) {
+    if (!IsWatchableSocket(hSocket)) {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
         return;
@@ -1040,173 +1437,229 @@ static void AcceptConnection(const ListenSocket &hListenSocket) {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
     }
+    if (pSocketEvents)
+        pSocketEvents->AddNode(pnode);
+}
+
+// Read what a peer has sent into its receive buffer. With nMaxReads above one, keep
+// reading until the socket is drained, the receive buffer is full or nMaxReads is
+// reached, and return whether data may be left on the socket.
+// requires LOCK(cs_vRecvMsg)
+static bool SocketRecvData(CNode *pnode, int nMaxReads) {
+    for (int i = 0; i < nMaxReads; i++) {
+        if (pnode->hSocket == INVALID_SOCKET)
+            return false;
+        if (i > 0 && pnode->GetTotalRecvSize() > ReceiveFloodSize())
+            return true;
+
+        // typical socket buffer is 8K-64K
+        char pchBuf[0x10000];
+        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+        if (nBytes > 0) {
+            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
+                pnode->CloseSocketDisconnect();
+            pnode->nLastRecv = GetTime();
+            pnode->nRecvBytes += nBytes;
+            pnode->RecordBytesRecv(nBytes);
+            // a short read means the socket has been drained
+            if (nBytes < (int) sizeof(pchBuf))
+                return false;
+        } else if (nBytes == 0) {
+            // socket closed gracefully
+            if (!pnode->fDisconnect)
+                LogPrint("net", "socket closed\n");
+            pnode->CloseSocketDisconnect();
+            return false;
+        } else {
+            // error
+            int nErr = WSAGetLastError();
+            if (nErr == WSAEINTR)
+                continue;
+            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINPROGRESS) {
+                if (!pnode->fDisconnect)
+                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+                pnode->CloseSocketDisconnect();
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether to read from a peer now, following the rules laid out in CSocketEventsSelect::Wait
+static bool ShouldReceive(CNode *pnode) {
+    {
+        TRY_LOCK(pnode->cs_vSend, lockSend);
+        if (lockSend && !pnode->vSendMsg.empty())
+            return false;
+    }
+    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+    return lockRecv && (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+                        pnode->GetTotalRecvSize() <= ReceiveFloodSize());
 }
 
 void ThreadSocketHandler() {
     unsigned int nPrevNodeCount = 0;
+    // An edge triggered backend reports a socket once per change, so peers that still have
+    // data waiting after their turn (receive buffer full, lock busy) are retried from here
+    const bool fEdgeTriggered = pSocketEvents->IsEdgeTriggered();
+    std::set<CNode *> setRecvPending;
+    std::set<CNode *> setSendPending;
+    std::vector<const ListenSocket *> vAccept;
+    std::vector<CNode *> vRecv;
+    std::vector<CNode *> vSend;
+    int64_t nNextHousekeeping = 0;
+    bool fWoken = false;
+    bool fRecvAgain = false;
     while (true) {
-        //
-        // Disconnect nodes
-        //
-        {
-            LOCK(cs_vNodes);
-            // Disconnect unused nodes
-            std::vector < CNode * > vNodesCopy = vNodes;
-            BOOST_FOREACH(CNode * pnode, vNodesCopy)
+        // select() looks at every peer on each pass anyway; with an edge triggered
+        // backend, passes without events are rare and the peers are checked once a second
+        bool fHousekeeping = !fEdgeTriggered || fWoken || GetTimeMillis() >= nNextHousekeeping;
+        if (fHousekeeping) {
+            nNextHousekeeping = GetTimeMillis() + SOCKET_HOUSEKEEPING_INTERVAL;
+
+            //
+            // Disconnect nodes
+            //
             {
-                if (pnode->fDisconnect ||
-                    (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() && pnode->nSendSize == 0 &&
-                     pnode->ssSend.empty())) {
-                    // remove from vNodes
-                    vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+                LOCK(cs_vNodes);
+                // Disconnect unused nodes
+                std::vector < CNode * > vNodesCopy = vNodes;
+                BOOST_FOREACH(CNode * pnode, vNodesCopy)
+                {
+                    if (pnode->fDisconnect ||
+                        (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() && pnode->nSendSize == 0 &&
+                         pnode->ssSend.empty())) {
+                        // remove from vNodes
+                        vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
 
-                    // release outbound grant (if any)
-                    pnode->grantOutbound.Release();
+                        // release outbound grant (if any)
+                        pnode->grantOutbound.Release();
 
-                    // close socket and cleanup
-                    pnode->CloseSocketDisconnect();
+                        // close socket and cleanup
+                        pnode->CloseSocketDisconnect();
+                        setRecvPending.erase(pnode);
+                        setSendPending.erase(pnode);
 
-                    // hold in disconnected pool until all refs are released
-                    if (pnode->fNetworkNode || pnode->fInbound)
-                        pnode->Release();
-                    vNodesDisconnected.push_back(pnode);
+                        // hold in disconnected pool until all refs are released
+                        if (pnode->fNetworkNode || pnode->fInbound)
+                            pnode->Release();
+                        vNodesDisconnected.push_back(pnode);
+                    }
                 }
             }
-        }
-        {
-            // Delete disconnected nodes
-            std::list < CNode * > vNodesDisconnectedCopy = vNodesDisconnected;
-            BOOST_FOREACH(CNode * pnode, vNodesDisconnectedCopy)
             {
-                // wait until threads are done using it
-                if (pnode->GetRefCount() <= 0) {
-                    bool fDelete = false;
-                    {
-                        TRY_LOCK(pnode->cs_vSend, lockSend);
-                        if (lockSend) {
-                            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                            if (lockRecv) {
-                                TRY_LOCK(pnode->cs_inventory, lockInv);
-                                if (lockInv)
-                                    fDelete = true;
+                // Delete disconnected nodes
+                std::list < CNode * > vNodesDisconnectedCopy = vNodesDisconnected;
+                BOOST_FOREACH(CNode * pnode, vNodesDisconnectedCopy)
+                {
+                    // wait until threads are done using it
+                    if (pnode->GetRefCount() <= 0) {
+                        bool fDelete = false;
+                        {
+                            TRY_LOCK(pnode->cs_vSend, lockSend);
+                            if (lockSend) {
+                                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                                if (lockRecv) {
+                                    TRY_LOCK(pnode->cs_inventory, lockInv);
+                                    if (lockInv)
+                                        fDelete = true;
+                                }
                             }
                         }
-                    }
-                    if (fDelete) {
-                        vNodesDisconnected.remove(pnode);
-                        delete pnode;
+                        if (fDelete) {
+                            vNodesDisconnected.remove(pnode);
+                            delete pnode;
+                        }
                     }
                 }
             }
-        }
-        if (vNodes.size() != nPrevNodeCount) {
-            nPrevNodeCount = vNodes.size();
-            uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
-        }
-
-        //
-        // Find which sockets have data to receive
-        //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH(
-        const ListenSocket &hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
+            if (vNodes.size() != nPrevNodeCount) {
+                nPrevNodeCount = vNodes.size();
+                uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
+            }
 
-        {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH(CNode * pnode, vNodes)
+            //
+            // Inactivity checking
+            //
+            std::vector < CNode * > vNodesCopy;
             {
-                if (pnode->hSocket == INVALID_SOCKET)
+                LOCK(cs_vNodes);
+                vNodesCopy = vNodes;
+                BOOST_FOREACH(CNode * pnode, vNodesCopy)
+                pnode->AddRef();
+            }
+            int64_t nTime = GetTime();
+            BOOST_FOREACH(CNode * pnode, vNodesCopy)
+            {
+                if (pnode->hSocket == INVALID_SOCKET || nTime - pnode->nTimeConnected <= 60)
                     continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
-                // * (if neither of the above applies, there is certainly one message
-                //   in the receiver buffer ready to be processed).
-                // Together, that means that at least one of the following is always possible,
-                // so we don't deadlock:
-                // * We send some data.
-                // * We wait for data to be received (and disconnect after timeout).
-                // * We process a message in the buffer (message handler thread).
-                {
-                    TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
-                    }
-                }
-                {
-                    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (
-                            pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                            pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
+                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
+                    LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0,
+                             pnode->nLastSend != 0, pnode->id);
+                    pnode->fDisconnect = true;
+                } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
+                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+                    pnode->fDisconnect = true;
+                } else if (nTime - pnode->nLastRecv >
+                           (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90 * 60)) {
+                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+                    pnode->fDisconnect = true;
+                } else if (pnode->nPingNonceSent &&
+                           pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
+                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+                    pnode->fDisconnect = true;
                 }
             }
+            {
+                LOCK(cs_vNodes);
+                BOOST_FOREACH(CNode * pnode, vNodesCopy)
+                pnode->Release();
+            }
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        //
+        // Find which sockets have data to receive
+        //
+        int64_t nTimeout = SOCKET_POLL_INTERVAL;
+        if (fRecvAgain)
+            nTimeout = 0;
+        else if (fEdgeTriggered && setRecvPending.empty() && setSendPending.empty())
+            nTimeout = std::max((int64_t) 0, std::min((int64_t) SOCKET_HOUSEKEEPING_INTERVAL, nNextHousekeeping - GetTimeMillis()));
+        vAccept.clear();
+        vRecv.clear();
+        vSend.clear();
+        fWoken = pSocketEvents->Wait(nTimeout, vAccept, vRecv, vSend);
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec / 1000);
-        }
-
         //
         // Accept new connections
         //
-        BOOST_FOREACH(
-        const ListenSocket &hListenSocket, vhListenSocket)
-        {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
-                AcceptConnection(hListenSocket);
-            }
-        }
+        BOOST_FOREACH(const ListenSocket *pListenSocket, vAccept)
+        AcceptConnection(*pListenSocket);
 
         //
         // Service each socket
         //
-        std::vector < CNode * > vNodesCopy;
+        if (fEdgeTriggered) {
+            vRecv.insert(vRecv.end(), setRecvPending.begin(), setRecvPending.end());
+            vSend.insert(vSend.end(), setSendPending.begin(), setSendPending.end());
+            setRecvPending.clear();
+            setSendPending.clear();
+            std::sort(vRecv.begin(), vRecv.end());
+            vRecv.erase(std::unique(vRecv.begin(), vRecv.end()), vRecv.end());
+            std::sort(vSend.begin(), vSend.end());
+            vSend.erase(std::unique(vSend.begin(), vSend.end()), vSend.end());
+        }
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH(CNode * pnode, vNodesCopy)
+            BOOST_FOREACH(CNode * pnode, vRecv)
+            pnode->AddRef();
+            BOOST_FOREACH(CNode * pnode, vSend)
             pnode->AddRef();
         }
-        BOOST_FOREACH(CNode * pnode, vNodesCopy)
+        fRecvAgain = false;
+        BOOST_FOREACH(CNode * pnode, vRecv)
         {
             boost::this_thread::interruption_point();
 
@@ -1215,75 +1668,41 @@ void ThreadSocketHandler() {
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
-                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv) {
-                    {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0) {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pnode->CloseSocketDisconnect();
-                            pnode->nLastRecv = GetTime();
-                            pnode->nRecvBytes += nBytes;
-                            pnode->RecordBytesRecv(nBytes);
-                        } else if (nBytes == 0) {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                LogPrint("net", "socket closed\n");
-                            pnode->CloseSocketDisconnect();
-                        } else if (nBytes < 0) {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR &&
-                                nErr != WSAEINPROGRESS) {
-                                if (!pnode->fDisconnect)
-                                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
+            if (fEdgeTriggered && !ShouldReceive(pnode)) {
+                setRecvPending.insert(pnode);
+                continue;
             }
+            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+            if (lockRecv) {
+                if (SocketRecvData(pnode, fEdgeTriggered ? MAX_SOCKET_READS_PER_WAKEUP : 1) && fEdgeTriggered) {
+                    setRecvPending.insert(pnode);
+                    // only out of turn, not waiting for the message handler: come back right away
+                    if (pnode->GetTotalRecvSize() <= ReceiveFloodSize())
+                        fRecvAgain = true;
+                }
+            } else if (fEdgeTriggered)
+                setRecvPending.insert(pnode);
+        }
+        BOOST_FOREACH(CNode * pnode, vSend)
+        {
+            boost::this_thread::interruption_point();
 
             //
             // Send
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend)) {
-                TRY_LOCK(pnode->cs_vSend, lockSend);
-                if (lockSend)
-                    SocketSendData(pnode);
-            }
-
-            //
-            // Inactivity checking
-            //
-            int64_t nTime = GetTime();
-            if (nTime - pnode->nTimeConnected > 60) {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
-                    LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0,
-                             pnode->nLastSend != 0, pnode->id);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastRecv >
-                           (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90 * 60)) {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                } else if (pnode->nPingNonceSent &&
-                           pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-            }
+            TRY_LOCK(pnode->cs_vSend, lockSend);
+            if (lockSend)
+                SocketSendData(pnode);
+            else if (fEdgeTriggered)
+                setSendPending.insert(pnode);
         }
         {
             LOCK(cs_vNodes);
-            BOOST_FOREACH(CNode * pnode, vNodesCopy)
+            BOOST_FOREACH(CNode * pnode, vRecv)
+            pnode->Release();
+            BOOST_FOREACH(CNode * pnode, vSend)
             pnode->Release();
         }
     }
@@ -1839,7 +2258,7 @@ bool BindListenPort(const CService &addrBind, std::string &strError, bool fWhite
         LogPrintf("%s\n", strError);
         return false;
     }
-    if (!IsSelectableSocket(hListenSocket)) {
+    if (!IsWatchableSocket(hListenSocket)) {
         strError = "Error: Couldn't create a listenable socket for incoming connections";
         LogPrintf("%s\n", strError);
         return false;
@@ -1962,6 +2381,10 @@ void static Discover(boost::thread_group &threadGroup) {
 }
 
 void StartNode(boost::thread_group &threadGroup, CScheduler &scheduler) {
+    // The -*messagestest options are checked for every message sent, so look them up only once
+    nDropMessagesTest = mapArgs.count("-dropmessagestest") ? std::max(1, (int) GetArg("-dropmessagestest", 2)) : 0;
+    nFuzzMessagesTest = mapArgs.count("-fuzzmessagestest") ? std::max(1, (int) GetArg("-fuzzmessagestest", 10)) : 0;
+
     uiInterface.InitMessage(_("Loading addresses..."));
     // Load addresses from peers.dat
     int64_t nStart = GetTimeMillis();
@@ -2021,6 +2444,10 @@ void StartNode(boost::thread_group &threadGroup, CScheduler &scheduler) {
     // Map ports with UPnP
     MapPort(GetBoolArg("-upnp", DEFAULT_UPNP));
 
+    // The mode can't change any more: listening sockets were bound and connections counted for it
+    assert(pSocketEvents != NULL);
+    pSocketEvents->WatchListenSockets();
+
     // Send and receive from sockets, accept connections
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "net", &ThreadSocketHandler));
 
@@ -2078,6 +2505,8 @@ public:
         semOutbound = NULL;
         delete pnodeLocalHost;
         pnodeLocalHost = NULL;
+        delete pSocketEvents;
+        pSocketEvents = NULL;
 
 #ifdef WIN32
         // Shutdown Windows Sockets
@@ -2400,10 +2829,9 @@ CNode::CNode(SOCKET hSocketIn, const CAddress &addrIn, const std::string &addrNa
     // libernode
     fLibernode = false;
 
-    BOOST_FOREACH(
-    const std::string &msg, getAllNetMessageTypes())
-    mapRecvBytesPerMsgCmd[msg] = 0;
-    mapRecvBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
+    // One counter per known command, plus the last one for everything else
+    vSendBytesPerMsgCmd.assign(getAllNetMessageTypes().size() + 1, 0);
+    vRecvBytesPerMsgCmd.assign(getAllNetMessageTypes().size() + 1, 0);
 
     {
         LOCK(cs_nLastNodeId);
@@ -2484,13 +2912,13 @@ void CNode::EndMessage(const char *pszCommand) UNLOCK_FUNCTION(cs_vSend) {
     // The -*messagestest options are intentionally not documented in the help message,
     // since they are only used during development to debug the networking code and are
     // not intended for end-users.
-    if (mapArgs.count("-dropmessagestest") && GetRand(GetArg("-dropmessagestest", 2)) == 0) {
+    if (nDropMessagesTest && GetRand(nDropMessagesTest) == 0) {
         LogPrint("net", "dropmessages DROPPING SEND MESSAGE\n");
         AbortMessage();
         return;
     }
-    if (mapArgs.count("-fuzzmessagestest"))
-        Fuzz(GetArg("-fuzzmessagestest", 10));
+    if (nFuzzMessagesTest)
+        Fuzz(nFuzzMessagesTest);
 
     if (ssSend.size() == 0) {
         LEAVE_CRITICAL_SECTION(cs_vSend);
@@ -2501,7 +2929,7 @@ void CNode::EndMessage(const char *pszCommand) UNLOCK_FUNCTION(cs_vSend) {
     WriteLE32((uint8_t * ) & ssSend[CMessageHeader::MESSAGE_SIZE_OFFSET], nSize);
 
     //log total amount of bytes per command
-    mapSendBytesPerMsgCmd[std::string(pszCommand)] += nSize + CMessageHeader::HEADER_SIZE;
+    vSendBytesPerMsgCmd[GetNetMessageTypeIndex(pszCommand)] += nSize + CMessageHeader::HEADER_SIZE;
 
     // Set the checksum
     uint256 hash = Hash(ssSend.begin() + CMessageHeader::HEADER_SIZE, ssSend.end());
@@ -2512,7 +2940,12 @@ void CNode::EndMessage(const char *pszCommand) UNLOCK_FUNCTION(cs_vSend) {
 
     LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
 
+    // Queue the message in a recycled buffer when one is available, saving the allocation
     std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
+    if (!vSendBufferPool.empty()) {
+        it->swap(vSendBufferPool.back());
+        vSendBufferPool.pop_back();
+    }
     ssSend.GetAndClear(*it);
     nSendSize += (*it).size();
 
@@ -2523,6 +2956,46 @@ void CNode::EndMessage(const char *pszCommand) UNLOCK_FUNCTION(cs_vSend) {
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
 
+void CNode::PushRawMessage(const char *pszCommand, CSerializeData &vPayload) {
+    BeginMessage(pszCommand);
+    if (nDropMessagesTest && GetRand(nDropMessagesTest) == 0) {
+        LogPrint("net", "dropmessages DROPPING SEND MESSAGE\n");
+        AbortMessage();
+        return;
+    }
+
+    // Only the header goes through ssSend; the payload keeps its own buffer
+    unsigned int nSize = vPayload.size();
+    WriteLE32((uint8_t * ) & ssSend[CMessageHeader::MESSAGE_SIZE_OFFSET], nSize);
+
+    vSendBytesPerMsgCmd[GetNetMessageTypeIndex(pszCommand)] += nSize + CMessageHeader::HEADER_SIZE;
+
+    uint256 hash = Hash(vPayload.begin(), vPayload.end());
+    memcpy((char *) &ssSend[CMessageHeader::CHECKSUM_OFFSET], &hash, CMessageHeader::CHECKSUM_SIZE);
+
+    LogPrint("net", "(%d bytes, raw) peer=%d\n", nSize, id);
+
+    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
+    if (!vSendBufferPool.empty()) {
+        it->swap(vSendBufferPool.back());
+        vSendBufferPool.pop_back();
+    }
+    ssSend.GetAndClear(*it);
+    nSendSize += (*it).size();
+    bool fWasEmpty = it == vSendMsg.begin();
+    if (nSize > 0) {
+        it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
+        it->swap(vPayload);
+        nSendSize += nSize;
+    }
+
+    // If write queue was empty, attempt "optimistic write"
+    if (fWasEmpty)
+        SocketSendData(this);
+
+    LEAVE_CRITICAL_SECTION(cs_vSend);
+}
+
 //
 // CBanDB
 //
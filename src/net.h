@@ -49,6 +49,12 @@ static const unsigned int MAX_INV_SZ = 50000;
 static const unsigned int MAX_ADDR_TO_SEND = 1000;
 /** Maximum length of incoming protocol messages (no message over 4 MB is currently acceptable). */
 static const unsigned int MAX_PROTOCOL_MESSAGE_LENGTH = 4 * 1000 * 1000;
+/** Maximum number of queued send buffers handed to the kernel in one gathered send */
+static const int MAX_SEND_IOVECS = 64;
+/** Maximum number of sent buffers a peer keeps around for its next messages */
+static const size_t MAX_SEND_BUFFER_POOL = 16;
+/** Sent buffers with a larger capacity than this are freed instead of being kept */
+static const size_t MAX_POOLED_SEND_BUFFER_SIZE = 64 * 1024;
 /** Maximum length of strSubVer in `version` message */
 static const unsigned int MAX_SUBVERSION_LENGTH = 256;
 /** -listen default */
@@ -82,6 +88,24 @@ static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Defaul
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
 
+/** How ThreadSocketHandler waits for socket readiness (-socketevents) */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT = 0,
+    SOCKETEVENTS_EPOLL = 1,
+};
+
+/** epoll where the platform provides it, select() elsewhere */
+SocketEventsMode GetDefaultSocketEventsMode();
+std::string GetSocketEventsModeName(SocketEventsMode mode);
+/** Parse a -socketevents value; fails for unknown modes and ones this build does not support */
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& mode);
+/**
+ * Create the socket event backend for nSocketEventsMode. Must be called before sockets are bound or
+ * connection limits are derived from the mode. If epoll can't be set up this falls back to select()
+ * when fFallback is set and fails otherwise
+ */
+bool InitSocketEvents(bool fFallback);
+
 typedef int NodeId;
 
 void AddOneShot(const std::string& strDest);
@@ -100,7 +124,15 @@ unsigned short GetListenPort();
 bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhitelisted = false);
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
+/** Make ThreadSocketHandler return from its wait right away, e.g. on shutdown */
+void WakeSocketHandler();
 void SocketSendData(CNode *pnode);
+/**
+ * Account for nBytes of pnode->vSendMsg handed to the socket: drop the buffers that went out completely
+ * (keeping them in vSendBufferPool for reuse) and advance nSendOffset into the next one. Returns false if
+ * the send ended inside a buffer. requires LOCK(cs_vSend)
+ */
+bool AdvanceSendQueue(CNode *pnode, size_t nBytes);
 
 struct CombinerAll
 {
@@ -168,6 +200,8 @@ extern CAddrMan addrman;
 
 /** Maximum number of connections to simultaneously allow (aka connection slots) */
 extern int nMaxConnections;
+/** Socket event backend, set from -socketevents before any socket is opened */
+extern SocketEventsMode nSocketEventsMode;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
@@ -233,12 +267,15 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
+    bool fPrechecked;               // signatures verified ahead of processing (libernode messages)
+
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        fPrechecked = false;
     }
 
     bool complete() const
@@ -333,6 +370,7 @@ public:
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
     std::deque<CSerializeData> vSendMsg;
+    std::vector<CSerializeData> vSendBufferPool; // emptied buffers reused by EndMessage
     CCriticalSection cs_vSend;
 
     std::deque<CInv> vRecvGetData;
@@ -390,8 +428,9 @@ protected:
     static std::vector<CSubNet> vWhitelistedRange;
     static CCriticalSection cs_vWhitelistedRange;
 
-    mapMsgCmdSize mapSendBytesPerMsgCmd;
-    mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    // Bytes per command, indexed by GetNetMessageTypeIndex
+    std::vector<uint64_t> vSendBytesPerMsgCmd;
+    std::vector<uint64_t> vRecvBytesPerMsgCmd;
 
     // Basic fuzz-testing
     void Fuzz(int nChance); // modifies ssSend
@@ -579,6 +618,13 @@ public:
     // TODO: Document the precondition of this function.  Is cs_vSend locked?
     void EndMessage(const char* pszCommand) UNLOCK_FUNCTION(cs_vSend);
 
+    /**
+     * Queue an already serialized message payload, such as a block read raw from
+     * disk. The payload is swapped into the send queue rather than copied, so
+     * vPayload is left empty. Must be called without cs_vSend held.
+     */
+    void PushRawMessage(const char* pszCommand, CSerializeData& vPayload);
+
     void PushVersion();
 
 
@@ -12,26 +12,38 @@
 #include <iostream>
 #include "util.h"
 #include "chainparams.h"
-#include "libzerocoin/bitcoin_bignum/bignum.h"
 #include "fixed.h"
 
 
-static CBigNum bnProofOfWorkLimit(~arith_uint256(0) >> 16);
+static const arith_uint256 bnProofOfWorkLimit = ~arith_uint256(0) >> 16;
+static const arith_uint256 bnProofOfWorkLimitTestNet = ~arith_uint256(0) >> 8;
 
-double GetDifficultyHelper(unsigned int nBits) {
-    int nShift = (nBits >> 24) & 0xff;
-    double dDiff = (double) 0x0000ffff / (double) (nBits & 0x00ffffff);
+static const arith_uint256 &ProofOfWorkLimit() {
+    bool fTestNet = Params().NetworkIDString() == CBaseChainParams::TESTNET;
+    return fTestNet ? bnProofOfWorkLimitTestNet : bnProofOfWorkLimit;
+}
 
-    while (nShift < 29) {
-        dDiff *= 256.0;
-        nShift++;
-    }
-    while (nShift > 29) {
-        dDiff /= 256.0;
-        nShift--;
+// bn / nDiv one 32-bit limb at a time, arith_uint256::operator/ does bit-by-bit long division
+static arith_uint256 DivideSmall(const arith_uint256 &bn, uint32_t nDiv, uint32_t *pnRemainder = NULL) {
+    arith_uint256 bnQuotient;
+    uint64_t nRemainder = 0;
+    for (int i = 256 / 32 - 1; i >= 0; i--) {
+        uint64_t nCur = (nRemainder << 32) | ((bn >> (32 * i)).GetLow64() & 0xffffffff);
+        bnQuotient |= arith_uint256(nCur / nDiv) << (32 * i);
+        nRemainder = nCur % nDiv;
     }
+    if (pnRemainder)
+        *pnRemainder = nRemainder;
+    return bnQuotient;
+}
 
-    return dDiff;
+// floor(bn * nMul / nDiv) without overflowing the intermediate product, saturates if the result does not fit
+static arith_uint256 MulDiv(const arith_uint256 &bn, uint32_t nMul, uint32_t nDiv) {
+    uint32_t nRemainder;
+    arith_uint256 bnQuotient = DivideSmall(bn, nDiv, &nRemainder);
+    if (bnQuotient.bits() > 256 - 32 && nMul != 0 && bnQuotient > DivideSmall(~arith_uint256(0), nMul))
+        return ~arith_uint256(0);
+    return bnQuotient * nMul + ((uint64_t)nRemainder * nMul) / nDiv;
 }
 
 static const int64_t nTargetSpacing = 180; // 2.5 minute blocks
@@ -44,21 +56,7 @@ static const int64_t nLookbackTimespan = nLookbackInterval * nTargetSpacing; //
 static const int64_t LimUp = nLookbackTimespan * 100 / 106; // 6% up
 static const int64_t LimDown = nLookbackTimespan * 106 / 100; // 6% down
 
-//btzc, libercoin GetNextWorkRequired
-unsigned int GetNextWorkRequired(const CBlockIndex *pindexLast, const CBlockHeader *pblock, const Consensus::Params &params) {
-
-        unsigned int nProofOfWorkLimit = bnProofOfWorkLimit.GetCompact();
-        bool fTestNet = Params().NetworkIDString() == CBaseChainParams::TESTNET;
-        // Genesis block
-        if (pindexLast == NULL)
-            return nProofOfWorkLimit;
-
-        // Testnet - min difficulty
-        if (fTestNet){
-            bnProofOfWorkLimit = CBigNum(~arith_uint256(0) >> 8);
-            //return bnProofOfWorkLimit.GetCompact();
-        }
-
+static unsigned int ComputeNextWorkRequired(const CBlockIndex *pindexLast) {
         // Only change once per interval
         if ((pindexLast->nHeight+1) % nRetargetInterval != 0){
             return pindexLast->nBits;
@@ -85,18 +83,34 @@ unsigned int GetNextWorkRequired(const CBlockIndex *pindexLast, const CBlockHead
         }
 
         // Retarget
-        CBigNum bnNew;
+        arith_uint256 bnNew;
         bnNew.SetCompact(pindexLast->nBits);
-        bnNew *= nActualTimespan;
-        bnNew /= nLookbackTimespan;
+        bnNew = MulDiv(bnNew, nActualTimespan, nLookbackTimespan);
 
-        //printf("bnNew = %lld    bnProofOfWorkLimit = %ld\n", bnNew.GetCompact(), bnProofOfWorkLimit.GetCompact());
-        if (bnNew > bnProofOfWorkLimit)
-            bnNew = bnProofOfWorkLimit;
+        if (bnNew > ProofOfWorkLimit())
+            bnNew = ProofOfWorkLimit();
 
         return bnNew.GetCompact();
 }
 
+//btzc, libercoin GetNextWorkRequired
+unsigned int GetNextWorkRequired(const CBlockIndex *pindexLast, const CBlockHeader *pblock, const Consensus::Params &params) {
+        // Genesis block
+        if (pindexLast == NULL)
+            return ProofOfWorkLimit().GetCompact();
+
+        // The result only depends on pindexLast and its ancestors, so every header and block built on top of
+        // it (and every getblocktemplate call) can share it. Indexes outside mapBlockIndex have no memo
+        if (pindexLast->nNextWorkRequired != 0)
+            return pindexLast->nNextWorkRequired;
+
+        return ComputeNextWorkRequired(pindexLast);
+}
+
+void SetNextWorkRequired(CBlockIndex *pindex) {
+        pindex->nNextWorkRequired = ComputeNextWorkRequired(pindex);
+}
+
 unsigned int GetNextWorkRequired_Bitcoin(const CBlockIndex *pindexLast, const CBlockHeader *pblock,
                                          const Consensus::Params &params) {
     unsigned int nProofOfWorkLimit = UintToArith256(params.powLimit).GetCompact();
@@ -174,12 +188,6 @@ bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params
     bool fNegative;
     bool fOverflow;
     arith_uint256 bnTarget = arith_uint256().SetCompact(nBits);
-    bool fTestNet = Params().NetworkIDString() == CBaseChainParams::TESTNET;
-
-    // Testnet - min difficulty
-    if (fTestNet){
-        bnProofOfWorkLimit = CBigNum(~arith_uint256(0) >> 8);
-    }
     // Check range
     if (fNegative || bnTarget == 0 || fOverflow || bnTarget > UintToArith256(params.powLimit)){
          LogPrintf("CPOW: Range Error\n %d", nHeight);
@@ -209,10 +217,10 @@ unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexL
     int32_t nActualSeconds = 0;
     int32_t nTargetSeconds = 0;
     fixed nBlockTimeRatio = 1;
-    CBigNum bnPastTargetAverage;
-    CBigNum bnPastTargetAveragePrev;
+    arith_uint256 bnPastTargetAverage;
+    arith_uint256 bnPastTargetAveragePrev;
 
-    float FastBlocksLimit[5040] = {317.772675, 136.233047, 83.194504, 58.732189, 44.894745, 36.089561, 30.038040,
+    static constexpr float FastBlocksLimit[5040] = {317.772675, 136.233047, 83.194504, 58.732189, 44.894745, 36.089561, 30.038040,
                                    25.646383, 22.327398, 19.739056, 17.669304, 15.980045, 14.577670, 13.396597,
                                    12.389578, 11.521759, 10.766892, 10.104856, 9.519974, 8.999868, 8.534638, 8.116274,
                                    7.738231, 7.395114, 7.082433, 6.796428, 6.533921, 6.292217, 6.069008, 5.862312,
@@ -843,7 +851,7 @@ unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexL
                                    1.009036, 1.009034, 1.009031, 1.009029, 1.009027, 1.009025, 1.009022, 1.009020,
                                    1.009018, 1.009016, 1.009014, 1.009012, 1.009009, 1.009007, 1.009005, 1.009003,
                                    1.009001, 1.008998};
-    float SlowBlocksLimit[5040] = {0.003147, 0.007340, 0.012020, 0.017026, 0.022274, 0.027709, 0.033291, 0.038992,
+    static constexpr float SlowBlocksLimit[5040] = {0.003147, 0.007340, 0.012020, 0.017026, 0.022274, 0.027709, 0.033291, 0.038992,
                                    0.044788, 0.050661, 0.056595, 0.062578, 0.068598, 0.074646, 0.080713, 0.086792,
                                    0.092877, 0.098962, 0.105042, 0.111113, 0.117170, 0.123209, 0.129229, 0.135224,
                                    0.141194, 0.147136, 0.153047, 0.158927, 0.164772, 0.170581, 0.176354, 0.182089,
@@ -1486,8 +1494,12 @@ unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexL
         if (i == 1) { bnPastTargetAverage.SetCompact(BlockReading->nBits); }
 
         else {
-            bnPastTargetAverage = ((CBigNum().SetCompact(BlockReading->nBits) - bnPastTargetAveragePrev) / i) +
-                                  bnPastTargetAveragePrev;
+            // prev + (target - prev) / i with the division truncating towards zero
+            arith_uint256 bnTarget = arith_uint256().SetCompact(BlockReading->nBits);
+            if (bnTarget >= bnPastTargetAveragePrev)
+                bnPastTargetAverage = bnPastTargetAveragePrev + DivideSmall(bnTarget - bnPastTargetAveragePrev, i);
+            else
+                bnPastTargetAverage = bnPastTargetAveragePrev - DivideSmall(bnPastTargetAveragePrev - bnTarget, i);
         }
         bnPastTargetAveragePrev = bnPastTargetAverage;
 
@@ -1518,14 +1530,15 @@ unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexL
     }
 
     // Limit range of bnPastTargetAverage to a halving or doubling from most recent block target
-    if (bnPastTargetAverage < (CBigNum().SetCompact(BlockLastSolved->nBits) / 2)) {
-        bnPastTargetAverage = CBigNum().SetCompact(BlockLastSolved->nBits) / 2;
+    arith_uint256 bnLastTarget = arith_uint256().SetCompact(BlockLastSolved->nBits);
+    if (bnPastTargetAverage < bnLastTarget / 2) {
+        bnPastTargetAverage = bnLastTarget / 2;
     }
-    if (bnPastTargetAverage > (CBigNum().SetCompact(BlockLastSolved->nBits) * 2)) {
-        bnPastTargetAverage = CBigNum().SetCompact(BlockLastSolved->nBits) * 2;
+    if (bnPastTargetAverage > MulDiv(bnLastTarget, 2, 1)) {
+        bnPastTargetAverage = MulDiv(bnLastTarget, 2, 1);
     }
 
-    CBigNum bnNew(bnPastTargetAverage);
+    arith_uint256 bnNew(bnPastTargetAverage);
 
     if (nActualSeconds != 0 && nTargetSeconds != 0) {
 
@@ -1536,12 +1549,11 @@ unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexL
             nActualSeconds = nTargetSeconds / 3;
         } // Maximal difficulty increase of x3 from constrained past average
 
-        bnNew *= nActualSeconds;
-        bnNew /= nTargetSeconds;
+        bnNew = MulDiv(bnNew, nActualSeconds, nTargetSeconds);
     }
 
 
-    if (bnNew > bnProofOfWorkLimit) { bnNew = bnProofOfWorkLimit; }
+    if (bnNew > ProofOfWorkLimit()) { bnNew = ProofOfWorkLimit(); }
 
 
     // debug print
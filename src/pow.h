@@ -18,6 +18,9 @@ class uint256;
 
 unsigned int GetNextWorkRequired(const CBlockIndex *pindexLast, const CBlockHeader *pblock, const Consensus::Params &);
 
+/** Memoize GetNextWorkRequired() for children of pindex. Call under cs_main before pindex can be seen without it */
+void SetNextWorkRequired(CBlockIndex *pindex);
+
 unsigned int CalculateNextWorkRequired(const CBlockIndex *pindexLast, int64_t nFirstBlockTime, const Consensus::Params &);
 
 unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexLast, uint32_t TargetBlocksSpacingSeconds,
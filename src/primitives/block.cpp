@@ -20,9 +20,14 @@
 #include <fstream>
 #include <algorithm>
 #include <string>
-#include "precomputed_hash.h"
+#include "primitives/precomputed_hash.h"
 #include "zerocoin.h"
 
+#include <boost/thread/tss.hpp>
+
+// Lyra2 memory matrix of the thread, kept between PoW hashes instead of allocating 8 MB every time
+static boost::thread_specific_ptr<CLyra2Scratchpad> lyra2Scratchpad;
+
 
 unsigned char GetNfactor(int64_t nTimestamp) {
     int l = 0;
@@ -54,24 +59,18 @@ uint256 CBlockHeader::GetPoWHash(int nHeight) const {
 //            std::chrono::system_clock::now().time_since_epoch()).count();
 
 
+    uint256 powHash;
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
-    if (!fTestNet) {
-        if (nHeight < 233001) {
-            if (!mapPoWHash.count(1)) {
-                LogPrintf("Start Build Map\n");
-                buildMapPoWHash();
-            }
-        }
-        if (mapPoWHash.count(nHeight)) {
-//        std::cout << "GetPowHash nHeight=" << nHeight << ", hash= " << mapPoWHash[nHeight].ToString() << std::endl;
-            //LogPrintf("Process POWHASH %d \n", nHeight);
-            return mapPoWHash[nHeight];
-        }
-    }
+    if (!fTestNet && GetPrecomputedPoWHash(nHeight, powHash))
+        return powHash;
 
-    uint256 powHash;
     try {
-        LYRA2(BEGIN(powHash), 32, BEGIN(nVersion), 80, BEGIN(nVersion), 80, 2, 330, 256);
+        if (!lyra2Scratchpad.get())
+            lyra2Scratchpad.reset(new CLyra2Scratchpad(330, 256, true));
+        if (lyra2Scratchpad->IsValid())
+            lyra2Scratchpad->Hash(BEGIN(powHash), 32, BEGIN(nVersion), 80, BEGIN(nVersion), 80, 2);
+        else
+            LYRA2(BEGIN(powHash), 32, BEGIN(nVersion), 80, BEGIN(nVersion), 80, 2, 330, 256);
     } catch (std::exception &e) {
         LogPrintf("excepetion: %s", e.what());
     }
@@ -79,8 +78,6 @@ uint256 CBlockHeader::GetPoWHash(int nHeight) const {
 //            std::chrono::system_clock::now().time_since_epoch()).count();
 //    std::cout << "GetPowHash nHeight=" << nHeight << ", hash= " << powHash.ToString() << " done in= " << (end - start) << " miliseconds" << std::endl;
     //LogPrintf("HEIGHT: %d POW: %s \n", nHeight, powHash.ToString());
-    //mapPoWHash.insert(make_pair(nHeight, powHash));
-//    SetPoWHash(thash);
     //LogPrintf("Process POWHASH %d \n", nHeight);
     return powHash;
 }
@@ -40,9 +40,9 @@ public:
 
     static const int CURRENT_VERSION = 2;
 
-    // uint32_t lastHeight;
-    uint256 powHash;
-    int32_t isComputed;
+    // memory only, PoW hash remembered by SetPoWHash and the header hash it was computed for
+    mutable uint256 powHash;
+    mutable uint256 powHashHeader;
 
     CBlockHeader()
     {
@@ -69,8 +69,8 @@ public:
         nTime = 0;
         nBits = 0;
         nNonce = 0;
-        isComputed = -1;
         powHash.SetNull();
+        powHashHeader.SetNull();
     }
 
     int GetChainID() const
@@ -83,15 +83,16 @@ public:
         return (nBits == 0);
     }
 
+    //! True if powHash was set for the current contents of the header
     bool IsComputed() const
     {
-        return (isComputed <= 0);
+        return !powHashHeader.IsNull() && powHashHeader == GetHash();
     }
 
     void SetPoWHash(uint256 hash) const
     {
-//        isComputed = 1;
-//        powHash = hash;
+        powHash = hash;
+        powHashHeader = GetHash();
     }
 
     uint256 GetPoWHash(int nHeight) const;
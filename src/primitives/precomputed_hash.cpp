@@ -0,0 +1,28 @@
+// Copyright (c) 2018 The Libercoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "primitives/precomputed_hash.h"
+
+#include "uint256.h"
+
+#include <string.h>
+
+// Defines precomputed_pow_hashes, one 32 byte little-endian uint256 per height
+#include "obj/powhashes.h"
+
+static const int POWHASH_STRIDE = 32;
+
+int GetPrecomputedPoWHashCount()
+{
+    // The string literal carries a terminating zero byte
+    return (sizeof(precomputed_pow_hashes) - 1) / POWHASH_STRIDE;
+}
+
+bool GetPrecomputedPoWHash(int nHeight, uint256& hashRet)
+{
+    if (nHeight < 0 || nHeight >= GetPrecomputedPoWHashCount())
+        return false;
+    memcpy(hashRet.begin(), precomputed_pow_hashes + (size_t)nHeight * POWHASH_STRIDE, POWHASH_STRIDE);
+    return true;
+}
@@ -0,0 +1,21 @@
+// Copyright (c) 2018 The Libercoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PRIMITIVES_PRECOMPUTED_HASH_H
+#define BITCOIN_PRIMITIVES_PRECOMPUTED_HASH_H
+
+class uint256;
+
+/** Number of main chain heights, starting at 0, covered by the precomputed PoW hash table. */
+int GetPrecomputedPoWHashCount();
+
+/**
+ * Look up the PoW hash of the main chain block at nHeight in the precomputed table.
+ * The table is a flat array with a 32 byte stride generated at build time from
+ * primitives/hashmap.txt, so the lookup needs no initialization or locking.
+ * Returns false if nHeight is not covered by the table.
+ */
+bool GetPrecomputedPoWHash(int nHeight, uint256& hashRet);
+
+#endif // BITCOIN_PRIMITIVES_PRECOMPUTED_HASH_H
@@ -65,7 +65,7 @@ const char *TXLOCKREQUEST = "ix";
 /** All known message types. Keep this in the same order as the list of
  * messages above and in protocol.h.
  */
-const static std::string allNetMessageTypes[] = {
+const static char *const allNetMessageTypes[] = {
     NetMsgType::VERSION,
     NetMsgType::VERACK,
     NetMsgType::ADDR,
@@ -95,6 +95,7 @@ const static std::string allNetMessageTypes[] = {
     
     //libernode
     NetMsgType::TXLOCKREQUEST,
+    NetMsgType::TXLOCKVOTE,
     NetMsgType::LIBERNODEPAYMENTVOTE,
     NetMsgType::LIBERNODEPAYMENTBLOCK,
     NetMsgType::LIBERNODEPAYMENTSYNC,
@@ -240,3 +241,15 @@ const std::vector<std::string> &getAllNetMessageTypes()
 {
     return allNetMessageTypesVec;
 }
+
+size_t GetNetMessageTypeIndex(const char *pszCommand)
+{
+    // Senders nearly always pass the NetMsgType constants themselves, so try their addresses first
+    for (size_t i = 0; i < ARRAYLEN(allNetMessageTypes); i++)
+        if (allNetMessageTypes[i] == pszCommand)
+            return i;
+    for (size_t i = 0; i < ARRAYLEN(allNetMessageTypes); i++)
+        if (strncmp(allNetMessageTypes[i], pszCommand, CMessageHeader::COMMAND_SIZE) == 0)
+            return i;
+    return ARRAYLEN(allNetMessageTypes);
+}
@@ -271,6 +271,12 @@ extern const char *BLOCKTXN;
 /* Get a vector of all valid message types (see above) */
 const std::vector<std::string> &getAllNetMessageTypes();
 
+/**
+ * Position of a command in getAllNetMessageTypes(), or getAllNetMessageTypes().size()
+ * for commands that are not in the list. Used to index per-command counters.
+ */
+size_t GetNetMessageTypeIndex(const char *pszCommand);
+
 /** nServices flags */
 enum ServiceFlags : uint64_t {
     // Nothing
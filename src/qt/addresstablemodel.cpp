@@ -99,7 +99,7 @@ public:
             }
             //[libercoin] add load pubcoin
             std::list<CZerocoinEntry> listPubcoin;
-            CWalletDB(wallet->strWalletFile).ListPubCoin(listPubcoin);
+            wallet->ListZerocoinEntries(listPubcoin);
             BOOST_FOREACH(const CZerocoinEntry& item, listPubcoin)
             {
                 if(item.randomness != 0 && item.serialNumber != 0){
@@ -310,10 +310,10 @@ void Libernodes::updateNodeList()
     ui->tableWidgetLibernodes_4->clearContents();
     ui->tableWidgetLibernodes_4->setRowCount(0);
 //    std::map<COutPoint, CLibernode> mapLibernodes = mnodeman.GetFullLibernodeMap();
-    std::vector<CLibernode> vLibernodes = mnodeman.GetFullLibernodeVector();
     int offsetFromUtc = GetOffsetFromUtc();
 
-    BOOST_FOREACH(CLibernode & mn, vLibernodes)
+    CLibernodeMan::CSnapshot snapshot(mnodeman);
+    BOOST_FOREACH(CLibernode & mn, snapshot)
     {
 //        CLibernode mn = mnpair.second;
         // populate list
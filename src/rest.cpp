@@ -214,6 +214,8 @@ static bool rest_block(HTTPRequest* req,
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
     CBlock block;
+    CSerializeData vBlock;
+    bool fRawBlock = false;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
@@ -224,23 +226,31 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        // Binary and hex replies can use the block file bytes as they are
+        if (rf != RF_JSON &&
+            IsRawBlockSerialization(pblockindex, !(RPCSerializationFlags() & SERIALIZE_TRANSACTION_NO_WITNESS), Params().GetConsensus()))
+            fRawBlock = ReadRawBlockFromDisk(vBlock, pblockindex, Params().MessageStart(), Params().GetConsensus());
+
+        if (!fRawBlock && !ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
+    if (!fRawBlock && rf != RF_JSON) {
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ssBlock << block;
+        ssBlock.GetAndClear(vBlock);
+    }
 
     switch (rf) {
     case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
+        string binaryBlock(vBlock.begin(), vBlock.end());
         req->WriteHeader("Content-Type", "application/octet-stream");
         req->WriteReply(HTTP_OK, binaryBlock);
         return true;
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        string strHex = HexStr(vBlock.begin(), vBlock.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
@@ -100,7 +100,7 @@ UniValue libernode(const UniValue &params, bool fHelp) {
          strCommand != "start-disabled" && strCommand != "list" && strCommand != "list-conf" && strCommand != "count" &&
          strCommand != "debug" && strCommand != "current" && strCommand != "winner" && strCommand != "winners" &&
          strCommand != "genkey" &&
-         strCommand != "connect" && strCommand != "outputs" && strCommand != "status"))
+         strCommand != "connect" && strCommand != "outputs" && strCommand != "status" && strCommand != "maintenance"))
         throw std::runtime_error(
                 "libernode \"command\"...\n"
                         "Set of commands to execute libernode related actions\n"
@@ -118,6 +118,7 @@ UniValue libernode(const UniValue &params, bool fHelp) {
                         "  status       - Print libernode status information\n"
                         "  list         - Print list of all known libernodes (see libernodelist for more info)\n"
                         "  list-conf    - Print libernode.conf in JSON format\n"
+                        "  maintenance  - Print timing counters of the libernode maintenance tasks\n"
                         "  winner       - Print info on next libernode winner to vote for\n"
                         "  winners      - Print list of libernode winners\n"
         );
@@ -398,6 +399,21 @@ UniValue libernode(const UniValue &params, bool fHelp) {
         return mnObj;
     }
 
+    if (strCommand == "maintenance") {
+        UniValue obj(UniValue::VOBJ);
+        BOOST_FOREACH(const CMaintenanceTaskStats& stats, GetDarkSendMaintenanceStats()) {
+            UniValue taskObj(UniValue::VOBJ);
+            taskObj.push_back(Pair("runs", stats.nRuns));
+            taskObj.push_back(Pair("skipped", stats.nSkipped));
+            taskObj.push_back(Pair("totalmicros", stats.nTotalMicros));
+            taskObj.push_back(Pair("maxmicros", stats.nMaxMicros));
+            taskObj.push_back(Pair("lastmicros", stats.nLastMicros));
+            taskObj.push_back(Pair("lastrun", stats.nTimeLastRun));
+            obj.push_back(Pair(stats.strName, taskObj));
+        }
+        return obj;
+    }
+
     if (strCommand == "winners") {
         int nHeight;
         {
@@ -488,8 +504,10 @@ UniValue libernodelist(const UniValue &params, bool fHelp) {
             obj.push_back(Pair(strOutpoint, s.first));
         }
     } else {
-        std::vector <CLibernode> vLibernodes = mnodeman.GetFullLibernodeVector();
-        BOOST_FOREACH(CLibernode & mn, vLibernodes)
+        // qualify needs cs_main, which must be locked before the libernode list
+        LOCK(cs_main);
+        CLibernodeMan::CSnapshot snapshot(mnodeman);
+        BOOST_FOREACH(CLibernode & mn, snapshot)
         {
             std::string strOutpoint = mn.vin.prevout.ToStringShort();
             if (strMode == "activeseconds") {
@@ -0,0 +1,252 @@
+// Copyright (c) 2018 The Libercoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "flat-database.h"
+#include "serialize.h"
+#include "streams.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+// Journals its changes per key, the way CLibernodePayeeIndex does per height
+class CFlatDBTestObject
+{
+public:
+    std::map<int, std::string> mapEntries;
+    std::set<int> setDirtyKeys;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(mapEntries);
+    }
+
+    void Set(int nKey, const std::string& str)
+    {
+        mapEntries[nKey] = str;
+        setDirtyKeys.insert(nKey);
+    }
+
+    void Erase(int nKey)
+    {
+        mapEntries.erase(nKey);
+        setDirtyKeys.insert(nKey);
+    }
+
+    void Clear()
+    {
+        mapEntries.clear();
+        setDirtyKeys.clear();
+    }
+
+    void CheckAndRemove() {}
+
+    std::string ToString() const
+    {
+        return strprintf("Entries: %d", (int)mapEntries.size());
+    }
+
+    void TakeJournalRecords(std::vector<CDataStream>& vRecordsRet)
+    {
+        BOOST_FOREACH(int nKey, setDirtyKeys) {
+            CDataStream ssRecord(SER_DISK, CLIENT_VERSION);
+            std::map<int, std::string>::const_iterator it = mapEntries.find(nKey);
+            bool fErased = it == mapEntries.end();
+            ssRecord << nKey << fErased;
+            if (!fErased)
+                ssRecord << it->second;
+            vRecordsRet.push_back(ssRecord);
+        }
+        setDirtyKeys.clear();
+    }
+
+    void ApplyJournalRecord(CDataStream& ssRecord)
+    {
+        int nKey;
+        bool fErased;
+        ssRecord >> nKey >> fErased;
+        if (fErased) {
+            mapEntries.erase(nKey);
+        } else {
+            std::string str;
+            ssRecord >> str;
+            mapEntries[nKey] = str;
+        }
+    }
+};
+
+static const std::string strTestFile = "flatdbtest.dat";
+static const std::string strTestMagic = "magicFlatDBTest";
+
+static boost::filesystem::path SnapshotPath()
+{
+    return GetDataDir() / strTestFile;
+}
+
+static boost::filesystem::path JournalPath()
+{
+    return GetDataDir() / (strTestFile + ".journal");
+}
+
+static uint64_t JournalHeaderSize()
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << strTestMagic << FLATDATA(Params().MessageStart()) << uint256();
+    return ss.size();
+}
+
+static std::map<int, std::string> LoadTestObject()
+{
+    CJournaledFlatDB<CFlatDBTestObject> flatdb(strTestFile, strTestMagic);
+    CFlatDBTestObject obj;
+    BOOST_CHECK(flatdb.Load(obj));
+    return obj.mapEntries;
+}
+
+static void DumpTestObject(CFlatDBTestObject& obj)
+{
+    CJournaledFlatDB<CFlatDBTestObject> flatdb(strTestFile, strTestMagic);
+    BOOST_CHECK(flatdb.Dump(obj));
+}
+
+static void RemoveTestFiles()
+{
+    boost::filesystem::remove(SnapshotPath());
+    boost::filesystem::remove(JournalPath());
+}
+
+// Overwrites the byte at nOffset from the end of the journal
+static void CorruptJournal(long nOffset)
+{
+    FILE* file = fopen(JournalPath().string().c_str(), "rb+");
+    BOOST_REQUIRE(file != NULL);
+    BOOST_REQUIRE(fseek(file, -nOffset, SEEK_END) == 0);
+    int ch = fgetc(file);
+    BOOST_REQUIRE(ch != EOF);
+    BOOST_REQUIRE(fseek(file, -nOffset, SEEK_END) == 0);
+    fputc(ch ^ 0xff, file);
+    fclose(file);
+}
+
+BOOST_FIXTURE_TEST_SUITE(flatdb_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(flatdb_journal_replay)
+{
+    RemoveTestFiles();
+    CFlatDBTestObject obj;
+
+    // without a journal the first dump writes a snapshot and an empty journal for it
+    obj.Set(1, "one");
+    obj.Set(2, "two");
+    obj.Set(3, "three");
+    DumpTestObject(obj);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(JournalPath()), JournalHeaderSize());
+    uint64_t nSnapshotSize = boost::filesystem::file_size(SnapshotPath());
+
+    // later dumps only append
+    obj.Set(4, "four");
+    obj.Erase(2);
+    DumpTestObject(obj);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(SnapshotPath()), nSnapshotSize);
+    uint64_t nJournalSize = boost::filesystem::file_size(JournalPath());
+    BOOST_CHECK(nJournalSize > JournalHeaderSize());
+    std::map<int, std::string> mapBefore = obj.mapEntries;
+
+    obj.Set(5, "five");
+    DumpTestObject(obj);
+    uint64_t nJournalSizeAfter = boost::filesystem::file_size(JournalPath());
+    BOOST_CHECK(nJournalSizeAfter > nJournalSize);
+    BOOST_CHECK(LoadTestObject() == obj.mapEntries);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(JournalPath()), nJournalSizeAfter);
+
+    // a record cut short is dropped and the journal is cut back to the good prefix
+    boost::filesystem::resize_file(JournalPath(), nJournalSizeAfter - 3);
+    BOOST_CHECK(LoadTestObject() == mapBefore);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(JournalPath()), nJournalSize);
+
+    // garbage after the last record goes the same way
+    obj.Set(5, "five");
+    DumpTestObject(obj);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(JournalPath()), nJournalSizeAfter);
+    {
+        FILE* file = fopen(JournalPath().string().c_str(), "ab");
+        BOOST_REQUIRE(file != NULL);
+        fputs("garbage", file);
+        fclose(file);
+    }
+    BOOST_CHECK(LoadTestObject() == obj.mapEntries);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(JournalPath()), nJournalSizeAfter);
+
+    // so does a record whose checksum doesn't match
+    CorruptJournal(1);
+    BOOST_CHECK(LoadTestObject() == mapBefore);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(JournalPath()), nJournalSize);
+
+    RemoveTestFiles();
+}
+
+BOOST_AUTO_TEST_CASE(flatdb_journal_stale)
+{
+    RemoveTestFiles();
+    CFlatDBTestObject obj;
+
+    obj.Set(1, "one");
+    DumpTestObject(obj);
+    obj.Set(2, "two");
+    DumpTestObject(obj);
+    BOOST_CHECK(LoadTestObject() == obj.mapEntries);
+
+    // a new snapshot without key 2, next to the journal of the old one that still sets it
+    boost::filesystem::path pathOldJournal = JournalPath().string() + ".old";
+    boost::filesystem::rename(JournalPath(), pathOldJournal);
+    obj.Erase(2);
+    obj.Set(3, "three");
+    DumpTestObject(obj);
+    BOOST_CHECK(RenameOver(pathOldJournal, JournalPath()));
+
+    BOOST_CHECK(LoadTestObject() == obj.mapEntries);
+
+    // nothing is appended to it either, the next dump starts over with a snapshot
+    obj.Set(4, "four");
+    DumpTestObject(obj);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(JournalPath()), JournalHeaderSize());
+    BOOST_CHECK(LoadTestObject() == obj.mapEntries);
+
+    RemoveTestFiles();
+}
+
+BOOST_AUTO_TEST_CASE(flatdb_journal_compaction)
+{
+    RemoveTestFiles();
+    CFlatDBTestObject obj;
+
+    obj.Set(0, "zero");
+    DumpTestObject(obj);
+    uint64_t nSnapshotSize = boost::filesystem::file_size(SnapshotPath());
+
+    // below the minimum the journal keeps growing, even past the size of the snapshot
+    const std::string strLarge(4096, 'x');
+    int nKey = 1;
+    while (boost::filesystem::file_size(JournalPath()) + strLarge.size() * 2 < FLATDB_MIN_JOURNAL_SIZE) {
+        obj.Set(nKey++, strLarge);
+        DumpTestObject(obj);
+    }
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(SnapshotPath()), nSnapshotSize);
+    BOOST_CHECK(boost::filesystem::file_size(JournalPath()) > nSnapshotSize);
+
+    // past it everything is folded into a new snapshot and the journal starts over
+    obj.Set(nKey++, strLarge);
+    obj.Set(nKey++, strLarge);
+    DumpTestObject(obj);
+    BOOST_CHECK(boost::filesystem::file_size(SnapshotPath()) > nSnapshotSize);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(JournalPath()), JournalHeaderSize());
+    BOOST_CHECK(LoadTestObject() == obj.mapEntries);
+
+    RemoveTestFiles();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,126 @@
+// Copyright (c) 2018 The Libercoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/Lyra2Z/Lyra2.h"
+#include "random.h"
+#include "utilstrencodings.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(lyra2_tests, BasicTestingSetup)
+
+// Vectors produced by the portable sponge, every SIMD implementation has to reproduce them bit for bit
+static void TestLyra2Vectors()
+{
+    // mainnet genesis header with the PoW parameters used by CBlockHeader::GetPoWHash
+    std::vector<unsigned char> header = ParseHex("020000000000000000000000000000000000000000000000000000000000000000000000a011c63fbd7e6779e0c1b3a7a8baa0ac87f24af6c790c25a21cf59143f0c23143b491a58ffff001f4c990100");
+    std::vector<unsigned char> out(32);
+    BOOST_CHECK_EQUAL(LYRA2(&out[0], 32, &header[0], 80, &header[0], 80, 2, 330, 256), 0);
+    BOOST_CHECK_EQUAL(HexStr(out), "2ff0a4336f58f066d290117358668485242d845c235ccaebf9786df77cf54092");
+
+    header[76]++;
+    BOOST_CHECK_EQUAL(LYRA2(&out[0], 32, &header[0], 80, &header[0], 80, 2, 330, 256), 0);
+    BOOST_CHECK_EQUAL(HexStr(out), "cee536679e3e5423c3cafa56b15165ea03c33a6826da12ec400803184f3263e5");
+
+    // Lyra2Z parameters
+    BOOST_CHECK_EQUAL(LYRA2(&out[0], 32, &header[0], 32, &header[0], 32, 8, 8, 8), 0);
+    BOOST_CHECK_EQUAL(HexStr(out), "d53b1b812381a21c3895e46bd7e10c8cc5bc42e7f5363a48d6a4dff0bea44848");
+
+    // odd sized matrix, multi-block absorb and squeeze
+    std::vector<unsigned char> in(160);
+    for (size_t i = 0; i < in.size(); i++)
+        in[i] = (unsigned char)i;
+    out.resize(100);
+    BOOST_CHECK_EQUAL(LYRA2(&out[0], 100, &in[0], 100, &in[100], 60, 3, 17, 5), 0);
+    BOOST_CHECK_EQUAL(HexStr(out), "8933ff9059cff6f99a9df4430a0da49605ac576ecbcd9c3515f43cd4e06f661e1a64c2bced362b1ad29a577f4439d7d5c21096e30304c13176449ca417bd110115d8826673c89b04da59dd137824a6a1547a506f0cf991499d8c2470c41ef5dacfb44465");
+}
+
+BOOST_AUTO_TEST_CASE(lyra2_known_answers)
+{
+    const int impls[] = {LYRA2_IMPL_GENERIC, LYRA2_IMPL_SSE2, LYRA2_IMPL_AVX2};
+    for (int impl : impls) {
+        // implementations the CPU can't run are skipped
+        if (LYRA2_select_impl(impl) != 0)
+            continue;
+        TestLyra2Vectors();
+    }
+    LYRA2_detect_simd();
+}
+
+BOOST_AUTO_TEST_CASE(lyra2_simd_matches_generic)
+{
+    const int impls[] = {LYRA2_IMPL_SSE2, LYRA2_IMPL_AVX2};
+    for (int n = 0; n < 32; n++) {
+        std::vector<unsigned char> pwd(1 + insecure_rand() % 200), salt(1 + insecure_rand() % 100);
+        for (unsigned char &c : pwd)
+            c = insecure_rand();
+        for (unsigned char &c : salt)
+            c = insecure_rand();
+        uint64_t kLen = 1 + insecure_rand() % 128;
+        uint64_t timeCost = 1 + insecure_rand() % 3;
+        uint64_t nRows = 3 + insecure_rand() % 30;
+        uint64_t nCols = 1 + insecure_rand() % 16;
+
+        std::vector<unsigned char> expected(kLen), out(kLen);
+        BOOST_CHECK_EQUAL(LYRA2_select_impl(LYRA2_IMPL_GENERIC), 0);
+        BOOST_CHECK_EQUAL(LYRA2(&expected[0], kLen, &pwd[0], pwd.size(), &salt[0], salt.size(), timeCost, nRows, nCols), 0);
+
+        for (int impl : impls) {
+            if (LYRA2_select_impl(impl) != 0)
+                continue;
+            BOOST_CHECK_EQUAL(LYRA2(&out[0], kLen, &pwd[0], pwd.size(), &salt[0], salt.size(), timeCost, nRows, nCols), 0);
+            BOOST_CHECK(out == expected);
+        }
+    }
+    LYRA2_detect_simd();
+}
+
+BOOST_AUTO_TEST_CASE(lyra2_scratchpad_reuse)
+{
+    std::vector<unsigned char> header = ParseHex("020000000000000000000000000000000000000000000000000000000000000000000000a011c63fbd7e6779e0c1b3a7a8baa0ac87f24af6c790c25a21cf59143f0c23143b491a58ffff001f4c990100");
+    std::vector<unsigned char> expected(32), out(32);
+
+    CLyra2Scratchpad scratchpad(330, 256, false);
+    BOOST_CHECK(scratchpad.IsValid());
+    for (int n = 0; n < 4; n++) {
+        header[76] = n;
+        BOOST_CHECK_EQUAL(LYRA2(&expected[0], 32, &header[0], 80, &header[0], 80, 2, 330, 256), 0);
+        BOOST_CHECK_EQUAL(scratchpad.Hash(&out[0], 32, &header[0], 80, &header[0], 80, 2), 0);
+        BOOST_CHECK(out == expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(lyra2_lanes)
+{
+    std::vector<unsigned char> header = ParseHex("020000000000000000000000000000000000000000000000000000000000000000000000a011c63fbd7e6779e0c1b3a7a8baa0ac87f24af6c790c25a21cf59143f0c23143b491a58ffff001f4c990100");
+    std::vector<std::vector<unsigned char> > headers(LYRA2_MAX_LANES, header), hashes(LYRA2_MAX_LANES, std::vector<unsigned char>(32));
+    void *output[LYRA2_MAX_LANES];
+    const void *input[LYRA2_MAX_LANES];
+    for (int l = 0; l < LYRA2_MAX_LANES; l++) {
+        headers[l][76] = l;
+        output[l] = &hashes[l][0];
+        input[l] = &headers[l][0];
+    }
+
+    CLyra2Scratchpad scratchpad(330, 256, false, LYRA2_MAX_LANES);
+    BOOST_CHECK(scratchpad.IsValid());
+    BOOST_CHECK_EQUAL(scratchpad.GetLanes(), (unsigned int)LYRA2_MAX_LANES);
+    BOOST_CHECK_EQUAL(scratchpad.HashLanes(0, output, 32, input, 80, input, 80, 2), -1);
+    BOOST_CHECK_EQUAL(scratchpad.HashLanes(LYRA2_MAX_LANES + 1, output, 32, input, 80, input, 80, 2), -1);
+
+    // every lane must give the same hash as a single-lane run, whatever the number of lanes
+    std::vector<unsigned char> expected(32);
+    for (unsigned int nLanes = 1; nLanes <= LYRA2_MAX_LANES; nLanes += 3) {
+        BOOST_CHECK_EQUAL(scratchpad.HashLanes(nLanes, output, 32, input, 80, input, 80, 2), 0);
+        for (unsigned int l = 0; l < nLanes; l++) {
+            BOOST_CHECK_EQUAL(LYRA2(&expected[0], 32, &headers[l][0], 80, &headers[l][0], 80, 2, 330, 256), 0);
+            BOOST_CHECK(hashes[l] == expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,7 +3,10 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "consensus/consensus.h"
+#include "consensus/merkle.h"
 #include "main.h"
+#include "streams.h"
 
 #include "test/test_bitcoin.h"
 
@@ -72,4 +75,160 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+static CBlock RawTestBlock(bool fWitness, uint32_t nLockTime = 0x01020304)
+{
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << OP_1 << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 50 * COIN;
+    coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    coinbase.nLockTime = nLockTime;
+    if (fWitness) {
+        coinbase.wit.vtxinwit.resize(1);
+        coinbase.wit.vtxinwit[0].scriptWitness.stack.push_back(std::vector<unsigned char>(32, 0x42));
+    }
+
+    CBlock block;
+    block.nVersion = 4;
+    block.nTime = 1500000000;
+    block.nBits = 0x1e0ffff0;
+    block.vtx.push_back(CTransaction(coinbase));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+// Writes the block the way AcceptBlock does and points the index at it
+static void WriteRawTestBlock(const CBlock& block, int nFile, CBlockIndex& index, uint256& hash)
+{
+    CDiskBlockPos pos(nFile, 0);
+    BOOST_REQUIRE(WriteBlockToDisk(block, pos, Params().MessageStart()));
+    hash = block.GetHash();
+    index = CBlockIndex(block);
+    index.phashBlock = &hash;
+    index.nHeight = 1;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus |= BLOCK_HAVE_DATA;
+}
+
+// Overwrites part of the block file, nOffset is relative to the start of the block data
+static void CorruptRawTestBlock(const CBlockIndex& index, long nOffset, const void* pData, size_t nLen)
+{
+    FILE* file = fopen(GetBlockPosFilename(index.GetBlockPos(), "blk").string().c_str(), "rb+");
+    BOOST_REQUIRE(file != NULL);
+    BOOST_REQUIRE(fseek(file, index.nDataPos + nOffset, SEEK_SET) == 0);
+    BOOST_REQUIRE(fwrite(pData, 1, nLen, file) == nLen);
+    fclose(file);
+}
+
+// Appends zeros after the block, like the preallocation in FindBlockPos leaves at the end of a file
+static void PadRawTestBlockFile(const CBlockIndex& index, size_t nLen)
+{
+    FILE* file = fopen(GetBlockPosFilename(index.GetBlockPos(), "blk").string().c_str(), "ab");
+    BOOST_REQUIRE(file != NULL);
+    std::vector<unsigned char> vZeros(nLen, 0);
+    BOOST_REQUIRE(fwrite(&vZeros[0], 1, nLen, file) == nLen);
+    fclose(file);
+}
+
+static bool RawBlockEquals(const CSerializeData& vData, const CBlock& block, int nVersion)
+{
+    CDataStream ss(SER_NETWORK, nVersion);
+    ss << block;
+    return vData.size() == ss.size() && std::equal(vData.begin(), vData.end(), ss.begin());
+}
+
+BOOST_AUTO_TEST_CASE(raw_block_from_disk)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    CBlockIndex index;
+    uint256 hash;
+    CSerializeData vData;
+
+    // Stored bytes are what a witness peer gets from CDataStream << block
+    CBlock witnessBlock = RawTestBlock(true);
+    WriteRawTestBlock(witnessBlock, 9000, index, hash);
+    BOOST_CHECK(IsRawBlockSerialization(&index, true, consensusParams));
+    BOOST_CHECK(ReadRawBlockFromDisk(vData, &index, Params().MessageStart(), consensusParams));
+    BOOST_CHECK(RawBlockEquals(vData, witnessBlock, PROTOCOL_VERSION));
+    BOOST_CHECK(!RawBlockEquals(vData, witnessBlock, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+
+    // Before segwit activation blocks carry no witness data, so they serve non-witness peers as well
+    CBlock block = RawTestBlock(false);
+    WriteRawTestBlock(block, 9001, index, hash);
+    BOOST_CHECK(IsRawBlockSerialization(&index, false, consensusParams));
+    BOOST_CHECK(ReadRawBlockFromDisk(vData, &index, Params().MessageStart(), consensusParams));
+    BOOST_CHECK(RawBlockEquals(vData, block, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    BOOST_CHECK(RawBlockEquals(vData, block, PROTOCOL_VERSION));
+}
+
+BOOST_AUTO_TEST_CASE(raw_block_from_disk_corrupted)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    const CBlock block = RawTestBlock(true);
+    const unsigned int nSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+    const long nSizeOffset = -(long)sizeof(unsigned int);
+    const long nMagicOffset = nSizeOffset - MESSAGE_START_SIZE;
+    CBlockIndex index;
+    uint256 hash;
+    CSerializeData vData;
+    int nFile = 9100;
+
+    // magic
+    WriteRawTestBlock(block, nFile++, index, hash);
+    unsigned char badMagic[MESSAGE_START_SIZE] = {0xde, 0xad, 0xbe, 0xef};
+    CorruptRawTestBlock(index, nMagicOffset, badMagic, sizeof(badMagic));
+    BOOST_CHECK(!ReadRawBlockFromDisk(vData, &index, Params().MessageStart(), consensusParams));
+    BOOST_CHECK(vData.empty());
+
+    // size prefix: out of range, too short by a little and too long by a little
+    const unsigned int vBadSizes[] = {79, MAX_BLOCK_SERIALIZED_SIZE + 1, nSize - 1, nSize - 2, nSize + 1};
+    for (size_t i = 0; i < sizeof(vBadSizes) / sizeof(vBadSizes[0]); i++) {
+        WriteRawTestBlock(block, nFile++, index, hash);
+        CorruptRawTestBlock(index, nSizeOffset, &vBadSizes[i], sizeof(vBadSizes[i]));
+        BOOST_CHECK(!ReadRawBlockFromDisk(vData, &index, Params().MessageStart(), consensusParams));
+        BOOST_CHECK(vData.empty());
+    }
+
+    // header
+    WriteRawTestBlock(block, nFile++, index, hash);
+    unsigned char badTime = 0xff;
+    CorruptRawTestBlock(index, 4 + 32 + 32, &badTime, 1);
+    BOOST_CHECK(!ReadRawBlockFromDisk(vData, &index, Params().MessageStart(), consensusParams));
+    BOOST_CHECK(vData.empty());
+
+    // the full read path the callers fall back to refuses the corrupted block as well
+    CBlock blockRead;
+    BOOST_CHECK(!ReadBlockFromDisk(blockRead, &index, consensusParams));
+}
+
+BOOST_AUTO_TEST_CASE(raw_block_from_disk_padded)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    // the last block of a file is followed by zero padding, and usually ends in zeros itself
+    const CBlock block = RawTestBlock(true, 0);
+    const unsigned int nSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+    const long nSizeOffset = -(long)sizeof(unsigned int);
+    CBlockIndex index;
+    uint256 hash;
+    CSerializeData vData;
+    int nFile = 9200;
+
+    WriteRawTestBlock(block, nFile++, index, hash);
+    PadRawTestBlockFile(index, 64);
+    BOOST_CHECK(ReadRawBlockFromDisk(vData, &index, Params().MessageStart(), consensusParams));
+    BOOST_CHECK(RawBlockEquals(vData, block, PROTOCOL_VERSION));
+
+    const unsigned int vBadSizes[] = {nSize - 3, nSize - 2, nSize - 1, nSize + 1, nSize + 2, nSize + 3, nSize + 8};
+    for (size_t i = 0; i < sizeof(vBadSizes) / sizeof(vBadSizes[0]); i++) {
+        WriteRawTestBlock(block, nFile++, index, hash);
+        PadRawTestBlockFile(index, 64);
+        CorruptRawTestBlock(index, nSizeOffset, &vBadSizes[i], sizeof(vBadSizes[i]));
+        BOOST_CHECK(!ReadRawBlockFromDisk(vData, &index, Params().MessageStart(), consensusParams));
+        BOOST_CHECK(vData.empty());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
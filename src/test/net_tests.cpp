@@ -164,4 +164,100 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+static void QueueSendBuffer(CNode* pnode, size_t nSize)
+{
+    pnode->vSendMsg.push_back(CSerializeData(nSize, 'x'));
+    pnode->nSendSize += nSize;
+}
+
+BOOST_AUTO_TEST_CASE(send_queue_partial_sends)
+{
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CNode node(INVALID_SOCKET, CAddress(CService(ipv4Addr, 7777), NODE_NETWORK), "", false);
+    LOCK(node.cs_vSend);
+    QueueSendBuffer(&node, 10);
+    QueueSendBuffer(&node, 20);
+    QueueSendBuffer(&node, 30);
+
+    // ends in the middle of the first buffer
+    BOOST_CHECK(!AdvanceSendQueue(&node, 4));
+    BOOST_CHECK_EQUAL(node.vSendMsg.size(), 3U);
+    BOOST_CHECK_EQUAL(node.nSendOffset, 4U);
+    BOOST_CHECK_EQUAL(node.nSendSize, 60U);
+    BOOST_CHECK(node.vSendBufferPool.empty());
+
+    // ends exactly on the boundary of the first buffer
+    BOOST_CHECK(AdvanceSendQueue(&node, 6));
+    BOOST_CHECK_EQUAL(node.vSendMsg.size(), 2U);
+    BOOST_CHECK_EQUAL(node.nSendOffset, 0U);
+    BOOST_CHECK_EQUAL(node.nSendSize, 50U);
+    BOOST_CHECK_EQUAL(node.vSendBufferPool.size(), 1U);
+
+    // steps over a whole buffer and ends inside the next one
+    BOOST_CHECK(!AdvanceSendQueue(&node, 25));
+    BOOST_CHECK_EQUAL(node.vSendMsg.size(), 1U);
+    BOOST_CHECK_EQUAL(node.nSendOffset, 5U);
+    BOOST_CHECK_EQUAL(node.nSendSize, 30U);
+    BOOST_CHECK_EQUAL(node.vSendBufferPool.size(), 2U);
+
+    // and again within the same buffer
+    BOOST_CHECK(!AdvanceSendQueue(&node, 5));
+    BOOST_CHECK_EQUAL(node.nSendOffset, 10U);
+    BOOST_CHECK_EQUAL(node.vSendBufferPool.size(), 2U);
+
+    // the rest of the queue goes out exactly
+    QueueSendBuffer(&node, 40);
+    BOOST_CHECK(AdvanceSendQueue(&node, 60));
+    BOOST_CHECK(node.vSendMsg.empty());
+    BOOST_CHECK_EQUAL(node.nSendOffset, 0U);
+    BOOST_CHECK_EQUAL(node.nSendSize, 0U);
+
+    // recycled buffers are empty but keep their memory
+    BOOST_CHECK_EQUAL(node.vSendBufferPool.size(), 4U);
+    for (size_t i = 0; i < node.vSendBufferPool.size(); i++) {
+        BOOST_CHECK(node.vSendBufferPool[i].empty());
+        BOOST_CHECK(node.vSendBufferPool[i].capacity() >= 10);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(send_queue_buffer_pool_limits)
+{
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CNode node(INVALID_SOCKET, CAddress(CService(ipv4Addr, 7777), NODE_NETWORK), "", false);
+    LOCK(node.cs_vSend);
+
+    // buffers that grew too large are freed instead of pooled
+    QueueSendBuffer(&node, MAX_POOLED_SEND_BUFFER_SIZE + 1);
+    BOOST_CHECK(AdvanceSendQueue(&node, MAX_POOLED_SEND_BUFFER_SIZE + 1));
+    BOOST_CHECK(node.vSendBufferPool.empty());
+
+    // the pool holds at most MAX_SEND_BUFFER_POOL buffers
+    size_t nTotal = 0;
+    for (size_t i = 0; i < MAX_SEND_BUFFER_POOL + 4; i++) {
+        QueueSendBuffer(&node, 100);
+        nTotal += 100;
+    }
+    BOOST_CHECK(AdvanceSendQueue(&node, nTotal));
+    BOOST_CHECK(node.vSendMsg.empty());
+    BOOST_CHECK_EQUAL(node.vSendBufferPool.size(), MAX_SEND_BUFFER_POOL);
+}
+
+BOOST_AUTO_TEST_CASE(net_message_type_index)
+{
+    const std::vector<std::string> &allMessages = getAllNetMessageTypes();
+    BOOST_CHECK_EQUAL(allMessages[GetNetMessageTypeIndex(NetMsgType::INV)], NetMsgType::INV);
+    BOOST_CHECK_EQUAL(allMessages[GetNetMessageTypeIndex(NetMsgType::TXLOCKVOTE)], NetMsgType::TXLOCKVOTE);
+
+    // Commands that are not the NetMsgType constants themselves are found by name
+    std::string strBlock(NetMsgType::BLOCK);
+    BOOST_CHECK_EQUAL(allMessages[GetNetMessageTypeIndex(strBlock.c_str())], NetMsgType::BLOCK);
+    char pchCommand[CMessageHeader::COMMAND_SIZE] = {'m', 'n', 'p'};
+    BOOST_CHECK_EQUAL(allMessages[GetNetMessageTypeIndex(pchCommand)], NetMsgType::MNPING);
+
+    BOOST_CHECK_EQUAL(GetNetMessageTypeIndex("dsr"), allMessages.size());
+    BOOST_CHECK_EQUAL(GetNetMessageTypeIndex(""), allMessages.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
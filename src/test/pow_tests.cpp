@@ -4,9 +4,13 @@
 
 #include "chain.h"
 #include "chainparams.h"
+#include "consensus/validation.h"
+#include "main.h"
 #include "pow.h"
+#include "primitives/precomputed_hash.h"
 #include "random.h"
 #include "util.h"
+#include "zerocoin.h"
 #include "test/test_bitcoin.h"
 
 #include <boost/test/unit_test.hpp>
@@ -71,6 +75,43 @@ BOOST_AUTO_TEST_CASE(get_next_work_upper_limit_actual)
     BOOST_CHECK_EQUAL(CalculateNextWorkRequired(&pindexLast, nLastRetargetTime, params), 0x1d00e1fd);
 }
 
+/* Test the 6 block lookback retarget and its per-index memo */
+BOOST_AUTO_TEST_CASE(get_next_work_lookback)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = Params().GetConsensus();
+
+    std::vector<CBlockIndex> blocks(9);
+    for (int i = 0; i < 9; i++) {
+        blocks[i].pprev = i ? &blocks[i - 1] : NULL;
+        blocks[i].nHeight = i;
+        blocks[i].nTime = 1500000000 + i * 60; // three times too fast
+        blocks[i].nBits = 0x1e0ffff0;
+    }
+
+    // no retarget between intervals, GetNextWorkRequired does not write the memo
+    BOOST_CHECK_EQUAL(GetNextWorkRequired(&blocks[6], NULL, params), 0x1e0ffff0U);
+    BOOST_CHECK_EQUAL(blocks[6].nNextWorkRequired, 0U);
+    SetNextWorkRequired(&blocks[6]);
+    BOOST_CHECK_EQUAL(blocks[6].nNextWorkRequired, 0x1e0ffff0U);
+
+    // clamped to the 6% step, same result from the memo
+    arith_uint256 bnExpected = arith_uint256().SetCompact(0x1e0ffff0) * (1080 * 100 / 106) / 1080;
+    BOOST_CHECK_EQUAL(GetNextWorkRequired(&blocks[8], NULL, params), bnExpected.GetCompact());
+    SetNextWorkRequired(&blocks[8]);
+    BOOST_CHECK_EQUAL(blocks[8].nNextWorkRequired, bnExpected.GetCompact());
+    BOOST_CHECK_EQUAL(GetNextWorkRequired(&blocks[8], NULL, params), bnExpected.GetCompact());
+
+    // capped at the proof of work limit
+    arith_uint256 bnLimit = ~arith_uint256(0) >> 16;
+    for (int i = 0; i < 9; i++) {
+        blocks[i].nTime = 1500000000 + i * 600;
+        blocks[i].nBits = bnLimit.GetCompact();
+        blocks[i].nNextWorkRequired = 0;
+    }
+    BOOST_CHECK_EQUAL(GetNextWorkRequired(&blocks[8], NULL, params), bnLimit.GetCompact());
+}
+
 BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
 {
     SelectParams(CBaseChainParams::MAIN);
@@ -95,4 +136,128 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(precomputed_pow_hash_table)
+{
+    uint256 hash;
+    BOOST_CHECK(GetPrecomputedPoWHashCount() > 0);
+    BOOST_CHECK(GetPrecomputedPoWHash(0, hash));
+    BOOST_CHECK_EQUAL(hash.GetHex(), "00000d76434e7e6c47395b56403b107785c3f3b3503ddd3b96de16fee98b1bf8");
+    BOOST_CHECK(GetPrecomputedPoWHash(1, hash));
+    BOOST_CHECK_EQUAL(hash.GetHex(), "00000da58fce09f363bf5bb42409fbc2aabfc8b58c2211b24a3d7e2a7deedc90");
+    BOOST_CHECK(GetPrecomputedPoWHash(GetPrecomputedPoWHashCount() - 1, hash));
+    BOOST_CHECK(!GetPrecomputedPoWHash(GetPrecomputedPoWHashCount(), hash));
+    BOOST_CHECK(!GetPrecomputedPoWHash(-1, hash));
+}
+
+// A chain of headers on top of hashPrev, none of them meeting a real target
+static std::vector<CBlockHeader> MakeTestHeaders(const uint256& hashPrev, unsigned int nBits, size_t nCount)
+{
+    std::vector<CBlockHeader> headers(nCount);
+    uint256 hashPrevBlock = hashPrev;
+    for (size_t i = 0; i < nCount; i++) {
+        headers[i].nVersion = 4;
+        headers[i].hashPrevBlock = hashPrevBlock;
+        headers[i].nTime = 1500000000 + i * 150;
+        headers[i].nBits = nBits;
+        headers[i].nNonce = i;
+        hashPrevBlock = headers[i].GetHash();
+    }
+    return headers;
+}
+
+// Index entry for a header, as AcceptBlockHeader adds it
+static CBlockIndex* AddTestHeaderIndex(const CBlockHeader& header, CBlockIndex* pprev, int nHeight)
+{
+    CBlockIndex* pindex = new CBlockIndex(header);
+    BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(header.GetHash(), pindex)).first;
+    pindex->phashBlock = &mi->first;
+    pindex->pprev = pprev;
+    pindex->nHeight = nHeight;
+    return pindex;
+}
+
+static void RemoveTestHeaderIndex(std::vector<CBlockIndex*>& vIndex)
+{
+    BOOST_FOREACH(CBlockIndex* pindex, vIndex) {
+        mapBlockIndex.erase(pindex->GetBlockHash());
+        delete pindex;
+    }
+    vIndex.clear();
+}
+
+BOOST_AUTO_TEST_CASE(precompute_headers_pow)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const CChainParams& chainparams = Params();
+    const Consensus::Params& params = chainparams.GetConsensus();
+    std::vector<CBlockIndex*> vIndex;
+    CValidationState state;
+
+    // below height 233000 targets aren't enforced, so the whole batch gets hashed
+    CBlockHeader parent;
+    parent.nNonce = 1;
+    {
+        LOCK(cs_main);
+        vIndex.push_back(AddTestHeaderIndex(parent, NULL, 232000));
+    }
+    std::vector<CBlockHeader> headers = MakeTestHeaders(parent.GetHash(), UintToArith256(params.powLimit).GetCompact(), 20);
+    PrecomputeHeadersPoW(headers, chainparams);
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < headers.size(); i++) {
+            BOOST_CHECK(headers[i].IsComputed());
+            // the height CheckBlockHeader uses once the previous header is in the index
+            int nHeight = ZerocoinGetNHeight(headers[i]);
+            BOOST_CHECK_EQUAL(nHeight, 232001 + (int)i);
+            BOOST_CHECK(headers[i].powHash == headers[i].GetPoWHash(nHeight));
+            BOOST_CHECK(CheckBlockHeader(headers[i], state, params));
+            vIndex.push_back(AddTestHeaderIndex(headers[i], vIndex.back(), nHeight));
+        }
+    }
+
+    // headers already in the index are not hashed again, the new ones after them are
+    std::vector<CBlockHeader> moreHeaders = MakeTestHeaders(headers.back().GetHash(), headers.back().nBits, 3);
+    headers = MakeTestHeaders(parent.GetHash(), UintToArith256(params.powLimit).GetCompact(), 20);
+    headers.insert(headers.end(), moreHeaders.begin(), moreHeaders.end());
+    PrecomputeHeadersPoW(headers, chainparams);
+    for (size_t i = 0; i < headers.size(); i++)
+        BOOST_CHECK_EQUAL(headers[i].IsComputed(), i >= 20);
+
+    // nothing is hashed for headers outside the chain: an unknown parent, or past a break in the batch
+    headers = MakeTestHeaders(uint256S("0x1234"), headers.back().nBits, 3);
+    PrecomputeHeadersPoW(headers, chainparams);
+    BOOST_FOREACH(const CBlockHeader& header, headers)
+        BOOST_CHECK(!header.IsComputed());
+    headers = MakeTestHeaders(vIndex.back()->GetBlockHash(), vIndex.back()->nBits, 3);
+    headers[2].hashPrevBlock = headers[0].GetHash();
+    PrecomputeHeadersPoW(headers, chainparams);
+    BOOST_CHECK(headers[0].IsComputed() && headers[1].IsComputed() && !headers[2].IsComputed());
+
+    // above it a header missing its target is rejected with the precomputed hash, with a stored hash that
+    // misses the target, and with a header changed after hashing
+    CBlockHeader parentHigh;
+    parentHigh.nNonce = 2;
+    {
+        LOCK(cs_main);
+        vIndex.push_back(AddTestHeaderIndex(parentHigh, NULL, 240000));
+    }
+    headers = MakeTestHeaders(parentHigh.GetHash(), 0x1d00ffff, 2);
+    PrecomputeHeadersPoW(headers, chainparams);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(headers[0].IsComputed());
+        BOOST_CHECK(!CheckBlockHeader(headers[0], state, params));
+
+        headers[0].SetPoWHash(uint256S("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"));
+        BOOST_CHECK(!CheckBlockHeader(headers[0], state, params));
+
+        headers[0].SetPoWHash(uint256());
+        headers[0].nNonce++;
+        BOOST_CHECK(!headers[0].IsComputed());
+        BOOST_CHECK(!CheckBlockHeader(headers[0], state, params));
+
+        RemoveTestHeaderIndex(vIndex);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
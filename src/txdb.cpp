@@ -20,6 +20,7 @@ static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_BLOCK_POWHASH = 'w';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
@@ -144,6 +145,8 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     batch.Write(DB_LAST_BLOCK, nLastFile);
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
+        if (!(*it)->hashPoW.IsNull())
+            batch.Write(make_pair(DB_BLOCK_POWHASH, (*it)->GetBlockHash()), (*it)->hashPoW);
     }
     return WriteBatch(batch, true);
 }
@@ -200,9 +203,7 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
                 pindexNew->nStatus        = diskindex.nStatus;
                 pindexNew->nTx            = diskindex.nTx;
 
-                pindexNew->accumulatorChanges = diskindex.accumulatorChanges;
-                pindexNew->mintedPubCoins     = diskindex.mintedPubCoins;
-                pindexNew->spentSerials       = diskindex.spentSerials;
+                pindexNew->zerocoinData   = diskindex.zerocoinData;
 
 /*
                 if (!CheckProofOfWork(pindexNew->GetBlockPoWHash(), pindexNew->nBits, Params().GetConsensus(),pindexNew->nHeight))
@@ -218,6 +219,22 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
         }
     }
 
+    // Load the PoW hashes stored next to the index entries
+    pcursor->Seek(make_pair(DB_BLOCK_POWHASH, uint256()));
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, uint256> key;
+        if (pcursor->GetKey(key) && key.first == DB_BLOCK_POWHASH) {
+            uint256 hashPoW;
+            if (!pcursor->GetValue(hashPoW))
+                return error("LoadBlockIndex() : failed to read PoW hash");
+            insertBlockIndex(key.second)->hashPoW = hashPoW;
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
     return true;
 }
 
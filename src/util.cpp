@@ -200,6 +200,51 @@ static FILE* fileout = NULL;
 static boost::mutex* mutexDebugLog = NULL;
 static list<string> *vMsgsBeforeOpenLog;
 
+/**
+ * Asynchronous debug.log writing. Every logging thread queues its messages
+ * in a ring of its own: only that thread adds to it, and only a holder of
+ * mutexDebugLog (normally the writer thread) takes from it, so queueing a
+ * message takes no lock. Messages carry a global sequence number. A thread
+ * may take its number and publish the message a little later, so the writer
+ * only writes up to the first number it hasn't seen yet and keeps the rest
+ * for the next batch.
+ */
+static const size_t LOG_RING_SIZE = 1024;
+static const int LOG_WRITER_INTERVAL_MS = 100;
+
+struct CLogRing
+{
+    std::string vMessages[LOG_RING_SIZE];
+    uint64_t vSequence[LOG_RING_SIZE];
+    // next slot to take, only advanced by the reader
+    std::atomic<size_t> nHead;
+    // next slot to fill, only advanced by the owning thread
+    std::atomic<size_t> nTail;
+    // the owning thread exited, the ring goes away once it's empty
+    std::atomic<bool> fOrphaned;
+
+    CLogRing() : nHead(0), nTail(0), fOrphaned(false) {}
+};
+
+struct CLogRingHandle
+{
+    boost::shared_ptr<CLogRing> ring;
+
+    CLogRingHandle(const boost::shared_ptr<CLogRing>& ringIn) : ring(ringIn) {}
+    ~CLogRingHandle() { ring->fOrphaned = true; }
+};
+
+// rings of all logging threads, guarded by mutexDebugLog
+static vector<boost::shared_ptr<CLogRing> >* vLogRings = NULL;
+static boost::thread_specific_ptr<CLogRingHandle>* ptrLogRing = NULL;
+static boost::condition_variable* condLogWriter = NULL;
+static boost::thread* threadLogWriter = NULL;
+static std::atomic<bool> fLogWriterRunning(false);
+static std::atomic<uint64_t> nLogSequence(0);
+// next sequence number to write and the messages waiting for it, guarded by mutexDebugLog
+static uint64_t nLogNextWrite = 0;
+static vector<pair<uint64_t, string> >* vLogHeldBack = NULL;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
@@ -210,6 +255,10 @@ static void DebugPrintInit()
     assert(mutexDebugLog == NULL);
     mutexDebugLog = new boost::mutex();
     vMsgsBeforeOpenLog = new list<string>;
+    vLogRings = new vector<boost::shared_ptr<CLogRing> >;
+    vLogHeldBack = new vector<pair<uint64_t, string> >;
+    ptrLogRing = new boost::thread_specific_ptr<CLogRingHandle>;
+    condLogWriter = new boost::condition_variable;
 }
 
 void OpenDebugLog()
@@ -233,6 +282,147 @@ void OpenDebugLog()
     vMsgsBeforeOpenLog = NULL;
 }
 
+/** Queue a message in the ring of this thread, false if the ring is full */
+static bool QueueLogMessage(std::string &str)
+{
+    CLogRingHandle* handle = ptrLogRing->get();
+    if (handle == NULL) {
+        boost::shared_ptr<CLogRing> ring(new CLogRing);
+        {
+            boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+            vLogRings->push_back(ring);
+        }
+        handle = new CLogRingHandle(ring);
+        ptrLogRing->reset(handle);
+    }
+
+    CLogRing& ring = *handle->ring;
+    size_t nTail = ring.nTail.load(std::memory_order_relaxed);
+    size_t nQueued = nTail - ring.nHead.load(std::memory_order_acquire);
+    if (nQueued == LOG_RING_SIZE)
+        return false;
+
+    size_t nSlot = nTail % LOG_RING_SIZE;
+    ring.vSequence[nSlot] = nLogSequence++;
+    ring.vMessages[nSlot].swap(str);
+    ring.nTail.store(nTail + 1, std::memory_order_release);
+
+    // the writer wakes up on its own often enough, unless the ring fills up
+    if (nQueued + 1 == LOG_RING_SIZE / 2)
+        condLogWriter->notify_one();
+    return true;
+}
+
+static int WriteDebugLogStr(const std::string &str)
+{
+    // buffer if we haven't opened the log yet
+    if (fileout == NULL) {
+        assert(vMsgsBeforeOpenLog);
+        vMsgsBeforeOpenLog->push_back(str);
+        return str.length();
+    }
+
+    // reopen the log file, if requested
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
+            setbuf(fileout, NULL); // unbuffered
+    }
+
+    return FileWriteStr(str, fileout);
+}
+
+/**
+ * Write out the queued messages of all threads in one go, in sequence order up
+ * to the first message that isn't published yet. fAll writes everything, for
+ * when the writer stops. Requires mutexDebugLog
+ */
+static void WriteQueuedLogMessages(bool fAll = false)
+{
+    vector<pair<uint64_t, string> > vBatch;
+    vBatch.swap(*vLogHeldBack);
+    for (size_t i = 0; i < vLogRings->size(); ) {
+        CLogRing& ring = *(*vLogRings)[i];
+        // read the flag first: once set, nothing is queued after the tail read below
+        bool fOrphaned = ring.fOrphaned;
+        size_t nHead = ring.nHead.load(std::memory_order_relaxed);
+        size_t nTail = ring.nTail.load(std::memory_order_acquire);
+        for (; nHead != nTail; nHead++) {
+            size_t nSlot = nHead % LOG_RING_SIZE;
+            vBatch.push_back(make_pair(ring.vSequence[nSlot], string()));
+            vBatch.back().second.swap(ring.vMessages[nSlot]);
+        }
+        ring.nHead.store(nHead, std::memory_order_release);
+
+        if (fOrphaned) {
+            (*vLogRings)[i] = vLogRings->back();
+            vLogRings->pop_back();
+        } else {
+            i++;
+        }
+    }
+    if (vBatch.empty())
+        return;
+
+    sort(vBatch.begin(), vBatch.end());
+    string strBatch;
+    size_t i = 0;
+    for (; i < vBatch.size(); i++) {
+        // numbers below nLogNextWrite were passed over by a forced flush, write them as they come
+        if (vBatch[i].first > nLogNextWrite && !fAll)
+            break;
+        nLogNextWrite = std::max(nLogNextWrite, vBatch[i].first + 1);
+        strBatch += vBatch[i].second;
+    }
+    vLogHeldBack->assign(vBatch.begin() + i, vBatch.end());
+    if (!strBatch.empty())
+        WriteDebugLogStr(strBatch);
+}
+
+static void ThreadDebugLogWriter()
+{
+    RenameThread("bitcoin-log");
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    while (true) {
+        WriteQueuedLogMessages();
+        if (!fLogWriterRunning)
+            break;
+        condLogWriter->timed_wait(scoped_lock, boost::posix_time::milliseconds(LOG_WRITER_INTERVAL_MS));
+    }
+}
+
+void StartDebugLogWriter()
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    if (threadLogWriter)
+        return;
+    fLogWriterRunning = true;
+    threadLogWriter = new boost::thread(&ThreadDebugLogWriter);
+}
+
+void StopDebugLogWriter()
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    boost::thread* thread;
+    {
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        thread = threadLogWriter;
+        threadLogWriter = NULL;
+        fLogWriterRunning = false;
+    }
+    if (!thread)
+        return;
+    condLogWriter->notify_one();
+    thread->join();
+    delete thread;
+
+    // whatever got queued while the writer was finishing
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    WriteQueuedLogMessages(true);
+}
+
 bool LogAcceptCategory(const char* category)
 {
     if (category != NULL)
@@ -244,20 +434,33 @@ bool LogAcceptCategory(const char* category)
         // This helps prevent issues debugging global destructors,
         // where mapMultiArgs might be deleted before another
         // global destructor calls LogPrint()
-        static boost::thread_specific_ptr<set<string> > ptrCategory;
+        struct CLogCategories
+        {
+            set<string> setCategories;
+            // categories are string literals, remember the answer by address
+            map<const char*, bool> mapAccepted;
+        };
+        static boost::thread_specific_ptr<CLogCategories> ptrCategory;
         if (ptrCategory.get() == NULL)
         {
             const vector<string>& categories = mapMultiArgs["-debug"];
-            ptrCategory.reset(new set<string>(categories.begin(), categories.end()));
+            ptrCategory.reset(new CLogCategories);
+            ptrCategory->setCategories.insert(categories.begin(), categories.end());
             // thread_specific_ptr automatically deletes the set when the thread ends.
         }
-        const set<string>& setCategories = *ptrCategory.get();
+        CLogCategories& logCategories = *ptrCategory.get();
+
+        map<const char*, bool>::const_iterator it = logCategories.mapAccepted.find(category);
+        if (it != logCategories.mapAccepted.end())
+            return it->second;
 
         // if not debugging everything and not debugging specific category, LogPrint does nothing.
-        if (setCategories.count(string("")) == 0 &&
-            setCategories.count(string("1")) == 0 &&
-            setCategories.count(string(category)) == 0)
-            return false;
+        const set<string>& setCategories = logCategories.setCategories;
+        bool fAccepted = setCategories.count(string("")) != 0 ||
+                         setCategories.count(string("1")) != 0 ||
+                         setCategories.count(string(category)) != 0;
+        logCategories.mapAccepted[category] = fAccepted;
+        return fAccepted;
     }
     return true;
 }
@@ -307,26 +510,20 @@ int LogPrintStr(const std::string &str)
     else if (fPrintToDebugLog)
     {
         boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+        ret = strTimestamped.length();
+
+        // leave the write to the writer thread. Check it's still there after queueing, if it
+        // stopped meanwhile the message may have missed its last round
+        bool fQueued = fLogWriterRunning && QueueLogMessage(strTimestamped);
+        if (fQueued && fLogWriterRunning)
+            return ret;
+
         boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
 
-        // buffer if we haven't opened the log yet
-        if (fileout == NULL) {
-            assert(vMsgsBeforeOpenLog);
-            ret = strTimestamped.length();
-            vMsgsBeforeOpenLog->push_back(strTimestamped);
-        }
-        else
-        {
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-                if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
-                    setbuf(fileout, NULL); // unbuffered
-            }
-
-            ret = FileWriteStr(strTimestamped, fileout);
-        }
+        // keep the order: whatever is queued goes first
+        WriteQueuedLogMessages(!fLogWriterRunning);
+        if (!fQueued)
+            ret = WriteDebugLogStr(strTimestamped);
     }
     return ret;
 }
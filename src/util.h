@@ -33,6 +33,7 @@
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
+static const bool DEFAULT_LOGASYNC      = false;
 
 /** Signals for translation. */
 class CTranslationInterface
@@ -90,20 +91,38 @@ inline int64_t roundint64(double d)
 void SetupEnvironment();
 bool SetupNetworking();
 
-/** Return true if log accepts specified category */
+/** Return true if log accepts specified category. Categories are string literals, answers are cached by address */
 bool LogAcceptCategory(const char* category);
 /** Send a string to the log output */
 int LogPrintStr(const std::string &str);
 
-#define LogPrintf(...) LogPrint(NULL, __VA_ARGS__)
+/** Hand debug.log writes to a background thread, logging threads only queue their messages */
+void StartDebugLogWriter();
+/** Write out everything queued and go back to writing debug.log from the logging threads */
+void StopDebugLogWriter();
 
-template<typename T1, typename... Args>
-static inline int LogPrint(const char* category, const char* fmt, const T1& v1, const Args&... args)
+/** Format a log message. A bare string is not a format string, it's logged as is */
+template<typename... Args>
+static inline std::string LogFormat(const char* fmt, const Args&... args)
+{
+    return tfm::format(fmt, args...);
+}
+static inline std::string LogFormat(const char* s)
 {
-    if(!LogAcceptCategory(category)) return 0;
-    return LogPrintStr(tfm::format(fmt, v1, args...));
+    return s;
 }
 
+/**
+ * The arguments are only evaluated and formatted if the category is enabled,
+ * a disabled category costs a single check
+ */
+#define LogPrint(category, ...) do { \
+    if (LogAcceptCategory(category)) \
+        LogPrintStr(LogFormat(__VA_ARGS__)); \
+} while (0)
+
+#define LogPrintf(...) LogPrint(NULL, __VA_ARGS__)
+
 template<typename T1, typename... Args>
 bool error(const char* fmt, const T1& v1, const Args&... args)
 {
@@ -112,15 +131,9 @@ bool error(const char* fmt, const T1& v1, const Args&... args)
 }
 
 /**
- * Zero-arg versions of logging and error, these are not covered by
- * the variadic templates above (and don't take format arguments but
- * bare strings).
+ * Zero-arg version of error, this is not covered by the variadic
+ * template above (and doesn't take format arguments but bare strings).
  */
-static inline int LogPrint(const char* category, const char* s)
-{
-    if(!LogAcceptCategory(category)) return 0;
-    return LogPrintStr(s);
-}
 static inline bool error(const char* s)
 {
     LogPrintStr(std::string("ERROR: ") + s + "\n");
@@ -2711,7 +2711,6 @@ UniValue mintzerocoin(const UniValue& params, bool fHelp)
         if (strError != "")
             throw JSONRPCError(RPC_WALLET_ERROR, strError);
 
-        CWalletDB walletdb(pwalletMain->strWalletFile);
         CZerocoinEntry zerocoinTx;
         zerocoinTx.IsUsed = false;
         zerocoinTx.denomination = denomination;
@@ -2722,7 +2721,7 @@ UniValue mintzerocoin(const UniValue& params, bool fHelp)
         }
         zerocoinTx.randomness = newCoin.getRandomness();
         zerocoinTx.serialNumber = newCoin.getSerialNumber();
-        walletdb.WriteZerocoinEntry(zerocoinTx);
+        pwalletMain->WriteZerocoinEntry(zerocoinTx);
 
         return pubCoin.getValue().GetHex();
     } else {
@@ -2791,8 +2790,7 @@ UniValue resetmintzerocoin(const UniValue& params, bool fHelp) {
                 + HelpRequiringPassphrase());
 
     list <CZerocoinEntry> listPubcoin;
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    walletdb.ListPubCoin(listPubcoin);
+    pwalletMain->ListZerocoinEntries(listPubcoin);
 
     BOOST_FOREACH(const CZerocoinEntry &zerocoinItem, listPubcoin){
         if (zerocoinItem.randomness != 0 && zerocoinItem.serialNumber != 0) {
@@ -2803,7 +2801,7 @@ UniValue resetmintzerocoin(const UniValue& params, bool fHelp) {
             zerocoinTx.serialNumber = zerocoinItem.serialNumber;
             zerocoinTx.nHeight = -1;
             zerocoinTx.randomness = zerocoinItem.randomness;
-            walletdb.WriteZerocoinEntry(zerocoinTx);
+            pwalletMain->WriteZerocoinEntry(zerocoinTx);
         }
     }
 
@@ -2825,8 +2823,7 @@ UniValue listmintzerocoins(const UniValue& params, bool fHelp) {
     }
 
     list <CZerocoinEntry> listPubcoin;
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    walletdb.ListPubCoin(listPubcoin);
+    pwalletMain->ListZerocoinEntries(listPubcoin);
     UniValue results(UniValue::VARR);
 
     BOOST_FOREACH(const CZerocoinEntry &zerocoinItem, listPubcoin) {
@@ -2861,8 +2858,7 @@ UniValue listpubcoins(const UniValue& params, bool fHelp) {
     }
 
     list <CZerocoinEntry> listPubcoin;
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    walletdb.ListPubCoin(listPubcoin);
+    pwalletMain->ListZerocoinEntries(listPubcoin);
     UniValue results(UniValue::VARR);
     listPubcoin.sort(CompID);
 
@@ -2898,8 +2894,7 @@ UniValue setmintzerocoinstatus(const UniValue& params, bool fHelp) {
     fStatus = params[1].get_bool();
 
     list <CZerocoinEntry> listPubcoin;
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    walletdb.ListPubCoin(listPubcoin);
+    pwalletMain->ListZerocoinEntries(listPubcoin);
 
     UniValue results(UniValue::VARR);
 
@@ -2917,7 +2912,7 @@ UniValue setmintzerocoinstatus(const UniValue& params, bool fHelp) {
                 zerocoinTx.nHeight = zerocoinItem.nHeight;
                 zerocoinTx.randomness = zerocoinItem.randomness;
                 pwalletMain->NotifyZerocoinChanged(pwalletMain, zerocoinTx.value.GetHex(), zerocoinTx.IsUsed ? "Used" : "New", CT_UPDATED);
-                walletdb.WriteZerocoinEntry(zerocoinTx);
+                pwalletMain->WriteZerocoinEntry(zerocoinTx);
 
                 UniValue entry(UniValue::VOBJ);
                 entry.push_back(Pair("id", zerocoinTx.id));
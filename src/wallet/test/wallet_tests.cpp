@@ -351,4 +351,111 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 2U);
 }
 
+BOOST_AUTO_TEST_CASE(zerocoin_entries)
+{
+    CWallet zerocoinWallet;
+
+    CZerocoinEntry mint;
+    mint.value = 1001;
+    mint.denomination = 10;
+    mint.randomness = 7;
+    mint.serialNumber = 11;
+    BOOST_CHECK(zerocoinWallet.LoadZerocoinEntry(mint));
+
+    CZerocoinEntry otherMint = mint;
+    otherMint.value = 1000;
+    otherMint.denomination = 1;
+    BOOST_CHECK(zerocoinWallet.LoadZerocoinEntry(otherMint));
+
+    // mints are listed by pubcoin value
+    list<CZerocoinEntry> listEntries;
+    zerocoinWallet.ListZerocoinEntries(listEntries);
+    BOOST_CHECK_EQUAL(listEntries.size(), 2U);
+    BOOST_CHECK(listEntries.front().value == otherMint.value);
+
+    // an update replaces the stored entry
+    mint.IsUsed = true;
+    mint.id = 3;
+    BOOST_CHECK(zerocoinWallet.WriteZerocoinEntry(mint));
+    CZerocoinEntry entry;
+    BOOST_CHECK(zerocoinWallet.GetZerocoinEntry(mint.value, entry));
+    BOOST_CHECK(entry.IsUsed);
+    BOOST_CHECK_EQUAL(entry.id, 3);
+
+    listEntries.clear();
+    zerocoinWallet.ListZerocoinEntries(listEntries);
+    BOOST_CHECK_EQUAL(listEntries.size(), 2U);
+
+    BOOST_CHECK(!zerocoinWallet.GetZerocoinEntry(CBigNum(999), entry));
+}
+
+static CZerocoinEntry ZerocoinTestMint(int value, int denomination, int nHeight, bool fUsed)
+{
+    CZerocoinEntry mint;
+    mint.value = value;
+    mint.denomination = denomination;
+    mint.randomness = 7;
+    mint.serialNumber = value + 1;
+    mint.nHeight = nHeight;
+    mint.IsUsed = fUsed;
+    return mint;
+}
+
+static std::vector<int> SpendableZerocoinValues(const CWallet& wallet, int denomination)
+{
+    std::vector<CZerocoinEntry> vEntries;
+    wallet.ListSpendableZerocoins(denomination, vEntries);
+    std::vector<int> vValues;
+    BOOST_FOREACH(const CZerocoinEntry& entry, vEntries)
+        vValues.push_back(entry.value.getint());
+    return vValues;
+}
+
+BOOST_AUTO_TEST_CASE(zerocoin_spendable_entries)
+{
+    CWallet zerocoinWallet;
+
+    // coin selection tries the unused mints of a denomination by wallet height, not by pubcoin value
+    BOOST_CHECK(zerocoinWallet.LoadZerocoinEntry(ZerocoinTestMint(500, 10, 30, false)));
+    BOOST_CHECK(zerocoinWallet.LoadZerocoinEntry(ZerocoinTestMint(600, 10, 10, false)));
+    BOOST_CHECK(zerocoinWallet.LoadZerocoinEntry(ZerocoinTestMint(700, 10, 20, true)));
+    BOOST_CHECK(zerocoinWallet.LoadZerocoinEntry(ZerocoinTestMint(800, 10, 20, false)));
+    BOOST_CHECK(zerocoinWallet.LoadZerocoinEntry(ZerocoinTestMint(900, 1, 5, false)));
+    // not spendable without its secrets
+    CZerocoinEntry noSecrets = ZerocoinTestMint(400, 10, 1, false);
+    noSecrets.randomness = 0;
+    BOOST_CHECK(zerocoinWallet.LoadZerocoinEntry(noSecrets));
+
+    std::vector<int> vExpected = {600, 800, 500};
+    BOOST_CHECK(SpendableZerocoinValues(zerocoinWallet, 10) == vExpected);
+    vExpected = {900};
+    BOOST_CHECK(SpendableZerocoinValues(zerocoinWallet, 1) == vExpected);
+    BOOST_CHECK(SpendableZerocoinValues(zerocoinWallet, 100).empty());
+
+    // same height: ties go by pubcoin value
+    BOOST_CHECK(zerocoinWallet.LoadZerocoinEntry(ZerocoinTestMint(650, 10, 20, false)));
+    vExpected = {600, 650, 800, 500};
+    BOOST_CHECK(SpendableZerocoinValues(zerocoinWallet, 10) == vExpected);
+
+    // spending a mint takes it out, a failed spend puts it back
+    CZerocoinEntry mint;
+    BOOST_CHECK(zerocoinWallet.GetZerocoinEntry(CBigNum(600), mint));
+    mint.IsUsed = true;
+    BOOST_CHECK(zerocoinWallet.WriteZerocoinEntry(mint));
+    vExpected = {650, 800, 500};
+    BOOST_CHECK(SpendableZerocoinValues(zerocoinWallet, 10) == vExpected);
+    BOOST_CHECK(zerocoinWallet.GetZerocoinEntry(CBigNum(700), mint));
+    mint.IsUsed = false;
+    BOOST_CHECK(zerocoinWallet.WriteZerocoinEntry(mint));
+    vExpected = {650, 700, 800, 500};
+    BOOST_CHECK(SpendableZerocoinValues(zerocoinWallet, 10) == vExpected);
+
+    // a mint that moves to another height is listed once, at its new place
+    BOOST_CHECK(zerocoinWallet.GetZerocoinEntry(CBigNum(500), mint));
+    mint.nHeight = 2;
+    BOOST_CHECK(zerocoinWallet.WriteZerocoinEntry(mint));
+    vExpected = {500, 650, 700, 800};
+    BOOST_CHECK(SpendableZerocoinValues(zerocoinWallet, 10) == vExpected);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
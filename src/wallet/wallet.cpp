@@ -1049,6 +1049,11 @@ void CWallet::SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex,
     }
 }
 
+void CWallet::UpdatedBlockTip(const CBlockIndex *pindex) {
+    // Spread the cost of zerocoin witnesses over block arrivals instead of paying it all at spend time
+    UpdateZerocoinWitnesses();
+}
+
 
 isminetype CWallet::IsMine(const CTxIn &txin) const {
     {
@@ -2212,39 +2217,83 @@ bool CWallet::GetVinAndKeysFromOutput(COutput out, CTxIn &txinRet, CPubKey &pubK
     return true;
 }
 
+static bool IsSpendableZerocoin(const CZerocoinEntry &zerocoinEntry) {
+    return !zerocoinEntry.IsUsed && zerocoinEntry.randomness != 0 && zerocoinEntry.serialNumber != 0;
+}
+
+bool CWallet::LoadZerocoinEntry(const CZerocoinEntry &zerocoinEntry) {
+    LOCK(cs_wallet);
+    map<CBigNum, CZerocoinEntry>::iterator it = mapZerocoinEntries.find(zerocoinEntry.value);
+    if (it != mapZerocoinEntries.end())
+        mapSpendableZerocoins[it->second.denomination].erase(make_pair(it->second.nHeight, it->second.value));
+
+    mapZerocoinEntries[zerocoinEntry.value] = zerocoinEntry;
+    if (IsSpendableZerocoin(zerocoinEntry))
+        mapSpendableZerocoins[zerocoinEntry.denomination].insert(make_pair(zerocoinEntry.nHeight, zerocoinEntry.value));
+    return true;
+}
+
+bool CWallet::WriteZerocoinEntry(const CZerocoinEntry &zerocoinEntry) {
+    LOCK(cs_wallet);
+    if (fFileBacked && !CWalletDB(strWalletFile).WriteZerocoinEntry(zerocoinEntry))
+        return false;
+    return LoadZerocoinEntry(zerocoinEntry);
+}
+
+bool CWallet::GetZerocoinEntry(const CBigNum &value, CZerocoinEntry &zerocoinEntryRet) const {
+    LOCK(cs_wallet);
+    map<CBigNum, CZerocoinEntry>::const_iterator it = mapZerocoinEntries.find(value);
+    if (it == mapZerocoinEntries.end())
+        return false;
+    zerocoinEntryRet = it->second;
+    return true;
+}
+
+void CWallet::ListZerocoinEntries(list <CZerocoinEntry> &listZerocoinEntriesRet) const {
+    LOCK(cs_wallet);
+    for (map<CBigNum, CZerocoinEntry>::const_iterator it = mapZerocoinEntries.begin(); it != mapZerocoinEntries.end(); ++it)
+        listZerocoinEntriesRet.push_back(it->second);
+}
+
+void CWallet::ListSpendableZerocoins(int denomination, vector <CZerocoinEntry> &vZerocoinEntriesRet) const {
+    LOCK(cs_wallet);
+    map<int, set<pair<int, CBigNum> > >::const_iterator itDenom = mapSpendableZerocoins.find(denomination);
+    if (itDenom == mapSpendableZerocoins.end())
+        return;
+    BOOST_FOREACH(const PAIRTYPE(int, CBigNum) &spendable, itDenom->second)
+        vZerocoinEntriesRet.push_back(mapZerocoinEntries.find(spendable.second)->second);
+}
+
 //[zcoin]
 void CWallet::ListAvailableCoinsMintCoins(vector <COutput> &vCoins, bool fOnlyConfirmed) const {
     vCoins.clear();
     {
         LOCK(cs_wallet);
-        list <CZerocoinEntry> listPubCoin = list<CZerocoinEntry>();
-        CWalletDB walletdb(pwalletMain->strWalletFile);
-        walletdb.ListPubCoin(listPubCoin);
-        LogPrintf("listPubCoin.size()=%s\n", listPubCoin.size());
+        LogPrint("zerocoin", "mapZerocoinEntries.size()=%s\n", mapZerocoinEntries.size());
         for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
             const CWalletTx *pcoin = &(*it).second;
 //            LogPrintf("pcoin=%s\n", pcoin->GetHash().ToString());
             if (!CheckFinalTx(*pcoin)) {
-                LogPrintf("!CheckFinalTx(*pcoin)=%s\n", !CheckFinalTx(*pcoin));
+                LogPrint("zerocoin", "!CheckFinalTx(*pcoin)=%s\n", !CheckFinalTx(*pcoin));
                 continue;
             }
 
             if (fOnlyConfirmed && !pcoin->IsTrusted()) {
-                LogPrintf("fOnlyConfirmed = %s, !pcoin->IsTrusted()\n", fOnlyConfirmed, !pcoin->IsTrusted());
+                LogPrint("zerocoin", "fOnlyConfirmed = %s, !pcoin->IsTrusted()\n", fOnlyConfirmed, !pcoin->IsTrusted());
                 continue;
             }
 
             if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0) {
-                LogPrintf("Not trusted\n");
+                LogPrint("zerocoin", "Not trusted\n");
                 continue;
             }
 
             int nDepth = pcoin->GetDepthInMainChain();
             if (nDepth < 0) {
-                LogPrintf("nDepth=%s\n", nDepth);
+                LogPrint("zerocoin", "nDepth=%s\n", nDepth);
                 continue;
             }
-            LogPrintf("pcoin->vout.size()=%s\n", pcoin->vout.size());
+            LogPrint("zerocoin", "pcoin->vout.size()=%s\n", pcoin->vout.size());
 
             for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
                 if (pcoin->vout[i].scriptPubKey.IsZerocoinMint()) {
@@ -2255,19 +2304,12 @@ void CWallet::ListAvailableCoinsMintCoins(vector <COutput> &vCoins, bool fOnlyCo
 
                     CBigNum pubCoin;
                     pubCoin.setvch(vchZeroMint);
-                    LogPrintf("Pubcoin=%s\n", pubCoin.ToString());
+                    LogPrint("zerocoin", "Pubcoin=%s\n", pubCoin.ToString());
                     // CHECKING PROCESS
-                    BOOST_FOREACH(const CZerocoinEntry &pubCoinItem, listPubCoin) {
-//                        LogPrintf("*******\n");
-//                        LogPrintf("pubCoinItem.value=%s,\n", pubCoinItem.value.ToString());
-//                        LogPrintf("pubCoinItem.IsUsed=%s\n, ", pubCoinItem.IsUsed);
-//                        LogPrintf("pubCoinItem.randomness=%s\n, ", pubCoinItem.randomness);
-//                        LogPrintf("pubCoinItem.serialNumber=%s\n, ", pubCoinItem.serialNumber);
-                        if (pubCoinItem.value == pubCoin && pubCoinItem.IsUsed == false &&
-                            pubCoinItem.randomness != 0 && pubCoinItem.serialNumber != 0) {
-                            vCoins.push_back(COutput(pcoin, i, nDepth, true, true));
-                            LogPrintf("-->OK\n");
-                        }
+                    map<CBigNum, CZerocoinEntry>::const_iterator itEntry = mapZerocoinEntries.find(pubCoin);
+                    if (itEntry != mapZerocoinEntries.end() && IsSpendableZerocoin(itEntry->second)) {
+                        vCoins.push_back(COutput(pcoin, i, nDepth, true, true));
+                        LogPrint("zerocoin", "-->OK\n");
                     }
 
                 }
@@ -3225,7 +3267,7 @@ bool CWallet::CreateZerocoinMintModel(string &stringError, string denomAmount) {
         LogPrintf("pubcoin=%s, isUsed=%s\n", zerocoinTx.value.GetHex(), zerocoinTx.IsUsed);
         LogPrintf("randomness=%s, serialNumber=%s\n", zerocoinTx.randomness, zerocoinTx.serialNumber);
         NotifyZerocoinChanged(this, zerocoinTx.value.GetHex(), zerocoinTx.IsUsed ? "Used" : "New", CT_NEW);
-        if (!CWalletDB(strWalletFile).WriteZerocoinEntry(zerocoinTx))
+        if (!WriteZerocoinEntry(zerocoinTx))
             return false;
         return true;
     } else {
@@ -3617,6 +3659,143 @@ CWallet::CreateZerocoinMintTransaction(CScript pubCoin, int64_t nValue, CWalletT
  * @param strFailReason
  * @return
  */
+void CWallet::UpdateZerocoinWitness(CWalletDB &walletdb, const CZerocoinEntry &coin, int coinId, int maxHeight,
+                                    CZerocoinWitnessEntry &witness) {
+    AssertLockHeld(cs_main);
+
+    bool fStored = walletdb.ReadZerocoinWitness(coin.value, witness);
+    if (fStored && (witness.denomination != coin.denomination || witness.id != coinId ||
+                    witness.nHeight < 0 || witness.nHeight > maxHeight ||
+                    chainActive[witness.nHeight]->GetBlockHash() != witness.blockHash)) {
+        // stored witness doesn't belong to the active chain anymore
+        LogPrint("zerocoin", "UpdateZerocoinWitness: rebuilding witness for coin id %d after reorganization\n", coinId);
+        fStored = false;
+    }
+
+    if (!fStored) {
+        witness.SetNull();
+        witness.pubCoin = coin.value;
+        witness.denomination = coin.denomination;
+        witness.id = coinId;
+    }
+
+    CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
+    int nAdded = zerocoinState->AdvanceWitness(maxHeight, coin.denomination, coinId, coin.value,
+                                               witness.witnessValue, witness.nHeight);
+    witness.blockHash = chainActive[witness.nHeight]->GetBlockHash();
+
+    // no new coins in the group: the stored witness is still valid for this chain, don't rewrite it
+    if (!fStored || nAdded > 0)
+        walletdb.WriteZerocoinWitness(witness);
+}
+
+void CWallet::UpdateZerocoinWitnesses() {
+    if (!fFileBacked || IsInitialBlockDownload())
+        return;
+
+    CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
+    CWalletDB walletdb(strWalletFile);
+
+    // Witness update of one coin. Filled under cs_main, the exponentiations are done after it's released
+    struct CWitnessUpdate {
+        CZerocoinEntry coin;
+        CZerocoinWitnessEntry witness;
+        bool fStored;
+        vector<CBigNum> coinsToAdd;
+    };
+    vector<CWitnessUpdate> vUpdates;
+
+    {
+        LOCK(cs_wallet);
+        for (map<CBigNum, CZerocoinEntry>::const_iterator it = mapZerocoinEntries.begin(); it != mapZerocoinEntries.end(); ++it) {
+            const CZerocoinEntry &coin = it->second;
+            CWitnessUpdate update;
+            if (coin.IsUsed) {
+                if (walletdb.ReadZerocoinWitness(coin.value, update.witness))
+                    walletdb.EraseZerocoinWitness(coin.value);
+                continue;
+            }
+
+            if (coin.randomness == 0 || coin.serialNumber == 0)
+                continue;
+
+            update.coin = coin;
+            update.fStored = walletdb.ReadZerocoinWitness(coin.value, update.witness);
+            vUpdates.push_back(update);
+        }
+    }
+
+    if (vUpdates.empty())
+        return;
+
+    int maxHeight;
+    uint256 maxHeightHash;
+    {
+        LOCK(cs_main);
+
+        maxHeight = chainActive.Height() - (ZC_MINT_CONFIRMATIONS-1);
+        if (maxHeight <= 0)
+            return;
+        maxHeightHash = chainActive[maxHeight]->GetBlockHash();
+
+        for (vector<CWitnessUpdate>::iterator it = vUpdates.begin(); it != vUpdates.end(); ) {
+            const CZerocoinEntry &coin = it->coin;
+            CZerocoinWitnessEntry &witness = it->witness;
+
+            int id;
+            int mintHeight = zerocoinState->GetMintedCoinHeightAndId(coin.value, coin.denomination, id);
+            if (mintHeight <= 0 || mintHeight > maxHeight) {
+                it = vUpdates.erase(it);
+                continue;
+            }
+
+            if (it->fStored && (witness.denomination != coin.denomination || witness.id != id ||
+                                witness.nHeight < 0 || witness.nHeight > maxHeight ||
+                                chainActive[witness.nHeight]->GetBlockHash() != witness.blockHash)) {
+                // stored witness doesn't belong to the active chain anymore
+                LogPrint("zerocoin", "UpdateZerocoinWitnesses: rebuilding witness for coin id %d after reorganization\n", id);
+                it->fStored = false;
+            }
+
+            if (!it->fStored) {
+                witness.SetNull();
+                witness.pubCoin = coin.value;
+                witness.denomination = coin.denomination;
+                witness.id = id;
+            }
+
+            int nAdded = zerocoinState->GetWitnessUpdate(maxHeight, coin.denomination, id, coin.value,
+                                                         witness.witnessValue, witness.nHeight, it->coinsToAdd);
+            // no new coins in the group: the stored witness is still valid for this chain, don't rewrite it
+            if (it->fStored && nAdded == 0) {
+                it = vUpdates.erase(it);
+                continue;
+            }
+
+            witness.nHeight = maxHeight;
+            witness.blockHash = maxHeightHash;
+            ++it;
+        }
+    }
+
+    BOOST_FOREACH(CWitnessUpdate &update, vUpdates)
+        CZerocoinState::AccumulateWitness(update.coin.denomination, update.witness.witnessValue, update.coinsToAdd);
+
+    {
+        LOCK(cs_main);
+        // a reorganization below maxHeight while we were busy makes the new witnesses useless
+        if (chainActive.Height() < maxHeight || chainActive[maxHeight]->GetBlockHash() != maxHeightHash)
+            return;
+    }
+
+    LOCK(cs_wallet);
+    BOOST_FOREACH(const CWitnessUpdate &update, vUpdates) {
+        map<CBigNum, CZerocoinEntry>::const_iterator it = mapZerocoinEntries.find(update.coin.value);
+        if (it != mapZerocoinEntries.end() && !it->second.IsUsed)
+            walletdb.WriteZerocoinWitness(update.witness);
+    }
+}
+
 bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDenomination denomination,
                                              CWalletTx &wtxNew, CReserveKey &reservekey, CBigNum &coinSerial,
                                              uint256 &txHash, CBigNum &zcSelectedValue, bool &zcSelectedIsUsed,
@@ -3648,7 +3827,7 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
             vector<CTxOut>::iterator position = txNew.vout.begin() + GetRandInt(txNew.vout.size() + 1);
             txNew.vout.insert(position, newTxOut);
 //            LogPrintf("txNew:%s\n", txNew.ToString());
-            LogPrintf("txNew.GetHash():%s\n", txNew.GetHash().ToString());
+            LogPrint("zerocoin", "txNew.GetHash():%s\n", txNew.GetHash().ToString());
 
             // Fill vin
 
@@ -3665,9 +3844,6 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
 
             // Select not yet used coin from the wallet with minimal possible id
 
-            list <CZerocoinEntry> listPubCoin;
-            CWalletDB(strWalletFile).ListPubCoin(listPubCoin);
-            listPubCoin.sort(CompHeight);
             CZerocoinEntry coinToUse;
             CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
 
@@ -3677,27 +3853,27 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
             int coinId = INT_MAX;
             int coinHeight;
 
-            BOOST_FOREACH(const CZerocoinEntry &minIdPubcoin, listPubCoin) {
-                if (minIdPubcoin.denomination == denomination
-                        && minIdPubcoin.IsUsed == false
-                        && minIdPubcoin.randomness != 0
-                        && minIdPubcoin.serialNumber != 0) {
-                    int id;
-                    coinHeight = zerocoinState->GetMintedCoinHeightAndId(minIdPubcoin.value, minIdPubcoin.denomination, id);
-                    LogPrintf("ZEROCOIN, denom %d, id %d, height %d \n" ,minIdPubcoin.value, id, coinHeight);
-                    if (coinHeight > 0
-                            && id < coinId
-                            && coinHeight + (ZC_MINT_CONFIRMATIONS-1) <= chainActive.Height()
-                            && zerocoinState->GetAccumulatorValueForSpend(
-                                    chainActive.Height()-(ZC_MINT_CONFIRMATIONS-1),
-                                    denomination,
-                                    id,
-                                    accumulatorValue,
-                                    accumulatorBlockHash) > 1
-                            ) {
-                        coinId = id;
-                        coinToUse = minIdPubcoin;
-                    }
+            // only the unused mints of the denomination are looked at, no walletdb scan. They come in wallet
+            // height order, so of the mints with the lowest id the earliest one is used
+            vector<CZerocoinEntry> vSpendable;
+            ListSpendableZerocoins(denomination, vSpendable);
+            BOOST_FOREACH(const CZerocoinEntry &minIdPubcoin, vSpendable) {
+                int id;
+                int mintHeight = zerocoinState->GetMintedCoinHeightAndId(minIdPubcoin.value, minIdPubcoin.denomination, id);
+                LogPrint("zerocoin", "ZEROCOIN, denom %d, id %d, height %d \n" ,minIdPubcoin.value, id, mintHeight);
+                if (mintHeight > 0
+                        && id < coinId
+                        && mintHeight + (ZC_MINT_CONFIRMATIONS-1) <= chainActive.Height()
+                        && zerocoinState->GetAccumulatorValueForSpend(
+                                chainActive.Height()-(ZC_MINT_CONFIRMATIONS-1),
+                                denomination,
+                                id,
+                                accumulatorValue,
+                                accumulatorBlockHash) > 1
+                        ) {
+                    coinId = id;
+                    coinHeight = mintHeight;
+                    coinToUse = minIdPubcoin;
                 }
             }
 
@@ -3719,12 +3895,13 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
                 return false;
             }
 
-            // 4. Generate withness
-            libzerocoin::AccumulatorWitness witness =
-                    zerocoinState->GetWitnessForSpend(&chainActive,
-                                                      chainActive.Height()-(ZC_MINT_CONFIRMATIONS-1),
-                                                      denomination, coinId,
-                                                      coinToUse.value);
+            // 4. Generate withness. Only the blocks since the last update of the stored witness are accumulated
+            CZerocoinWitnessEntry witnessEntry;
+            CWalletDB walletdb(strWalletFile);
+            UpdateZerocoinWitness(walletdb, coinToUse, coinId, chainActive.Height()-(ZC_MINT_CONFIRMATIONS-1), witnessEntry);
+            libzerocoin::AccumulatorWitness witness(ZCParams,
+                                                    libzerocoin::Accumulator(ZCParams, witnessEntry.witnessValue, denomination),
+                                                    pubCoinSelected);
             CTxIn newTxIn;
             newTxIn.nSequence = coinId;
             newTxIn.scriptSig = CScript();
@@ -3807,7 +3984,7 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
                     pubCoinTx.randomness = coinToUse.randomness;
                     pubCoinTx.serialNumber = coinToUse.serialNumber;
                     pubCoinTx.value = coinToUse.value;
-                    CWalletDB(strWalletFile).WriteZerocoinEntry(pubCoinTx);
+                    WriteZerocoinEntry(pubCoinTx);
                     LogPrintf("CreateZerocoinSpendTransaction() -> NotifyZerocoinChanged\n");
                     LogPrintf("pubcoin=%s, isUsed=Used\n", coinToUse.value.GetHex());
                     pwalletMain->NotifyZerocoinChanged(pwalletMain, coinToUse.value.GetHex(), "Used",
@@ -3819,7 +3996,7 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
 
             coinSerial = spend.getCoinSerialNumber();
             txHash = wtxNew.GetHash();
-            LogPrintf("txHash:\n%s", txHash.ToString());
+            LogPrint("zerocoin", "txHash:\n%s", txHash.ToString());
             zcSelectedValue = coinToUse.value;
             zcSelectedIsUsed = coinToUse.IsUsed;
 
@@ -3829,7 +4006,7 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
             entry.pubCoin = zcSelectedValue;
             entry.id = coinId;
             entry.denomination = coinToUse.denomination;
-            LogPrintf("WriteCoinSpendSerialEntry, serialNumber=%s\n", coinSerial.ToString());
+            LogPrint("zerocoin", "WriteCoinSpendSerialEntry, serialNumber=%s\n", coinSerial.ToString());
             if (!CWalletDB(strWalletFile).WriteCoinSpendSerialEntry(entry)) {
                 strFailReason = _("it cannot write coin serial number into wallet");
             }
@@ -3837,7 +4014,7 @@ bool CWallet::CreateZerocoinSpendTransaction(int64_t nValue, libzerocoin::CoinDe
             coinToUse.IsUsed = true;
             coinToUse.id = coinId;
             coinToUse.nHeight = coinHeight;
-            CWalletDB(strWalletFile).WriteZerocoinEntry(coinToUse);
+            WriteZerocoinEntry(coinToUse);
             pwalletMain->NotifyZerocoinChanged(pwalletMain, coinToUse.value.GetHex(), "Used",
                                                CT_UPDATED);
         }
@@ -3987,25 +4164,12 @@ string CWallet::SpendZerocoin(int64_t nValue, libzerocoin::CoinDenomination deno
     if (!CommitZerocoinSpendTransaction(wtxNew, reservekey)) {
         LogPrintf("CommitZerocoinSpendTransaction() -> FAILED!\n");
         CZerocoinEntry pubCoinTx;
-        list <CZerocoinEntry> listPubCoin;
-        listPubCoin.clear();
-
-        CWalletDB walletdb(pwalletMain->strWalletFile);
-        walletdb.ListPubCoin(listPubCoin);
-        BOOST_FOREACH(const CZerocoinEntry &pubCoinItem, listPubCoin) {
-            if (zcSelectedValue == pubCoinItem.value) {
-                pubCoinTx.id = pubCoinItem.id;
-                pubCoinTx.IsUsed = false; // having error, so set to false, to be able to use again
-                pubCoinTx.value = pubCoinItem.value;
-                pubCoinTx.nHeight = pubCoinItem.nHeight;
-                pubCoinTx.randomness = pubCoinItem.randomness;
-                pubCoinTx.serialNumber = pubCoinItem.serialNumber;
-                pubCoinTx.denomination = pubCoinItem.denomination;
-                CWalletDB(strWalletFile).WriteZerocoinEntry(pubCoinTx);
-                LogPrintf("SpendZerocoin failed, re-updated status -> NotifyZerocoinChanged\n");
-                LogPrintf("pubcoin=%s, isUsed=New\n", pubCoinItem.value.GetHex());
-                pwalletMain->NotifyZerocoinChanged(pwalletMain, pubCoinItem.value.GetHex(), "New", CT_UPDATED);
-            }
+        if (GetZerocoinEntry(zcSelectedValue, pubCoinTx)) {
+            pubCoinTx.IsUsed = false; // having error, so set to false, to be able to use again
+            WriteZerocoinEntry(pubCoinTx);
+            LogPrintf("SpendZerocoin failed, re-updated status -> NotifyZerocoinChanged\n");
+            LogPrintf("pubcoin=%s, isUsed=New\n", pubCoinTx.value.GetHex());
+            pwalletMain->NotifyZerocoinChanged(pwalletMain, pubCoinTx.value.GetHex(), "New", CT_UPDATED);
         }
         CZerocoinSpendEntry entry;
         entry.coinSerial = coinSerial;
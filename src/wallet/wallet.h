@@ -569,6 +569,87 @@ private:
 };
 
 
+class CZerocoinEntry
+{
+
+private:
+    template <typename Stream>
+    auto is_eof_helper(Stream &s, bool) -> decltype(s.eof()) {
+        return s.eof();
+    }
+
+    template <typename Stream>
+    bool is_eof_helper(Stream &s, int) {
+        return false;
+    }
+
+    template<typename Stream>
+    bool is_eof(Stream &s) {
+        return is_eof_helper(s, true);
+    }
+public:
+    //public
+    Bignum value;
+    int denomination;
+    //private
+    Bignum randomness;
+    Bignum serialNumber;
+
+    vector<unsigned char> ecdsaSecretKey;
+
+    bool IsUsed;
+    int nHeight;
+    int id;
+
+    CZerocoinEntry()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        IsUsed = false;
+        randomness = 0;
+        serialNumber = 0;
+        value = 0;
+        denomination = -1;
+        nHeight = -1;
+        id = -1;
+    }
+
+    bool IsCorrectV2Mint() const {
+        return value > 0 && randomness > 0 && serialNumber > 0 && serialNumber.bitSize() <= 160 &&
+                ecdsaSecretKey.size() >= 32;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(IsUsed);
+        READWRITE(randomness);
+        READWRITE(serialNumber);
+        READWRITE(value);
+        READWRITE(denomination);
+        READWRITE(nHeight);
+        READWRITE(id);
+        if (ser_action.ForRead()) {
+            if (!is_eof(s)) {
+                int nStoredVersion = 0;
+                READWRITE(nStoredVersion);
+                if (nStoredVersion >= ZC_ADVANCED_WALLETDB_MINT_VERSION)
+                    READWRITE(ecdsaSecretKey);
+            }
+        }
+        else {
+            READWRITE(nVersion);
+            READWRITE(ecdsaSecretKey);
+        }
+    }
+
+};
+
+
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
@@ -618,6 +699,11 @@ private:
     /* the HD chain data model (external chain counters) */
     CHDChain hdChain;
 
+    //! zerocoin mints by pubcoin value, loaded with the wallet and written through to walletdb
+    std::map<CBigNum, CZerocoinEntry> mapZerocoinEntries;
+    //! (wallet height, pubcoin value) of the mints that can still be spent, by denomination
+    std::map<int, std::set<std::pair<int, CBigNum> > > mapSpendableZerocoins;
+
 public:
     /*
      * Main wallet lock.
@@ -786,6 +872,7 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, const CBlock* pblock);
+    void UpdatedBlockTip(const CBlockIndex *pindex);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
     void ReacceptWalletTransactions();
@@ -843,6 +930,25 @@ public:
     bool CreateZerocoinMintModel(string &stringError, string denomAmount);
     bool CreateZerocoinSpendModel(string &stringError, string denomAmount);
     bool SetZerocoinBook(const CZerocoinEntry& zerocoinEntry);
+    //! Adds a zerocoin mint to the in-memory store without saving it to disk (used by LoadWallet)
+    bool LoadZerocoinEntry(const CZerocoinEntry& zerocoinEntry);
+    //! Adds or updates a zerocoin mint, in walletdb and in memory
+    bool WriteZerocoinEntry(const CZerocoinEntry& zerocoinEntry);
+    bool GetZerocoinEntry(const CBigNum& value, CZerocoinEntry& zerocoinEntryRet) const;
+    //! All zerocoin mints of the wallet, ordered by pubcoin value
+    void ListZerocoinEntries(std::list<CZerocoinEntry>& listZerocoinEntriesRet) const;
+    //! Unused mints of the denomination in the order coin selection tries them: by wallet height, then pubcoin value
+    void ListSpendableZerocoins(int denomination, std::vector<CZerocoinEntry>& vZerocoinEntriesRet) const;
+    /**
+     * Bring the stored accumulator witness of the coin up to maxHeight, rebuilding it if the chain was
+     * reorganized below the stored height. Requires cs_main
+     */
+    void UpdateZerocoinWitness(CWalletDB &walletdb, const CZerocoinEntry &coin, int coinId, int maxHeight, CZerocoinWitnessEntry &witness);
+    /**
+     * Advance witnesses of all the unspent coins to the current spend height. cs_main is held only to collect
+     * the coins to accumulate, the exponentiations run without it. Nothing is done during initial block download
+     */
+    void UpdateZerocoinWitnesses();
 
     bool CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey);
 
@@ -1060,118 +1166,77 @@ public:
     }
 };
 
-class CZerocoinEntry
+class CZerocoinSpendEntry
 {
-
-private:
-    template <typename Stream>
-    auto is_eof_helper(Stream &s, bool) -> decltype(s.eof()) {
-        return s.eof();
-    }
-
-    template <typename Stream>
-    bool is_eof_helper(Stream &s, int) {
-        return false;
-    }
-
-    template<typename Stream>
-    bool is_eof(Stream &s) {
-        return is_eof_helper(s, true);
-    }
 public:
-    //public
-    Bignum value;
+    Bignum coinSerial;
+    uint256 hashTx;
+    Bignum pubCoin;
     int denomination;
-    //private
-    Bignum randomness;
-    Bignum serialNumber;
-
-    vector<unsigned char> ecdsaSecretKey;
-
-    bool IsUsed;
-    int nHeight;
     int id;
 
-    CZerocoinEntry()
+    CZerocoinSpendEntry()
     {
         SetNull();
     }
 
     void SetNull()
     {
-        IsUsed = false;
-        randomness = 0;
-        serialNumber = 0;
-        value = 0;
-        denomination = -1;
-        nHeight = -1;
-        id = -1;
-    }
-
-    bool IsCorrectV2Mint() const {
-        return value > 0 && randomness > 0 && serialNumber > 0 && serialNumber.bitSize() <= 160 &&
-                ecdsaSecretKey.size() >= 32;
+        coinSerial = 0;
+//        hashTx =
+        pubCoin = 0;
+        denomination = 0;
+        id = 0;
     }
-
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
-        READWRITE(IsUsed);
-        READWRITE(randomness);
-        READWRITE(serialNumber);
-        READWRITE(value);
+        READWRITE(coinSerial);
+        READWRITE(hashTx);
+        READWRITE(pubCoin);
         READWRITE(denomination);
-        READWRITE(nHeight);
         READWRITE(id);
-        if (ser_action.ForRead()) {
-            if (!is_eof(s)) {
-                int nStoredVersion = 0;
-                READWRITE(nStoredVersion);
-                if (nStoredVersion >= ZC_ADVANCED_WALLETDB_MINT_VERSION)
-                    READWRITE(ecdsaSecretKey);
-            }
-        }
-        else {
-            READWRITE(nVersion);
-            READWRITE(ecdsaSecretKey);
-        }
     }
-
 };
 
-
-class CZerocoinSpendEntry
+// Accumulator witness of an unspent coin kept up to date as blocks connect, so that spending doesn't have to
+// accumulate the whole coin group again
+class CZerocoinWitnessEntry
 {
 public:
-    Bignum coinSerial;
-    uint256 hashTx;
     Bignum pubCoin;
     int denomination;
     int id;
+    // witness includes every coin of the group minted up to this block except pubCoin
+    int nHeight;
+    uint256 blockHash;
+    Bignum witnessValue;
 
-    CZerocoinSpendEntry()
+    CZerocoinWitnessEntry()
     {
         SetNull();
     }
 
     void SetNull()
     {
-        coinSerial = 0;
-//        hashTx =
         pubCoin = 0;
-        denomination = 0;
-        id = 0;
+        denomination = -1;
+        id = -1;
+        nHeight = -1;
+        blockHash.SetNull();
+        witnessValue = 0;
     }
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
-        READWRITE(coinSerial);
-        READWRITE(hashTx);
         READWRITE(pubCoin);
         READWRITE(denomination);
         READWRITE(id);
+        READWRITE(nHeight);
+        READWRITE(blockHash);
+        READWRITE(witnessValue);
     }
 };
 
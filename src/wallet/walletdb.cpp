@@ -233,6 +233,18 @@ bool CWalletDB::EraseCoinSpendSerialEntry(const CZerocoinSpendEntry &zerocoinSpe
     return Erase(make_pair(string("zcserial"), zerocoinSpend.coinSerial));
 }
 
+bool CWalletDB::WriteZerocoinWitness(const CZerocoinWitnessEntry &witness) {
+    return Write(make_pair(string("zcwitness"), witness.pubCoin), witness, true);
+}
+
+bool CWalletDB::ReadZerocoinWitness(const CBigNum &pubCoin, CZerocoinWitnessEntry &witness) {
+    return Read(make_pair(string("zcwitness"), pubCoin), witness);
+}
+
+bool CWalletDB::EraseZerocoinWitness(const CBigNum &pubCoin) {
+    return Erase(make_pair(string("zcwitness"), pubCoin));
+}
+
 bool
 CWalletDB::WriteZerocoinAccumulator(libzerocoin::Accumulator accumulator, libzerocoin::CoinDenomination denomination,
                                     int pubcoinid) {
@@ -268,39 +280,6 @@ bool CWalletDB::WriteCalculatedZCBlock(int height) {
     return Write(std::string("calculatedzcblock"), height);
 }
 
-void CWalletDB::ListPubCoin(std::list <CZerocoinEntry> &listPubCoin) {
-    Dbc *pcursor = GetCursor();
-    if (!pcursor)
-        throw runtime_error("CWalletDB::ListPubCoin() : cannot create DB cursor");
-    unsigned int fFlags = DB_SET_RANGE;
-    while (true) {
-        // Read next record
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        if (fFlags == DB_SET_RANGE)
-            ssKey << make_pair(string("zerocoin"), CBigNum(0));
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        int ret = ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
-        fFlags = DB_NEXT;
-        if (ret == DB_NOTFOUND)
-            break;
-        else if (ret != 0) {
-            pcursor->close();
-            throw runtime_error("CWalletDB::ListPubCoin() : error scanning DB");
-        }
-        // Unserialize
-        string strType;
-        ssKey >> strType;
-        if (strType != "zerocoin")
-            break;
-        CBigNum value;
-        ssKey >> value;
-        CZerocoinEntry zerocoinItem;
-        ssValue >> zerocoinItem;
-        listPubCoin.push_back(zerocoinItem);
-    }
-    pcursor->close();
-}
-
 void CWalletDB::ListCoinSpendSerial(std::list <CZerocoinSpendEntry> &listCoinSpendSerial) {
     Dbc *pcursor = GetCursor();
     if (!pcursor)
@@ -637,6 +616,15 @@ bool ReadKeyValue(CWallet *pwallet, CDataStream &ssKey, CDataStream &ssValue,
                 strErr = "Error reading wallet database: SetHDChain failed";
                 return false;
             }
+        } else if (strType == "zerocoin") {
+            CBigNum value;
+            ssKey >> value;
+            CZerocoinEntry zerocoin;
+            ssValue >> zerocoin;
+            if (!pwallet->LoadZerocoinEntry(zerocoin)) {
+                strErr = "Error reading wallet database: LoadZerocoinEntry failed";
+                return false;
+            }
         }
     } catch (...) {
         return false;
@@ -33,6 +33,7 @@ class uint160;
 class uint256;
 class CZerocoinEntry;
 class CZerocoinSpendEntry;
+class CZerocoinWitnessEntry;
 
 /** Error statuses for the wallet database */
 enum DBErrors
@@ -173,10 +174,12 @@ public:
 
     bool WriteZerocoinEntry(const CZerocoinEntry& zerocoin);
     bool EraseZerocoinEntry(const CZerocoinEntry& zerocoin);
-    void ListPubCoin(std::list<CZerocoinEntry>& listPubCoin);
     void ListCoinSpendSerial(std::list<CZerocoinSpendEntry>& listCoinSpendSerial);
     bool WriteCoinSpendSerialEntry(const CZerocoinSpendEntry& zerocoinSpend);
     bool EraseCoinSpendSerialEntry(const CZerocoinSpendEntry& zerocoinSpend);
+    bool WriteZerocoinWitness(const CZerocoinWitnessEntry& witness);
+    bool ReadZerocoinWitness(const CBigNum& pubCoin, CZerocoinWitnessEntry& witness);
+    bool EraseZerocoinWitness(const CBigNum& pubCoin);
     bool WriteZerocoinAccumulator(libzerocoin::Accumulator accumulator, libzerocoin::CoinDenomination denomination, int pubcoinid);
     bool ReadZerocoinAccumulator(libzerocoin::Accumulator& accumulator, libzerocoin::CoinDenomination denomination, int pubcoinid);
     // bool EraseZerocoinAccumulator(libzerocoin::Accumulator& accumulator, libzerocoin::CoinDenomination denomination, int pubcoinid);
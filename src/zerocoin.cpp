@@ -6,12 +6,17 @@
 #include "definition.h"
 #include "wallet/wallet.h"
 #include "wallet/walletdb.h"
+#include "hash.h"
+#include "memusage.h"
+#include "random.h"
 
 #include <atomic>
 #include <sstream>
 #include <chrono>
 
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_set.hpp>
 
 using namespace std;
 
@@ -29,6 +34,185 @@ static libzerocoin::Params *ZCParams = new libzerocoin::Params(bnTrustedModulus)
 
 static CZerocoinState zerocoinState;
 
+namespace {
+
+/**
+ * We're hashing a nonce into the entries themselves, so we don't need extra
+ * blinding in the set hash computation.
+ */
+class CZerocoinSpendCacheHasher
+{
+public:
+    size_t operator()(const uint256& key) const {
+        return key.GetCheapHash();
+    }
+};
+
+/**
+ * Valid zerocoin spend cache, to avoid verifying the spend proof twice for every spend
+ * (once when accepted into memory pool, and again when the block containing it is checked)
+ */
+class CZerocoinSpendCache
+{
+private:
+    //! Entries are SHA256(nonce || spend hash || accumulator || metadata hash)
+    uint256 nonce;
+    typedef boost::unordered_set<uint256, CZerocoinSpendCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_spendcache;
+
+public:
+    CZerocoinSpendCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void
+    ComputeEntry(uint256& entry, const uint256 &spendHash, const libzerocoin::Accumulator &accumulator, const libzerocoin::SpendMetaData &metaData)
+    {
+        uint256 accumulatorHash = SerializeHash(accumulator);
+        uint256 metaDataHash = SerializeHash(metaData);
+        CSHA256().Write(nonce.begin(), 32).Write(spendHash.begin(), 32).Write(accumulatorHash.begin(), 32).Write(metaDataHash.begin(), 32).Finalize(entry.begin());
+    }
+
+    bool
+    Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_spendcache);
+        return setValid.count(entry);
+    }
+
+    void Erase(const uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_spendcache);
+        setValid.erase(entry);
+    }
+
+    void Set(const uint256& entry)
+    {
+        size_t nMaxCacheSize = GetArg("-maxzerocoinspendcachesize", DEFAULT_MAX_ZEROCOIN_SPEND_CACHE_SIZE) * ((size_t) 1 << 20);
+        if (nMaxCacheSize <= 0) return;
+
+        boost::unique_lock<boost::shared_mutex> lock(cs_spendcache);
+        while (memusage::DynamicUsage(setValid) > nMaxCacheSize)
+        {
+            map_type::size_type s = GetRand(setValid.bucket_count());
+            map_type::local_iterator it = setValid.begin(s);
+            if (it != setValid.end(s)) {
+                setValid.erase(*it);
+            }
+        }
+
+        setValid.insert(entry);
+    }
+};
+
+CZerocoinSpendCache zerocoinSpendCache;
+
+}
+
+// Spends verified for the mempool are remembered, block checks consume the entry the same way signature checks do
+static bool VerifySpendCached(const libzerocoin::CoinSpend &spend, const uint256 &spendHash,
+                              const libzerocoin::Accumulator &accumulator, const libzerocoin::SpendMetaData &metaData,
+                              bool store) {
+    uint256 entry;
+    zerocoinSpendCache.ComputeEntry(entry, spendHash, accumulator, metaData);
+
+    if (zerocoinSpendCache.Get(entry)) {
+        if (!store) {
+            zerocoinSpendCache.Erase(entry);
+        }
+        return true;
+    }
+
+    if (!spend.Verify(accumulator, metaData))
+        return false;
+
+    if (store) {
+        zerocoinSpendCache.Set(entry);
+    }
+    return true;
+}
+
+bool CZerocoinSpendCheck::operator()() {
+    // a default constructed check has nothing to verify
+    if (!spend) {
+        LogPrintf("CZerocoinSpendCheck: empty check at block %d\n", nHeight);
+        return false;
+    }
+
+    bool passVerify = false;
+    pair<int,int> denominationAndId = make_pair((int)denomination, pubcoinId);
+    libzerocoin::SpendMetaData newMetadata(pubcoinId, txHashForMetadata);
+    // the coin group may have no accumulator changes recorded yet
+    static const vector<CAccumulatorCheckpoint> noCheckpoints;
+    const vector<CAccumulatorCheckpoint> &checkpoints = pCheckpoints ? *pCheckpoints : noCheckpoints;
+    // only mempool acceptance populates the cache
+    bool fCacheStore = nHeight == INT_MAX;
+
+    try {
+        uint256 spendHash = SerializeHash(*spend);
+
+        auto verifyAtBlock = [&](const CBlockIndex *index) -> bool {
+            CBigNum accValue;
+            int nMints;
+            if (!index->GetAccumulatorChange(denominationAndId, accValue, nMints))
+                return false;
+            libzerocoin::Accumulator accumulator(ZCParams, accValue, denomination);
+            LogPrint("zerocoin", "CheckSpendZerocoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
+            return VerifySpendCached(*spend, spendHash, accumulator, newMetadata, fCacheStore);
+        };
+
+        if (fSpendHasBlockHash) {
+            // Only the accumulator value of the block named by the spend is tried
+            passVerify = pindexStart != NULL && verifyAtBlock(pindexStart);
+        }
+        else {
+            // Enumerate all the accumulator changes seen in the blockchain starting with the latest block
+            // In most cases the latest accumulator value will be used for verification
+            for (size_t n = checkpoints.size(); n > 0 && !passVerify; n--)
+                passVerify = verifyAtBlock(checkpoints[n - 1].pindex);
+        }
+
+        // Rare case: accumulator value contains some but NOT ALL coins from one block. In this case we will
+        // have to enumerate over coins manually. No optimization is really needed here because it's a rarity
+        // This can't happen if spend is of version 1.5 or 2.0
+        if (!passVerify && spend->getVersion() == ZEROCOIN_TX_VERSION_1) {
+            // Build vector of coins sorted by the time of mint
+            vector<CBigNum> pubCoins, blockPubCoins;
+            BOOST_FOREACH(const CAccumulatorCheckpoint &checkpoint, checkpoints) {
+                if (checkpoint.pindex->GetMintedPubCoins(denominationAndId, blockPubCoins))
+                    pubCoins.insert(pubCoins.end(), blockPubCoins.cbegin(), blockPubCoins.cend());
+            }
+
+            libzerocoin::Accumulator accumulator(ZCParams, denomination);
+            BOOST_FOREACH(const CBigNum &pubCoin, pubCoins) {
+                accumulator += libzerocoin::PublicCoin(ZCParams, pubCoin, denomination);
+                LogPrint("zerocoin", "CheckSpendZerocoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
+                if ((passVerify = VerifySpendCached(*spend, spendHash, accumulator, newMetadata, fCacheStore)) == true)
+                    break;
+            }
+
+            if (!passVerify) {
+                // One more time now in reverse direction. The only reason why it's required is compatibility with
+                // previous client versions
+                libzerocoin::Accumulator accumulator(ZCParams, denomination);
+                BOOST_REVERSE_FOREACH(const CBigNum &pubCoin, pubCoins) {
+                    accumulator += libzerocoin::PublicCoin(ZCParams, pubCoin, denomination);
+                    LogPrint("zerocoin", "CheckSpendZerocoinTransaction: accumulatorRev=%s\n", accumulator.getValue().ToString().substr(0,15));
+                    if ((passVerify = VerifySpendCached(*spend, spendHash, accumulator, newMetadata, fCacheStore)) == true)
+                        break;
+                }
+            }
+        }
+    } catch (const std::exception &e) {
+        LogPrintf("CZerocoinSpendCheck: exception during spend verification at block %d: %s\n", nHeight, e.what());
+        return false;
+    }
+
+    return passVerify;
+}
+
 bool CheckSpendZerocoinTransaction(const CTransaction &tx,
                                 libzerocoin::CoinDenomination targetDenomination,
                                 CValidationState &state,
@@ -36,10 +220,11 @@ bool CheckSpendZerocoinTransaction(const CTransaction &tx,
                                 bool isVerifyDB,
                                 int nHeight,
                                 bool isCheckWallet,
-                                CZerocoinTxInfo *zerocoinTxInfo) {
+                                CZerocoinTxInfo *zerocoinTxInfo,
+                                std::vector<CZerocoinSpendCheck> *pvChecks) {
 
     // Check for inputs only, everything else was checked before
-    LogPrintf("CheckSpendZerocoinTransaction denomination=%d nHeight=%d\n", targetDenomination, nHeight);
+    LogPrint("zerocoin", "CheckSpendZerocoinTransaction denomination=%d nHeight=%d\n", targetDenomination, nHeight);
 
 	BOOST_FOREACH(const CTxIn &txin, tx.vin)
 	{
@@ -65,9 +250,9 @@ bool CheckSpendZerocoinTransaction(const CTransaction &tx,
         CDataStream serializedCoinSpend((const char *)&*(txin.scriptSig.begin() + 4),
                                         (const char *)&*txin.scriptSig.end(),
                                         SER_NETWORK, PROTOCOL_VERSION);
-        libzerocoin::CoinSpend newSpend(ZCParams, serializedCoinSpend);
+        std::shared_ptr<libzerocoin::CoinSpend> newSpend = std::make_shared<libzerocoin::CoinSpend>(ZCParams, serializedCoinSpend);
 
-        int spendVersion = newSpend.getVersion();
+        int spendVersion = newSpend->getVersion();
         if (spendVersion != ZEROCOIN_TX_VERSION_1 &&
                 spendVersion != ZEROCOIN_TX_VERSION_1_5 &&
                 spendVersion != ZEROCOIN_TX_VERSION_2) {
@@ -91,7 +276,7 @@ bool CheckSpendZerocoinTransaction(const CTransaction &tx,
             // old spends are probably incorrect, force spend to version 1
             if (spendVersion == ZEROCOIN_TX_VERSION_2){
                 spendVersion = ZEROCOIN_TX_VERSION_1;
-                newSpend.setVersion(ZEROCOIN_TX_VERSION_1);
+                newSpend->setVersion(ZEROCOIN_TX_VERSION_1);
             }
         }
 
@@ -122,125 +307,76 @@ bool CheckSpendZerocoinTransaction(const CTransaction &tx,
                 return false;
             }
         }
-        libzerocoin::SpendMetaData newMetadata(txin.nSequence, txHashForMetadata);
-
-
         CZerocoinState::CoinGroupInfo coinGroup;
         if (!zerocoinState.GetCoinGroupInfo(targetDenomination, pubcoinId, coinGroup))
                 return state.DoS(100, false, NO_MINT_ZEROCOIN, "CheckSpendZerocoinTransaction: Error: no coins were minted with such parameters at height %d", nHeight);
 
-        bool passVerify = false;
         CBlockIndex *index = coinGroup.lastBlock;
-        pair<int,int> denominationAndId = make_pair(targetDenomination, pubcoinId);
-
-
-        bool spendHasBlockHash;
+        bool spendHasBlockHash = false;
 
         // Zerocoin v2 transaction can cointain block hash of the last mint tx seen at the moment of spend. It speeds
         // up verification
-        if (spendVersion > ZEROCOIN_TX_VERSION_1 && !newSpend.getAccumulatorBlockHash().IsNull()) {
+        if (spendVersion > ZEROCOIN_TX_VERSION_1 && !newSpend->getAccumulatorBlockHash().IsNull()) {
             spendHasBlockHash = true;
-            uint256 accumulatorBlockHash = newSpend.getAccumulatorBlockHash();
-
-            // find index for block with hash of accumulatorBlockHash or set index to the coinGroup.firstBlock if not found
-            while (index != coinGroup.firstBlock && index->GetBlockHash() != accumulatorBlockHash)
-                index = index->pprev;
+            uint256 accumulatorBlockHash = newSpend->getAccumulatorBlockHash();
+
+            // find index for block with hash of accumulatorBlockHash between the first and the last block of the
+            // group or set index to the coinGroup.firstBlock if not found
+            BlockMap::const_iterator mi = mapBlockIndex.find(accumulatorBlockHash);
+            CBlockIndex *pindexNamed = mi != mapBlockIndex.end() ? mi->second : NULL;
+            if (pindexNamed && pindexNamed->nHeight > coinGroup.firstBlock->nHeight &&
+                    pindexNamed->nHeight <= coinGroup.lastBlock->nHeight &&
+                    coinGroup.lastBlock->GetAncestor(pindexNamed->nHeight) == pindexNamed)
+                index = pindexNamed;
+            else
+                index = coinGroup.firstBlock;
         }
 
-        // Enumerate all the accumulator changes seen in the blockchain starting with the latest block
-        // In most cases the latest accumulator value will be used for verification
-        do {
-            if (index->accumulatorChanges.count(denominationAndId) > 0) {
-                libzerocoin::Accumulator accumulator(ZCParams,
-                                                     index->accumulatorChanges[denominationAndId].first,
-                                                     targetDenomination);
-                LogPrintf("CheckSpendZerocoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
-                passVerify = newSpend.Verify(accumulator, newMetadata);
-
-            }
+        // Proof verification is the expensive part, defer it to the check queue if the caller provided one.
+        // Serial bookkeeping below stays in transaction order; a failed deferred check fails the whole block.
+        CZerocoinSpendCheck check(newSpend, targetDenomination, pubcoinId, txHashForMetadata,
+                                  zerocoinState.GetAccumulatorCheckpoints(targetDenomination, pubcoinId),
+                                  index, spendHasBlockHash, nHeight);
+        if (pvChecks) {
+            pvChecks->push_back(CZerocoinSpendCheck());
+            check.swap(pvChecks->back());
+        }
+        else if (!check()) {
+            LogPrintf("CheckSpendZerocoinTransaction: verification failed at block %d\n", nHeight);
+            return false;
+        }
 
-            if (index == coinGroup.firstBlock || spendHasBlockHash)
-                break;
+        // Pull the serial number out of the CoinSpend object. If we
+        // were a real Zerocoin client we would now check that the serial number
+        // has not been spent before (in another ZEROCOIN_SPEND) transaction.
+        // The serial number is stored as a Bignum.
+        CBigNum serial = newSpend->getCoinSerialNumber();
+        if (nHeight > ZC_CHECK_BUG_FIXED_AT_BLOCK &&
+                // do not check for duplicates in case we've seen exact copy of this tx in this block before
+                !(zerocoinTxInfo &&
+                    zerocoinTxInfo->zcTransactions.count(hashTx) > 0) &&
+                // check for used serials both in zerocoinState and in other transactions of this block
+                (zerocoinState.IsUsedCoinSerial(serial) ||
+                    // check for zerocoin transaction in the same block as well
+                    (zerocoinTxInfo &&
+                        !zerocoinTxInfo->fInfoIsComplete &&
+                     zerocoinTxInfo->spentSerials.count(serial) > 0))) {
+
+            if (nHeight < ZC_V1_5_STARTING_BLOCK)
+                LogPrint("zerocoin", "ZCSpend: height=%d, denomination=%d, serial=%s\n", nHeight, (int)newSpend->getDenomination(), newSpend->getCoinSerialNumber().ToString());
             else
-                index = index->pprev;
-        } while (!passVerify);
-
-        // Rare case: accumulator value contains some but NOT ALL coins from one block. In this case we will
-        // have to enumerate over coins manually. No optimization is really needed here because it's a rarity
-        // This can't happen if spend is of version 1.5 or 2.0
-        if (!passVerify && spendVersion == ZEROCOIN_TX_VERSION_1) {
-            // Build vector of coins sorted by the time of mint
-            index = coinGroup.lastBlock;
-            vector<CBigNum> pubCoins = index->mintedPubCoins[denominationAndId];
-            if (index != coinGroup.firstBlock) {
-                do {
-                    index = index->pprev;
-                    if (index->mintedPubCoins.count(denominationAndId) > 0)
-                        pubCoins.insert(pubCoins.begin(),
-                                        index->mintedPubCoins[denominationAndId].cbegin(),
-                                        index->mintedPubCoins[denominationAndId].cend());
-                } while (index != coinGroup.firstBlock);
-            }
-
-            libzerocoin::Accumulator accumulator(ZCParams, targetDenomination);
-            BOOST_FOREACH(const CBigNum &pubCoin, pubCoins) {
-                accumulator += libzerocoin::PublicCoin(ZCParams, pubCoin, (libzerocoin::CoinDenomination)targetDenomination);
-                LogPrintf("CheckSpendZerocoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
-                if ((passVerify = newSpend.Verify(accumulator, newMetadata)) == true)
-                    break;
-            }
-
-            if (!passVerify) {
-                // One more time now in reverse direction. The only reason why it's required is compatibility with
-                // previous client versions
-                libzerocoin::Accumulator accumulator(ZCParams, targetDenomination);
-                BOOST_REVERSE_FOREACH(const CBigNum &pubCoin, pubCoins) {
-                    accumulator += libzerocoin::PublicCoin(ZCParams, pubCoin, (libzerocoin::CoinDenomination)targetDenomination);
-                    LogPrintf("CheckSpendZerocoinTransaction: accumulatorRev=%s\n", accumulator.getValue().ToString().substr(0,15));
-                    if ((passVerify = newSpend.Verify(accumulator, newMetadata)) == true)
-                        break;
-                }
-            }
+                return state.DoS(0, error("CTransaction::CheckTransaction() : The CoinSpend serial has been used"));
         }
 
+        if(!isVerifyDB && !isCheckWallet) {
+            if (zerocoinTxInfo && !zerocoinTxInfo->fInfoIsComplete) {
+                // add spend information to the index
+                zerocoinTxInfo->spentSerials.insert(serial);
+                zerocoinTxInfo->zcTransactions.insert(hashTx);
 
-        if (passVerify) {
-            // Pull the serial number out of the CoinSpend object. If we
-            // were a real Zerocoin client we would now check that the serial number
-            // has not been spent before (in another ZEROCOIN_SPEND) transaction.
-            // The serial number is stored as a Bignum.
-            CBigNum serial = newSpend.getCoinSerialNumber();
-            if (nHeight > ZC_CHECK_BUG_FIXED_AT_BLOCK &&
-                    // do not check for duplicates in case we've seen exact copy of this tx in this block before
-                    !(zerocoinTxInfo &&
-                        zerocoinTxInfo->zcTransactions.count(hashTx) > 0) &&
-                    // check for used serials both in zerocoinState and in other transactions of this block
-                    (zerocoinState.IsUsedCoinSerial(serial) ||
-                        // check for zerocoin transaction in the same block as well
-                        (zerocoinTxInfo &&
-                            !zerocoinTxInfo->fInfoIsComplete &&
-                         zerocoinTxInfo->spentSerials.count(serial) > 0))) {
-
-                if (nHeight < ZC_V1_5_STARTING_BLOCK)
-                    LogPrintf("ZCSpend: height=%d, denomination=%d, serial=%s\n", nHeight, (int)newSpend.getDenomination(), newSpend.getCoinSerialNumber().ToString());
-                else
-                    return state.DoS(0, error("CTransaction::CheckTransaction() : The CoinSpend serial has been used"));
+                if (newSpend->getVersion() == ZEROCOIN_TX_VERSION_1)
+                    zerocoinTxInfo->fHasSpendV1 = true;
             }
-
-            if(!isVerifyDB && !isCheckWallet) {
-                if (zerocoinTxInfo && !zerocoinTxInfo->fInfoIsComplete) {
-                    // add spend information to the index
-                    zerocoinTxInfo->spentSerials.insert(serial);
-                    zerocoinTxInfo->zcTransactions.insert(hashTx);
-
-                    if (newSpend.getVersion() == ZEROCOIN_TX_VERSION_1)
-                        zerocoinTxInfo->fHasSpendV1 = true;
-                }
-            }
-        }
-        else {
-            LogPrintf("CheckSpendZerocoinTransaction: verification failed at block %d\n", nHeight);
-            return false;
         }
 	}
 	return true;
@@ -251,8 +387,8 @@ bool CheckMintZerocoinTransaction(const CTxOut &txout,
                                uint256 hashTx,
                                CZerocoinTxInfo *zerocoinTxInfo) {
 
-    LogPrintf("CheckMintZerocoinTransaction txHash = %s\n", txout.GetHash().ToString());
-    LogPrintf("nValue = %d\n", txout.nValue);
+    LogPrint("zerocoin", "CheckMintZerocoinTransaction txHash = %s\n", txout.GetHash().ToString());
+    LogPrint("zerocoin", "nValue = %d\n", txout.nValue);
 
     if (txout.scriptPubKey.size() < 6)
         return state.DoS(100,
@@ -321,7 +457,8 @@ bool CheckZerocoinTransaction(const CTransaction &tx,
                               bool isVerifyDB,
                               int nHeight,
                               bool isCheckWallet,
-                              CZerocoinTxInfo *zerocoinTxInfo)
+                              CZerocoinTxInfo *zerocoinTxInfo,
+                              std::vector<CZerocoinSpendCheck> *pvChecks)
 {
 	// Check Mint Zerocoin Transaction
 	BOOST_FOREACH(const CTxOut &txout, tx.vout) {
@@ -345,7 +482,7 @@ bool CheckZerocoinTransaction(const CTransaction &tx,
                 case libzerocoin::ZQ_PEDERSEN*COIN:
                 case libzerocoin::ZQ_WILLIAMSON*COIN:
                     if((nHeight >= ZC_V1_5_STARTING_BLOCK + 500)){
-                        if(!CheckSpendZerocoinTransaction(tx, (libzerocoin::CoinDenomination)(txout.nValue / COIN), state, hashTx, isVerifyDB, nHeight, isCheckWallet, zerocoinTxInfo))
+                        if(!CheckSpendZerocoinTransaction(tx, (libzerocoin::CoinDenomination)(txout.nValue / COIN), state, hashTx, isVerifyDB, nHeight, isCheckWallet, zerocoinTxInfo, pvChecks))
                             return false;
                     }
                     else
@@ -386,10 +523,12 @@ bool ConnectTipZC(CValidationState &state, const CChainParams &chainparams, CBlo
                 return false;
             }
         }
-        pindexNew->spentSerials = pblock->zerocoinTxInfo->spentSerials;
+        const CZerocoinBlockData::SerialSet &spentSerials = pblock->zerocoinTxInfo->spentSerials;
+        CZerocoinBlockData::MintMap mintedPubCoins;
+        CZerocoinBlockData::AccumulatorMap accumulatorChanges;
 
         if (pindexNew->nHeight > ZC_CHECK_BUG_FIXED_AT_BLOCK) {
-            BOOST_FOREACH(const CBigNum &serial, pindexNew->spentSerials) {
+            BOOST_FOREACH(const CBigNum &serial, spentSerials) {
                 zerocoinState.AddSpend(serial);
             }
         }
@@ -399,10 +538,15 @@ bool ConnectTipZC(CValidationState &state, const CChainParams &chainparams, CBlo
             int denomination = mint.first;
             CBigNum oldAccValue = ZCParams->accumulatorParams.accumulatorBase;
             int mintId = zerocoinState.AddMint(pindexNew, denomination, mint.second, oldAccValue);
-            LogPrintf("ConnectTipZC: mint added denomination=%d, id=%d\n", denomination, mintId);
+            LogPrint("zerocoin", "ConnectTipZC: mint added denomination=%d, id=%d\n", denomination, mintId);
             pair<int,int> denomAndId = make_pair(denomination, mintId);
 
-            pindexNew->mintedPubCoins[denomAndId].push_back(mint.second);
+            // an earlier mint of this block in the same group is not in the index yet
+            CZerocoinBlockData::AccumulatorMap::const_iterator prevChange = accumulatorChanges.find(denomAndId);
+            if (prevChange != accumulatorChanges.end())
+                oldAccValue = prevChange->second.first;
+
+            mintedPubCoins[denomAndId].push_back(mint.second);
 
             CZerocoinState::CoinGroupInfo coinGroupInfo;
             zerocoinState.GetCoinGroupInfo(denomination, mintId, coinGroupInfo);
@@ -413,15 +557,18 @@ bool ConnectTipZC(CValidationState &state, const CChainParams &chainparams, CBlo
                                                  (libzerocoin::CoinDenomination)denomination);
             accumulator += pubCoin;
 
-            if (pindexNew->accumulatorChanges.count(denomAndId) > 0) {
-                pair<CBigNum,int> &accChange = pindexNew->accumulatorChanges[denomAndId];
+            if (accumulatorChanges.count(denomAndId) > 0) {
+                pair<CBigNum,int> &accChange = accumulatorChanges[denomAndId];
                 accChange.first = accumulator.getValue();
                 accChange.second++;
             }
             else {
-                pindexNew->accumulatorChanges[denomAndId] = make_pair(accumulator.getValue(), 1);
+                accumulatorChanges[denomAndId] = make_pair(accumulator.getValue(), 1);
             }
         }
+
+        pindexNew->SetZerocoinData(mintedPubCoins, accumulatorChanges, spentSerials);
+        zerocoinState.AddAccumulatorCheckpoints(pindexNew, accumulatorChanges);
     }
     else {
         zerocoinState.AddBlock(pindexNew);
@@ -510,7 +657,9 @@ int CZerocoinState::AddMint(CBlockIndex *index, int denomination, const CBigNum
             coinGroup.firstBlock = coinGroup.lastBlock = index;
         }
         else {
-            previousAccValue = coinGroup.lastBlock->accumulatorChanges[make_pair(denomination,mintId)].first;
+            // if lastBlock is index itself the caller knows the value, its zerocoin data isn't set yet
+            int nMints;
+            coinGroup.lastBlock->GetAccumulatorChange(make_pair(denomination,mintId), previousAccValue, nMints);
             coinGroup.lastBlock = index;
         }
     }
@@ -534,8 +683,31 @@ void CZerocoinState::AddSpend(const CBigNum &serial) {
     usedCoinSerials.insert(serial);
 }
 
+void CZerocoinState::AddAccumulatorCheckpoints(CBlockIndex *index, const CZerocoinBlockData::AccumulatorMap &accumulatorChanges) {
+    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int), PAIRTYPE(CBigNum,int)) &accUpdate, accumulatorChanges) {
+        vector<CAccumulatorCheckpoint> &checkpoints = accumulatorCheckpoints[accUpdate.first];
+        assert(checkpoints.empty() || checkpoints.back().nHeight < index->nHeight);
+
+        CAccumulatorCheckpoint checkpoint;
+        checkpoint.nHeight = index->nHeight;
+        checkpoint.pindex = index;
+        checkpoint.nCoins = (checkpoints.empty() ? 0 : checkpoints.back().nCoins) + accUpdate.second.second;
+        checkpoints.push_back(checkpoint);
+    }
+}
+
 void CZerocoinState::AddBlock(CBlockIndex *index) {
-    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int), PAIRTYPE(CBigNum,int)) &accUpdate, index->accumulatorChanges)
+    if (!index->zerocoinData)
+        return;
+
+    CZerocoinBlockData::AccumulatorMap blockAccumulatorChanges;
+    CZerocoinBlockData::MintMap blockPubCoins;
+    CZerocoinBlockData::SerialSet blockSerials;
+    index->GetAccumulatorChanges(blockAccumulatorChanges);
+    index->GetMintedPubCoins(blockPubCoins);
+    index->GetSpentSerials(blockSerials);
+
+    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int), PAIRTYPE(CBigNum,int)) &accUpdate, blockAccumulatorChanges)
     {
         CoinGroupInfo   &coinGroup = coinGroups[accUpdate.first];
 
@@ -545,7 +717,9 @@ void CZerocoinState::AddBlock(CBlockIndex *index) {
         coinGroup.nCoins += accUpdate.second.second;
     }
 
-    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int),vector<CBigNum>) &pubCoins, index->mintedPubCoins) {
+    AddAccumulatorCheckpoints(index, blockAccumulatorChanges);
+
+    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int),vector<CBigNum>) &pubCoins, blockPubCoins) {
         latestCoinIds[pubCoins.first.first] = pubCoins.first.second;
         BOOST_FOREACH(const CBigNum &coin, pubCoins.second) {
             CMintedCoinInfo coinInfo;
@@ -557,38 +731,51 @@ void CZerocoinState::AddBlock(CBlockIndex *index) {
     }
 
     if (index->nHeight > ZC_CHECK_BUG_FIXED_AT_BLOCK) {
-        BOOST_FOREACH(const CBigNum &serial, index->spentSerials) {
+        BOOST_FOREACH(const CBigNum &serial, blockSerials) {
            usedCoinSerials.insert(serial);
         }
     }
 }
 
 void CZerocoinState::RemoveBlock(CBlockIndex *index) {
+    if (!index->zerocoinData)
+        return;
+
+    CZerocoinBlockData::AccumulatorMap blockAccumulatorChanges;
+    CZerocoinBlockData::MintMap blockPubCoins;
+    CZerocoinBlockData::SerialSet blockSerials;
+    index->GetAccumulatorChanges(blockAccumulatorChanges);
+    index->GetMintedPubCoins(blockPubCoins);
+    index->GetSpentSerials(blockSerials);
+
     // roll back accumulator updates
-    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int), PAIRTYPE(CBigNum,int)) &accUpdate, index->accumulatorChanges)
+    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int), PAIRTYPE(CBigNum,int)) &accUpdate, blockAccumulatorChanges)
     {
         CoinGroupInfo   &coinGroup = coinGroups[accUpdate.first];
         int  nMintsToForget = accUpdate.second.second;
 
         assert(coinGroup.nCoins >= nMintsToForget);
 
+        vector<CAccumulatorCheckpoint> &checkpoints = accumulatorCheckpoints[accUpdate.first];
+        assert(!checkpoints.empty() && checkpoints.back().pindex == index);
+        checkpoints.pop_back();
+
         if ((coinGroup.nCoins -= nMintsToForget) == 0) {
             // all the coins of this group have been erased, remove the group altogether
             coinGroups.erase(accUpdate.first);
+            accumulatorCheckpoints.erase(accUpdate.first);
             // decrease pubcoin id for this denomination
             latestCoinIds[accUpdate.first.first]--;
         }
         else {
-            // roll back lastBlock to previous position
-            do {
-                assert(coinGroup.lastBlock != coinGroup.firstBlock);
-                coinGroup.lastBlock = coinGroup.lastBlock->pprev;
-            } while (coinGroup.lastBlock->accumulatorChanges.count(accUpdate.first) == 0);
+            // roll back lastBlock to previous accumulator change
+            assert(!checkpoints.empty());
+            coinGroup.lastBlock = checkpoints.back().pindex;
         }
     }
 
     // roll back mints
-    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int),vector<CBigNum>) &pubCoins, index->mintedPubCoins) {
+    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int),vector<CBigNum>) &pubCoins, blockPubCoins) {
         BOOST_FOREACH(const CBigNum &coin, pubCoins.second) {
             auto coins = mintedPubCoins.equal_range(coin);
             auto coinIt = find_if(coins.first, coins.second, [=](const decltype(mintedPubCoins)::value_type &v) {
@@ -601,7 +788,7 @@ void CZerocoinState::RemoveBlock(CBlockIndex *index) {
     }
 
     // roll back spends
-    BOOST_FOREACH(const CBigNum &serial, index->spentSerials) {
+    BOOST_FOREACH(const CBigNum &serial, blockSerials) {
         usedCoinSerials.erase(serial);
     }
 }
@@ -615,6 +802,11 @@ bool CZerocoinState::GetCoinGroupInfo(int denomination, int id, CoinGroupInfo &r
     return true;
 }
 
+const vector<CAccumulatorCheckpoint> *CZerocoinState::GetAccumulatorCheckpoints(int denomination, int id) const {
+    auto it = accumulatorCheckpoints.find(make_pair(denomination, id));
+    return it != accumulatorCheckpoints.end() ? &it->second : NULL;
+}
+
 bool CZerocoinState::IsUsedCoinSerial(const CBigNum &coinSerial) {
     return usedCoinSerials.count(coinSerial) != 0;
 }
@@ -623,80 +815,111 @@ bool CZerocoinState::HasCoin(const CBigNum &pubCoin) {
     return mintedPubCoins.count(pubCoin) != 0;
 }
 
+// Index of the first checkpoint above given height
+static size_t UpperCheckpoint(const vector<CAccumulatorCheckpoint> &checkpoints, int nHeight) {
+    return upper_bound(checkpoints.begin(), checkpoints.end(), nHeight,
+                       [](int h, const CAccumulatorCheckpoint &cp) { return h < cp.nHeight; }) - checkpoints.begin();
+}
+
 int CZerocoinState::GetAccumulatorValueForSpend(int maxHeight, int denomination, int id, CBigNum &accumulator, uint256 &blockHash) {
     pair<int, int> denomAndId = pair<int, int>(denomination, id);
 
-    if (coinGroups.count(denomAndId) == 0)
+    auto it = accumulatorCheckpoints.find(denomAndId);
+    if (it == accumulatorCheckpoints.end())
         return 0;
 
-    CoinGroupInfo coinGroup = coinGroups[denomAndId];
-    CBlockIndex *lastBlock = coinGroup.lastBlock;
-
-    assert(lastBlock->accumulatorChanges.count(denomAndId) > 0);
-    assert(coinGroup.firstBlock->accumulatorChanges.count(denomAndId) > 0);
-    int numberOfCoins = 0;
-    for (;;) {
-        if (lastBlock->accumulatorChanges.count(denomAndId) > 0) {
-            if (lastBlock->nHeight <= maxHeight) {
-                if (numberOfCoins == 0) {
-                    // latest block satisfying given conditions
-                    // remember accumulator value and block hash
-                    accumulator = lastBlock->accumulatorChanges[denomAndId].first;
-                    blockHash = lastBlock->GetBlockHash();
-                }
-                numberOfCoins += lastBlock->accumulatorChanges[denomAndId].second;
-            }
-        }
-        if (lastBlock == coinGroup.firstBlock)
-            break;
-        else
-            lastBlock = lastBlock->pprev;
-    }
+    // latest block satisfying given conditions
+    const vector<CAccumulatorCheckpoint> &checkpoints = it->second;
+    size_t n = UpperCheckpoint(checkpoints, maxHeight);
+    if (n == 0)
+        return 0;
 
-    return numberOfCoins;
+    const CAccumulatorCheckpoint &checkpoint = checkpoints[n-1];
+    int nMints;
+    bool fHasChange = checkpoint.pindex->GetAccumulatorChange(denomAndId, accumulator, nMints);
+    assert(fHasChange);
+    blockHash = checkpoint.pindex->GetBlockHash();
+
+    return checkpoint.nCoins;
 }
 
-libzerocoin::AccumulatorWitness CZerocoinState::GetWitnessForSpend(CChain *chain, int maxHeight, int denomination, int id, const CBigNum &pubCoin) {
+int CZerocoinState::GetWitnessUpdate(int maxHeight, int denomination, int id, const CBigNum &pubCoin,
+                                     CBigNum &witnessValue, int nWitnessHeight, vector<CBigNum> &coinsToAdd) {
     libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)denomination;
     pair<int, int> denomAndId = pair<int, int>(denomination, id);
 
     assert(coinGroups.count(denomAndId) > 0);
-
-    CoinGroupInfo coinGroup = coinGroups[denomAndId];
+    const vector<CAccumulatorCheckpoint> &checkpoints = accumulatorCheckpoints[denomAndId];
 
     int coinId;
     int mintHeight = GetMintedCoinHeightAndId(pubCoin, denomination, coinId);
 
     assert(coinId == id);
 
-    // Find accumulator value preceding mint operation
-    CBlockIndex *mintBlock = (*chain)[mintHeight];
-    CBlockIndex *block = mintBlock;
-    libzerocoin::Accumulator accumulator(ZCParams, d);
-    if (block != coinGroup.firstBlock) {
-        do {
-            block = block->pprev;
-        } while (block->accumulatorChanges.count(denomAndId) == 0);
-        accumulator = libzerocoin::Accumulator(ZCParams, block->accumulatorChanges[denomAndId].first, d);
+    size_t nFirstCheckpoint;
+    if (nWitnessHeight < mintHeight || nWitnessHeight > maxHeight) {
+        // Start with accumulator value preceding mint operation
+        nFirstCheckpoint = UpperCheckpoint(checkpoints, mintHeight);
+        assert(nFirstCheckpoint > 0 && checkpoints[nFirstCheckpoint-1].nHeight == mintHeight);
+        nFirstCheckpoint--;
+
+        if (nFirstCheckpoint > 0) {
+            int nMints;
+            checkpoints[nFirstCheckpoint-1].pindex->GetAccumulatorChange(denomAndId, witnessValue, nMints);
+        }
+        else {
+            witnessValue = libzerocoin::Accumulator(ZCParams, d).getValue();
+        }
+    }
+    else {
+        // Continue from the stored witness
+        nFirstCheckpoint = UpperCheckpoint(checkpoints, nWitnessHeight);
     }
 
-    // Now add to the accumulator every coin minted since that moment except pubCoin
-    block = coinGroup.lastBlock;
-    while(true) {
-        if (block->nHeight <= maxHeight && block->mintedPubCoins.count(denomAndId) > 0) {
-            vector<CBigNum> &pubCoins = block->mintedPubCoins[denomAndId];
+    // Every coin minted since that moment except pubCoin
+    size_t nLastCheckpoint = UpperCheckpoint(checkpoints, maxHeight);
+    vector<CBigNum> pubCoins;
+    coinsToAdd.clear();
+    for (size_t n = nFirstCheckpoint; n < nLastCheckpoint; n++) {
+        CBlockIndex *block = checkpoints[n].pindex;
+        if (block->GetMintedPubCoins(denomAndId, pubCoins)) {
             for (const CBigNum &coin: pubCoins) {
-                if (block != mintBlock || coin != pubCoin)
-                    accumulator += libzerocoin::PublicCoin(ZCParams, coin, d);
+                if (block->nHeight != mintHeight || coin != pubCoin)
+                    coinsToAdd.push_back(coin);
             }
         }
-        if (block != mintBlock)
-            block = block->pprev;
-        else
-            break;
     }
 
-    return libzerocoin::AccumulatorWitness(ZCParams, accumulator, libzerocoin::PublicCoin(ZCParams, pubCoin, d));
+    return (int)coinsToAdd.size();
+}
+
+void CZerocoinState::AccumulateWitness(int denomination, CBigNum &witnessValue, const vector<CBigNum> &coinsToAdd) {
+    libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)denomination;
+
+    libzerocoin::Accumulator accumulator(ZCParams, witnessValue, d);
+    for (const CBigNum &coin: coinsToAdd)
+        accumulator += libzerocoin::PublicCoin(ZCParams, coin, d);
+    witnessValue = accumulator.getValue();
+}
+
+int CZerocoinState::AdvanceWitness(int maxHeight, int denomination, int id, const CBigNum &pubCoin,
+                                   CBigNum &witnessValue, int &nWitnessHeight) {
+    vector<CBigNum> coinsToAdd;
+    int nAdded = GetWitnessUpdate(maxHeight, denomination, id, pubCoin, witnessValue, nWitnessHeight, coinsToAdd);
+    AccumulateWitness(denomination, witnessValue, coinsToAdd);
+    nWitnessHeight = maxHeight;
+    return nAdded;
+}
+
+libzerocoin::AccumulatorWitness CZerocoinState::GetWitnessForSpend(CChain *chain, int maxHeight, int denomination, int id, const CBigNum &pubCoin) {
+    libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)denomination;
+
+    CBigNum witnessValue;
+    int nWitnessHeight = -1;
+    AdvanceWitness(maxHeight, denomination, id, pubCoin, witnessValue, nWitnessHeight);
+
+    return libzerocoin::AccumulatorWitness(ZCParams, libzerocoin::Accumulator(ZCParams, witnessValue, d),
+                                           libzerocoin::PublicCoin(ZCParams, pubCoin, d));
 }
 
 int CZerocoinState::GetMintedCoinHeightAndId(const CBigNum &pubCoin, int denomination, int &id) {
@@ -717,6 +940,7 @@ void CZerocoinState::Reset() {
     usedCoinSerials.clear();
     mintedPubCoins.clear();
     latestCoinIds.clear();
+    accumulatorCheckpoints.clear();
 }
 
 CZerocoinState *CZerocoinState::GetZerocoinState() {
@@ -10,9 +10,17 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <functional>
+#include <memory>
 
 #define ZEROCOIN_MODULUS   "25195908475657893494027183240048398571429282126204032027777137836043662020707595556264018525880784406918290641249515082189298559149176184502808489120072844992687392807287776735971418347270261896375014971824691165077613379859095700097330459748808428401797429100642458691817195118746121515172654632282216869987549182422433637259085141865462043576798423387184774447920739934236584823824281198163815010674810451660377306056201619676256133844143603833904414952634432190114657544454178424020924616515723350778707749817125772467962926386356373289912154831438167899885040445364023527381951378636564391212010397122822120720357"
 
+// DoS prevention: limit verified zerocoin spend cache to less than 8MB (over 100000 entries on 64-bit systems)
+static const unsigned int DEFAULT_MAX_ZEROCOIN_SPEND_CACHE_SIZE = 8;
+// -zkpthreads default (number of threads of the shared ParallelTasks pool, 0 = auto)
+static const int DEFAULT_ZEROCOIN_THREADS = 0;
+// Maximum number of zerocoin proof threads
+static const int MAX_ZEROCOIN_THREADS = 64;
+
 // Zerocoin transaction info, added to the CBlock to ensure zerocoin mint/spend transactions got their info stored into
 // index
 
@@ -53,13 +61,67 @@ public:
     void Complete();
 };
 
+/**
+ * Block that changed the accumulator of a coin group. Its index entry holds the block hash and the accumulator value
+ */
+struct CAccumulatorCheckpoint
+{
+    int nHeight;
+    CBlockIndex *pindex;
+    // coins of the group minted up to and including this block
+    int nCoins;
+};
+
+/**
+ * Closure representing proof verification of one zerocoin spend against the accumulator values of its coin group.
+ * Holds pointers into the block index, so it must be run to completion while the queuing thread holds cs_main
+ */
+class CZerocoinSpendCheck
+{
+private:
+    std::shared_ptr<libzerocoin::CoinSpend> spend;
+    libzerocoin::CoinDenomination denomination;
+    int pubcoinId;
+    uint256 txHashForMetadata;
+    // accumulator checkpoints of the coin group (NULL if none) and the block named by the spend (if any)
+    const std::vector<CAccumulatorCheckpoint> *pCheckpoints;
+    CBlockIndex *pindexStart;
+    bool fSpendHasBlockHash;
+    int nHeight;
+
+public:
+    CZerocoinSpendCheck(): denomination(libzerocoin::ZQ_LOVELACE), pubcoinId(0), pCheckpoints(NULL),
+        pindexStart(NULL), fSpendHasBlockHash(false), nHeight(0) {}
+    CZerocoinSpendCheck(const std::shared_ptr<libzerocoin::CoinSpend> &spendIn, libzerocoin::CoinDenomination denominationIn,
+                        int pubcoinIdIn, const uint256 &txHashForMetadataIn,
+                        const std::vector<CAccumulatorCheckpoint> *pCheckpointsIn, CBlockIndex *pindexStartIn,
+                        bool fSpendHasBlockHashIn, int nHeightIn) :
+        spend(spendIn), denomination(denominationIn), pubcoinId(pubcoinIdIn), txHashForMetadata(txHashForMetadataIn),
+        pCheckpoints(pCheckpointsIn), pindexStart(pindexStartIn),
+        fSpendHasBlockHash(fSpendHasBlockHashIn), nHeight(nHeightIn) {}
+
+    bool operator()();
+
+    void swap(CZerocoinSpendCheck &check) {
+        spend.swap(check.spend);
+        std::swap(denomination, check.denomination);
+        std::swap(pubcoinId, check.pubcoinId);
+        std::swap(txHashForMetadata, check.txHashForMetadata);
+        std::swap(pCheckpoints, check.pCheckpoints);
+        std::swap(pindexStart, check.pindexStart);
+        std::swap(fSpendHasBlockHash, check.fSpendHasBlockHash);
+        std::swap(nHeight, check.nHeight);
+    }
+};
+
 bool CheckZerocoinTransaction(const CTransaction &tx,
 	CValidationState &state,
 	uint256 hashTx,
 	bool isVerifyDB,
 	int nHeight,
     bool isCheckWallet,
-    CZerocoinTxInfo *zerocoinTxInfo);
+    CZerocoinTxInfo *zerocoinTxInfo,
+    std::vector<CZerocoinSpendCheck> *pvChecks = NULL);
 
 void DisconnectTipZC(CBlock &block, CBlockIndex *pindexDelete);
 bool ConnectTipZC(CValidationState &state, const CChainParams &chainparams, CBlockIndex *pindexNew, const CBlock *pblock);
@@ -105,6 +167,8 @@ private:
     unordered_multimap<CBigNum,CMintedCoinInfo,CBigNumHash> mintedPubCoins;
     // Latest IDs of coins by denomination
     map<int, int> latestCoinIds;
+    // Blocks that changed the accumulator of each coin group, ordered by height
+    map<pair<int, int>, vector<CAccumulatorCheckpoint>> accumulatorCheckpoints;
 
 public:
     CZerocoinState();
@@ -113,6 +177,8 @@ public:
     int AddMint(CBlockIndex *index, int denomination, const CBigNum &pubCoin, CBigNum &previousAccValue);
     // Add serial to the list of used ones
     void AddSpend(const CBigNum &serial);
+    // Record accumulator changes of the block, called after its mints were added
+    void AddAccumulatorCheckpoints(CBlockIndex *index, const CZerocoinBlockData::AccumulatorMap &accumulatorChanges);
 
     // Add everything from the block to the state
     void AddBlock(CBlockIndex *index);
@@ -121,6 +187,8 @@ public:
 
     // Query coin group with given denomination and id
     bool GetCoinGroupInfo(int denomination, int id, CoinGroupInfo &result);
+    // Accumulator checkpoints of coin group with given denomination and id, NULL if there are none. Valid while cs_main is held
+    const vector<CAccumulatorCheckpoint> *GetAccumulatorCheckpoints(int denomination, int id) const;
 
     // Query if the coin serial was previously used
     bool IsUsedCoinSerial(const CBigNum &coinSerial);
@@ -132,6 +200,19 @@ public:
     // Returns number of coins satisfying conditions
     int GetAccumulatorValueForSpend(int maxHeight, int denomination, int id, CBigNum &accumulator, uint256 &blockHash);
 
+    // Bring witness value of pubCoin from nWitnessHeight up to maxHeight. Witness is built from scratch if
+    // nWitnessHeight is -1 or out of range. The caller must make sure the chain wasn't reorganized below
+    // nWitnessHeight. Returns number of coins accumulated
+    int AdvanceWitness(int maxHeight, int denomination, int id, const CBigNum &pubCoin, CBigNum &witnessValue, int &nWitnessHeight);
+
+    // First half of AdvanceWitness, needs cs_main: sets witnessValue to the accumulator value to start from (left as
+    // is if the witness at nWitnessHeight can be continued) and fills coinsToAdd. Returns number of coins to add
+    int GetWitnessUpdate(int maxHeight, int denomination, int id, const CBigNum &pubCoin, CBigNum &witnessValue,
+                         int nWitnessHeight, vector<CBigNum> &coinsToAdd);
+    // Second half of AdvanceWitness: accumulates coinsToAdd into witnessValue. Doesn't touch the state, so it
+    // can run without cs_main
+    static void AccumulateWitness(int denomination, CBigNum &witnessValue, const vector<CBigNum> &coinsToAdd);
+
     // Get witness
     libzerocoin::AccumulatorWitness GetWitnessForSpend(CChain *chain, int maxHeight, int denomination, int id, const CBigNum &pubCoin);
 